@@ -4,7 +4,7 @@ CONFIG(release, debug|release): DEFINES += NDEBUG
 DEFINES += "FREEGLUT_STATIC=1"
 
 # needed by freeglut: -lwinmm  -lgdi32
-win:LIBS += -lfreeglut_static -lopengl32 -lglu32 -lwinmm  -lgdi32
+win:LIBS += -lfreeglut_static -lopengl32 -lglu32 -lwinmm  -lgdi32 -lpsapi
 
 QMAKE_CXXFLAGS_RELEASE -= -O2
 QMAKE_CXXFLAGS_RELEASE += -O3
@@ -16,10 +16,14 @@ INCLUDEPATH += C:/Qt/Tools/mingw730_64/x86_64-w64-mingw32/include
 
 SOURCES += \
     $$files(src/*.cpp) \
-    $$files(src/topology/*.cpp)
+    $$files(src/topology/*.cpp) \
+    $$files(src/io/*.cpp) \
+    $$files(src/utils/*.cpp)
 
 HEADERS += \
     $$files(src/*.hpp) \
-    $$files(src/topology/*.hpp)
+    $$files(src/topology/*.hpp) \
+    $$files(src/io/*.hpp) \
+    $$files(src/utils/*.hpp)
 
-CONFIG += c++14
+CONFIG += c++17
@@ -0,0 +1,386 @@
+/*
+ * Accuracy harness: compare solver configurations against known harmonic
+ * functions.
+ *
+ * harmonic_weights_accuracy [options]
+ * Every vertex on a side of the mesh is fixed to the value of an analytic
+ * harmonic function f (x, x^2 - y^2, Re(z^3)...), the Laplace equation is
+ * solved for the others and compared to f. Running this for each solver
+ * configuration and mesh resolution gives error versus time curves, and the
+ * cheapest configuration meeting an accuracy target.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "mesh.hpp"
+#include "topology/vertex_to_face.hpp"
+#include "topology/vertex_to_1st_ring_vertices.hpp"
+#include "solvers.hpp"
+#include "utils/cli_args.hpp"
+#include "utils/json.hpp"
+#include "utils/mute_cout.hpp"
+#include "utils/parallel_for.hpp"
+
+// -----------------------------------------------------------------------------
+
+/// Harmonic functions of the plane (their Laplacian is zero)
+struct Harmonic_function {
+    const char* _name;
+    double (*_eval)(double x, double y);
+};
+
+static const Harmonic_function g_functions[] = {
+    {"x",       [](double x, double  ) { return x; }},
+    {"xy",      [](double x, double y) { return x * y; }},
+    {"x2-y2",   [](double x, double y) { return x * x - y * y; }},
+    {"re_z3",   [](double x, double y) { return x * x * x - 3. * x * y * y; }},
+    {"exp_cos", [](double x, double y) { return std::exp(x) * std::cos(y); }},
+};
+
+// -----------------------------------------------------------------------------
+
+static void print_usage(const char* exe)
+{
+    std::cout << "Usage: " << exe << " [options]\n";
+    std::cout << "Options:\n";
+    std::cout << "  --meshes <m,m,...>     mesh files or generators (e.g. gen:jittered:100K)\n";
+    std::cout << "                         (default: samples/plane_*.off)\n";
+    std::cout << "  --functions <f,f,...>  x, xy, x2-y2, re_z3, exp_cos (default: all)\n";
+    std::cout << "  --solvers <s,s,...>    solver configurations (see harmonic_weights_cli -h)\n";
+    std::cout << "                         (default: lu, lu:float, ldlt, ldlt:float, cg with\n";
+    std::cout << "                         tolerances 1e-4 to 1e-10, cg:1e-5:float, bicgstab:1e-8)\n";
+    std::cout << "  --triangles            build the Laplacian from the list of triangles\n";
+    std::cout << "  --target <error>       report the fastest configuration whose maximal error\n";
+    std::cout << "                         over every function is below <error> (default: 1e-2)\n";
+    std::cout << "  -r, --repetitions <n>  runs of each configuration, median time (default: 3)\n";
+    std::cout << "  --threads <n>          number of threads (default: every hardware thread)\n";
+    std::cout << "  -o, --output <file>    JSON report (default: accuracy.json)\n";
+    std::cout << "  -h, --help             print this message" << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+
+struct Accuracy_options {
+    Accuracy_options()
+        : _use_half_edges(true)
+        , _target(1e-2)
+        , _repetitions(3)
+        , _nb_threads(0)
+        , _output("accuracy.json")
+    {
+        _solvers = {"lu", "lu:float", "ldlt", "ldlt:float",
+                    "cg:1e-4", "cg:1e-6", "cg:1e-8", "cg:1e-10",
+                    "cg:1e-5:float", "bicgstab:1e-8"};
+    }
+
+    std::vector<std::string> _meshes;
+    std::vector<std::string> _functions;
+    std::vector<std::string> _solvers;
+    bool _use_half_edges;
+    double _target;
+    int _repetitions;
+    unsigned _nb_threads;
+    const char* _output;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @return false if the command line is invalid (message printed on std::cerr)
+static bool parse_arguments(int argc, char** argv, Accuracy_options& opt, bool& help)
+{
+    help = false;
+    Cli_args args(argc, argv);
+    while( args.next() )
+    {
+        const char* str = nullptr;
+        long long nb = 0;
+        if( args.is("-h", "--help") ) {
+            help = true;
+            return true;
+        } else if( args.is("--triangles") ) {
+            opt._use_half_edges = false;
+        } else if( args.is("--meshes") ) {
+            if( (str = args.value()) == nullptr )
+                return false;
+            opt._meshes = split_list(str);
+        } else if( args.is("--functions") ) {
+            if( (str = args.value()) == nullptr )
+                return false;
+            opt._functions = split_list(str);
+        } else if( args.is("--solvers") ) {
+            if( (str = args.value()) == nullptr )
+                return false;
+            opt._solvers = split_list(str);
+        } else if( args.is("--target") ) {
+            if( !args.value(opt._target) )
+                return false;
+            if( opt._target <= 0. )
+                return args.invalid(args.arg());
+        } else if( args.is("-r", "--repetitions") ) {
+            if( !args.value(nb) )
+                return false;
+            if( nb < 1 || nb > INT_MAX )
+                return args.invalid(args.arg());
+            opt._repetitions = int(nb);
+        } else if( args.is("--threads") ) {
+            if( !args.value(opt._nb_threads) )
+                return false;
+        } else if( args.is("-o", "--output") ) {
+            if( (opt._output = args.value()) == nullptr )
+                return false;
+        } else {
+            std::cerr << "Unknown option: " << args.arg() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// =============================================================================
+
+/// Result of one solver configuration on one function
+struct Run_result {
+    double _time;         ///< median of assembly + factorization + solve (s)
+    int _iterations;
+    double _max_error;    ///< against the analytic function
+    double _l2_error;     ///< root mean square over the free vertices
+    double _solver_error; ///< max difference with the reference direct solve
+};
+
+// -----------------------------------------------------------------------------
+
+/// Solve 'reps' times with 'options'
+/// @return false if the solver failed
+static bool run_solver(const Mesh& mesh,
+                       const std::vector< std::vector<int> >& edges,
+                       const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                       const Solver_options& options,
+                       int reps,
+                       std::vector<double>& weights,
+                       double& median_time,
+                       int& iterations)
+{
+    std::vector<double> times( reps );
+    for(int r = 0; r < reps; ++r) {
+        Solve_timings timings;
+        Mute_cout mute;
+        if( !solve_laplace_equation(mesh._vertices, edges, mesh._triangles,
+                                    boundaries, weights, &timings, &options) )
+        {
+            return false;
+        }
+        times[r] = timings.total() - timings._laplacian;
+        iterations = timings._iterations;
+    }
+    std::sort(times.begin(), times.end());
+    median_time = times[ reps / 2 ];
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// @return list of samples/plane_*.off
+static std::vector<std::string> default_meshes()
+{
+    std::vector<std::string> files;
+    std::error_code err;
+    for(const auto& entry : std::filesystem::directory_iterator("samples", err)) {
+        std::string name = entry.path().filename().string();
+        if( name.compare(0, 6, "plane_") == 0 && entry.path().extension() == ".off" )
+            files.push_back( entry.path().generic_string() );
+    }
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+// =============================================================================
+
+int main(int argc, char** argv)
+{
+    Accuracy_options opt;
+    bool help = false;
+    if( !parse_arguments(argc, argv, opt, help) ) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if( help ) {
+        print_usage(argv[0]);
+        return EXIT_SUCCESS;
+    }
+    set_nb_threads( opt._nb_threads );
+
+    if( opt._meshes.empty() )
+        opt._meshes = default_meshes();
+    if( opt._meshes.empty() ) {
+        std::cerr << "No mesh to test (no samples/plane_*.off, see --meshes)" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<const Harmonic_function*> functions;
+    for(const Harmonic_function& f : g_functions)
+        if( opt._functions.empty() || std::count(opt._functions.begin(), opt._functions.end(), f._name) )
+            functions.push_back( &f );
+    if( functions.size() < std::max(opt._functions.size(), size_t(1)) ) {
+        std::cerr << "Unknown harmonic function (expected x, xy, x2-y2, re_z3 or exp_cos)" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Solver_options> solvers( opt._solvers.size() );
+    for(unsigned s = 0; s < solvers.size(); ++s)
+        if( !parse_solver_options(opt._solvers[s].c_str(), solvers[s]) )
+            return EXIT_FAILURE;
+
+    // Reference solution: direct solve in double precision
+    Solver_options reference;
+    reference._solver = "ldlt";
+
+    Json_value results = Json_value::array();
+    Json_value cheapest = Json_value::array();
+
+    for(const std::string& mesh_path : opt._meshes)
+    {
+        std::unique_ptr<Mesh> mesh_ptr( build_mesh(mesh_path.c_str()) );
+        if( mesh_ptr == nullptr )
+            return EXIT_FAILURE;
+        const Mesh& mesh = *mesh_ptr;
+        const int nv = int(mesh.nb_vertices());
+
+        Vertex_to_face v_to_face;
+        Vertex_to_1st_ring_vertices first_ring;
+        v_to_face.compute( mesh );
+        first_ring.compute(mesh, v_to_face);
+        std::vector< std::vector<int> > edges;
+        if( opt._use_half_edges )
+            edges = first_ring._rings_per_vertex;
+
+        std::printf("\n%s (%d vertices, %d on sides)\n", mesh_path.c_str(), nv,
+                    int(first_ring._on_side_verts.size()));
+        if( first_ring._on_side_verts.empty() ) {
+            std::cerr << "Skipped: the mesh has no side to set boundary conditions" << std::endl;
+            continue;
+        }
+        std::printf("  %-8s %-21s %10s %6s %11s %11s %11s\n",
+                    "function", "solver", "time (ms)", "iters", "max error", "l2 error", "solver err");
+
+        // Worst error over the functions for each solver
+        std::vector<double> worst_error( solvers.size(), 0. );
+        std::vector<double> total_time( solvers.size(), 0. );
+        std::vector<bool> failed( solvers.size(), false );
+        for(const Harmonic_function* f : functions)
+        {
+            std::vector<double> exact( nv );
+            parallel_for(0, nv, [&](int v) {
+                exact[v] = f->_eval(mesh._vertices[v].x, mesh._vertices[v].y);
+            });
+            std::vector<std::pair<Vert_idx, float> > boundaries;
+            std::vector<bool> is_fixed( nv, false );
+            for(Vert_idx v : first_ring._on_side_verts) {
+                boundaries.push_back( std::make_pair(v, float(exact[v])) );
+                is_fixed[v] = true;
+            }
+
+            std::vector<double> ref;
+            double ref_time = 0.;
+            int ref_iter = 0;
+            if( !run_solver(mesh, edges, boundaries, reference, 1, ref, ref_time, ref_iter) )
+                return EXIT_FAILURE;
+
+            for(unsigned s = 0; s < solvers.size(); ++s)
+            {
+                Run_result res;
+                std::vector<double> weights;
+                if( !run_solver(mesh, edges, boundaries, solvers[s], opt._repetitions,
+                                weights, res._time, res._iterations) )
+                {
+                    failed[s] = true;
+                    continue;
+                }
+
+                res._max_error = 0.;
+                res._solver_error = 0.;
+                double sum = 0.;
+                int nb_free = 0;
+                for(int v = 0; v < nv; ++v) {
+                    if( is_fixed[v] )
+                        continue;
+                    double err = std::abs(weights[v] - exact[v]);
+                    res._max_error = std::max(res._max_error, err);
+                    res._solver_error = std::max(res._solver_error, std::abs(weights[v] - ref[v]));
+                    sum += err * err;
+                    ++nb_free;
+                }
+                res._l2_error = nb_free > 0 ? std::sqrt(sum / nb_free) : 0.;
+                worst_error[s] = std::max(worst_error[s], res._max_error);
+                total_time[s] += res._time;
+
+                std::string name = solver_options_string(solvers[s]);
+                std::printf("  %-8s %-21s %10.3f %6d %11.3e %11.3e %11.3e\n",
+                            f->_name, name.c_str(), res._time * 1000.0, res._iterations,
+                            res._max_error, res._l2_error, res._solver_error);
+
+                Json_value entry = Json_value::object();
+                entry["mesh"] = mesh_path;
+                entry["vertices"] = nv;
+                entry["function"] = f->_name;
+                entry["solver"] = name;
+                entry["time_s"] = res._time;
+                entry["iterations"] = res._iterations;
+                entry["max_error"] = res._max_error;
+                entry["l2_error"] = res._l2_error;
+                entry["solver_error"] = res._solver_error;
+                results.push_back( entry );
+            }
+        }
+
+        // Fastest configuration meeting the target on every function
+        int best = -1;
+        for(unsigned s = 0; s < solvers.size(); ++s) {
+            if( failed[s] || worst_error[s] > opt._target )
+                continue;
+            if( best < 0 || total_time[s] < total_time[best] )
+                best = int(s);
+        }
+        if( best < 0 ) {
+            std::printf("  No configuration reaches a max error of %g\n", opt._target);
+            continue;
+        }
+        std::string name = solver_options_string(solvers[best]);
+        std::printf("  Fastest with max error <= %g: %s (%.3f ms per solve, max error %.3e)\n",
+                    opt._target, name.c_str(), total_time[best] * 1000.0 / functions.size(),
+                    worst_error[best]);
+
+        Json_value entry = Json_value::object();
+        entry["mesh"] = mesh_path;
+        entry["vertices"] = nv;
+        entry["solver"] = name;
+        entry["time_s"] = total_time[best] / functions.size();
+        entry["max_error"] = worst_error[best];
+        cheapest.push_back( entry );
+    }
+
+    // Boundary values are stored as floats: errors below ~1e-7 times the
+    // magnitude of the function are not meaningful
+    Json_value report = Json_value::object();
+    Json_value& config = report["config"];
+    config["threads"] = get_nb_threads();
+    config["repetitions"] = opt._repetitions;
+    config["laplacian"] = opt._use_half_edges ? "rings" : "triangles";
+    config["target"] = opt._target;
+    report["results"] = results;
+    report["cheapest"] = cheapest;
+    if( !write_json_file(opt._output, report) )
+        return EXIT_FAILURE;
+    std::cout << "\nReport written to " << opt._output << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,183 @@
+/*
+ * Batch runner: harmonic weights of every mesh of a manifest.
+ *
+ * harmonic_weights_batch <manifest.json> [options]
+ * Runs the jobs of the manifest (see batch/batch_runner.hpp) on every core,
+ * prints one line per mesh done, writes per job timings and failures to a
+ * JSON summary and the throughput in meshes per hour at the end.
+ * Exit code is 2 when at least one job failed.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "batch/batch_runner.hpp"
+#include "io/mesh_cache.hpp"
+#include "io/solve_cache.hpp"
+#include "utils/cli_args.hpp"
+#include "utils/json.hpp"
+#include "utils/mute_cout.hpp"
+
+// -----------------------------------------------------------------------------
+
+static void print_usage(const char* exe)
+{
+    std::cout << "Usage: " << exe << " <manifest.json> [options]\n";
+    std::cout << "Options:\n";
+    std::cout << "  --summary <file>       per job timings and failures (default: batch_summary.json)\n";
+    std::cout << "  --workers <n>          number of threads (default: every hardware thread)\n";
+    std::cout << "  --big-mesh <vertices>  meshes from this size are solved one at a time with\n";
+    std::cout << "                         every thread, smaller ones one per thread (default: 250K)\n";
+    std::cout << "  --no-cache             don't read nor write the binary mesh cache\n";
+    std::cout << "  --mesh-cache <dir>     directory of the binary mesh cache\n";
+    std::cout << "                         (default: ~/.cache/harmonic_weights)\n";
+    std::cout << "  --solve-cache <dir>    reuse the weights, and the factorizations of ldlt / llt\n";
+    std::cout << "                         (not lu, whose factors are not kept)\n";
+    std::cout << "  --verbose              keep the messages of the solver\n";
+    std::cout << "  -h, --help             print this message" << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+
+struct Batch_cli_options {
+    Batch_cli_options()
+        : _manifest(nullptr)
+        , _summary("batch_summary.json")
+        , _use_cache(true)
+        , _mesh_cache(nullptr)
+        , _solve_cache(nullptr)
+        , _verbose(false)
+    { }
+
+    const char* _manifest;
+    const char* _summary;
+    Batch_options _batch;
+    bool _use_cache;
+    const char* _mesh_cache;
+    const char* _solve_cache;
+    bool _verbose;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @return false if the command line is invalid (message printed on std::cerr)
+static bool parse_arguments(int argc, char** argv, Batch_cli_options& opt, bool& help)
+{
+    help = false;
+    Cli_args args(argc, argv);
+    while( args.next() )
+    {
+        const char* str = nullptr;
+        char* end = nullptr;
+        if( args.is("-h", "--help") ) {
+            help = true;
+            return true;
+        } else if( args.is("--summary") ) {
+            if( (opt._summary = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--workers") ) {
+            if( !args.value(opt._batch._nb_workers) )
+                return false;
+        } else if( args.is("--big-mesh") ) {
+            if( (str = args.value()) == nullptr )
+                return false;
+            double nb = std::strtod(str, &end);
+            if( end != str && (*end == 'K' || *end == 'k') ) { nb *= 1e3; ++end; }
+            else if( end != str && (*end == 'M' || *end == 'm') ) { nb *= 1e6; ++end; }
+            if( end == str || *end != '\0' || nb < 0. )
+                return args.invalid(str);
+            opt._batch._big_mesh_vertices = (long long)nb;
+        } else if( args.is("--no-cache") ) {
+            opt._use_cache = false;
+        } else if( args.is("--mesh-cache") ) {
+            if( (opt._mesh_cache = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--solve-cache") ) {
+            if( (opt._solve_cache = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--verbose") ) {
+            opt._verbose = true;
+        } else if( args.arg()[0] == '-' || opt._manifest != nullptr ) {
+            std::cerr << "Unknown option: " << args.arg() << std::endl;
+            return false;
+        } else {
+            opt._manifest = args.arg();
+        }
+    }
+    if( opt._manifest == nullptr ) {
+        std::cerr << "Missing manifest file" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// One line on std::cerr per job done
+static void print_progress(const Batch_job_record& rec, int nb_done, int nb_jobs)
+{
+    char line[256];
+    std::snprintf(line, sizeof(line), "[%d/%d] %-6s %s: ", nb_done, nb_jobs,
+                  rec._big ? "big" : "packed", rec._name.c_str());
+    std::cerr << line;
+    if( !rec._error.empty() ) {
+        std::cerr << "FAILED (" << rec._error << ")" << std::endl;
+        return;
+    }
+    std::cerr << rec._nb_vertices << " vertices, " << rec._total << " s";
+    for(const Batch_solve_record& s : rec._solves)
+        if( !s._ok )
+            std::cerr << ", " << s._boundary << " FAILED (" << s._error << ")";
+    std::cerr << std::endl;
+}
+
+// =============================================================================
+
+int main(int argc, char** argv)
+{
+    Batch_cli_options opt;
+    bool help = false;
+    if( !parse_arguments(argc, argv, opt, help) ) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if( help ) {
+        print_usage(argv[0]);
+        return EXIT_SUCCESS;
+    }
+
+    set_mesh_cache_enabled( opt._use_cache );
+    if( opt._mesh_cache != nullptr )
+        set_mesh_cache_directory( opt._mesh_cache );
+    if( opt._solve_cache != nullptr )
+        set_solve_cache_dir( opt._solve_cache );
+
+    Batch_manifest manifest;
+    if( !read_batch_manifest(opt._manifest, manifest) )
+        return EXIT_FAILURE;
+    std::cerr << manifest._jobs.size() << " meshes to process" << std::endl;
+
+    Batch_report report;
+    {
+        // solve_laplace_equation() and the loaders are verbose
+        std::unique_ptr<Mute_cout> mute( opt._verbose ? nullptr : new Mute_cout() );
+        if( !run_batch(manifest, opt._batch, report, print_progress) )
+            return EXIT_FAILURE;
+    }
+
+    Json_value summary = report.to_json();
+    summary["manifest"] = opt._manifest;
+    summary["big_mesh_vertices"] = opt._batch._big_mesh_vertices;
+    if( !write_json_file(opt._summary, summary) )
+        return EXIT_FAILURE;
+
+    int nb_failed = report.nb_failed_jobs();
+    std::cerr << report._jobs.size() - nb_failed << " meshes done, " << nb_failed << " failed in "
+              << report._wall << " s on " << report._nb_workers << " workers ("
+              << report.meshes_per_hour() << " meshes/hour, " << report._nb_steals << " steals)\n";
+    std::cerr << "Summary written to " << opt._summary << std::endl;
+    return nb_failed > 0 ? 2 : EXIT_SUCCESS;
+}
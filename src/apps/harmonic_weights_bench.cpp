@@ -0,0 +1,624 @@
+/*
+ * Benchmark of the harmonic weights pipeline.
+ *
+ * harmonic_weights_bench [options]
+ * Times every phase (load, topology, Laplacian, factorization, solve, weight
+ * interpolation at surface points) on the meshes of a directory and on
+ * generated meshes of increasing size. Results (median / p95 times,
+ * throughput, peak memory) are written as JSON, which
+ * can serve as a baseline for later runs: phases slower than the baseline
+ * are reported as regressions.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <random>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "mesh.hpp"
+#include "mesh_generators.hpp"
+#include "topology/vertex_to_face.hpp"
+#include "topology/vertex_to_1st_ring_vertices.hpp"
+#include "io/mesh_loader.hpp"
+#include "boundary_conditions.hpp"
+#include "solvers.hpp"
+#include "weight_sampler.hpp"
+#include "utils/cli_args.hpp"
+#include "utils/json.hpp"
+#include "utils/memory_usage.hpp"
+#include "utils/mute_cout.hpp"
+#include "utils/parallel_for.hpp"
+#include "utils/trace.hpp"
+#include "utils/timer.hpp"
+
+// -----------------------------------------------------------------------------
+
+static void print_usage(const char* exe)
+{
+    std::cout << "Usage: " << exe << " [options]\n";
+    std::cout << "Options:\n";
+    std::cout << "  --samples <dir>          meshes to benchmark (default: samples)\n";
+    std::cout << "  --no-samples             only benchmark generated meshes\n";
+    std::cout << "  --scales <n,n,...>       number of vertices of the generated meshes\n";
+    std::cout << "                           (default: 10000,100000,1000000,10000000)\n";
+    std::cout << "  --generators <k,k,...>   kinds of generated meshes: grid, jittered, holes,\n";
+    std::cout << "                           icosphere, torus (default: grid)\n";
+    std::cout << "  --no-synthetic           only benchmark the meshes of --samples\n";
+    std::cout << "  -r, --repetitions <n>    runs of each phase (default: 5)\n";
+    std::cout << "  --max-solve-vertices <n> skip factorization and solve above this\n";
+    std::cout << "                           number of vertices (default: 100000)\n";
+    std::cout << "  --queries <n>            surface points of the interpolation phase\n";
+    std::cout << "                           (default: 100000, 0 to skip it)\n";
+    std::cout << "  -b, --boundary <spec>    boundary conditions preset (default: cone)\n";
+    std::cout << "  --solvers <s,s,...>      solver configurations to sweep, e.g. lu,ldlt,cg:1e-8\n";
+    std::cout << "                           (default: lu, see harmonic_weights_cli -h)\n";
+    std::cout << "  --threads <n>            number of threads (default: every hardware thread)\n";
+    std::cout << "  -o, --output <file>      JSON report (default: bench.json)\n";
+    std::cout << "  --baseline <file>        compare against a previous JSON report\n";
+    std::cout << "  --threshold <ratio>      slowdown flagged as a regression (default: 0.1 = 10%)\n";
+    std::cout << "  --min-delta <seconds>    ignore slowdowns below this duration (default: 0.001)\n";
+    std::cout << "  --trace <file.json>      record every phase in Chrome trace format\n";
+    std::cout << "  -h, --help               print this message\n";
+    std::cout << "Exit code is 2 when regressions are found." << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+
+struct Bench_options {
+    Bench_options()
+        : _samples_dir("samples")
+        , _use_samples(true)
+        , _use_synthetic(true)
+        , _repetitions(5)
+        , _max_solve_vertices(100000)
+        , _nb_queries(100000)
+        , _boundary("cone")
+        , _nb_threads(0)
+        , _output("bench.json")
+        , _baseline(nullptr)
+        , _threshold(0.1)
+        , _min_delta(0.001)
+        , _trace(nullptr)
+    {
+        _scales = {10000, 100000, 1000000, 10000000};
+        _generators = {"grid"};
+        _solvers = {Solver_options()};
+    }
+
+    const char* _samples_dir;
+    bool _use_samples;
+    bool _use_synthetic;
+    std::vector<long long> _scales;
+    std::vector<std::string> _generators;
+    int _repetitions;
+    long long _max_solve_vertices;
+    long long _nb_queries;
+    const char* _boundary;
+    std::vector<Solver_options> _solvers;
+    unsigned _nb_threads;
+    const char* _output;
+    const char* _baseline;
+    double _threshold;
+    double _min_delta;
+    const char* _trace;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @return false if the command line is invalid (message printed on std::cerr)
+static bool parse_arguments(int argc, char** argv, Bench_options& opt, bool& help)
+{
+    help = false;
+    Cli_args args(argc, argv);
+    while( args.next() )
+    {
+        long long n = 0;
+        const char* str = nullptr;
+        if( args.is("-h", "--help") ) {
+            help = true;
+            return true;
+        } else if( args.is("--no-samples") ) {
+            opt._use_samples = false;
+        } else if( args.is("--no-synthetic") ) {
+            opt._use_synthetic = false;
+        } else if( args.is("--samples") ) {
+            if( (opt._samples_dir = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--scales") ) {
+            if( (str = args.value()) == nullptr )
+                return false;
+            opt._scales.clear();
+            for(const std::string& item : split_list(str)) {
+                if( !parse_count(item.c_str(), n) || n < 4 )
+                    return args.invalid(str);
+                opt._scales.push_back( n );
+            }
+        } else if( args.is("--generators") ) {
+            if( (str = args.value()) == nullptr )
+                return false;
+            opt._generators = split_list(str);
+        } else if( args.is("--solvers") ) {
+            if( (str = args.value()) == nullptr )
+                return false;
+            opt._solvers.clear();
+            for(const std::string& item : split_list(str)) {
+                Solver_options solver;
+                if( !parse_solver_options(item.c_str(), solver) )
+                    return false;
+                opt._solvers.push_back( solver );
+            }
+        } else if( args.is("-r", "--repetitions") ) {
+            if( !args.value(n) )
+                return false;
+            if( n < 1 || n > INT_MAX )
+                return args.invalid(args.arg());
+            opt._repetitions = int(n);
+        } else if( args.is("--max-solve-vertices") ) {
+            if( !args.value(opt._max_solve_vertices) )
+                return false;
+        } else if( args.is("--queries") ) {
+            if( !args.value(opt._nb_queries) )
+                return false;
+            if( opt._nb_queries > INT_MAX )
+                return args.invalid(args.arg());
+        } else if( args.is("-b", "--boundary") ) {
+            if( (opt._boundary = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--threads") ) {
+            if( !args.value(opt._nb_threads) )
+                return false;
+        } else if( args.is("-o", "--output") ) {
+            if( (opt._output = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--baseline") ) {
+            if( (opt._baseline = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--threshold") ) {
+            if( !args.value(opt._threshold) )
+                return false;
+        } else if( args.is("--min-delta") ) {
+            if( !args.value(opt._min_delta) )
+                return false;
+        } else if( args.is("--trace") ) {
+            if( (opt._trace = args.value()) == nullptr )
+                return false;
+        } else {
+            std::cerr << "Unknown option: " << args.arg() << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// =============================================================================
+// Measures
+// =============================================================================
+
+/// @return value at percentile 'p' in [0 1] (nearest rank)
+static double percentile(std::vector<double> times, double p)
+{
+    std::sort(times.begin(), times.end());
+    size_t rank = size_t( std::ceil(p * double(times.size())) );
+    return times[ std::min(std::max(rank, size_t(1)), times.size()) - 1 ];
+}
+
+// -----------------------------------------------------------------------------
+
+/// Summary of the run times of a phase
+static Json_value phase_json(const std::string& name, const std::vector<double>& times, unsigned nb_vertices)
+{
+    double median = percentile(times, 0.5);
+    Json_value phase = Json_value::object();
+    phase["name"] = name;
+    phase["repetitions"] = unsigned(times.size());
+    phase["median_s"] = median;
+    phase["p95_s"] = percentile(times, 0.95);
+    phase["min_s"] = *std::min_element(times.begin(), times.end());
+    phase["vertices_per_s"] = median > 0. ? double(nb_vertices) / median : 0.;
+    return phase;
+}
+
+/// Same with the throughput of a phase answering 'nb_queries' queries
+static Json_value phase_json(const std::string& name,
+                             const std::vector<double>& times,
+                             unsigned nb_vertices,
+                             unsigned nb_queries)
+{
+    Json_value phase = phase_json(name, times, nb_vertices);
+    double median = phase.find("median_s")->as_number();
+    phase["queries"] = nb_queries;
+    phase["queries_per_s"] = median > 0. ? double(nb_queries) / median : 0.;
+    return phase;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Print a phase summary as one row of the console table
+static void print_phase(const Json_value& phase)
+{
+    const Json_value* queries = phase.find("queries_per_s");
+    std::printf("  %-20s median %10.3f ms  p95 %10.3f ms  %12.0f %s\n",
+                phase.find("name")->as_string().c_str(),
+                phase.find("median_s")->as_number() * 1000.0,
+                phase.find("p95_s")->as_number() * 1000.0,
+                queries ? queries->as_number() : phase.find("vertices_per_s")->as_number(),
+                queries ? "queries/s" : "vertices/s");
+}
+
+// -----------------------------------------------------------------------------
+
+/// @return 'nb' random points close to the surface of 'mesh' (random
+/// triangle and barycentric coordinates, jittered by 1% of the triangle size)
+static std::vector<Vec3> surface_queries(const Mesh& mesh, int nb)
+{
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<int> pick_tri(0, int(mesh.nb_triangles()) - 1);
+    std::uniform_real_distribution<float> unit(0.f, 1.f);
+    std::vector<Vec3> points( nb );
+    for(Vec3& p : points) {
+        const Tri_face& tri = mesh._triangles[pick_tri(rng)];
+        float u = unit(rng), v = unit(rng);
+        if( u + v > 1.f ) {
+            u = 1.f - u;
+            v = 1.f - v;
+        }
+        const Vec3& a = mesh._vertices[tri[0]];
+        const Vec3& b = mesh._vertices[tri[1]];
+        const Vec3& c = mesh._vertices[tri[2]];
+        float jitter = 0.01f * (b - a).norm();
+        p = a + (b - a) * u + (c - a) * v +
+            Vec3(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f) * jitter;
+    }
+    return points;
+}
+
+// -----------------------------------------------------------------------------
+
+/**
+ * Benchmark every phase of the pipeline on one mesh.
+ * @param load : fills the mesh (file loading or generation), it is timed too.
+ * @return the JSON description of the case or a null value on error
+ */
+static Json_value bench_case(const std::string& name,
+                             const char* load_phase,
+                             const std::function<bool(Mesh&)>& load,
+                             const Bench_options& opt)
+{
+    const int reps = opt._repetitions;
+    std::vector<double> times( reps );
+    Json_value phases = Json_value::array();
+    Timer timer;
+    Trace_scope trace(trace_name(name), "case");
+
+    std::cout << name << std::endl;
+
+    // Load
+    Mesh mesh;
+    for(int r = 0; r < reps; ++r) {
+        mesh = Mesh();
+        timer.start();
+        if( !load(mesh) )
+            return Json_value();
+        times[r] = timer.elapsed();
+    }
+    const unsigned nv = mesh.nb_vertices();
+    phases.push_back( phase_json(load_phase, times, nv) );
+
+    // Topology
+    Vertex_to_face v_to_face;
+    for(int r = 0; r < reps; ++r) {
+        v_to_face = Vertex_to_face();
+        timer.start();
+        v_to_face.compute( mesh );
+        times[r] = timer.elapsed();
+    }
+    phases.push_back( phase_json("vertex_to_face", times, nv) );
+
+    Vertex_to_1st_ring_vertices first_ring;
+    for(int r = 0; r < reps; ++r) {
+        first_ring = Vertex_to_1st_ring_vertices();
+        timer.start();
+        first_ring.compute(mesh, v_to_face);
+        times[r] = timer.elapsed();
+    }
+    phases.push_back( phase_json("first_ring", times, nv) );
+    const std::vector< std::vector<int> >& edges = first_ring._rings_per_vertex;
+
+    // Laplacian (both flavors)
+    for(int r = 0; r < reps; ++r) {
+        Mute_cout mute;
+        timer.start();
+        std::vector<std::vector<Triplet>> lap = get_laplacian(mesh._vertices, edges);
+        times[r] = timer.elapsed();
+    }
+    phases.push_back( phase_json("laplacian_rings", times, nv) );
+
+    for(int r = 0; r < reps; ++r) {
+        Mute_cout mute;
+        timer.start();
+        std::vector<std::vector<Triplet>> lap = get_laplacian(mesh._vertices, mesh._triangles);
+        times[r] = timer.elapsed();
+    }
+    phases.push_back( phase_json("laplacian_triangles", times, nv) );
+
+    // Factorization and solve
+    std::vector<std::pair<Vert_idx, float> > boundaries;
+    if( !set_boundaries(opt._boundary, mesh, boundaries) )
+        return Json_value();
+    bool solve = !boundaries.empty() && (long long)(nv) <= opt._max_solve_vertices;
+    for(unsigned s = 0; solve && s < opt._solvers.size(); ++s)
+    {
+        const Solver_options& solver = opt._solvers[s];
+        // Phases keep their plain names with a single solver (baselines)
+        std::string suffix;
+        if( opt._solvers.size() > 1 )
+            suffix = " " + solver_options_string(solver);
+        std::vector<double> assembly( reps ), factorization( reps );
+        std::vector<double> weight_map;
+        bool ok = true;
+        for(int r = 0; r < reps && ok; ++r) {
+            Solve_timings solve_times;
+            {
+                Mute_cout mute;
+                ok = solve_laplace_equation(mesh._vertices, edges, mesh._triangles,
+                                            boundaries, weight_map, &solve_times, &solver);
+            }
+            assembly[r] = solve_times._assembly;
+            factorization[r] = solve_times._factorization;
+            times[r] = solve_times._solve;
+        }
+        if( !ok ) {
+            std::cerr << "  " << solver_options_string(solver) << " failed, skipped" << std::endl;
+            continue;
+        }
+        phases.push_back( phase_json("assembly" + suffix, assembly, nv) );
+        phases.push_back( phase_json("factorization" + suffix, factorization, nv) );
+        phases.push_back( phase_json("solve" + suffix, times, nv) );
+    }
+
+    // Weights at surface points: index of the triangles, then location and
+    // interpolation of a batch of points (of the coordinates as weight map
+    // when there was no solve, the values do not change the timings)
+    const int nb_queries = int(opt._nb_queries);
+    if( nb_queries > 0 && mesh.nb_triangles() > 0 )
+    {
+        Weight_sampler sampler;
+        for(int r = 0; r < reps; ++r) {
+            sampler = Weight_sampler();
+            timer.start();
+            sampler.build( mesh );
+            times[r] = timer.elapsed();
+        }
+        phases.push_back( phase_json("spatial_index", times, nv) );
+
+        std::vector<double> weights( nv );
+        for(unsigned i = 0; i < nv; ++i)
+            weights[i] = mesh._vertices[i].x;
+        const std::vector<Vec3> points = surface_queries(mesh, nb_queries);
+        std::vector<double> values;
+        for(int r = 0; r < reps; ++r) {
+            timer.start();
+            sampler.sample(points, weights, values);
+            times[r] = timer.elapsed();
+        }
+        phases.push_back( phase_json("interpolation", times, nv, unsigned(nb_queries)) );
+    }
+
+    for(unsigned i = 0; i < phases.size(); ++i)
+        print_phase( phases.at(i) );
+    if( !solve ) {
+        std::cout << "  (factorization and solve skipped: ";
+        std::cout << (boundaries.empty() ? "no boundary vertex" : "too many vertices") << ")" << std::endl;
+    }
+
+    Json_value res = Json_value::object();
+    res["name"] = name;
+    res["vertices"] = nv;
+    res["triangles"] = mesh.nb_triangles();
+    res["boundary_vertices"] = unsigned(boundaries.size());
+    // Process wide maximum: it never decreases from one case to the next,
+    // generated meshes are run from the smallest to the largest.
+    res["peak_rss_bytes"] = (unsigned long long)peak_rss_bytes();
+    res["phases"] = phases;
+    return res;
+}
+
+// =============================================================================
+// Baseline comparison
+// =============================================================================
+
+/// @return element of 'array' whose member "name" is 'name'
+static const Json_value* find_named(const Json_value* array, const std::string& name)
+{
+    if( array == nullptr || !array->is_array() )
+        return nullptr;
+    for(unsigned i = 0; i < array->size(); ++i) {
+        const Json_value* n = array->at(i).find("name");
+        if( n != nullptr && n->as_string() == name )
+            return &array->at(i);
+    }
+    return nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Compare median times of every (case, phase) present in both reports
+/// (phases answering queries only when both ran the same number of them)
+/// @return comparison report, its member "regressions" counts slow phases
+static Json_value compare(const Json_value& baseline,
+                          const Json_value& current,
+                          const Bench_options& opt)
+{
+    Json_value entries = Json_value::array();
+    int nb_regressions = 0;
+    const Json_value* cases = current.find("cases");
+    for(unsigned c = 0; c < cases->size(); ++c)
+    {
+        const Json_value& cur_case = cases->at(c);
+        std::string case_name = cur_case.find("name")->as_string();
+        const Json_value* base_case = find_named(baseline.find("cases"), case_name);
+        if( base_case == nullptr )
+            continue;
+
+        const Json_value* phases = cur_case.find("phases");
+        for(unsigned p = 0; p < phases->size(); ++p)
+        {
+            std::string phase_name = phases->at(p).find("name")->as_string();
+            const Json_value* base_phase = find_named(base_case->find("phases"), phase_name);
+            if( base_phase == nullptr || base_phase->find("median_s") == nullptr )
+                continue;
+
+            // Times of a phase answering queries depend on their number
+            const Json_value* base_queries = base_phase->find("queries");
+            const Json_value* cur_queries = phases->at(p).find("queries");
+            if( base_queries != nullptr && cur_queries != nullptr &&
+                base_queries->as_number() != cur_queries->as_number() )
+            {
+                std::printf("skipped %s / %s: %.0f queries against %.0f in the baseline\n",
+                            case_name.c_str(), phase_name.c_str(),
+                            cur_queries->as_number(), base_queries->as_number());
+                continue;
+            }
+
+            double base = base_phase->find("median_s")->as_number();
+            double cur = phases->at(p).find("median_s")->as_number();
+            double ratio = base > 0. ? cur / base : 1.;
+            bool regression = ratio > 1. + opt._threshold && (cur - base) > opt._min_delta;
+            nb_regressions += regression ? 1 : 0;
+
+            Json_value entry = Json_value::object();
+            entry["case"] = case_name;
+            entry["phase"] = phase_name;
+            entry["baseline_s"] = base;
+            entry["current_s"] = cur;
+            entry["ratio"] = ratio;
+            entry["regression"] = regression;
+            entries.push_back( entry );
+
+            if( regression ) {
+                std::printf("REGRESSION %s / %s: %.3f ms -> %.3f ms (x%.2f)\n",
+                            case_name.c_str(), phase_name.c_str(),
+                            base * 1000.0, cur * 1000.0, ratio);
+            }
+        }
+    }
+
+    std::cout << entries.size() << " phases compared, ";
+    std::cout << nb_regressions << " regressions (threshold ";
+    std::cout << opt._threshold * 100.0 << "%)" << std::endl;
+
+    Json_value res = Json_value::object();
+    res["baseline"] = opt._baseline;
+    res["threshold"] = opt._threshold;
+    res["min_delta_s"] = opt._min_delta;
+    res["regressions"] = nb_regressions;
+    res["entries"] = entries;
+    return res;
+}
+
+// =============================================================================
+
+int main(int argc, char** argv)
+{
+    Bench_options opt;
+    bool help = false;
+    if( !parse_arguments(argc, argv, opt, help) ) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if( help ) {
+        print_usage(argv[0]);
+        return EXIT_SUCCESS;
+    }
+    set_nb_threads( opt._nb_threads );
+    if( opt._trace != nullptr )
+        start_tracing();
+
+    Json_value baseline;
+    if( opt._baseline != nullptr && !read_json_file(opt._baseline, baseline) )
+        return EXIT_FAILURE;
+
+    Json_value report = Json_value::object();
+    Json_value& config = report["config"];
+    config["threads"] = get_nb_threads();
+    config["repetitions"] = opt._repetitions;
+    config["boundary"] = opt._boundary;
+    config["max_solve_vertices"] = opt._max_solve_vertices;
+    Json_value solvers = Json_value::array();
+    for(const Solver_options& solver : opt._solvers)
+        solvers.push_back( solver_options_string(solver) );
+    config["solvers"] = solvers;
+    Json_value& cases = report["cases"];
+    cases = Json_value::array();
+
+    // Mesh files, in a stable order
+    if( opt._use_samples )
+    {
+        std::vector<std::string> files;
+        std::error_code err;
+        for(const auto& entry : std::filesystem::directory_iterator(opt._samples_dir, err)) {
+            std::string path = entry.path().generic_string();
+            if( entry.is_regular_file() && detect_mesh_format(path.c_str()) != eUNKNOWN_FORMAT )
+                files.push_back( path );
+        }
+        if( err ) {
+            std::cerr << "Can't list directory " << opt._samples_dir << ": " << err.message() << std::endl;
+            return EXIT_FAILURE;
+        }
+        std::sort(files.begin(), files.end());
+
+        for(const std::string& path : files) {
+            Json_value res = bench_case(path, "load", [&](Mesh& mesh) {
+                return load_mesh(path.c_str(), mesh);
+            }, opt);
+            if( res.is_null() )
+                return EXIT_FAILURE;
+            cases.push_back( res );
+        }
+    }
+
+    // Generated meshes, from the smallest to the largest
+    if( opt._use_synthetic )
+    {
+        std::vector<long long> scales = opt._scales;
+        std::sort(scales.begin(), scales.end());
+        for(long long n : scales) {
+            for(const std::string& kind : opt._generators) {
+                std::string spec = "gen:" + kind + ":" + std::to_string(n);
+                Json_value res = bench_case(spec, "generate", [&](Mesh& mesh) {
+                    return generate_mesh(spec.c_str(), mesh);
+                }, opt);
+                if( res.is_null() )
+                    return EXIT_FAILURE;
+                cases.push_back( res );
+            }
+        }
+    }
+
+    bool regressions = false;
+    if( opt._baseline != nullptr ) {
+        report["comparison"] = compare(baseline, report, opt);
+        regressions = report["comparison"]["regressions"].as_number() > 0.;
+    }
+
+    if( !write_json_file(opt._output, report) )
+        return EXIT_FAILURE;
+    std::cout << "Report written to " << opt._output << std::endl;
+
+    if( opt._trace != nullptr ) {
+        stop_tracing();
+        if( !write_trace(opt._trace) )
+            return EXIT_FAILURE;
+        std::cout << "Trace written to " << opt._trace << std::endl;
+    }
+    return regressions ? 2 : EXIT_SUCCESS;
+}
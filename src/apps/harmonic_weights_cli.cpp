@@ -0,0 +1,503 @@
+/*
+ * Headless harmonic weights solver (no OpenGL dependency).
+ *
+ * harmonic_weights_cli <mesh> [options]
+ * Loads a mesh, sets the boundary conditions, solves the Laplace equation
+ * and writes one weight per vertex. Time spent in each phase is printed
+ * at the end.
+ * With --sample the weights are also interpolated at arbitrary points of
+ * the surface.
+ * With --connect the solve is sent to a running harmonic_weights_server.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <utility>
+
+#include "mesh.hpp"
+#include "mesh_cleanup.hpp"
+#include "mesh_pipeline.hpp"
+#include "topology/vertex_to_face.hpp"
+#include "topology/vertex_to_1st_ring_vertices.hpp"
+#include "io/mesh_cache.hpp"
+#include "io/solve_cache.hpp"
+#include "io/weights_io.hpp"
+#include "boundary_conditions.hpp"
+#include "solvers.hpp"
+#include "solver_backend.hpp"
+#include "solver_planner.hpp"
+#include "weight_sampler.hpp"
+#include "service/solve_protocol.hpp"
+#include "utils/cli_args.hpp"
+#include "utils/memory_report.hpp"
+#include "utils/memory_usage.hpp"
+#include "utils/parallel_for.hpp"
+#include "utils/timer.hpp"
+#include "utils/trace.hpp"
+
+// -----------------------------------------------------------------------------
+
+static void print_usage(const char* exe)
+{
+    std::cout << "Usage: " << exe << " <mesh.off|.ply|.obj|gen:<kind>:<nb_vertices>> [options]\n";
+    std::cout << "Generated meshes: gen:grid:1M, gen:jittered:250K, gen:holes:100K,\n";
+    std::cout << "                  gen:icosphere:1M, gen:torus:50K\n";
+    std::cout << "Options:\n";
+    std::cout << "  -b, --boundary <spec>  boundary conditions preset: strip, cone, strip:<length>\n";
+    std::cout << "                         cone:<length> (default: cone), or declarative spec:\n";
+    std::cout << "                         inline JSON or a .json file (see boundary_spec.hpp)\n";
+    std::cout << "  -o, --output <file>    weight map, raw doubles if the file ends with .bin\n";
+    std::cout << "                         one value per line otherwise (default: weights.txt)\n";
+    std::cout << "  --sample <points>      also interpolate the weights at the points of the file\n";
+    std::cout << "                         (projected on the closest triangle): raw floats x y z\n";
+    std::cout << "                         if it ends with .bin, text otherwise\n";
+    std::cout << "  --sample-output <file> weights at the points, same formats as --output\n";
+    std::cout << "                         (default: sampled_weights.txt)\n";
+    std::cout << "  -s, --solver <spec>    linear solver: " << solver_backend_names() << " or auto,\n";
+    std::cout << "                         followed by :<tolerance> (iterative solvers) and :float\n";
+    std::cout << "                         or :double\n";
+    std::cout << "                         e.g. cg:1e-8:float (default: lu:double)\n";
+    std::cout << "                         auto picks the fastest solver within --memory-budget\n";
+    std::cout << "  --memory-budget <size> memory the auto solver may use, e.g. 512M, 2G\n";
+    std::cout << "                         (default: no limit)\n";
+    std::cout << "  --plan                 print the predicted time and memory of each solver\n";
+    std::cout << "                         then exit without solving\n";
+    std::cout << "  --triangles            build the Laplacian from the list of triangles\n";
+    std::cout << "                         instead of the first ring of each vertex\n";
+    std::cout << "  --cleanup[=<tol>]      weld vertices (tolerance relative to the bounding box\n";
+    std::cout << "                         diagonal) and remove degenerate triangles after loading\n";
+    std::cout << "  --pipeline             overlap loading, topology and Laplacian of OFF files\n";
+    std::cout << "                         in a task graph (unless the mesh cache is valid)\n";
+    std::cout << "  --threads <n>          number of threads (default: every hardware thread)\n";
+    std::cout << "  --no-cache             don't read nor write the binary mesh cache\n";
+    std::cout << "  --mesh-cache <dir>     directory of the binary mesh cache\n";
+    std::cout << "                         (default: ~/.cache/harmonic_weights)\n";
+    std::cout << "  --solve-cache <dir>    reuse the weights of previous solves stored in <dir>,\n";
+    std::cout << "                         and their factorization with -s ldlt or llt (the\n";
+    std::cout << "                         factors of the other solvers, e.g. lu, are not kept)\n";
+    std::cout << "  --connect <socket>     send the solve to harmonic_weights_server listening\n";
+    std::cout << "                         on <socket> (the server loads the mesh)\n";
+    std::cout << "  --inline               with --connect, load the mesh here and send it\n";
+    std::cout << "  --trace <file.json>    record the phases in Chrome trace format\n";
+    std::cout << "                         (chrome://tracing or ui.perfetto.dev)\n";
+    std::cout << "  --memory               print the memory used by each phase and the size of\n";
+    std::cout << "                         the main data structures\n";
+    std::cout << "  -h, --help             print this message" << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+
+struct Cli_options {
+    Cli_options()
+        : _mesh_path(nullptr)
+        , _boundary("cone")
+        , _output("weights.txt")
+        , _sample(nullptr)
+        , _sample_output("sampled_weights.txt")
+        , _use_half_edges(true)
+        , _cleanup(false)
+        , _nb_threads(0)
+        , _use_cache(true)
+        , _mesh_cache(nullptr)
+        , _solve_cache(nullptr)
+        , _connect(nullptr)
+        , _inline(false)
+        , _trace(nullptr)
+        , _memory(false)
+        , _plan(false)
+        , _pipeline(false)
+    { }
+
+    const char* _mesh_path;
+    const char* _boundary;
+    const char* _output;
+    const char* _sample; ///< points file, nullptr when not sampling
+    const char* _sample_output;
+    Solver_options _solver;
+    bool _use_half_edges;
+    bool _cleanup;
+    Cleanup_options _cleanup_options;
+    unsigned _nb_threads;
+    bool _use_cache;
+    const char* _mesh_cache;  ///< directory, nullptr for the default one
+    const char* _solve_cache; ///< directory, nullptr when disabled
+    const char* _connect;     ///< socket of the server, nullptr to solve here
+    bool _inline;
+    const char* _trace; ///< trace file, nullptr when not tracing
+    bool _memory;
+    bool _plan;
+    bool _pipeline;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @return false if the command line is invalid (message printed on std::cerr)
+static bool parse_arguments(int argc, char** argv, Cli_options& opt, bool& help)
+{
+    help = false;
+    Cli_args args(argc, argv);
+    while( args.next() )
+    {
+        const char* arg = args.arg();
+        if( args.is("-h", "--help") ) {
+            help = true;
+            return true;
+        } else if( args.is("-b", "--boundary") ) {
+            if( (opt._boundary = args.value()) == nullptr )
+                return false;
+        } else if( args.is("-o", "--output") ) {
+            if( (opt._output = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--sample") ) {
+            if( (opt._sample = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--sample-output") ) {
+            if( (opt._sample_output = args.value()) == nullptr )
+                return false;
+        } else if( args.is("-s", "--solver") ) {
+            const char* str = args.value();
+            if( str == nullptr || !parse_solver_options(str, opt._solver) )
+                return false;
+        } else if( args.is("--threads") ) {
+            if( !args.value(opt._nb_threads) )
+                return false;
+        } else if( args.is("--trace") ) {
+            if( (opt._trace = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--memory") ) {
+            opt._memory = true;
+        } else if( args.is("--memory-budget") ) {
+            const char* str = args.value();
+            if( str == nullptr || !parse_byte_size(str, opt._solver._memory_budget) )
+                return false;
+        } else if( args.is("--plan") ) {
+            opt._plan = true;
+        } else if( args.is("--pipeline") ) {
+            opt._pipeline = true;
+        } else if( args.is("--triangles") ) {
+            opt._use_half_edges = false;
+        } else if( args.is("--no-cache") ) {
+            opt._use_cache = false;
+        } else if( args.is("--mesh-cache") ) {
+            if( (opt._mesh_cache = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--connect") ) {
+            if( (opt._connect = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--inline") ) {
+            opt._inline = true;
+        } else if( args.is("--solve-cache") ) {
+            if( (opt._solve_cache = args.value()) == nullptr )
+                return false;
+        } else if( args.is("--cleanup") ) {
+            opt._cleanup = true;
+        } else if( !std::strncmp(arg, "--cleanup=", 10) ) {
+            opt._cleanup = true;
+            char* end = nullptr;
+            opt._cleanup_options._weld_tolerance = std::strtof(arg + 10, &end);
+            if( end == arg + 10 || *end != '\0' ) {
+                std::cerr << "Invalid weld tolerance: " << arg << std::endl;
+                return false;
+            }
+        } else if( arg[0] == '-' ) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        } else if( opt._mesh_path == nullptr ) {
+            opt._mesh_path = arg;
+        } else {
+            std::cerr << "Unexpected argument: " << arg << std::endl;
+            return false;
+        }
+    }
+
+    if( opt._mesh_path == nullptr ) {
+        std::cerr << "No mesh file given" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+static void print_timing(const char* phase, double seconds)
+{
+    std::printf("  %-14s %10.3f ms\n", phase, seconds * 1000.0);
+}
+
+// -----------------------------------------------------------------------------
+
+/// @return true if --pipeline applies to the mesh of 'opt': reading the
+/// mesh cache is faster when it is valid
+static bool use_pipeline(const Cli_options& opt)
+{
+    if( !opt._pipeline || opt._cleanup || !can_pipeline(opt._mesh_path) )
+        return false;
+    Mesh_cache cache;
+    return !opt._use_cache || !cache.open(opt._mesh_path, false);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Solve on the server listening on 'opt._connect' and write the weights
+static int run_client(const Cli_options& opt)
+{
+    using namespace Solve_protocol;
+    Timer total;
+    Request request;
+    request._boundary_spec = opt._boundary;
+    request._solver = solver_options_string(opt._solver);
+    request._flags = opt._use_half_edges ? 0 : eTRIANGLE_LAPLACIAN;
+
+    Cleanup_report report;
+    if( opt._inline || opt._cleanup ) {
+        std::unique_ptr<Mesh> mesh( build_mesh(opt._mesh_path,
+                                               opt._cleanup ? &opt._cleanup_options : nullptr,
+                                               &report) );
+        if( mesh == nullptr )
+            return EXIT_FAILURE;
+        request._vertices.swap( mesh->_vertices );
+        request._triangles.swap( mesh->_triangles );
+    } else {
+        // The server does not share our working directory
+        request._mesh_path = opt._mesh_path;
+        if( request._mesh_path.compare(0, 4, "gen:") != 0 )
+            request._mesh_path = std::filesystem::absolute( request._mesh_path ).string();
+    }
+
+    int fd = connect_unix_socket( opt._connect );
+    if( fd < 0 )
+        return EXIT_FAILURE;
+    Response response;
+    bool ok = send_request(fd, request) && receive_response(fd, response);
+    close_socket( fd );
+    if( !ok ) {
+        std::cerr << "No answer from the server " << opt._connect << std::endl;
+        return EXIT_FAILURE;
+    }
+    if( response._status != eSTATUS_OK ) {
+        std::cerr << "Server error: " << response._error << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<double>& weight_map = response._weights;
+    if( opt._cleanup ) {
+        std::vector<double> original;
+        to_original_vertices(report, weight_map, original, 0.0);
+        weight_map.swap( original );
+    }
+    if( !write_weights(opt._output, weight_map) )
+        return EXIT_FAILURE;
+
+    std::cout << "Wrote " << weight_map.size() << " weights to " << opt._output << std::endl;
+    std::cout << "Server timings (solver " << request._solver << ", resident:";
+    if( response._resident == 0 ) std::cout << " none";
+    if( response._resident & eRESIDENT_MESH    ) std::cout << " mesh";
+    if( response._resident & eRESIDENT_FACTOR  ) std::cout << " factorization";
+    if( response._resident & eRESIDENT_WEIGHTS ) std::cout << " weights";
+    std::cout << "):" << std::endl;
+    print_timing("mesh"         , response._timings[eTIMING_MESH]);
+    print_timing("laplacian"    , response._timings[eTIMING_LAPLACIAN]);
+    print_timing("assembly"     , response._timings[eTIMING_ASSEMBLY]);
+    print_timing("factorization", response._timings[eTIMING_FACTORIZATION]);
+    print_timing("solve"        , response._timings[eTIMING_SOLVE]);
+    print_timing("server total" , response._timings[eTIMING_TOTAL]);
+    print_timing("total"        , total.elapsed());
+    return EXIT_SUCCESS;
+}
+
+// =============================================================================
+
+int main(int argc, char** argv)
+{
+    Cli_options opt;
+    bool help = false;
+    if( !parse_arguments(argc, argv, opt, help) ) {
+        print_usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if( help ) {
+        print_usage(argv[0]);
+        return EXIT_SUCCESS;
+    }
+
+    if( opt._connect != nullptr )
+        return run_client(opt);
+
+    set_nb_threads( opt._nb_threads );
+    set_mesh_cache_enabled( opt._use_cache );
+    if( opt._mesh_cache != nullptr )
+        set_mesh_cache_directory( opt._mesh_cache );
+    if( opt._solve_cache != nullptr )
+        set_solve_cache_dir( opt._solve_cache );
+    if( opt._trace != nullptr )
+        start_tracing();
+    if( opt._memory )
+        start_memory_accounting();
+
+    Timer total;
+    Timer timer;
+
+    // Load (and with --pipeline topology and Laplacian rows)
+    Cleanup_report report;
+    std::unique_ptr<Mesh> mesh_ptr;
+    std::vector< std::vector<int> > edges;
+    std::vector<std::vector<Triplet>> laplacian;
+    Pipeline_timings pipeline_time;
+    const bool pipelined = use_pipeline(opt);
+    if( pipelined ) {
+        mesh_ptr.reset( new Mesh() );
+        Vertex_to_face v_to_face;
+        Vertex_to_1st_ring_vertices first_ring;
+        if( !build_mesh_pipelined(opt._mesh_path, !opt._use_half_edges, *mesh_ptr,
+                                  v_to_face, first_ring, laplacian, &pipeline_time) )
+        {
+            return EXIT_FAILURE;
+        }
+        record_footprint("vertex_to_face", v_to_face.memory_bytes());
+        record_footprint("first_ring", first_ring.memory_bytes());
+        edges.swap( first_ring._rings_per_vertex );
+    } else {
+        // First ring from the cache or computed along with it
+        mesh_ptr.reset( build_mesh(opt._mesh_path,
+                                   opt._cleanup ? &opt._cleanup_options : nullptr,
+                                   &report,
+                                   opt._use_half_edges ? &edges : nullptr) );
+        if( mesh_ptr == nullptr )
+            return EXIT_FAILURE;
+        record_footprint("first_ring", heap_bytes(edges));
+    }
+    const Mesh& mesh = *mesh_ptr;
+    double load_time = timer.lap();
+    record_footprint("mesh", mesh.memory_bytes());
+    std::cout << "Mesh: " << mesh.nb_vertices() << " vertices, ";
+    std::cout << mesh.nb_triangles() << " triangles" << std::endl;
+    if( opt._cleanup )
+        report.print();
+    timer.lap();
+
+    // Boundary conditions
+    std::vector<std::pair<Vert_idx, float> > boundaries;
+    {
+        Trace_scope trace("boundaries");
+        if( !set_boundaries(opt._boundary, mesh, boundaries) )
+            return EXIT_FAILURE;
+    }
+    if( boundaries.empty() ) {
+        std::cerr << "No vertex selected by the boundary conditions: " << opt._boundary << std::endl;
+        return EXIT_FAILURE;
+    }
+    double boundary_time = timer.lap();
+
+    // Points of --sample, read before the solve to fail early
+    std::vector<Vec3> points;
+    if( opt._sample != nullptr && !read_points(opt._sample, points) )
+        return EXIT_FAILURE;
+
+    if( opt._plan ) {
+        if( !pipelined )
+            laplacian = opt._use_half_edges ? get_laplacian(mesh._vertices, edges) :
+                                              get_laplacian(mesh._vertices, mesh._triangles);
+        Solver_plan plan;
+        plan_solver(laplacian, boundaries, opt._solver, plan);
+        plan.print();
+        return EXIT_SUCCESS;
+    }
+
+    // Solve
+    Solve_timings solve_time;
+    std::vector<double> weight_map( mesh.nb_vertices() );
+    bool solved = pipelined ?
+                solve_laplace_equation(mesh._vertices, edges, mesh._triangles, laplacian,
+                                       boundaries, weight_map, &solve_time, &opt._solver) :
+                solve_laplace_equation(mesh._vertices, edges, mesh._triangles,
+                                       boundaries, weight_map, &solve_time, &opt._solver);
+    if( !solved )
+        return EXIT_FAILURE;
+    timer.start();
+
+    // Weights at the points of --sample (on the mesh we solved on, before
+    // going back to the original vertices)
+    double index_time = 0.0, sample_time = 0.0;
+    if( opt._sample != nullptr )
+    {
+        std::vector<double> sampled;
+        Weight_sampler sampler;
+        sampler.build( mesh );
+        record_footprint("weight_sampler", sampler.bytes());
+        index_time = timer.lap();
+        sampler.sample(points, weight_map, sampled);
+        sample_time = timer.lap();
+        Trace_scope trace("write_sampled_weights");
+        if( !write_weights(opt._sample_output, sampled) )
+            return EXIT_FAILURE;
+        std::cout << "Wrote " << sampled.size() << " sampled weights to " << opt._sample_output << std::endl;
+        timer.start();
+    }
+
+    // Write (weights of the original vertices when the mesh was cleaned)
+    if( opt._cleanup ) {
+        std::vector<double> original;
+        to_original_vertices(report, weight_map, original, 0.0);
+        weight_map.swap( original );
+    }
+    {
+        Trace_scope trace("write_weights");
+        if( !write_weights(opt._output, weight_map) )
+            return EXIT_FAILURE;
+    }
+    double write_time = timer.lap();
+
+    std::cout << "Wrote " << weight_map.size() << " weights to " << opt._output << std::endl;
+    std::cout << "Timings (" << get_nb_threads() << " threads, solver ";
+    std::cout << solver_options_string(opt._solver) << "):" << std::endl;
+    if( pipelined ) {
+        // Stages overlap: their sum exceeds the time of the pipeline
+        print_timing("pipeline"     , load_time);
+        print_timing("  open"       , pipeline_time._open);
+        print_timing("  vertices"   , pipeline_time._vertices);
+        print_timing("  faces"      , pipeline_time._faces);
+        print_timing("  vert to face", pipeline_time._vertex_to_face);
+        print_timing("  rings"      , pipeline_time._rings);
+        print_timing("  laplacian"  , pipeline_time._laplacian);
+        print_timing("  stages sum" , pipeline_time.sum());
+    } else {
+        // First rings included
+        print_timing("load"         , load_time);
+    }
+    print_timing("boundaries"   , boundary_time);
+    print_timing("laplacian"    , solve_time._laplacian);
+    if( opt._solver._solver == "auto" )
+        print_timing("planning" , solve_time._planning);
+    print_timing("assembly"     , solve_time._assembly);
+    print_timing("factorization", solve_time._factorization);
+    print_timing("solve"        , solve_time._solve);
+    if( solve_time._iterations > 0 ) {
+        std::printf("  (%d iterations, relative residual %g)\n",
+                    solve_time._iterations, solve_time._residual);
+    }
+    if( opt._sample != nullptr ) {
+        print_timing("sample index" , index_time);
+        print_timing("sample"       , sample_time);
+        std::printf("  (%zu points, %.0f queries/s)\n", points.size(),
+                    sample_time > 0.0 ? double(points.size()) / sample_time : 0.0);
+    }
+    print_timing("write"        , write_time);
+    print_timing("total"        , total.elapsed());
+
+    if( opt._memory ) {
+        stop_memory_accounting();
+        print_memory_report();
+    }
+    if( opt._trace != nullptr ) {
+        stop_tracing();
+        if( !write_trace(opt._trace) )
+            return EXIT_FAILURE;
+        std::cout << "Trace (" << nb_trace_events() << " spans) written to " << opt._trace << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+/*
+ * Long running harmonic weights solver.
+ *
+ * harmonic_weights_server [options]
+ * Listens on a Unix domain socket and answers the solve requests of
+ * harmonic_weights_cli --connect (or any client of service/solve_protocol.hpp).
+ * Meshes, topology, factorizations and weights stay in memory between
+ * requests, so a repeated query on the same asset only costs the back
+ * substitution.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "io/mesh_cache.hpp"
+#include "io/solve_cache.hpp"
+#include "service/solve_protocol.hpp"
+#include "service/solve_service.hpp"
+#include "utils/cli_args.hpp"
+#include "utils/memory_usage.hpp"
+#include "utils/mute_cout.hpp"
+#include "utils/parallel_for.hpp"
+#include "utils/trace.hpp"
+
+// -----------------------------------------------------------------------------
+
+static void print_usage(const char* exe)
+{
+    std::cout << "Usage: " << exe << " [options]\n";
+    std::cout << "Options:\n";
+    std::cout << "  --socket <path>        Unix domain socket to listen on\n";
+    std::cout << "                         (default: /tmp/harmonic_weights.sock)\n";
+    std::cout << "  --workers <n>          requests processed at the same time, idle\n";
+    std::cout << "                         connections don't hold a worker\n";
+    std::cout << "                         (default: every hardware thread)\n";
+    std::cout << "  --threads <n>          threads of the parallel loops of each request\n";
+    std::cout << "                         (default: 1)\n";
+    std::cout << "  --memory-cap <size>    memory of the resident meshes, factorizations and\n";
+    std::cout << "                         weights, e.g. 512M, 8G (default: 2G), larger\n";
+    std::cout << "                         requests are rejected\n";
+    std::cout << "  --solve-cache <dir>    also keep weights and factorizations on disk (only the\n";
+    std::cout << "                         ldlt / llt factors are kept, not the lu ones)\n";
+    std::cout << "  --no-cache             don't read nor write the binary mesh cache\n";
+    std::cout << "  --mesh-cache <dir>     directory of the binary mesh cache\n";
+    std::cout << "                         (default: ~/.cache/harmonic_weights)\n";
+    std::cout << "  --verbose              print the log of every solve\n";
+    std::cout << "  --trace <file.json>    record the phases of every request in Chrome trace\n";
+    std::cout << "                         format, written when the server stops\n";
+    std::cout << "  --stats                print the state of the server listening on --socket\n";
+    std::cout << "  --stop                 stop the server listening on --socket\n";
+    std::cout << "  -h, --help             print this message" << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Send 'command' to the server of 'socket_path'
+/// @return false if the server did not answer
+static bool send_command(const std::string& socket_path, const char* command, std::string& text)
+{
+    using namespace Solve_protocol;
+    int fd = connect_unix_socket( socket_path );
+    if( fd < 0 )
+        return false;
+    Request request;
+    request._command = command;
+    Response response;
+    bool ok = send_request(fd, request) && receive_response(fd, response);
+    close_socket( fd );
+    if( ok && response._status != eSTATUS_OK ) {
+        std::cerr << "Server error: " << response._error << std::endl;
+        return false;
+    }
+    text = response._text;
+    return ok;
+}
+
+// =============================================================================
+
+int main(int argc, char** argv)
+{
+    Server_options options;
+    options._socket_path = "/tmp/harmonic_weights.sock";
+    unsigned nb_threads = 1;
+    const char* mesh_cache = nullptr;
+    const char* solve_cache = nullptr;
+    bool use_cache = true;
+    bool verbose = false;
+    const char* trace = nullptr;
+    const char* command = nullptr;
+
+    Cli_args args(argc, argv);
+    while( args.next() )
+    {
+        if( args.is("-h", "--help") ) {
+            print_usage(argv[0]);
+            return EXIT_SUCCESS;
+        } else if( args.is("--socket") ) {
+            const char* str = args.value();
+            if( str == nullptr )
+                return EXIT_FAILURE;
+            options._socket_path = str;
+        } else if( args.is("--workers") ) {
+            if( !args.value(options._nb_workers) )
+                return EXIT_FAILURE;
+        } else if( args.is("--threads") ) {
+            if( !args.value(nb_threads) )
+                return EXIT_FAILURE;
+        } else if( args.is("--memory-cap") ) {
+            const char* str = args.value();
+            if( str == nullptr || !parse_byte_size(str, options._memory_cap) )
+                return EXIT_FAILURE;
+        } else if( args.is("--solve-cache") ) {
+            if( (solve_cache = args.value()) == nullptr )
+                return EXIT_FAILURE;
+        } else if( args.is("--no-cache") ) {
+            use_cache = false;
+        } else if( args.is("--mesh-cache") ) {
+            if( (mesh_cache = args.value()) == nullptr )
+                return EXIT_FAILURE;
+        } else if( args.is("--verbose") ) {
+            verbose = true;
+        } else if( args.is("--trace") ) {
+            if( (trace = args.value()) == nullptr )
+                return EXIT_FAILURE;
+        } else if( args.is("--stats") ) {
+            command = "stats";
+        } else if( args.is("--stop") ) {
+            command = "shutdown";
+        } else {
+            std::cerr << "Unknown option: " << args.arg() << std::endl;
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if( command != nullptr ) {
+        std::string text;
+        if( !send_command(options._socket_path, command, text) )
+            return EXIT_FAILURE;
+        std::cout << text;
+        return EXIT_SUCCESS;
+    }
+
+    // Requests already run in parallel
+    set_nb_threads( nb_threads );
+    set_mesh_cache_enabled( use_cache );
+    if( mesh_cache != nullptr )
+        set_mesh_cache_directory( mesh_cache );
+    if( solve_cache != nullptr )
+        set_solve_cache_dir( solve_cache );
+    if( trace != nullptr )
+        start_tracing();
+
+    std::cout << "Listening on " << options._socket_path << std::endl;
+    bool ok = false;
+    if( verbose ) {
+        ok = run_solve_server( options );
+    } else {
+        Mute_cout mute;
+        ok = run_solve_server( options );
+    }
+    if( !ok )
+        return EXIT_FAILURE;
+    std::cout << "Server stopped" << std::endl;
+    if( trace != nullptr ) {
+        stop_tracing();
+        if( !write_trace(trace) )
+            return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
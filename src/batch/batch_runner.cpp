@@ -0,0 +1,573 @@
+#include "batch/batch_runner.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+
+#include "boundary_spec.hpp"
+#include "mesh.hpp"
+#include "mesh_generators.hpp"
+#include "io/mesh_cache.hpp"
+#include "io/mesh_loader.hpp"
+#include "io/weights_io.hpp"
+#include "topology/vertex_to_face.hpp"
+#include "topology/vertex_to_1st_ring_vertices.hpp"
+#include "utils/parallel_for.hpp"
+#include "utils/timer.hpp"
+#include "utils/trace.hpp"
+#include "utils/work_stealing_pool.hpp"
+
+namespace fs = std::filesystem;
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Defaults of the jobs, each job may override them
+struct Job_settings {
+    Job_settings() : _triangles(false) { }
+
+    std::vector<std::string> _boundaries;
+    Solver_options _solver;
+    bool _triangles;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @return 'path' relative to 'base' unless absolute (generator specs are
+/// kept as is)
+std::string resolve_path(const fs::path& base, const std::string& path)
+{
+    if( is_generator_spec(path.c_str()) || fs::path(path).is_absolute() )
+        return path;
+    return (base / path).lexically_normal().string();
+}
+
+// -----------------------------------------------------------------------------
+
+/// Read "boundaries", "solver" and "triangles" of 'json' over 'settings'
+/// @param base : directory of the manifest (spec files are relative to it)
+/// @param where : location in the manifest for the error messages
+bool read_settings(const Json_value& json, const fs::path& base, const std::string& where,
+                   Job_settings& settings)
+{
+    if( const Json_value* b = json.find("boundaries") )
+    {
+        // Presets, spec files or inline specs (kept as single line JSON)
+        settings._boundaries.clear();
+        for(unsigned i = 0; i < (b->is_array() ? b->size() : 1u); ++i) {
+            const Json_value& spec = b->is_array() ? b->at(i) : *b;
+            std::string str = spec.as_string();
+            bool is_file = is_boundary_spec_json(str.c_str()) && str[0] != '{' && str[0] != '[';
+            if( spec.is_string() && is_file )
+                settings._boundaries.push_back( resolve_path(base, str) );
+            else if( spec.is_string() )
+                settings._boundaries.push_back( str );
+            else if( spec.is_object() )
+                settings._boundaries.push_back( spec.dump(-1) );
+            else {
+                std::cerr << where << ": \"boundaries\" must hold strings or objects" << std::endl;
+                return false;
+            }
+            Boundary_spec parsed;
+            if( !parsed.parse(settings._boundaries.back().c_str()) ) {
+                std::cerr << "  in " << where << std::endl;
+                return false;
+            }
+        }
+    }
+    if( const Json_value* s = json.find("solver") ) {
+        if( !s->is_string() ) {
+            std::cerr << where << ": \"solver\" must be a string" << std::endl;
+            return false;
+        }
+        if( !parse_solver_options(s->as_string().c_str(), settings._solver) ) {
+            std::cerr << "  in " << where << std::endl;
+            return false;
+        }
+    }
+    if( const Json_value* t = json.find("triangles") ) {
+        if( !t->is_bool() ) {
+            std::cerr << where << ": \"triangles\" must be true or false" << std::endl;
+            return false;
+        }
+        settings._triangles = t->as_bool();
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Append the OFF, PLY and OBJ files of 'dir' to 'files', sorted by path
+/// @return false if 'dir' can't be listed (message printed on std::cerr)
+bool list_meshes(const std::string& dir, bool recursive, std::vector<std::string>& files)
+{
+    std::vector<std::string> found;
+    auto add = [&](const fs::directory_entry& entry) {
+        std::string path = entry.path().string();
+        if( entry.is_regular_file() && mesh_format_from_extension(path.c_str()) != eUNKNOWN_FORMAT )
+            found.push_back( path );
+    };
+
+    std::error_code ec;
+    if( recursive ) {
+        fs::recursive_directory_iterator it(dir, ec), end;
+        for(; !ec && it != end; it.increment(ec))
+            add( *it );
+    } else {
+        fs::directory_iterator it(dir, ec), end;
+        for(; !ec && it != end; it.increment(ec))
+            add( *it );
+    }
+    if( ec ) {
+        std::cerr << "Can't list the directory " << dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+    std::sort(found.begin(), found.end());
+    files.insert(files.end(), found.begin(), found.end());
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Default name of the outputs of 'mesh': file name without extension
+std::string default_job_name(const std::string& mesh)
+{
+    std::string name = is_generator_spec(mesh.c_str()) ? mesh : fs::path(mesh).stem().string();
+    std::replace(name.begin(), name.end(), ':', '_');
+    return name;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Part of the output file names for the boundary spec 'spec':
+/// "strip:0.2" -> "strip_0.2", "hot.json" -> "hot", inline JSON -> its "name"
+std::string boundary_file_tag(const std::string& spec)
+{
+    std::string tag = spec;
+    if( spec[0] == '{' || spec[0] == '[' ) {
+        Boundary_spec parsed;
+        parsed.parse( spec.c_str() );
+        tag = parsed._name;
+        if( tag.empty() ) {
+            Hasher h;
+            h.add( spec );
+            tag = "spec_" + h.digest().hex().substr(0, 8);
+        }
+    } else if( is_boundary_spec_json(spec.c_str()) ) {
+        tag = fs::path(spec).stem().string();
+    }
+    std::replace(tag.begin(), tag.end(), ':', '_');
+    std::replace(tag.begin(), tag.end(), '/', '_');
+    return tag;
+}
+
+// -----------------------------------------------------------------------------
+
+/// @return approximate number of vertices of 'mesh' without loading it
+long long estimate_vertices(const std::string& mesh)
+{
+    if( is_generator_spec(mesh.c_str()) )
+    {
+        // "gen:<kind>[:<nb_vertices>][:<key>=<value>...]"
+        size_t begin = mesh.find(':', 4);
+        if( begin == std::string::npos )
+            return 10000;
+        std::string count = mesh.substr(begin + 1, mesh.find(':', begin + 1) - begin - 1);
+        char* end = nullptr;
+        double nb = std::strtod(count.c_str(), &end);
+        if( end == count.c_str() )
+            return 10000;
+        switch( *end ) {
+        case 'K': case 'k': nb *= 1e3; break;
+        case 'M': case 'm': nb *= 1e6; break;
+        case 'G': case 'g': nb *= 1e9; break;
+        }
+        return (long long)nb;
+    }
+
+    Mesh_cache cache;
+    // An outdated cache still gives a good estimate
+    if( is_mesh_cache_enabled() && cache.open(mesh.c_str(), false) )
+        return cache.nb_vertices();
+
+    std::error_code ec;
+    uintmax_t size = fs::file_size(mesh, ec);
+    if( ec )
+        return 0;
+    // Bytes of a vertex and its two triangles: about 40 in binary PLY,
+    // 80 in text files
+    double bytes_per_vertex = detect_mesh_format(mesh.c_str()) == ePLY ? 40. : 80.;
+    return (long long)(double(size) / bytes_per_vertex);
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+bool read_batch_manifest(const char* file_name, Batch_manifest& manifest)
+{
+    manifest = Batch_manifest();
+    manifest._file_name = file_name;
+    Json_value doc;
+    if( !read_json_file(file_name, doc) )
+        return false;
+    if( !doc.is_object() ) {
+        std::cerr << "Batch manifest must be a JSON object: " << file_name << std::endl;
+        return false;
+    }
+    const fs::path base = fs::path(file_name).parent_path();
+
+    Job_settings defaults;
+    if( !read_settings(doc, base, file_name, defaults) )
+        return false;
+    const Json_value* out = doc.find("output_dir");
+    manifest._output_dir = resolve_path(base, out != nullptr ? out->as_string(".") : ".");
+
+    const Json_value* jobs = doc.find("jobs");
+    if( jobs == nullptr || !jobs->is_array() ) {
+        std::cerr << "Batch manifest without \"jobs\" array: " << file_name << std::endl;
+        return false;
+    }
+
+    std::set<std::string> names;
+    for(unsigned j = 0; j < jobs->size(); ++j)
+    {
+        const Json_value& entry = jobs->at(j);
+        std::string where = std::string(file_name) + ", job " + std::to_string(j);
+        Job_settings settings = defaults;
+        if( !entry.is_object() || !read_settings(entry, base, where, settings) ) {
+            if( !entry.is_object() )
+                std::cerr << where << ": must be an object" << std::endl;
+            return false;
+        }
+        if( settings._boundaries.empty() ) {
+            std::cerr << where << ": no boundary preset (\"boundaries\")" << std::endl;
+            return false;
+        }
+
+        std::vector<std::string> meshes;
+        const Json_value* mesh = entry.find("mesh");
+        const Json_value* dir = entry.find("directory");
+        if( mesh != nullptr && mesh->is_string() ) {
+            meshes.push_back( resolve_path(base, mesh->as_string()) );
+        } else if( dir != nullptr && dir->is_string() ) {
+            const Json_value* recursive = entry.find("recursive");
+            if( !list_meshes(resolve_path(base, dir->as_string()),
+                             recursive != nullptr && recursive->as_bool(), meshes) )
+            {
+                return false;
+            }
+        } else {
+            std::cerr << where << ": expected a \"mesh\" or a \"directory\" string" << std::endl;
+            return false;
+        }
+
+        const Json_value* name = entry.find("name");
+        for(const std::string& path : meshes)
+        {
+            Batch_job job;
+            job._mesh = path;
+            job._boundaries = settings._boundaries;
+            job._solver = settings._solver;
+            job._triangles = settings._triangles;
+            job._estimated_vertices = estimate_vertices(path);
+            job._name = (name != nullptr && meshes.size() == 1) ? name->as_string() : default_job_name(path);
+            // Same file name in two directories: number the outputs
+            std::string unique = job._name;
+            for(int i = 2; !names.insert(unique).second; ++i)
+                unique = job._name + "_" + std::to_string(i);
+            job._name = unique;
+            manifest._jobs.push_back( job );
+        }
+    }
+    return true;
+}
+
+// =============================================================================
+
+namespace {
+
+/// Mesh of a job, shared by the solves of its boundary presets
+struct Loaded_mesh {
+    Loaded_mesh() : _nb_left(0) { }
+
+    std::unique_ptr<Mesh> _mesh;
+    std::vector< std::vector<int> > _rings;
+    std::atomic<int> _nb_left; ///< presets not solved yet
+    Timer _timer;              ///< started with the job
+};
+
+// -----------------------------------------------------------------------------
+
+/// State of run_batch()
+class Batch_run {
+public:
+    Batch_run(const Batch_manifest& manifest, Batch_report& report, Batch_progress on_job_done)
+        : _manifest(manifest)
+        , _report(report)
+        , _on_job_done(on_job_done)
+        , _nb_done(0)
+    { }
+
+    /// Load the mesh of job 'j' and its topology
+    /// @return false if the job failed (record updated)
+    bool load(int j, Loaded_mesh& loaded)
+    {
+        const Batch_job& job = _manifest._jobs[j];
+        Batch_job_record& rec = _report._jobs[j];
+        rec._start = _timer.elapsed();
+        rec._worker = Work_stealing_pool::worker_index();
+        loaded._timer.start();
+        Timer timer;
+
+        // First rings from the cache or computed along with it
+        loaded._mesh.reset( build_mesh(job._mesh.c_str(), nullptr, nullptr,
+                                       job._triangles ? nullptr : &loaded._rings) );
+        if( loaded._mesh == nullptr ) {
+            rec._error = "can't load the mesh";
+            return false;
+        }
+        const Mesh& mesh = *loaded._mesh;
+        rec._nb_vertices = mesh.nb_vertices();
+        rec._nb_triangles = mesh.nb_triangles();
+        rec._load = timer.lap();
+        loaded._nb_left = int(job._boundaries.size());
+        return true;
+    }
+
+    /// Solve the boundary preset 's' of job 'j' and write the weights
+    void solve(int j, int s, Loaded_mesh& loaded)
+    {
+        const Batch_job& job = _manifest._jobs[j];
+        Batch_solve_record& rec = _report._jobs[j]._solves[s];
+        const Mesh& mesh = *loaded._mesh;
+
+        std::vector<std::pair<Vert_idx, float> > boundaries;
+        std::vector<double> weights;
+        if( !set_boundaries(rec._boundary.c_str(), mesh, boundaries) || boundaries.empty() )
+            rec._error = "no vertex selected by the boundary conditions";
+        else if( !solve_laplace_equation(mesh._vertices, loaded._rings, mesh._triangles,
+                                         boundaries, weights, &rec._timings, &job._solver) )
+            rec._error = "solve failed";
+        else if( !write_weights(rec._output.c_str(), weights) )
+            rec._error = "can't write " + rec._output;
+        else
+            rec._ok = true;
+
+        if( --loaded._nb_left == 0 )
+            finish(j, &loaded);
+    }
+
+    /// Job 'j' is over, 'loaded' is freed
+    void finish(int j, Loaded_mesh* loaded)
+    {
+        Batch_job_record& rec = _report._jobs[j];
+        rec._ok = rec._error.empty();
+        for(const Batch_solve_record& s : rec._solves)
+            rec._ok = rec._ok && s._ok;
+        if( loaded != nullptr ) {
+            rec._total = loaded->_timer.elapsed();
+            loaded->_mesh.reset();
+            std::vector< std::vector<int> >().swap( loaded->_rings );
+        }
+
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_nb_done;
+        if( _on_job_done )
+            _on_job_done(rec, _nb_done, int(_report._jobs.size()));
+    }
+
+    /// Load then solve every preset on the calling thread
+    void run_alone(int j)
+    {
+        Trace_scope trace("batch_big_mesh");
+        Loaded_mesh loaded;
+        if( !load(j, loaded) ) {
+            finish(j, &loaded);
+            return;
+        }
+        for(int s = 0; s < int(_manifest._jobs[j]._boundaries.size()); ++s)
+            solve(j, s, loaded);
+    }
+
+    /// Load on a worker of 'pool' then queue one task per preset
+    void run_packed(int j, Work_stealing_pool& pool)
+    {
+        std::shared_ptr<Loaded_mesh> loaded = std::make_shared<Loaded_mesh>();
+        {
+            Trace_scope trace("batch_load");
+            if( !load(j, *loaded) ) {
+                finish(j, loaded.get());
+                return;
+            }
+        }
+        // Most recent first: this worker goes on with the presets of the
+        // mesh it just loaded while idle workers may steal them
+        for(int s = 0; s < int(_manifest._jobs[j]._boundaries.size()); ++s) {
+            pool.submit([this, j, s, loaded] {
+                Nb_threads_scope single_thread(1);
+                Trace_scope trace("batch_solve");
+                solve(j, s, *loaded);
+            });
+        }
+    }
+
+    const Batch_manifest& _manifest;
+    Batch_report& _report;
+    Batch_progress _on_job_done;
+    std::mutex _mutex;
+    int _nb_done;
+    Timer _timer;
+};
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+bool run_batch(const Batch_manifest& manifest,
+               const Batch_options& options,
+               Batch_report& report,
+               Batch_progress on_job_done)
+{
+    Trace_scope trace("run_batch");
+    std::error_code ec;
+    fs::create_directories(manifest._output_dir, ec);
+    if( ec ) {
+        std::cerr << "Can't create the directory " << manifest._output_dir << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    const int nb_jobs = int(manifest._jobs.size());
+    report = Batch_report();
+    report._nb_workers = options._nb_workers > 0 ? options._nb_workers :
+                                                   std::max(std::thread::hardware_concurrency(), 1u);
+    report._jobs.resize( nb_jobs );
+    for(int j = 0; j < nb_jobs; ++j)
+    {
+        const Batch_job& job = manifest._jobs[j];
+        Batch_job_record& rec = report._jobs[j];
+        rec._mesh = job._mesh;
+        rec._name = job._name;
+        rec._big = job._estimated_vertices >= options._big_mesh_vertices;
+        rec._solves.resize( job._boundaries.size() );
+        for(unsigned s = 0; s < job._boundaries.size(); ++s) {
+            rec._solves[s]._boundary = job._boundaries[s];
+            rec._solves[s]._output = (fs::path(manifest._output_dir) /
+                                      (job._name + "." + boundary_file_tag(job._boundaries[s]) + ".bin")).string();
+        }
+    }
+
+    std::vector<int> order( nb_jobs );
+    for(int j = 0; j < nb_jobs; ++j)
+        order[j] = j;
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        return manifest._jobs[a]._estimated_vertices < manifest._jobs[b]._estimated_vertices;
+    });
+
+    Timer wall;
+    Batch_run run(manifest, report, on_job_done);
+
+    // Big meshes one after another, largest first, with every thread
+    {
+        Nb_threads_scope all_threads( report._nb_workers );
+        for(int i = nb_jobs - 1; i >= 0; --i)
+            if( report._jobs[order[i]]._big )
+                run.run_alone( order[i] );
+    }
+
+    // Small meshes packed one per worker (single threaded loops). Queued
+    // smallest first: each worker starts with the largest mesh of its
+    // queue, thieves take the smallest
+    {
+        Work_stealing_pool pool( report._nb_workers );
+        for(int j : order)
+            if( !report._jobs[j]._big )
+                pool.submit([&run, &pool, j] {
+                    Nb_threads_scope single_thread(1);
+                    run.run_packed(j, pool);
+                });
+        pool.wait_idle();
+        report._nb_steals = pool.nb_steals();
+    }
+
+    report._wall = wall.elapsed();
+    return true;
+}
+
+// =============================================================================
+
+int Batch_report::nb_failed_jobs() const
+{
+    int nb = 0;
+    for(const Batch_job_record& rec : _jobs)
+        nb += rec._ok ? 0 : 1;
+    return nb;
+}
+
+// -----------------------------------------------------------------------------
+
+double Batch_report::meshes_per_hour() const
+{
+    int nb_ok = int(_jobs.size()) - nb_failed_jobs();
+    return _wall > 0. ? double(nb_ok) * 3600. / _wall : 0.;
+}
+
+// -----------------------------------------------------------------------------
+
+Json_value Batch_report::to_json() const
+{
+    Json_value doc = Json_value::object();
+    int nb_solves = 0;
+    int nb_failed_solves = 0;
+    Json_value jobs = Json_value::array();
+    for(const Batch_job_record& rec : _jobs)
+    {
+        Json_value job = Json_value::object();
+        job["mesh"] = rec._mesh;
+        job["name"] = rec._name;
+        job["ok"] = rec._ok;
+        if( !rec._error.empty() )
+            job["error"] = rec._error;
+        job["mode"] = rec._big ? "big" : "packed";
+        job["worker"] = rec._worker;
+        job["vertices"] = rec._nb_vertices;
+        job["triangles"] = rec._nb_triangles;
+        job["start"] = rec._start;
+        job["load"] = rec._load;
+        job["total"] = rec._total;
+        Json_value solves = Json_value::array();
+        for(const Batch_solve_record& s : rec._solves)
+        {
+            Json_value solve = Json_value::object();
+            solve["boundary"] = s._boundary;
+            solve["output"] = s._output;
+            solve["ok"] = s._ok;
+            if( !s._error.empty() )
+                solve["error"] = s._error;
+            solve["laplacian"] = s._timings._laplacian;
+            solve["assembly"] = s._timings._planning + s._timings._assembly;
+            solve["factorization"] = s._timings._factorization;
+            solve["solve"] = s._timings._solve;
+            if( s._timings._iterations > 0 )
+                solve["iterations"] = s._timings._iterations;
+            solves.push_back( solve );
+            nb_solves++;
+            nb_failed_solves += s._ok ? 0 : 1;
+        }
+        job["solves"] = solves;
+        jobs.push_back( job );
+    }
+
+    doc["workers"] = _nb_workers;
+    doc["wall_seconds"] = _wall;
+    doc["meshes"] = unsigned(_jobs.size());
+    doc["meshes_failed"] = nb_failed_jobs();
+    doc["solves"] = nb_solves;
+    doc["solves_failed"] = nb_failed_solves;
+    doc["meshes_per_hour"] = meshes_per_hour();
+    doc["steals"] = _nb_steals;
+    doc["jobs"] = jobs;
+    return doc;
+}
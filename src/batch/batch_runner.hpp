@@ -0,0 +1,139 @@
+#ifndef BATCH_RUNNER_HPP
+#define BATCH_RUNNER_HPP
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "solvers.hpp"
+#include "utils/json.hpp"
+
+/**
+ * @brief Harmonic weights of many meshes, each for several boundary
+ * presets, scheduled over every core.
+ *
+ * The manifest is a JSON file:
+ * @code
+ * {
+ *     "output_dir": "weights",
+ *     "boundaries": ["cone", "strip:0.2"],
+ *     "solver": "ldlt",
+ *     "jobs": [
+ *         { "mesh": "assets/rock.off" },
+ *         { "mesh": "assets/tree.ply", "name": "tree_hi", "solver": "cg:1e-8" },
+ *         { "directory": "assets/props", "recursive": true, "boundaries": ["cone"] }
+ *     ]
+ * }
+ * @endcode
+ * "boundaries" (presets or spec files of set_boundaries(), objects are
+ * inline specs, see boundary_spec.hpp), "solver" (see
+ * parse_solver_options()) and "triangles" (Laplacian from the triangles)
+ * at the top level are the defaults of the jobs. A "directory" job expands
+ * to every OFF, PLY and OBJ file it holds. Relative paths are relative to
+ * the directory of the manifest. Weights are written as raw doubles to
+ * "<output_dir>/<name>.<boundary>.bin", where the name defaults to the file
+ * name without extension and <boundary> is the preset with ':' replaced by
+ * '_', the name of a spec file or the "name" of an inline spec.
+ *
+ * Scheduling: meshes of at least Batch_options::_big_mesh_vertices
+ * (estimated from the file size or the mesh cache) run first, one at a time
+ * with every thread in their parallel loops. The other meshes are then
+ * packed one per worker of a Work_stealing_pool with single threaded
+ * loops. The boundary presets of a mesh are sub tasks, stolen by idle
+ * workers at the end of the batch.
+ */
+
+/// One mesh of the manifest and the solves to run on it
+struct Batch_job {
+    Batch_job() : _triangles(false), _estimated_vertices(0) { }
+
+    std::string _mesh;                    ///< path or generator spec ("gen:...")
+    std::string _name;                    ///< prefix of the output files
+    std::vector<std::string> _boundaries; ///< specs of set_boundaries()
+    Solver_options _solver;
+    bool _triangles;                      ///< Laplacian from the triangles
+    long long _estimated_vertices;        ///< set by read_batch_manifest()
+};
+
+struct Batch_manifest {
+    std::string _file_name;
+    std::string _output_dir;
+    std::vector<Batch_job> _jobs;
+};
+
+/// Read and check a manifest, directories are expanded
+/// @return false on error (message printed on std::cerr)
+bool read_batch_manifest(const char* file_name, Batch_manifest& manifest);
+
+// -----------------------------------------------------------------------------
+
+struct Batch_options {
+    Batch_options()
+        : _nb_workers(0)
+        , _big_mesh_vertices(250000)
+    { }
+
+    unsigned _nb_workers;         ///< 0 means every hardware thread
+    long long _big_mesh_vertices; ///< meshes from this size run alone
+};
+
+/// What happened to one boundary preset of a job
+struct Batch_solve_record {
+    Batch_solve_record() : _ok(false) { }
+
+    std::string _boundary;
+    std::string _output;
+    bool _ok;
+    std::string _error;
+    Solve_timings _timings;
+};
+
+/// What happened to one job (in seconds)
+struct Batch_job_record {
+    Batch_job_record()
+        : _ok(false), _big(false), _worker(-1), _nb_vertices(0), _nb_triangles(0)
+        , _start(0.), _load(0.), _total(0.)
+    { }
+
+    std::string _mesh;
+    std::string _name;
+    bool _ok;           ///< mesh loaded and every preset solved
+    std::string _error; ///< why the mesh could not be loaded
+    bool _big;          ///< run alone with every thread
+    int _worker;        ///< worker which loaded the mesh (-1 for big meshes)
+    int _nb_vertices;
+    int _nb_triangles;
+    double _start;      ///< since the beginning of the batch
+    double _load;       ///< first rings included
+    double _total;      ///< from the start to the end of the last preset
+    std::vector<Batch_solve_record> _solves;
+};
+
+struct Batch_report {
+    Batch_report() : _nb_workers(0), _nb_steals(0), _wall(0.) { }
+
+    std::vector<Batch_job_record> _jobs; ///< in the order of the manifest
+    unsigned _nb_workers;
+    size_t _nb_steals;
+    double _wall;
+
+    int nb_failed_jobs() const;
+    /// Meshes done without failure per hour of wall time
+    double meshes_per_hour() const;
+
+    /// Summary file content
+    Json_value to_json() const;
+};
+
+/// Called by run_batch() each time a job is over (one call at a time)
+typedef std::function<void(const Batch_job_record& record, int nb_done, int nb_jobs)> Batch_progress;
+
+/// Run every job of 'manifest'
+/// @return false if the output directory can't be created, failures of
+/// the jobs are in 'report'
+bool run_batch(const Batch_manifest& manifest,
+               const Batch_options& options,
+               Batch_report& report,
+               Batch_progress on_job_done = nullptr);
+
+#endif // BATCH_RUNNER_HPP
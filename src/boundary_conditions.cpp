@@ -0,0 +1,206 @@
+#include "boundary_conditions.hpp"
+#include "boundary_spec.hpp"
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+// -----------------------------------------------------------------------------
+
+void set_strip_boundaries(std::vector<std::pair<Vert_idx, float> >& boundaries,
+                          const Mesh& mesh,
+                          float length)
+{
+    /*
+     *  Our sample models coordinates should roughly lie between [-1, 1]
+     *  We are going to select a thin strip of vertices on the top and bottom
+     *  of the model:
+
+        -----------------------▲  ▲ (1)
+            ___                   |
+           //_\\_                 |
+         ."\\    ".  ----------▼  |
+        /          \              |
+        |           \_            |
+        |       ,--.-.)           |
+        \     /  o \o\            + (0)
+        /\/\  \    /_/            |
+         (_.   `--'__)            |
+          |     .-'  \            |
+          |  .-'.     )           |
+          | (  _/--.-'            |
+          |  `.___.' ----------▲  |
+                (                 |
+                                  |
+        -----------------------▼  ▼ (-1)
+
+     *
+    */
+
+    boundaries.resize(mesh.nb_vertices());
+    int acc = 0;
+    for(int i = 0; i < mesh.nb_vertices(); ++i)
+    {
+        float dist = (mesh._vertices[i].y + 1.0f) * 0.5f;
+        if( dist < length) {
+            boundaries[acc++] = std::make_pair(i, dist);
+        }
+
+        if( dist > (1.0f-length) ) {
+            boundaries[acc++] = std::make_pair(i, dist);
+        }
+    }
+    boundaries.resize( acc );
+}
+
+// -----------------------------------------------------------------------------
+
+/*
+
+    Set boundary conditions to look like this:
+
+
+        0   0   0   0   0   0   0   0
+
+        0                           0
+                    1  1
+        0        1       1          0
+                1          1
+        0       1          1        0
+                 1        1
+        0           1  1            0
+
+        0                           0
+                                      ▲
+        0   0   0   0   0   0   0   0 | length
+                                 <--> ▼
+                                length
+
+    0s on all sides and 1s in the middle
+
+*/
+void set_cone_boundaries(std::vector<std::pair<Vert_idx, float> >& boundaries,
+                         const Mesh& mesh,
+                         float length)
+{
+    boundaries.resize(mesh.nb_vertices());
+    int acc = 0;
+    for(int i = 0; i < mesh.nb_vertices(); ++i)
+    {
+        Vec3 pos = mesh._vertices[i];
+        float dist = (pos.y + 1.0f) * 0.5f;
+        // Set bottom strip
+        if( dist < length) {
+            boundaries[acc++] = std::make_pair(i, 0.0f);
+        }
+
+        // Set top strip
+        if( dist > (1.0f-length) ) {
+            boundaries[acc++] = std::make_pair(i, 0.0f);
+        }
+
+        dist = (pos.x + 1.0f) * 0.5f;
+        // set left strip
+        if( dist < length) {
+            boundaries[acc++] = std::make_pair(i, 0.0f);
+        }
+
+        // set right strip
+        if( dist > (1.0f-length) ) {
+            boundaries[acc++] = std::make_pair(i, 0.0f);
+        }
+
+        // Set central values
+        dist = (pos.x*pos.x + pos.y*pos.y);
+        if( dist < length) {
+            boundaries[acc++] = std::make_pair(i, 1.0f);
+        }
+    }
+    boundaries.resize( acc );
+}
+
+// -----------------------------------------------------------------------------
+
+float default_boundary_length(Boundary_type type)
+{
+    return type == eSTRIP ? 0.1f : 0.01f;
+}
+
+// -----------------------------------------------------------------------------
+
+bool boundary_preset_value(Boundary_type type, float length, const Vec3& pos, float& value)
+{
+    float dist_y = (pos.y + 1.0f) * 0.5f;
+    bool side_y = dist_y < length || dist_y > (1.0f-length);
+    if( type == eSTRIP ) {
+        value = dist_y;
+        return side_y;
+    }
+
+    float dist_x = (pos.x + 1.0f) * 0.5f;
+    bool side_x = dist_x < length || dist_x > (1.0f-length);
+    if( (pos.x*pos.x + pos.y*pos.y) < length ) {
+        value = 1.0f;
+        return true;
+    }
+    value = 0.0f;
+    return side_x || side_y;
+}
+
+// -----------------------------------------------------------------------------
+
+bool parse_boundary_spec(const char* spec, Boundary_type& type, float& length)
+{
+    std::string str(spec);
+    std::string name = str.substr(0, str.find(':'));
+    if( name == "strip" )
+        type = eSTRIP;
+    else if( name == "cone" )
+        type = eCONE;
+    else {
+        std::cerr << "Unknown boundary preset '" << name << "' (expected strip, cone or a JSON spec)" << std::endl;
+        return false;
+    }
+
+    length = default_boundary_length(type);
+    if( name.size() < str.size() )
+    {
+        const char* arg = spec + name.size() + 1;
+        char* stop = nullptr;
+        length = std::strtof(arg, &stop);
+        if( stop == arg || *stop != '\0' || length <= 0.f ) {
+            std::cerr << "Invalid boundary length in '" << spec << "'" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool set_boundaries(const char* spec,
+                    const Mesh& mesh,
+                    std::vector<std::pair<Vert_idx, float> >& boundaries,
+                    const Spatial_index* index)
+{
+    boundaries.clear();
+    if( is_boundary_spec_json(spec) ) {
+        Boundary_spec declared;
+        Boundary_set set;
+        if( !declared.parse(spec) || !declared.resolve(mesh, set, index) )
+            return false;
+        boundaries.swap( set._boundaries );
+        return true;
+    }
+
+    Boundary_type type;
+    float length;
+    if( !parse_boundary_spec(spec, type, length) )
+        return false;
+
+    switch( type ) {
+    case eSTRIP: set_strip_boundaries(boundaries, mesh, length); break;
+    case eCONE:  set_cone_boundaries(boundaries, mesh, length);  break;
+    }
+    return true;
+}
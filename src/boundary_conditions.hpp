@@ -0,0 +1,52 @@
+#ifndef BOUNDARY_CONDITIONS_HPP
+#define BOUNDARY_CONDITIONS_HPP
+
+#include <vector>
+#include <utility>
+#include "mesh.hpp"
+
+class Spatial_index;
+
+/// Boundary condition presets. They assume the model roughly lies in
+/// [-1 1] on the (x,y) plane (which is the case of our sample models)
+enum Boundary_type {
+    eSTRIP, ///< bottom to top gradient (see set_strip_boundaries())
+    eCONE   ///< 0s on all sides and 1s in the middle (see set_cone_boundaries())
+};
+
+/// @brief Fix a thin strip of vertices at the top and bottom of the model
+/// to their normalized height.
+/// boundaries[] = (vertex_i, weight)
+void set_strip_boundaries(std::vector<std::pair<Vert_idx, float> >& boundaries,
+                          const Mesh& mesh,
+                          float length = 0.1f);
+
+/// @brief 0s on every side of the model and 1s in the middle
+void set_cone_boundaries(std::vector<std::pair<Vert_idx, float> >& boundaries,
+                         const Mesh& mesh,
+                         float length = 0.01f);
+
+/// Default 'length' parameter of a preset
+float default_boundary_length(Boundary_type type);
+
+/// @brief Value a preset gives to a vertex at 'pos'
+/// (the last one set_strip_boundaries() / set_cone_boundaries() lists for it)
+/// @return false if the preset leaves the vertex free
+bool boundary_preset_value(Boundary_type type, float length, const Vec3& pos, float& value);
+
+/// @brief Read a preset of set_boundaries() without applying it
+/// @return false if 'spec' is invalid (message printed on std::cerr)
+bool parse_boundary_spec(const char* spec, Boundary_type& type, float& length);
+
+/// @brief Set boundaries from a textual preset: "strip", "cone",
+/// optionally followed by the length parameter: "strip:0.2",
+/// or from a declarative spec: inline JSON or a ".json" file
+/// (see Boundary_spec in boundary_spec.hpp)
+/// @param index : spatial index of 'mesh' used by declarative specs (optional)
+/// @return false if 'spec' is invalid (message printed on std::cerr)
+bool set_boundaries(const char* spec,
+                    const Mesh& mesh,
+                    std::vector<std::pair<Vert_idx, float> >& boundaries,
+                    const Spatial_index* index = nullptr);
+
+#endif // BOUNDARY_CONDITIONS_HPP
@@ -0,0 +1,437 @@
+#include "boundary_spec.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#include "utils/parallel_for.hpp"
+#include "utils/trace.hpp"
+
+// -----------------------------------------------------------------------------
+
+float Boundary_value::eval(const Vec3& pos) const
+{
+    float t = 0.f;
+    switch( _kind ) {
+    case eCONSTANT:
+        return _v0;
+    case eLINEAR: {
+        Vec3 axis = _p1 - _p0;
+        float len2 = axis.norm_squared();
+        t = len2 > 0.f ? (pos - _p0).dot(axis) / len2 : 0.f;
+    } break;
+    case eRADIAL: {
+        float dr = _r1 - _r0;
+        t = dr != 0.f ? ((pos - _p0).norm() - _r0) / dr : 0.f;
+    } break;
+    }
+    t = std::min(std::max(t, 0.f), 1.f);
+    return _v0 + t * (_v1 - _v0);
+}
+
+// -----------------------------------------------------------------------------
+
+bool Boundary_region::contains(const Vec3& pos) const
+{
+    switch( _kind ) {
+    case eHALF_SPACE:
+        return (pos - _a).dot(_b) >= 0.f;
+    case eBOX:
+        return pos.x >= _a.x && pos.y >= _a.y && pos.z >= _a.z &&
+               pos.x <= _b.x && pos.y <= _b.y && pos.z <= _b.z;
+    case eSPHERE:
+        return (pos - _a).norm_squared() <= _r1 * _r1;
+    case eBAND: {
+        float d2 = (pos - _a).norm_squared();
+        return d2 >= _r0 * _r0 && d2 <= _r1 * _r1;
+    }
+    default:
+        return false;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+bool Boundary_region::may_overlap(const Aabb& box) const
+{
+    switch( _kind ) {
+    case eHALF_SPACE: {
+        // Corner of the box furthest along the normal
+        Vec3 corner(_b.x >= 0.f ? box._max.x : box._min.x,
+                    _b.y >= 0.f ? box._max.y : box._min.y,
+                    _b.z >= 0.f ? box._max.z : box._min.z);
+        return (corner - _a).dot(_b) >= 0.f;
+    }
+    case eBOX:
+        return box.overlaps( Aabb(_a, _b) );
+    case eSPHERE:
+    case eBAND: {
+        // The band is tested on its outer sphere
+        if( box.distance_squared(_a) > _r1 * _r1 )
+            return false;
+        Vec3 far(std::max(std::abs(box._min.x - _a.x), std::abs(box._max.x - _a.x)),
+                 std::max(std::abs(box._min.y - _a.y), std::abs(box._max.y - _a.y)),
+                 std::max(std::abs(box._min.z - _a.z), std::abs(box._max.z - _a.z)));
+        return far.norm_squared() >= _r0 * _r0;
+    }
+    default:
+        return false;
+    }
+}
+
+// =============================================================================
+
+namespace {
+
+/// Read [x, y, z] of 'json'
+bool read_vec3(const Json_value* json, const std::string& where, const char* key, Vec3& v)
+{
+    if( json == nullptr || !json->is_array() || json->size() != 3 ||
+        !json->at(0).is_number() || !json->at(1).is_number() || !json->at(2).is_number() )
+    {
+        std::cerr << where << ": \"" << key << "\" must be an array of 3 numbers" << std::endl;
+        return false;
+    }
+    v = Vec3(float(json->at(0).as_number()), float(json->at(1).as_number()), float(json->at(2).as_number()));
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool read_number(const Json_value* json, const std::string& where, const char* key, float& f)
+{
+    if( json == nullptr || !json->is_number() ) {
+        std::cerr << where << ": \"" << key << "\" must be a number" << std::endl;
+        return false;
+    }
+    f = float(json->as_number());
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Read [a, b] of 'json'
+bool read_range(const Json_value* json, const std::string& where, const char* key, float& a, float& b)
+{
+    if( json == nullptr || !json->is_array() || json->size() != 2 ||
+        !json->at(0).is_number() || !json->at(1).is_number() )
+    {
+        std::cerr << where << ": \"" << key << "\" must be an array of 2 numbers" << std::endl;
+        return false;
+    }
+    a = float(json->at(0).as_number());
+    b = float(json->at(1).as_number());
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// "value": number, linear {"from", "to", "range"} or radial
+/// {"center", "radii", "range"}
+bool read_value(const Json_value* json, const std::string& where, Boundary_value& value)
+{
+    if( json == nullptr ) {
+        std::cerr << where << ": missing \"value\"" << std::endl;
+        return false;
+    }
+    if( json->is_number() ) {
+        value = Boundary_value( float(json->as_number()) );
+        return true;
+    }
+    if( !json->is_object() ) {
+        std::cerr << where << ": \"value\" must be a number or an object" << std::endl;
+        return false;
+    }
+    if( !read_range(json->find("range"), where, "range", value._v0, value._v1) )
+        return false;
+    if( json->find("from") != nullptr ) {
+        value._kind = Boundary_value::eLINEAR;
+        return read_vec3(json->find("from"), where, "from", value._p0) &&
+               read_vec3(json->find("to"), where, "to", value._p1);
+    }
+    if( json->find("center") != nullptr ) {
+        value._kind = Boundary_value::eRADIAL;
+        return read_vec3(json->find("center"), where, "center", value._p0) &&
+               read_range(json->find("radii"), where, "radii", value._r0, value._r1);
+    }
+    std::cerr << where << ": \"value\" needs \"from\" and \"to\" or \"center\" and \"radii\"" << std::endl;
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+
+bool read_constraint(const Json_value& json, const std::string& where, Boundary_constraint& c)
+{
+    if( !json.is_object() ) {
+        std::cerr << where << ": must be an object" << std::endl;
+        return false;
+    }
+    Boundary_region& r = c._region;
+    const Json_value* region = nullptr;
+
+    if( const Json_value* preset = json.find("preset") )
+    {
+        r._kind = Boundary_region::ePRESET;
+        if( !preset->is_string() ||
+            !parse_boundary_spec(preset->as_string().c_str(), r._preset, r._length) )
+        {
+            std::cerr << where << ": invalid \"preset\"" << std::endl;
+            return false;
+        }
+        if( const Json_value* length = json.find("length") ) {
+            if( !read_number(length, where, "length", r._length) )
+                return false;
+        }
+        return true;
+    }
+    else if( const Json_value* vertices = json.find("vertices") )
+    {
+        r._kind = Boundary_region::eVERTICES;
+        if( !vertices->is_array() ) {
+            std::cerr << where << ": \"vertices\" must be an array of indices" << std::endl;
+            return false;
+        }
+        c._vertices.resize( vertices->size() );
+        for(unsigned i = 0; i < vertices->size(); ++i) {
+            double idx = vertices->at(i).as_number(-1.);
+            if( idx < 0. || idx != std::floor(idx) ) {
+                std::cerr << where << ": invalid vertex index in \"vertices\"" << std::endl;
+                return false;
+            }
+            c._vertices[i] = Vert_idx(idx);
+        }
+        if( const Json_value* values = json.find("values") ) {
+            if( !values->is_array() || values->size() != vertices->size() ) {
+                std::cerr << where << ": \"values\" must be an array as long as \"vertices\"" << std::endl;
+                return false;
+            }
+            c._values.resize( values->size() );
+            for(unsigned i = 0; i < values->size(); ++i)
+                if( !read_number(&values->at(i), where, "values", c._values[i]) )
+                    return false;
+            return true;
+        }
+    }
+    else if( (region = json.find("half_space")) != nullptr )
+    {
+        r._kind = Boundary_region::eHALF_SPACE;
+        if( region->find("point") != nullptr && !read_vec3(region->find("point"), where, "point", r._a) )
+            return false;
+        if( !read_vec3(region->find("normal"), where, "normal", r._b) )
+            return false;
+    }
+    else if( (region = json.find("box")) != nullptr )
+    {
+        r._kind = Boundary_region::eBOX;
+        if( !read_vec3(region->find("min"), where, "min", r._a) ||
+            !read_vec3(region->find("max"), where, "max", r._b) )
+        {
+            return false;
+        }
+    }
+    else if( (region = json.find("sphere")) != nullptr )
+    {
+        r._kind = Boundary_region::eSPHERE;
+        if( !read_vec3(region->find("center"), where, "center", r._a) ||
+            !read_number(region->find("radius"), where, "radius", r._r1) )
+        {
+            return false;
+        }
+    }
+    else if( (region = json.find("nearest")) != nullptr )
+    {
+        r._kind = Boundary_region::eNEAREST;
+        if( !read_vec3(region->find("point"), where, "point", r._a) )
+            return false;
+        if( const Json_value* count = region->find("count") ) {
+            double nb = count->as_number(0.);
+            if( nb < 1. || nb != std::floor(nb) ) {
+                std::cerr << where << ": \"count\" must be a positive integer" << std::endl;
+                return false;
+            }
+            r._count = int(nb);
+        }
+    }
+    else if( (region = json.find("band")) != nullptr )
+    {
+        r._kind = Boundary_region::eBAND;
+        if( !read_vec3(region->find("center"), where, "center", r._a) ||
+            !read_number(region->find("min"), where, "min", r._r0) ||
+            !read_number(region->find("max"), where, "max", r._r1) )
+        {
+            return false;
+        }
+    }
+    else
+    {
+        std::cerr << where << ": expected \"preset\", \"vertices\", \"half_space\", "
+                  << "\"box\", \"sphere\", \"band\" or \"nearest\"" << std::endl;
+        return false;
+    }
+    return read_value(json.find("value"), where, c._value);
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+bool is_boundary_spec_json(const char* spec)
+{
+    size_t len = std::strlen(spec);
+    return spec[0] == '{' || spec[0] == '[' ||
+           (len > 5 && std::strcmp(spec + len - 5, ".json") == 0);
+}
+
+// -----------------------------------------------------------------------------
+
+bool Boundary_spec::parse(const char* spec)
+{
+    _name.clear();
+    _constraints.clear();
+    if( !is_boundary_spec_json(spec) )
+    {
+        Boundary_constraint c;
+        c._region._kind = Boundary_region::ePRESET;
+        if( !parse_boundary_spec(spec, c._region._preset, c._region._length) )
+            return false;
+        _name = spec;
+        _constraints.push_back( c );
+        return true;
+    }
+
+    Json_value json;
+    if( spec[0] == '{' || spec[0] == '[' ) {
+        std::string error;
+        if( !Json_value::parse(spec, json, &error) ) {
+            std::cerr << "Invalid boundary spec: " << error << std::endl;
+            return false;
+        }
+        return from_json(json, "boundary spec");
+    }
+    if( !read_json_file(spec, json) )
+        return false;
+    return from_json(json, spec);
+}
+
+// -----------------------------------------------------------------------------
+
+bool Boundary_spec::from_json(const Json_value& json, const std::string& where)
+{
+    _name.clear();
+    _constraints.clear();
+    const Json_value* list = &json;
+    if( json.is_object() ) {
+        if( const Json_value* name = json.find("name") )
+            _name = name->as_string();
+        list = json.find("constraints");
+    }
+    if( list == nullptr || !list->is_array() ) {
+        std::cerr << where << ": expected a \"constraints\" array" << std::endl;
+        return false;
+    }
+
+    _constraints.resize( list->size() );
+    for(unsigned i = 0; i < list->size(); ++i) {
+        std::string at = where + ", constraint " + std::to_string(i);
+        if( !read_constraint(list->at(i), at, _constraints[i]) )
+            return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Boundary_spec::resolve(const Mesh& mesh, Boundary_set& set, const Spatial_index* index) const
+{
+    Trace_scope trace("resolve_boundaries");
+    const int nv = int(mesh.nb_vertices());
+    if( index != nullptr && index->nb_vertices() != nv )
+        index = nullptr; // not built or of another mesh
+    Spatial_index local_index;
+    for(const Boundary_constraint& con : _constraints) {
+        if( index == nullptr && con._region._kind == Boundary_region::eNEAREST ) {
+            local_index.build_vertices( mesh._vertices );
+            index = &local_index;
+        }
+    }
+    std::vector<Vert_idx> selected;
+    std::vector<std::pair<Vert_idx, float> > nearest;
+
+    // Value and whether the vertex is fixed, the last constraint wins
+    std::vector<float> values( nv, 0.f );
+    std::vector<uint8_t> fixed( nv, 0 );
+
+    for(unsigned c = 0; c < _constraints.size(); ++c)
+    {
+        const Boundary_constraint& con = _constraints[c];
+        const Boundary_region& r = con._region;
+        switch( r._kind ) {
+        case Boundary_region::eVERTICES:
+            for(unsigned i = 0; i < con._vertices.size(); ++i) {
+                Vert_idx v = con._vertices[i];
+                if( v < 0 || v >= nv ) {
+                    std::cerr << "Boundary constraint " << c << ": vertex " << v
+                              << " out of range (" << nv << " vertices)" << std::endl;
+                    return false;
+                }
+                values[v] = con._values.empty() ? con._value.eval(mesh._vertices[v]) : con._values[i];
+                fixed[v] = 1;
+            }
+            break;
+        case Boundary_region::eNEAREST:
+            index->k_nearest_vertices(r._a, r._count, nearest);
+            for(const std::pair<Vert_idx, float>& elt : nearest) {
+                values[elt.first] = con._value.eval( mesh._vertices[elt.first] );
+                fixed[elt.first] = 1;
+            }
+            break;
+        case Boundary_region::ePRESET:
+            parallel_for(0, nv, [&](int v) {
+                float value;
+                if( boundary_preset_value(r._preset, r._length, mesh._vertices[v], value) ) {
+                    values[v] = value;
+                    fixed[v] = 1;
+                }
+            });
+            break;
+        default:
+            if( index != nullptr ) {
+                index->vertices_where([&](const Aabb& box) { return r.may_overlap(box); },
+                                      [&](const Vec3& pos) { return r.contains(pos); }, selected);
+                for(Vert_idx v : selected) {
+                    values[v] = con._value.eval( mesh._vertices[v] );
+                    fixed[v] = 1;
+                }
+                break;
+            }
+            parallel_for(0, nv, [&](int v) {
+                const Vec3& pos = mesh._vertices[v];
+                if( r.contains(pos) ) {
+                    values[v] = con._value.eval(pos);
+                    fixed[v] = 1;
+                }
+            });
+            break;
+        }
+    }
+
+    set._boundaries.clear();
+    for(int v = 0; v < nv; ++v)
+        if( fixed[v] )
+            set._boundaries.push_back( std::make_pair(v, values[v]) );
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+Hash128 boundary_vertices_key(const std::vector<std::pair<Vert_idx, float> >& boundaries)
+{
+    std::vector<Vert_idx> verts( boundaries.size() );
+    for(unsigned i = 0; i < boundaries.size(); ++i)
+        verts[i] = boundaries[i].first;
+    std::sort(verts.begin(), verts.end());
+    verts.erase(std::unique(verts.begin(), verts.end()), verts.end());
+    Hasher h;
+    h.add( verts );
+    return h.digest();
+}
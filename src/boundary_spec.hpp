@@ -0,0 +1,158 @@
+#ifndef BOUNDARY_SPEC_HPP
+#define BOUNDARY_SPEC_HPP
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "boundary_conditions.hpp"
+#include "mesh.hpp"
+#include "spatial_index.hpp"
+#include "utils/hash.hpp"
+#include "utils/json.hpp"
+
+/**
+ * @brief Declarative boundary conditions: an ordered list of constraints,
+ * each selecting vertices and the value they are fixed to.
+ *
+ * Read from JSON, inline or from a file (see Boundary_spec::parse()):
+ * @code
+ * {
+ *     "name": "hot_spot",
+ *     "constraints": [
+ *         { "preset": "cone", "length": 0.02 },
+ *         { "vertices": [12, 57, 301], "value": 0.5 },
+ *         { "vertices": [4, 8], "values": [0.0, 1.0] },
+ *         { "half_space": { "point": [0, 0.9, 0], "normal": [0, 1, 0] }, "value": 1 },
+ *         { "box": { "min": [-1, -1, -1], "max": [-0.9, 1, 1] },
+ *           "value": { "from": [0, -1, 0], "to": [0, 1, 0], "range": [0, 1] } },
+ *         { "sphere": { "center": [0, 0, 0], "radius": 0.1 }, "value": 1 },
+ *         { "band": { "center": [0, 0, 0], "min": 0.4, "max": 0.5 },
+ *           "value": { "center": [0, 0, 0], "radii": [0.4, 0.5], "range": [1, 0] } },
+ *         { "nearest": { "point": [0.3, 0.2, 0], "count": 1 }, "value": 1 }
+ *     ]
+ * }
+ * @endcode
+ * A value is a number, a linear ramp between two points (clamped
+ * projection on the segment) or a radial ramp between two distances to a
+ * point. A vertex selected by several constraints takes the value of the
+ * last one. Presets are the ones of set_boundaries() ("preset" may also be
+ * written "cone:0.02"). "nearest" snaps to the 'count' vertices closest to
+ * a point (e.g. a handle or a joint position).
+ *
+ * Region constraints and presets are evaluated with parallel loops over
+ * the vertices, or with queries of a Spatial_index when resolve() is given
+ * one (logarithmic instead of linear in the number of vertices). The result
+ * is sorted by vertex without duplicates, so two specs selecting the same
+ * vertices give the same boundary_vertices_key() and reuse the
+ * factorizations of the solve cache (see io/solve_cache.hpp).
+ */
+
+/// Value of the vertices selected by a constraint
+struct Boundary_value {
+    enum Kind {
+        eCONSTANT,
+        eLINEAR,  ///< _v0 at _p0 to _v1 at _p1, projected on the segment
+        eRADIAL   ///< _v0 at distance _r0 of _p0 to _v1 at distance _r1
+    };
+
+    Boundary_value(float v = 0.f)
+        : _kind(eCONSTANT), _v0(v), _v1(v), _p0(0.f), _p1(0.f), _r0(0.f), _r1(0.f)
+    { }
+
+    float eval(const Vec3& pos) const;
+
+    Kind _kind;
+    float _v0, _v1;
+    Vec3 _p0, _p1;
+    float _r0, _r1;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Vertices selected by a constraint
+struct Boundary_region {
+    enum Kind {
+        eVERTICES,   ///< explicit list of vertex indices
+        eHALF_SPACE, ///< dot(pos - _a, _b) >= 0 (_b is the normal)
+        eBOX,        ///< _a <= pos <= _b
+        eSPHERE,     ///< |pos - _a| <= _r1
+        eBAND,       ///< _r0 <= |pos - _a| <= _r1
+        eNEAREST,    ///< the _count vertices closest to _a
+        ePRESET      ///< set_strip_boundaries() or set_cone_boundaries()
+    };
+
+    Boundary_region()
+        : _kind(eVERTICES), _a(0.f), _b(0.f), _r0(0.f), _r1(0.f), _count(1)
+        , _preset(eCONE), _length(0.f)
+    { }
+
+    /// @return true if 'pos' is in the region
+    /// (not for eVERTICES, eNEAREST and ePRESET)
+    bool contains(const Vec3& pos) const;
+
+    /// @return false if no point of 'box' is in the region
+    /// (not for eVERTICES, eNEAREST and ePRESET)
+    bool may_overlap(const Aabb& box) const;
+
+    Kind _kind;
+    Vec3 _a, _b;
+    float _r0, _r1;
+    int _count;
+    Boundary_type _preset;
+    float _length;
+};
+
+// -----------------------------------------------------------------------------
+
+struct Boundary_constraint {
+    Boundary_region _region;
+    Boundary_value _value;
+    std::vector<Vert_idx> _vertices; ///< eVERTICES only
+    std::vector<float> _values;      ///< eVERTICES only, per vertex when not empty
+};
+
+// -----------------------------------------------------------------------------
+
+/// Boundary conditions resolved on a mesh
+struct Boundary_set {
+    /// (vertex, value) sorted by vertex, without duplicates
+    std::vector<std::pair<Vert_idx, float> > _boundaries;
+};
+
+// -----------------------------------------------------------------------------
+
+class Boundary_spec {
+public:
+    /// @brief Read 'spec': a preset of set_boundaries() ("strip:0.2"),
+    /// inline JSON (starts with '{' or '[') or a ".json" file
+    /// @return false on error (message printed on std::cerr)
+    bool parse(const char* spec);
+
+    /// @brief Read an object with a "constraints" array or an array of
+    /// constraints (see the format above)
+    /// @param where : context of the error messages (e.g. the file name)
+    bool from_json(const Json_value& json, const std::string& where);
+
+    /// Fix the vertices selected by the constraints
+    /// @param index : of 'mesh', optional (built for "nearest" constraints
+    /// when not given)
+    /// @return false if a vertex index is out of range (message printed on
+    /// std::cerr)
+    bool resolve(const Mesh& mesh, Boundary_set& set, const Spatial_index* index = nullptr) const;
+
+    std::string _name; ///< "name" of the JSON spec (optional)
+    std::vector<Boundary_constraint> _constraints;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @return true if 'spec' is a declarative spec (inline JSON or a ".json"
+/// file) rather than a preset
+bool is_boundary_spec_json(const char* spec);
+
+/// Hash of the constrained vertices, in any order and with duplicates:
+/// the reduced system and its factorization only depend on it
+Hash128 boundary_vertices_key(const std::vector<std::pair<Vert_idx, float> >& boundaries);
+
+#endif // BOUNDARY_SPEC_HPP
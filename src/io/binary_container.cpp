@@ -0,0 +1,217 @@
+#include "io/binary_container.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+    #include <process.h>
+#else
+    #include <unistd.h>
+#endif
+
+#include "utils/parallel_for.hpp"
+
+// =============================================================================
+namespace Binary_container {
+// =============================================================================
+
+static const uint32_t g_endianness = 0x01020304;
+
+static uint64_t align(uint64_t offset) {
+    return (offset + g_alignment - 1) / g_alignment * g_alignment;
+}
+
+/// Name of the file written before its rename to 'file_name', unique per
+/// process and thread so that concurrent writers of the same file (e.g. two
+/// processes sharing a cache directory) never write into the same file
+static std::string temp_name(const std::string& file_name)
+{
+#ifdef _WIN32
+    unsigned long pid = (unsigned long)_getpid();
+#else
+    unsigned long pid = (unsigned long)::getpid();
+#endif
+    size_t tid = std::hash<std::thread::id>()( std::this_thread::get_id() );
+    return file_name + "." + std::to_string(pid) + "." + std::to_string(tid) + ".tmp";
+}
+
+// -----------------------------------------------------------------------------
+
+Writer::Writer(const char magic[8], uint32_t version)
+{
+    std::memset(&_header, 0, sizeof(Header));
+    std::memcpy(_header._magic, magic, 8);
+    _header._version = version;
+    _header._endianness = g_endianness;
+}
+
+// -----------------------------------------------------------------------------
+
+void Writer::add_section(uint32_t id, const void* data, uint64_t nb, uint32_t elt_size)
+{
+    Section_entry entry;
+    entry._id = id;
+    entry._elt_size = elt_size;
+    entry._offset = 0;
+    entry._size = nb * elt_size;
+    _sections.push_back( entry );
+    _data.push_back( data );
+}
+
+// -----------------------------------------------------------------------------
+
+bool Writer::write(const std::string& file_name)
+{
+    _header._nb_sections = uint32_t(_sections.size());
+    uint64_t offset = sizeof(Header) + sizeof(Section_entry) * _sections.size();
+    for(Section_entry& entry : _sections) {
+        offset = align(offset);
+        entry._offset = offset;
+        offset += entry._size;
+    }
+
+    std::string tmp_name = temp_name(file_name);
+    FILE* file = std::fopen(tmp_name.c_str(), "wb");
+    if( file == nullptr )
+        return false;
+
+    static const char zeros[g_alignment] = {0};
+    bool ok = std::fwrite(&_header, sizeof(Header), 1, file) == 1;
+    if( !_sections.empty() )
+        ok = ok && std::fwrite(_sections.data(), sizeof(Section_entry), _sections.size(), file) == _sections.size();
+
+    uint64_t pos = sizeof(Header) + sizeof(Section_entry) * _sections.size();
+    for(unsigned i = 0; i < _sections.size() && ok; ++i) {
+        const Section_entry& entry = _sections[i];
+        ok = ok && std::fwrite(zeros, 1, size_t(entry._offset - pos), file) == entry._offset - pos;
+        if( entry._size > 0 )
+            ok = ok && std::fwrite(_data[i], 1, size_t(entry._size), file) == entry._size;
+        pos = entry._offset + entry._size;
+    }
+    ok = (std::fclose(file) == 0) && ok;
+
+    if( ok && std::rename(tmp_name.c_str(), file_name.c_str()) != 0 ) {
+        // std::rename() does not overwrite on every platform
+        std::remove(file_name.c_str());
+        ok = std::rename(tmp_name.c_str(), file_name.c_str()) == 0;
+    }
+    if( !ok )
+        std::remove(tmp_name.c_str());
+    return ok;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Reader::open(const std::string& file_name, const char magic[8], uint32_t version)
+{
+    close();
+    if( !_file.open(file_name.c_str()) )
+        return false;
+
+    const Header* header = (const Header*)_file.data();
+    if( _file.size() < sizeof(Header) ||
+        std::memcmp(header->_magic, magic, 8) != 0 ||
+        header->_version != version ||
+        header->_endianness != g_endianness )
+    {
+        _file.close();
+        return false;
+    }
+
+    const Section_entry* sections = (const Section_entry*)(header + 1);
+    uint64_t table_end = sizeof(Header) + sizeof(Section_entry) * uint64_t(header->_nb_sections);
+    bool ok = table_end <= _file.size();
+    for(uint32_t i = 0; i < header->_nb_sections && ok; ++i)
+        ok = sections[i]._offset + sections[i]._size <= _file.size() &&
+             sections[i]._offset % g_alignment == 0;
+
+    if( !ok ) {
+        _file.close();
+        return false;
+    }
+    _header = header;
+    _sections = sections;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void Reader::close()
+{
+    _file.close();
+    _header = nullptr;
+    _sections = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+const void* Reader::section(uint32_t id, uint64_t& nb, uint32_t elt_size) const
+{
+    nb = 0;
+    for(uint32_t i = 0; i < _header->_nb_sections; ++i)
+    {
+        const Section_entry& entry = _sections[i];
+        if( entry._id != id )
+            continue;
+        if( entry._elt_size != elt_size )
+            return nullptr;
+        nb = entry._size / elt_size;
+        return _file.data() + entry._offset;
+    }
+    return nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Reader::has_section(uint32_t id) const
+{
+    for(uint32_t i = 0; i < _header->_nb_sections; ++i)
+        if( _sections[i]._id == id )
+            return true;
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+
+bool in_range(const int* values, uint64_t nb, int bound)
+{
+    std::atomic<bool> ok(true);
+    parallel_for_ranges(0, int(nb), [&](int begin, int end) {
+        for(int i = begin; i < end && ok; ++i)
+            if( values[i] < 0 || values[i] >= bound )
+                ok = false;
+    }, 1 << 16);
+    return ok;
+}
+
+// -----------------------------------------------------------------------------
+
+bool is_permutation(const int* perm, int n)
+{
+    std::vector<char> seen(n, 0);
+    for(int i = 0; i < n; ++i) {
+        if( perm[i] < 0 || perm[i] >= n || seen[ perm[i] ] )
+            return false;
+        seen[ perm[i] ] = 1;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool is_csr_offsets(const int* offsets, int nb_lists, uint64_t nb_indices)
+{
+    if( offsets[0] != 0 || uint64_t(offsets[nb_lists]) != nb_indices )
+        return false;
+    for(int i = 0; i < nb_lists; ++i)
+        if( offsets[i+1] < offsets[i] )
+            return false;
+    return true;
+}
+
+}// END Binary_container NAMESPACE =============================================
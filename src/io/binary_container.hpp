@@ -0,0 +1,125 @@
+#ifndef BINARY_CONTAINER_HPP
+#define BINARY_CONTAINER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "io/mapped_file.hpp"
+
+/**
+ * @brief Versioned binary file made of aligned sections.
+ *
+ * Layout:
+ * @code
+ * [Header][Section table][pad][section 0][pad][section 1]...
+ * @endcode
+ * Every section starts on a 64 bytes boundary so that the file can be
+ * memory mapped and its arrays used in place without any copy.
+ * Files are written in native endianness, readers reject files written with
+ * a different one.
+ */
+namespace Binary_container {
+
+/// Alignment of every section in bytes
+const uint64_t g_alignment = 64;
+
+struct Header {
+    char _magic[8];
+    uint32_t _version;
+    uint32_t _endianness;  ///< 0x01020304 as written by the host
+    uint32_t _nb_sections;
+    uint32_t _pad;
+    uint64_t _stamp[4];    ///< user data (e.g. source file stamp / hash)
+};
+
+struct Section_entry {
+    uint32_t _id;
+    uint32_t _elt_size;   ///< size of one element in bytes
+    uint64_t _offset;     ///< from the beginning of the file
+    uint64_t _size;       ///< in bytes
+};
+
+// -----------------------------------------------------------------------------
+
+/// @brief Accumulate sections then write them to disk in one go.
+/// @warning only pointers are kept, data must stay alive until write()
+struct Writer {
+
+    Writer(const char magic[8], uint32_t version);
+
+    /// User data stored in the header
+    void set_stamp(int i, uint64_t val) { _header._stamp[i] = val; }
+
+    /// Add an array of 'nb' elements of 'elt_size' bytes
+    void add_section(uint32_t id, const void* data, uint64_t nb, uint32_t elt_size);
+
+    template<class T>
+    void add_section(uint32_t id, const std::vector<T>& array) {
+        add_section(id, array.data(), array.size(), sizeof(T));
+    }
+
+    /// Write to 'file_name' (through a temporary file of this process and
+    /// thread renamed at the end so readers never see a partially written
+    /// file)
+    /// @return false on error
+    bool write(const std::string& file_name);
+
+private:
+    Header _header;
+    std::vector<Section_entry> _sections;
+    std::vector<const void*> _data;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @brief Memory mapped read access to a container
+struct Reader {
+
+    Reader() : _header(nullptr), _sections(nullptr) { }
+
+    /// Map and validate the file.
+    /// @return false if the file does not exist, is truncated or does
+    /// not match 'magic' 'version' and endianness
+    bool open(const std::string& file_name, const char magic[8], uint32_t version);
+
+    void close();
+
+    bool is_open() const { return _header != nullptr; }
+
+    const Header& header() const { return *_header; }
+
+    /// @return pointer to the section data (in the mapping, no copy) or
+    /// nullptr if the section does not exist.
+    /// @param[out] nb : number of elements
+    const void* section(uint32_t id, uint64_t& nb, uint32_t elt_size) const;
+
+    template<class T>
+    const T* section(uint32_t id, uint64_t& nb) const {
+        return (const T*)section(id, nb, sizeof(T));
+    }
+
+    bool has_section(uint32_t id) const;
+
+private:
+    Mapped_file _file;
+    const Header* _header;
+    const Section_entry* _sections;
+};
+
+// -----------------------------------------------------------------------------
+/// @name Checks of the sections read from a file before using them in place
+// -----------------------------------------------------------------------------
+
+/// @return true if every value of 'values' is in [0 bound)
+bool in_range(const int* values, uint64_t nb, int bound);
+
+/// @return true if 'perm' holds every index of [0 n) once
+bool is_permutation(const int* perm, int n);
+
+/// @return true if 'offsets' of a CSR (or compressed column) layout of
+/// 'nb_lists' lists increase from 0 to 'nb_indices'
+bool is_csr_offsets(const int* offsets, int nb_lists, uint64_t nb_indices);
+
+}// END Binary_container NAMESPACE =============================================
+
+#endif // BINARY_CONTAINER_HPP
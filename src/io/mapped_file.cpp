@@ -0,0 +1,107 @@
+#include "io/mapped_file.hpp"
+
+#include <iostream>
+
+#if defined(_WIN32)
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+// -----------------------------------------------------------------------------
+
+// Mark empty but opened files
+static char g_empty_file = 0;
+
+// -----------------------------------------------------------------------------
+
+bool Mapped_file::open(const char* file_name)
+{
+    close();
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if( file == INVALID_HANDLE_VALUE )
+        return false;
+
+    LARGE_INTEGER size;
+    if( !GetFileSizeEx(file, &size) ) {
+        CloseHandle(file);
+        return false;
+    }
+
+    if( size.QuadPart == 0 ) {
+        CloseHandle(file);
+        _data = &g_empty_file;
+        _size = 0;
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if( mapping == NULL )
+        return false;
+
+    void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if( ptr == NULL ) {
+        CloseHandle(mapping);
+        return false;
+    }
+    _handle = mapping;
+    _data = (const char*)ptr;
+    _size = size_t(size.QuadPart);
+#else
+    int fd = ::open(file_name, O_RDONLY);
+    if( fd < 0 )
+        return false;
+
+    struct stat st;
+    if( fstat(fd, &st) != 0 ) {
+        ::close(fd);
+        return false;
+    }
+
+    if( st.st_size == 0 ) {
+        ::close(fd);
+        _data = &g_empty_file;
+        _size = 0;
+        return true;
+    }
+
+    void* ptr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after closing the descriptor
+    ::close(fd);
+    if( ptr == MAP_FAILED )
+        return false;
+    // We read files front to back
+    madvise(ptr, size_t(st.st_size), MADV_SEQUENTIAL);
+
+    _data = (const char*)ptr;
+    _size = size_t(st.st_size);
+#endif
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void Mapped_file::close()
+{
+    if( _data != nullptr && _data != &g_empty_file )
+    {
+#if defined(_WIN32)
+        UnmapViewOfFile(_data);
+        CloseHandle((HANDLE)_handle);
+#else
+        munmap((void*)_data, _size);
+#endif
+    }
+    _data = nullptr;
+    _size = 0;
+    _handle = nullptr;
+}
@@ -0,0 +1,37 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+
+/// @brief Read only memory mapping of a whole file.
+/// The mapping is released when the object is destroyed.
+struct Mapped_file {
+
+    Mapped_file() : _data(nullptr), _size(0), _handle(nullptr) { }
+
+    ~Mapped_file() { close(); }
+
+    /// Map 'file_name' in memory
+    /// @return false if the file can't be opened (an empty file is valid)
+    bool open(const char* file_name);
+
+    /// Unmap the file
+    void close();
+
+    bool is_open() const { return _data != nullptr; }
+
+    const char* data() const { return _data; }
+    const char* end() const { return _data + _size; }
+    size_t size() const { return _size; }
+
+private:
+    Mapped_file(const Mapped_file&);
+    Mapped_file& operator=(const Mapped_file&);
+
+    const char* _data;
+    size_t _size;
+    /// Platform specific handle (file mapping object on windows)
+    void* _handle;
+};
+
+#endif // MAPPED_FILE_HPP
@@ -0,0 +1,433 @@
+#include "io/mesh_cache.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <filesystem>
+#include <Eigen/Sparse>
+#include <Eigen/OrderingMethods>
+
+#include "topology/vertex_to_face.hpp"
+#include "topology/vertex_to_1st_ring_vertices.hpp"
+#include "io/mapped_file.hpp"
+#include "utils/hash.hpp"
+#include "utils/parallel_for.hpp"
+#include "utils/trace.hpp"
+
+// -----------------------------------------------------------------------------
+
+static const char g_magic[8] = {'H','W','M','E','S','H','\0','\0'};
+/// Increment whenever the layout or the content of a section changes
+static const uint32_t g_version = 2;
+
+static bool g_cache_enabled = true;
+
+/// Empty for the default directory
+static std::string g_cache_directory;
+
+/// Section ids
+enum {
+    eSECTION_VERTICES = 1,
+    eSECTION_TRIANGLES,
+    eSECTION_V2F_OFFSETS,
+    eSECTION_V2F_TRIS,
+    eSECTION_RING_OFFSETS,
+    eSECTION_RING_VERTS,
+    eSECTION_RING_FLAGS,
+    eSECTION_LAPLACIAN_OFFSETS,
+    eSECTION_LAPLACIAN_COLS,
+    eSECTION_PERMUTATION
+};
+
+// -----------------------------------------------------------------------------
+
+/// Size of the source file
+static bool source_size(const char* mesh_path, uint64_t& size)
+{
+    std::error_code err;
+    size = uint64_t( std::filesystem::file_size(mesh_path, err) );
+    return !err;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Hash of the content of the source file, hashed in parallel by chunks
+/// whose digests are then hashed in order
+static bool source_hash(const char* mesh_path, Hash128& hash)
+{
+    Trace_scope trace("hash_mesh_source");
+    Mapped_file file;
+    if( !file.open(mesh_path) )
+        return false;
+    const size_t chunk = size_t(1) << 22;
+    const int nb_chunks = int((file.size() + chunk - 1) / chunk);
+    std::vector<Hash128> digests( nb_chunks );
+    parallel_for_chunks(nb_chunks, [&](int c) {
+        size_t begin = size_t(c) * chunk;
+        Hasher hasher;
+        hasher.add(file.data() + begin, std::min(chunk, file.size() - begin));
+        digests[c] = hasher.digest();
+    });
+    Hasher hasher;
+    hasher.add( digests );
+    hash = hasher.digest();
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Default directory of the caches (see set_mesh_cache_directory())
+static std::filesystem::path default_cache_directory()
+{
+    namespace fs = std::filesystem;
+#ifdef _WIN32
+    const char* local = std::getenv("LOCALAPPDATA");
+    if( local != nullptr && *local != '\0' )
+        return fs::path(local) / "harmonic_weights";
+#else
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    if( xdg != nullptr && *xdg != '\0' )
+        return fs::path(xdg) / "harmonic_weights";
+    const char* home = std::getenv("HOME");
+    if( home != nullptr && *home != '\0' )
+        return fs::path(home) / ".cache" / "harmonic_weights";
+#endif
+    std::error_code err;
+    return fs::temp_directory_path(err) / "harmonic_weights";
+}
+
+// -----------------------------------------------------------------------------
+
+/// Read a CSR adjacency made of two sections. A truncated or corrupted
+/// adjacency (offsets not increasing from 0 to the number of indices,
+/// indices outside [0 bound)) is ignored.
+static Csr_view csr_section(const Binary_container::Reader& reader,
+                            uint32_t offsets_id,
+                            uint32_t indices_id,
+                            int nb_lists,
+                            int bound)
+{
+    uint64_t nb_offsets = 0, nb_indices = 0;
+    const int* offsets = reader.section<int>(offsets_id, nb_offsets);
+    const int* indices = reader.section<int>(indices_id, nb_indices);
+    if( offsets == nullptr || indices == nullptr ||
+        nb_offsets != uint64_t(nb_lists) + 1 ||
+        !Binary_container::is_csr_offsets(offsets, nb_lists, nb_indices) ||
+        !Binary_container::in_range(indices, nb_indices, bound) )
+    {
+        return Csr_view();
+    }
+    return Csr_view(offsets, indices, nb_lists);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Non zeros of the Laplacian: the first ring plus the diagonal, sorted
+static void laplacian_pattern(const std::vector< std::vector<Vert_idx> >& rings,
+                              Csr_adjacency& pattern)
+{
+    int nv = int(rings.size());
+    pattern._offsets.resize( nv + 1 );
+    pattern._offsets[0] = 0;
+    for(int i = 0; i < nv; ++i)
+        pattern._offsets[i+1] = pattern._offsets[i] + int(rings[i].size()) + 1;
+
+    pattern._indices.resize( pattern._offsets[nv] );
+    parallel_for(0, nv, [&](int i) {
+        std::vector<int>::iterator it = pattern._indices.begin() + pattern._offsets[i];
+        *it = i;
+        std::copy(rings[i].begin(), rings[i].end(), it + 1);
+        std::sort(it, it + rings[i].size() + 1);
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+/// Approximate minimum degree ordering of a symmetric sparsity pattern
+static void fill_reducing_permutation(const Csr_adjacency& pattern,
+                                      std::vector<int>& perm)
+{
+    int n = pattern.nb_lists();
+    // Symmetric pattern: CSR and CSC are the same
+    Eigen::SparseMatrix<double, Eigen::ColMajor, int> mat(n, n);
+    mat.resizeNonZeros( int(pattern._indices.size()) );
+    std::memcpy(mat.outerIndexPtr(), pattern._offsets.data(), sizeof(int) * (n + 1));
+    std::memcpy(mat.innerIndexPtr(), pattern._indices.data(), sizeof(int) * pattern._indices.size());
+    std::fill(mat.valuePtr(), mat.valuePtr() + pattern._indices.size(), 1.0);
+
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> p;
+    Eigen::AMDOrdering<int> amd;
+    amd(mat, p);
+    // Eigen's orderings return P^-1 (i.e. maps new -> old index)
+    perm.assign(p.indices().data(), p.indices().data() + n);
+}
+
+// =============================================================================
+
+void Mesh_cache::close()
+{
+    _reader.close();
+    _nb_vertices = _nb_triangles = 0;
+    _vertices = nullptr;
+    _triangles = nullptr;
+    _vert_to_face = _rings = _laplacian_pattern = Csr_view();
+    _ring_flags = nullptr;
+    _permutation = nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Mesh_cache::open(const char* mesh_path, bool check_content)
+{
+    close();
+    uint64_t size;
+    if( !source_size(mesh_path, size) )
+        return false;
+
+    if( !_reader.open(mesh_cache_path(mesh_path), g_magic, g_version) )
+        return false;
+
+    const Binary_container::Header& header = _reader.header();
+    uint64_t nv = 0, nt = 0;
+    _vertices  = _reader.section<Vec3>(eSECTION_VERTICES, nv);
+    _triangles = _reader.section<Tri_face>(eSECTION_TRIANGLES, nt);
+    // Indices are checked once here so that readers of the sections never
+    // go out of bounds on a corrupted file
+    if( header._stamp[0] != size ||
+        _vertices == nullptr || _triangles == nullptr ||
+        nv > uint64_t(INT32_MAX) || nt > uint64_t(INT32_MAX) / 3 ||
+        !Binary_container::in_range(&_triangles[0].a, nt * 3, int(nv)) )
+    {
+        close();
+        return false;
+    }
+    // Same size: the content tells a rewritten source apart
+    Hash128 hash;
+    if( check_content &&
+        (!source_hash(mesh_path, hash) ||
+         header._stamp[1] != hash._h[0] || header._stamp[2] != hash._h[1]) )
+    {
+        close();
+        return false;
+    }
+    _nb_vertices = int(nv);
+    _nb_triangles = int(nt);
+
+    _vert_to_face = csr_section(_reader, eSECTION_V2F_OFFSETS, eSECTION_V2F_TRIS,
+                                _nb_vertices, _nb_triangles);
+    _rings = csr_section(_reader, eSECTION_RING_OFFSETS, eSECTION_RING_VERTS,
+                         _nb_vertices, _nb_vertices);
+    uint64_t nb_flags = 0;
+    _ring_flags = _reader.section<uint8_t>(eSECTION_RING_FLAGS, nb_flags);
+    if( nb_flags != nv || _rings.empty() ) {
+        _ring_flags = nullptr;
+        _rings = Csr_view();
+    }
+    _laplacian_pattern = csr_section(_reader, eSECTION_LAPLACIAN_OFFSETS, eSECTION_LAPLACIAN_COLS,
+                                     _nb_vertices, _nb_vertices);
+    uint64_t nb_perm = 0;
+    _permutation = _reader.section<int>(eSECTION_PERMUTATION, nb_perm);
+    if( nb_perm != nv || (_permutation != nullptr && !Binary_container::is_permutation(_permutation, _nb_vertices)) )
+        _permutation = nullptr;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void Mesh_cache::fill(Mesh& mesh) const
+{
+    mesh._vertices.resize( _nb_vertices );
+    mesh._triangles.resize( _nb_triangles );
+    if( _nb_vertices > 0 )
+        std::memcpy(mesh._vertices.data(), _vertices, sizeof(Vec3) * _nb_vertices);
+    if( _nb_triangles > 0 )
+        std::memcpy(mesh._triangles.data(), _triangles, sizeof(Tri_face) * _nb_triangles);
+}
+
+// -----------------------------------------------------------------------------
+
+bool Mesh_cache::fill(Vertex_to_face& vert_to_face) const
+{
+    if( _vert_to_face.empty() )
+        return false;
+
+    vert_to_face.clear();
+    vert_to_face._1st_ring_tris.resize( _nb_vertices );
+    vert_to_face._is_vertex_connected.resize( _nb_vertices );
+    for(int i = 0; i < _nb_vertices; ++i) {
+        vert_to_face._1st_ring_tris[i].assign(_vert_to_face.begin(i), _vert_to_face.end(i));
+        vert_to_face._is_vertex_connected[i] = _vert_to_face.size(i) > 0;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Mesh_cache::fill(std::vector< std::vector<Vert_idx> >& rings) const
+{
+    if( _rings.empty() )
+        return false;
+
+    rings.resize( _nb_vertices );
+    parallel_for(0, _nb_vertices, [&](int i) {
+        rings[i].assign(_rings.begin(i), _rings.end(i));
+    });
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Mesh_cache::fill(Vertex_to_1st_ring_vertices& first_ring) const
+{
+    if( _rings.empty() )
+        return false;
+
+    first_ring.clear();
+    first_ring._rings_per_vertex.resize( _nb_vertices );
+    first_ring._is_vert_on_side.resize( _nb_vertices );
+    for(int i = 0; i < _nb_vertices; ++i)
+    {
+        first_ring._rings_per_vertex[i].assign(_rings.begin(i), _rings.end(i));
+        bool on_side = (_ring_flags[i] & eON_SIDE) != 0;
+        first_ring._is_vert_on_side[i] = on_side;
+        if( on_side )
+            first_ring._on_side_verts.push_back( i );
+        if( _ring_flags[i] & eNOT_MANIFOLD )
+            first_ring._not_manifold_verts.push_back( i );
+    }
+    first_ring._is_mesh_closed = first_ring._on_side_verts.empty();
+    first_ring._is_mesh_manifold = first_ring._not_manifold_verts.empty();
+    return true;
+}
+
+// =============================================================================
+
+std::string mesh_cache_path(const char* mesh_path)
+{
+    namespace fs = std::filesystem;
+    std::error_code err;
+    fs::path path = fs::absolute(mesh_path, err);
+    if( !err )
+        path = fs::weakly_canonical(path, err);
+    if( err )
+        path = mesh_path;
+    Hasher hasher;
+    hasher.add( path.string() );
+    std::string name = path.filename().string() + "." + hasher.digest().hex().substr(0, 16) + ".hwmc";
+    return (fs::path(mesh_cache_directory()) / name).string();
+}
+
+// -----------------------------------------------------------------------------
+
+void set_mesh_cache_directory(const std::string& dir) { g_cache_directory = dir; }
+
+std::string mesh_cache_directory()
+{
+    return g_cache_directory.empty() ? default_cache_directory().string() : g_cache_directory;
+}
+
+// -----------------------------------------------------------------------------
+
+bool write_mesh_cache(const char* mesh_path,
+                      const Mesh& mesh,
+                      unsigned content,
+                      const Vertex_to_face* vert_to_face,
+                      const Vertex_to_1st_ring_vertices* first_ring)
+{
+    uint64_t size;
+    Hash128 hash;
+    if( !source_size(mesh_path, size) || !source_hash(mesh_path, hash) )
+        return false;
+
+    Binary_container::Writer writer(g_magic, g_version);
+    writer.set_stamp(0, size);
+    writer.set_stamp(1, hash._h[0]);
+    writer.set_stamp(2, hash._h[1]);
+    writer.add_section(eSECTION_VERTICES, mesh._vertices);
+    writer.add_section(eSECTION_TRIANGLES, mesh._triangles);
+
+    // Compute what's missing
+    Vertex_to_face tmp_v2f;
+    Vertex_to_1st_ring_vertices tmp_ring;
+    bool need_rings = (content & (Mesh_cache::eTOPOLOGY |
+                                  Mesh_cache::eLAPLACIAN_PATTERN |
+                                  Mesh_cache::ePERMUTATION)) != 0;
+    if( need_rings && vert_to_face == nullptr ) {
+        tmp_v2f.compute( mesh );
+        vert_to_face = &tmp_v2f;
+    }
+    if( need_rings && first_ring == nullptr ) {
+        tmp_ring.compute( mesh, *vert_to_face );
+        first_ring = &tmp_ring;
+    }
+
+    Csr_adjacency v2f, rings, pattern;
+    std::vector<uint8_t> flags;
+    std::vector<int> perm;
+    if( content & Mesh_cache::eTOPOLOGY )
+    {
+        v2f.compute( vert_to_face->_1st_ring_tris );
+        rings.compute( first_ring->_rings_per_vertex );
+        flags.assign( mesh.nb_vertices(), 0 );
+        for(Vert_idx v : first_ring->_on_side_verts)
+            flags[v] |= Mesh_cache::eON_SIDE;
+        for(Vert_idx v : first_ring->_not_manifold_verts)
+            flags[v] |= Mesh_cache::eNOT_MANIFOLD;
+
+        writer.add_section(eSECTION_V2F_OFFSETS, v2f._offsets);
+        writer.add_section(eSECTION_V2F_TRIS, v2f._indices);
+        writer.add_section(eSECTION_RING_OFFSETS, rings._offsets);
+        writer.add_section(eSECTION_RING_VERTS, rings._indices);
+        writer.add_section(eSECTION_RING_FLAGS, flags);
+    }
+
+    if( content & (Mesh_cache::eLAPLACIAN_PATTERN | Mesh_cache::ePERMUTATION) )
+        laplacian_pattern(first_ring->_rings_per_vertex, pattern);
+
+    if( content & Mesh_cache::eLAPLACIAN_PATTERN ) {
+        writer.add_section(eSECTION_LAPLACIAN_OFFSETS, pattern._offsets);
+        writer.add_section(eSECTION_LAPLACIAN_COLS, pattern._indices);
+    }
+
+    if( content & Mesh_cache::ePERMUTATION ) {
+        fill_reducing_permutation(pattern, perm);
+        writer.add_section(eSECTION_PERMUTATION, perm);
+    }
+
+    std::error_code err;
+    std::filesystem::create_directories(mesh_cache_directory(), err);
+    return writer.write( mesh_cache_path(mesh_path) );
+}
+
+// -----------------------------------------------------------------------------
+
+bool load_cached_rings(const char* mesh_path,
+                       std::vector< std::vector<Vert_idx> >& rings)
+{
+    if( !is_mesh_cache_enabled() )
+        return false;
+    Trace_scope trace("read_topology_cache");
+    Mesh_cache cache;
+    return cache.open(mesh_path) && cache.fill(rings);
+}
+
+// -----------------------------------------------------------------------------
+
+bool load_cached_topology(const char* mesh_path,
+                          Vertex_to_face& vert_to_face,
+                          Vertex_to_1st_ring_vertices& first_ring)
+{
+    if( !is_mesh_cache_enabled() )
+        return false;
+    Trace_scope trace("read_topology_cache");
+    Mesh_cache cache;
+    return cache.open(mesh_path) &&
+           cache.fill(vert_to_face) &&
+           cache.fill(first_ring);
+}
+
+// -----------------------------------------------------------------------------
+
+void set_mesh_cache_enabled(bool state) { g_cache_enabled = state; }
+
+bool is_mesh_cache_enabled() { return g_cache_enabled; }
@@ -0,0 +1,154 @@
+#ifndef MESH_CACHE_HPP
+#define MESH_CACHE_HPP
+
+#include <cstdint>
+#include <string>
+#include "mesh.hpp"
+#include "io/binary_container.hpp"
+#include "topology/csr_adjacency.hpp"
+
+struct Vertex_to_face;
+struct Vertex_to_1st_ring_vertices;
+
+/**
+ * @brief Binary cache of a mesh file and its precomputed adjacency.
+ *
+ * Caches lie in a directory of their own (see mesh_cache_directory()),
+ * never next to the source which may be read only or shared, and are
+ * named after the source file and a hash of its absolute path. A cache is
+ * stamped with the size and a content hash of the source: it is considered
+ * outdated as soon as the source changes, even without a new modification
+ * time.
+ *
+ * Arrays are stored in aligned sections (see Binary_container) and accessed
+ * in place from the memory mapping: vertices(), triangles() or
+ * vertex_to_face() do not copy anything. fill() copies into the usual
+ * structures when needed. build_mesh() copies vertices and triangles into
+ * the Mesh and computes the normals straight from the mapped
+ * vertex_to_face() lists.
+ */
+struct Mesh_cache {
+
+    /// What can be stored on top of vertices and triangles.
+    /// The solvers compute their own ordering of the reduced system (free
+    /// vertices only), build_mesh() therefore only stores the topology:
+    /// the pattern and the permutation are for external tools.
+    enum Content {
+        eTOPOLOGY          = 1 << 0, ///< vertex to face and ordered rings
+        eLAPLACIAN_PATTERN = 1 << 1, ///< sparsity of the Laplacian matrix
+        ePERMUTATION       = 1 << 2, ///< fill reducing ordering (AMD)
+        eDEFAULT = eTOPOLOGY,
+        eALL = eTOPOLOGY | eLAPLACIAN_PATTERN | ePERMUTATION
+    };
+
+    Mesh_cache()
+        : _nb_vertices(0)
+        , _nb_triangles(0)
+        , _vertices(nullptr)
+        , _triangles(nullptr)
+        , _ring_flags(nullptr)
+        , _permutation(nullptr)
+    { }
+
+    /// Open the cache of 'mesh_path'. Every index stored in the file is
+    /// checked (triangle corners, CSR offsets and indices, permutation),
+    /// corrupted optional sections are ignored.
+    /// @param check_content : false only compares the size of the source
+    /// and skips hashing it, when an outdated cache does no harm (e.g. to
+    /// estimate the number of vertices)
+    /// @return false if it does not exist, is corrupted or outdated
+    bool open(const char* mesh_path, bool check_content = true);
+
+    void close();
+
+    // -------------------------------------------------------------------------
+    /// @name In place accessors (valid until close())
+    // -------------------------------------------------------------------------
+
+    int nb_vertices() const { return _nb_vertices; }
+    int nb_triangles() const { return _nb_triangles; }
+    const Vec3* vertices() const { return _vertices; }
+    const Tri_face* triangles() const { return _triangles; }
+
+    /// Vertex to triangles lists sorted by triangle index (empty view if absent)
+    Csr_view vertex_to_face() const { return _vert_to_face; }
+    /// Ordered first rings (empty view if absent)
+    Csr_view rings() const { return _rings; }
+    /// Per vertex flags (see eON_SIDE, eNOT_MANIFOLD) or nullptr
+    const uint8_t* ring_flags() const { return _ring_flags; }
+    /// Sorted column indices of the non zeros of each row of the Laplacian
+    /// (diagonal included)
+    Csr_view laplacian_pattern() const { return _laplacian_pattern; }
+    /// Fill reducing permutation of the Laplacian or nullptr
+    /// (perm[new_index] = old_index)
+    const int* permutation() const { return _permutation; }
+
+    // -------------------------------------------------------------------------
+    /// @name Copy to the usual structures
+    // -------------------------------------------------------------------------
+
+    /// Copy vertices and triangles (the Mesh owns its arrays)
+    void fill(Mesh& mesh) const;
+    /// @return false if the cache holds no topology
+    bool fill(Vertex_to_face& vert_to_face) const;
+    bool fill(Vertex_to_1st_ring_vertices& first_ring) const;
+    /// Only the rings (Vertex_to_1st_ring_vertices::_rings_per_vertex)
+    bool fill(std::vector< std::vector<Vert_idx> >& rings) const;
+
+    /// Per vertex flags of ring_flags()
+    enum Ring_flags { eON_SIDE = 1, eNOT_MANIFOLD = 2 };
+
+private:
+    Binary_container::Reader _reader;
+    int _nb_vertices;
+    int _nb_triangles;
+    const Vec3* _vertices;
+    const Tri_face* _triangles;
+    Csr_view _vert_to_face;
+    Csr_view _rings;
+    const uint8_t* _ring_flags;
+    Csr_view _laplacian_pattern;
+    const int* _permutation;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Path of the cache file associated to 'mesh_path':
+/// <mesh_cache_directory()>/<file name>.<hash of the absolute path>.hwmc
+std::string mesh_cache_path(const char* mesh_path);
+
+/// Directory of the caches, created by write_mesh_cache() when needed.
+/// An empty 'dir' restores the default: $XDG_CACHE_HOME/harmonic_weights,
+/// ~/.cache/harmonic_weights (%LOCALAPPDATA%\harmonic_weights on Windows)
+/// or harmonic_weights in the temporary directory
+void set_mesh_cache_directory(const std::string& dir);
+std::string mesh_cache_directory();
+
+/// Write the cache of 'mesh_path'.
+/// Topology is computed when not provided and requested in 'content'
+/// @param content : bit field of Mesh_cache::Content
+/// @return false on error (e.g. read only directory)
+bool write_mesh_cache(const char* mesh_path,
+                      const Mesh& mesh,
+                      unsigned content = Mesh_cache::eDEFAULT,
+                      const Vertex_to_face* vert_to_face = nullptr,
+                      const Vertex_to_1st_ring_vertices* first_ring = nullptr);
+
+/// Open the cache of 'mesh_path' and copy its ordered rings, what the
+/// Laplacian needs (the vertex to face lists are not copied)
+/// @return false if there is no valid cache or it holds no topology
+bool load_cached_rings(const char* mesh_path,
+                       std::vector< std::vector<Vert_idx> >& rings);
+
+/// Open the cache of 'mesh_path' and copy its topology
+/// @return false if there is no valid cache or it holds no topology
+bool load_cached_topology(const char* mesh_path,
+                          Vertex_to_face& vert_to_face,
+                          Vertex_to_1st_ring_vertices& first_ring);
+
+/// Globally enable / disable the use of caches by build_mesh()
+/// (enabled by default)
+void set_mesh_cache_enabled(bool state);
+bool is_mesh_cache_enabled();
+
+#endif // MESH_CACHE_HPP
@@ -0,0 +1,94 @@
+#include "io/mesh_loader.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <cctype>
+
+#include "io/text_parsing.hpp"
+#include "io/off_loader.hpp"
+#include "io/ply_loader.hpp"
+#include "io/obj_loader.hpp"
+
+// -----------------------------------------------------------------------------
+
+Mesh_format mesh_format_from_extension(const char* file_name)
+{
+    std::string name(file_name);
+    size_t dot = name.find_last_of('.');
+    if( dot == std::string::npos )
+        return eUNKNOWN_FORMAT;
+
+    std::string ext = name.substr(dot + 1);
+    for(char& c : ext)
+        c = char( std::tolower((unsigned char)c) );
+    if( ext == "off" ) return eOFF;
+    if( ext == "ply" ) return ePLY;
+    if( ext == "obj" ) return eOBJ;
+    return eUNKNOWN_FORMAT;
+}
+
+// -----------------------------------------------------------------------------
+
+Mesh_format detect_mesh_format(const char* file_name)
+{
+    char buff[4096];
+    std::ifstream file(file_name, std::ios::binary);
+    file.read(buff, sizeof(buff));
+    const char* p = buff;
+    const char* end = buff + file.gcount();
+
+    // First word of the file that is not a comment
+    while( p < end && Text::is_end_of_line(p, end) )
+        p = Text::next_line(p, end);
+    const char* word = nullptr;
+    size_t len = 0;
+    std::string first;
+    if( Text::parse_word(p, end, word, len) )
+        first.assign(word, len);
+
+    // Magic numbers
+    if( first == "ply" )
+        return ePLY;
+    if( first.size() >= 3 && first.compare(first.size() - 3, 3, "OFF") == 0 )
+        return eOFF;
+
+    Mesh_format format = mesh_format_from_extension(file_name);
+    if( format != eUNKNOWN_FORMAT )
+        return format;
+
+    // OBJ has no header, look for its usual statements
+    if( first == "v" || first == "vt" || first == "vn" || first == "f" ||
+        first == "o" || first == "g" || first == "s" ||
+        first == "mtllib" || first == "usemtl" )
+    {
+        return eOBJ;
+    }
+
+    // OFF files may omit the header keyword and start with the counts
+    int val;
+    const char* q = word;
+    if( !first.empty() && Text::parse(q, end, val) )
+        return eOFF;
+
+    return eUNKNOWN_FORMAT;
+}
+
+// -----------------------------------------------------------------------------
+
+bool load_mesh(const char* file_name, Mesh& mesh)
+{
+    switch( detect_mesh_format(file_name) ) {
+    case eOFF: return load_off(file_name, mesh);
+    case ePLY: return load_ply(file_name, mesh);
+    case eOBJ: return load_obj(file_name, mesh);
+    default: break;
+    }
+
+    std::ifstream file(file_name);
+    if( !file.is_open() )
+        std::cerr << "Can't open file: " << file_name << std::endl;
+    else
+        std::cerr << "Unknown mesh file format: " << file_name << std::endl;
+    return false;
+}
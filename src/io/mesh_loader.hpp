@@ -0,0 +1,26 @@
+#ifndef MESH_LOADER_HPP
+#define MESH_LOADER_HPP
+
+#include "mesh.hpp"
+
+/// Mesh file formats we can read
+enum Mesh_format {
+    eOFF,           ///< ASCII OFF (see Off_reader)
+    ePLY,           ///< binary or ASCII PLY (see load_ply())
+    eOBJ,           ///< Wavefront OBJ (see load_obj())
+    eUNKNOWN_FORMAT
+};
+
+/// Format of a mesh file from its extension only (case insensitive)
+Mesh_format mesh_format_from_extension(const char* file_name);
+
+/// Guess the format of a mesh file from its first bytes ("ply", "OFF"
+/// keyword...) or its extension when the content is not conclusive.
+Mesh_format detect_mesh_format(const char* file_name);
+
+/// Load an OFF, PLY or OBJ file into 'mesh' (only vertices and triangles are
+/// set), polygons are triangulated.
+/// @return false on error (message printed on std::cerr)
+bool load_mesh(const char* file_name, Mesh& mesh);
+
+#endif // MESH_LOADER_HPP
@@ -0,0 +1,221 @@
+#include "io/obj_loader.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+
+#include "io/mapped_file.hpp"
+#include "io/text_parsing.hpp"
+#include "io/polygon_triangulation.hpp"
+#include "utils/parallel_for.hpp"
+
+// -----------------------------------------------------------------------------
+
+/// Chunks smaller than this are not worth a thread
+static const size_t g_min_chunk_size = 1 << 18;
+
+/// A range of lines of the file
+struct Obj_chunk {
+    const char* _begin;
+    const char* _end;
+    int _first_vertex;   ///< index of the first vertex of the chunk
+    int _nb_vertices;    ///< "v" statements in [_begin _end)
+    int _first_triangle; ///< index of the first triangle of the chunk
+    int _nb_triangles;   ///< triangles produced by the faces of the chunk
+    int _nb_skipped;     ///< faces with less than 3 vertices
+};
+
+enum Obj_statement { eVERTEX, eFACE, eOTHER };
+
+// -----------------------------------------------------------------------------
+
+/// Read the keyword of the line starting at 'p'
+/// @return the kind of statement, 'p' points after the keyword
+/// for vertices and faces
+static Obj_statement parse_statement(const char*& p, const char* end)
+{
+    const char* s = Text::skip_blanks(p, end);
+    if( s + 1 < end && Text::is_blank(s[1]) ) {
+        if( s[0] == 'v' ) { p = s + 2; return eVERTEX; }
+        if( s[0] == 'f' ) { p = s + 2; return eFACE;   }
+    }
+    return eOTHER;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Number of corners of the face whose statement ends at 'p'
+static int nb_corners(const char* p, const char* end)
+{
+    const char* word = nullptr;
+    size_t len = 0;
+    int nb = 0;
+    while( !Text::is_end_of_line(p, end) && Text::parse_word(p, end, word, len) )
+        ++nb;
+    return nb;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Parse the vertex index of a face corner: "v", "v/vt", "v//vn" or "v/vt/vn"
+/// @param nb_prev : number of vertices defined before the face
+/// (negative indices are relative to it)
+static bool parse_corner(const char*& p, const char* end, int nb_prev, Vert_idx& v)
+{
+    int idx;
+    if( !Text::parse(p, end, idx) || idx == 0 )
+        return false;
+    v = idx > 0 ? idx - 1 : nb_prev + idx;
+    // Skip texture and normal indices
+    while( p < end && !Text::is_blank(*p) && *p != '\n' )
+        ++p;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+static void count_statements(Obj_chunk& chunk)
+{
+    chunk._nb_vertices = chunk._nb_triangles = chunk._nb_skipped = 0;
+    const char* end = chunk._end;
+    for(const char* p = chunk._begin; p < end; p = Text::next_line(p, end))
+    {
+        switch( parse_statement(p, end) ) {
+        case eVERTEX: ++chunk._nb_vertices; break;
+        case eFACE: {
+            int nb = nb_corners(p, end);
+            if( nb < 3 )
+                ++chunk._nb_skipped;
+            else
+                chunk._nb_triangles += nb - 2;
+        } break;
+        default: break;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+static bool parse_vertices(const Obj_chunk& chunk, Mesh& mesh, std::string& error)
+{
+    const char* end = chunk._end;
+    int vert = chunk._first_vertex;
+    const int last = chunk._first_vertex + chunk._nb_vertices;
+    for(const char* p = chunk._begin; p < end && vert < last; p = Text::next_line(p, end))
+    {
+        if( parse_statement(p, end) != eVERTEX )
+            continue;
+
+        Vec3& v = mesh._vertices[vert];
+        if( !Text::parse(p, end, v.x) ||
+            !Text::parse(p, end, v.y) ||
+            !Text::parse(p, end, v.z) )
+        {
+            error = "can't read vertex " + std::to_string(vert + 1);
+            return false;
+        }
+        ++vert;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+static bool parse_faces(const Obj_chunk& chunk, Mesh& mesh, std::string& error)
+{
+    if( chunk._nb_triangles == 0 )
+        return true;
+
+    const int nv = int(mesh._vertices.size());
+    const char* end = chunk._end;
+    std::vector<Vert_idx> poly;
+    Tri_face* tris = mesh._triangles.data() + chunk._first_triangle;
+    int nb_prev = chunk._first_vertex;
+    for(const char* p = chunk._begin; p < end; p = Text::next_line(p, end))
+    {
+        Obj_statement type = parse_statement(p, end);
+        if( type == eVERTEX ) {
+            ++nb_prev;
+            continue;
+        }
+        if( type != eFACE )
+            continue;
+
+        poly.clear();
+        Vert_idx v;
+        while( !Text::is_end_of_line(p, end) )
+        {
+            const char* corner = Text::skip_blanks(p, end);
+            if( !parse_corner(p, end, nb_prev, v) || v < 0 || v >= nv ) {
+                const char* e = corner;
+                while( e < end && !Text::is_blank(*e) && *e != '\n' ) ++e;
+                error = "invalid face corner '" + std::string(corner, e) + "'";
+                return false;
+            }
+            poly.push_back( v );
+        }
+        tris += triangulate_polygon(poly.data(), int(poly.size()), mesh._vertices.data(), tris);
+    }
+    return true;
+}
+
+// =============================================================================
+
+bool load_obj(const char* file_name, Mesh& mesh)
+{
+    Mapped_file file;
+    if( !file.open(file_name) ) {
+        std::cerr << "Can't open file: " << file_name << std::endl;
+        return false;
+    }
+
+    int nb_chunks = int(std::min<size_t>(get_nb_threads() * 4,
+                                         file.size() / g_min_chunk_size + 1));
+    std::vector<const char*> bounds;
+    Text::split_lines(file.data(), file.end(), nb_chunks, bounds);
+
+    std::vector<Obj_chunk> chunks( nb_chunks );
+    parallel_for_chunks(nb_chunks, [&](int c) {
+        chunks[c]._begin = bounds[c];
+        chunks[c]._end = bounds[c+1];
+        count_statements( chunks[c] );
+    });
+
+    int nb_vertices = 0, nb_triangles = 0, nb_skipped = 0;
+    for(Obj_chunk& chunk : chunks) {
+        chunk._first_vertex = nb_vertices;
+        chunk._first_triangle = nb_triangles;
+        nb_vertices += chunk._nb_vertices;
+        nb_triangles += chunk._nb_triangles;
+        nb_skipped += chunk._nb_skipped;
+    }
+
+    if( nb_skipped > 0 ) {
+        std::cerr << "Warning: " << nb_skipped << " faces with less than 3 vertices ignored: ";
+        std::cerr << file_name << std::endl;
+    }
+
+    mesh._vertices.resize( nb_vertices );
+    mesh._triangles.resize( nb_triangles );
+
+    std::vector<std::string> errors( nb_chunks );
+    std::atomic<bool> ok(true);
+    parallel_for_chunks(nb_chunks, [&](int c) {
+        if( !parse_vertices(chunks[c], mesh, errors[c]) )
+            ok = false;
+    });
+
+    // Faces need every vertex position to triangulate concave polygons
+    if( ok ) {
+        parallel_for_chunks(nb_chunks, [&](int c) {
+            if( !parse_faces(chunks[c], mesh, errors[c]) )
+                ok = false;
+        });
+    }
+
+    for(const std::string& err : errors)
+        if( !err.empty() )
+            std::cerr << err << ": " << file_name << std::endl;
+    return ok;
+}
@@ -0,0 +1,25 @@
+#ifndef OBJ_LOADER_HPP
+#define OBJ_LOADER_HPP
+
+#include "mesh.hpp"
+
+/**
+ * @brief Load a Wavefront OBJ file into 'mesh' (only vertices and triangles
+ * are set)
+ *
+ * Like Off_reader the file is memory mapped and split in chunks at line
+ * boundaries. A first parallel pass counts the vertices and triangles of
+ * each chunk; vertices then faces are parsed in parallel straight into the
+ * preallocated arrays of the mesh.
+ *
+ * Only "v" and "f" statements are read ("vt", "vn", groups, materials...
+ * are ignored). Face corners may be given as "v", "v/vt", "v//vn" or
+ * "v/vt/vn", negative (relative) indices are supported. Polygons are
+ * triangulated with triangulate_polygon(), faces with less than 3 vertices
+ * are skipped with a warning.
+ *
+ * @return false on error (message printed on std::cerr)
+ */
+bool load_obj(const char* file_name, Mesh& mesh);
+
+#endif // OBJ_LOADER_HPP
@@ -0,0 +1,362 @@
+#include "io/off_loader.hpp"
+
+#include <iostream>
+#include <atomic>
+#include <climits>
+#include <cstdint>
+
+#include "io/text_parsing.hpp"
+#include "io/polygon_triangulation.hpp"
+#include "utils/parallel_for.hpp"
+
+// -----------------------------------------------------------------------------
+
+/// Chunks smaller than this are not worth a thread
+static const size_t g_min_chunk_size = 1 << 18;
+
+/// Faces with more vertices are considered corrupted
+static const int g_max_face_size = 1 << 16;
+
+// -----------------------------------------------------------------------------
+
+/// @return true if the line starting at 'p' holds data
+static bool is_record(const char* p, const char* end)
+{
+    return !Text::is_end_of_line(p, end);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Parse an integer which must be followed by a blank, the end of the line
+/// or a comment (e.g. "4OFF" or "12x" are not numbers)
+/// @return false if no such number could be read, 'p' is left untouched then.
+static bool parse_number(const char*& p, const char* end, int& val)
+{
+    const char* q = p;
+    if( !Text::parse(q, end, val) )
+        return false;
+    if( q < end && !Text::is_blank(*q) && *q != '\n' && *q != '#' )
+        return false;
+    p = q;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Skip blank lines and comments
+/// @return pointer to the first record line from 'p'
+static const char* next_record(const char* p, const char* end)
+{
+    while( p < end && !is_record(p, end) )
+        p = Text::next_line(p, end);
+    return p;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Off_reader::open(const char* file_name)
+{
+    close();
+    _file_name = file_name;
+    if( !_file.open(file_name) ){
+        std::cerr << "Can't open file: " << file_name << std::endl;
+        return false;
+    }
+    return parse_header() && locate_records() && count_triangles();
+}
+
+// -----------------------------------------------------------------------------
+
+void Off_reader::close()
+{
+    _file.close();
+    _chunks.clear();
+    _nb_vertices = 0;
+    _nb_faces = 0;
+    _nb_triangles = 0;
+    _nb_skipped_faces = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Off_reader::parse_header()
+{
+    const char* end = _file.end();
+    const char* p = next_record(_file.data(), end);
+
+    // Header keyword, e.g. "OFF", "COFF", "NOFF", "STOFF", "4OFF"
+    // The keyword is optional: the file may start with the counts. A word
+    // (up to a blank or the end of the line) is a count only when it is
+    // entirely a number.
+    const char* word = nullptr;
+    size_t len = 0;
+    int tmp;
+    const char* q = p;
+    if( !parse_number(q, end, tmp) && Text::parse_word(p, end, word, len) )
+    {
+        std::string format(word, len);
+        if( len < 3 || format.compare(len - 3, 3, "OFF") != 0 ) {
+            std::cerr << "Not an OFF file: " << _file_name << std::endl;
+            return false;
+        }
+        if( format.find('n') != std::string::npos ) {
+            std::cerr << "nOFF (n dimensional) files are not supported: " << _file_name << std::endl;
+            return false;
+        }
+        q = p;
+        if( Text::parse_word(q, end, word, len) && std::string(word, len) == "BINARY" ) {
+            std::cerr << "Binary OFF files are not supported: " << _file_name << std::endl;
+            return false;
+        }
+        // The counts may follow on the same line
+        if( Text::is_end_of_line(p, end) )
+            p = next_record(Text::next_line(p, end), end);
+    }
+
+    // Counts: nb_vertices nb_faces [nb_edges]
+    if( !parse_number(p, end, _nb_vertices) || !parse_number(p, end, _nb_faces) ||
+        _nb_vertices < 0 || _nb_faces < 0 || _nb_faces > INT_MAX - _nb_vertices )
+    {
+        std::cerr << "Can't read the number of vertices and faces: " << _file_name << std::endl;
+        return false;
+    }
+
+    _body = Text::next_line(p, end);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Off_reader::locate_records()
+{
+    const char* end = _file.end();
+    size_t body_size = size_t(end - _body);
+    int nb_chunks = int(std::min<size_t>(get_nb_threads() * 4,
+                                         body_size / g_min_chunk_size + 1));
+
+    std::vector<const char*> bounds;
+    Text::split_lines(_body, end, nb_chunks, bounds);
+
+    _chunks.resize( nb_chunks );
+    parallel_for_chunks(nb_chunks, [&](int c) {
+        Chunk& chunk = _chunks[c];
+        chunk._begin = bounds[c];
+        chunk._end = bounds[c+1];
+        int nb = 0;
+        for(const char* p = chunk._begin; p < chunk._end; p = Text::next_line(p, chunk._end))
+            if( is_record(p, chunk._end) )
+                ++nb;
+        chunk._nb_records = nb;
+    });
+
+    int acc = 0;
+    for(Chunk& chunk : _chunks) {
+        chunk._first_record = acc;
+        acc += chunk._nb_records;
+    }
+
+    if( acc < _nb_vertices + _nb_faces ) {
+        std::cerr << "Unexpected end of file, " << (_nb_vertices + _nb_faces);
+        std::cerr << " records expected but only " << acc << " found: " << _file_name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Off_reader::count_triangles()
+{
+    const int nv = _nb_vertices;
+    const int last_record = _nb_vertices + _nb_faces;
+    std::vector<int> skipped( _chunks.size(), 0 );
+    std::vector<int> bad_face( _chunks.size(), -1 );
+    std::vector<int64_t> nb_chunk_tris( _chunks.size(), 0 );
+    parallel_for_chunks(int(_chunks.size()), [&](int c) {
+        Chunk& chunk = _chunks[c];
+        const char* end = chunk._end;
+        int record = chunk._first_record;
+        int64_t nb_tris = 0;
+        chunk._nb_triangles = 0;
+        chunk._nb_polygons = 0;
+        if( record + chunk._nb_records <= nv )
+            return; // only vertices
+
+        for(const char* p = chunk._begin; p < end && record < last_record; p = Text::next_line(p, end))
+        {
+            if( !is_record(p, end) )
+                continue;
+
+            if( record >= nv )
+            {
+                int nb_verts_face;
+                if( !parse_number(p, end, nb_verts_face) ||
+                    nb_verts_face < 0 || nb_verts_face > g_max_face_size )
+                {
+                    bad_face[c] = record - nv;
+                    return;
+                }
+                if( nb_verts_face < 3 )
+                    ++skipped[c];
+                else
+                    nb_tris += nb_verts_face - 2;
+                if( nb_verts_face > 3 )
+                    ++chunk._nb_polygons;
+            }
+            ++record;
+        }
+        nb_chunk_tris[c] = nb_tris;
+    });
+
+    for(int face : bad_face) {
+        if( face >= 0 ) {
+            std::cerr << "Can't read face " << face << " (expected a number of vertices in [0 ";
+            std::cerr << g_max_face_size << "]): " << _file_name << std::endl;
+            return false;
+        }
+    }
+
+    // Triangles are indexed with int
+    int64_t nb_triangles = 0;
+    _nb_skipped_faces = 0;
+    for(unsigned c = 0; c < _chunks.size(); ++c) {
+        _chunks[c]._first_triangle = int(nb_triangles);
+        _chunks[c]._nb_triangles = int(nb_chunk_tris[c]);
+        nb_triangles += nb_chunk_tris[c];
+        _nb_skipped_faces += skipped[c];
+        if( nb_triangles > INT_MAX ) {
+            std::cerr << "Too many triangles (more than " << INT_MAX << "): " << _file_name << std::endl;
+            return false;
+        }
+    }
+    _nb_triangles = int(nb_triangles);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Off_reader::parse_vertices(int i, Mesh& mesh, std::string& error) const
+{
+    const Chunk& chunk = _chunks[i];
+    const int nv = _nb_vertices;
+    const char* end = chunk._end;
+
+    int record = chunk._first_record;
+    for(const char* p = chunk._begin; p < end && record < nv; p = Text::next_line(p, end))
+    {
+        if( !is_record(p, end) )
+            continue;
+
+        Vec3& v = mesh._vertices[record];
+        if( !Text::parse(p, end, v.x) ||
+            !Text::parse(p, end, v.y) ||
+            !Text::parse(p, end, v.z) )
+        {
+            error = "can't read vertex " + std::to_string(record);
+            return false;
+        }
+        ++record;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Off_reader::parse_faces(int i, Mesh& mesh, std::string& error) const
+{
+    const Chunk& chunk = _chunks[i];
+    if( chunk._nb_triangles == 0 )
+        return true;
+
+    const int nv = _nb_vertices;
+    const int last_record = _nb_vertices + _nb_faces;
+    const char* end = chunk._end;
+
+    std::vector<Vert_idx> poly;
+    Tri_face* tris = mesh._triangles.data() + chunk._first_triangle;
+    int record = chunk._first_record;
+    for(const char* p = chunk._begin; p < end && record < last_record; p = Text::next_line(p, end))
+    {
+        if( !is_record(p, end) )
+            continue;
+
+        if( record++ < nv )
+            continue;
+
+        int face = record - 1 - nv;
+        int nb_verts_face;
+        parse_number(p, end, nb_verts_face); // already checked by count_triangles()
+        if( nb_verts_face < 3 )
+            continue;
+
+        if( nb_verts_face == 3 )
+        {
+            Tri_face& tri = *tris++;
+            for(int k = 0; k < 3; ++k) {
+                if( !Text::parse(p, end, tri[k]) || tri[k] < 0 || tri[k] >= nv ) {
+                    error = "invalid vertex index in face " + std::to_string(face);
+                    return false;
+                }
+            }
+            continue;
+        }
+
+        poly.resize( nb_verts_face );
+        for(int k = 0; k < nb_verts_face; ++k) {
+            if( !Text::parse(p, end, poly[k]) || poly[k] < 0 || poly[k] >= nv ) {
+                error = "invalid vertex index in face " + std::to_string(face);
+                return false;
+            }
+        }
+        tris += triangulate_polygon(poly.data(), nb_verts_face, mesh._vertices.data(), tris);
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void Off_reader::allocate(Mesh& mesh) const
+{
+    mesh._vertices.resize( _nb_vertices );
+    mesh._triangles.resize( _nb_triangles );
+
+    if( _nb_skipped_faces > 0 ) {
+        std::cerr << "Warning: " << _nb_skipped_faces << " faces with less than 3 vertices ignored: ";
+        std::cerr << _file_name << std::endl;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+bool Off_reader::load(Mesh& mesh)
+{
+    allocate( mesh );
+
+    std::vector<std::string> errors( _chunks.size() );
+    std::atomic<bool> ok(true);
+    parallel_for_chunks(int(_chunks.size()), [&](int c) {
+        if( !parse_vertices(c, mesh, errors[c]) )
+            ok = false;
+    });
+
+    // Faces need every vertex position to triangulate concave polygons
+    if( ok ) {
+        parallel_for_chunks(int(_chunks.size()), [&](int c) {
+            if( !parse_faces(c, mesh, errors[c]) )
+                ok = false;
+        });
+    }
+
+    for(const std::string& err : errors)
+        if( !err.empty() )
+            std::cerr << err << ": " << _file_name << std::endl;
+    return ok;
+}
+
+// -----------------------------------------------------------------------------
+
+bool load_off(const char* file_name, Mesh& mesh)
+{
+    Off_reader reader;
+    return reader.open(file_name) && reader.load(mesh);
+}
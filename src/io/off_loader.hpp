@@ -0,0 +1,109 @@
+#ifndef OFF_LOADER_HPP
+#define OFF_LOADER_HPP
+
+#include <string>
+#include <vector>
+#include "mesh.hpp"
+#include "io/mapped_file.hpp"
+
+/**
+ * @brief Fast reader for ASCII OFF files
+ *
+ * The file is memory mapped and its body split in chunks at line
+ * boundaries. A first parallel pass counts the records (non blank, non
+ * comment lines) of each chunk, so that every chunk knows the index of its
+ * first vertex / face. A second cheap pass reads the vertex count of each
+ * face to know how many triangles each chunk produces. Chunks are then parsed
+ * in parallel with std::from_chars() directly into the preallocated arrays of
+ * the mesh: vertices first, then faces.
+ *
+ * Polygons are triangulated on the fly with triangulate_polygon() (quads and
+ * n-gons can be loaded directly). Faces with less than 3 vertices are skipped
+ * with a warning, a negative vertex count or one above 65536 is an error
+ * (corrupted file), as well as more than INT_MAX triangles.
+ *
+ * Supported headers: "OFF", "COFF", "NOFF", "CNOFF", "STOFF", "4OFF"... (extra
+ * vertex attributes are skipped, only x y z are read) as well as files
+ * without header keyword. Comments ('#') and blank lines are ignored.
+ * @warning one record per line is expected (which is what every exporter
+ * writes)
+ */
+struct Off_reader {
+
+    /// A range of lines of the file body
+    struct Chunk {
+        const char* _begin;
+        const char* _end;
+        int _first_record;   ///< index of the first record of the chunk
+        int _nb_records;     ///< number of records in [_begin _end)
+        int _first_triangle; ///< index of the first triangle of the chunk
+        int _nb_triangles;   ///< triangles produced by the faces of the chunk
+        int _nb_polygons;    ///< faces of more than 3 vertices in the chunk
+    };
+
+    Off_reader()
+        : _body(nullptr)
+        , _nb_vertices(0)
+        , _nb_faces(0)
+        , _nb_triangles(0)
+        , _nb_skipped_faces(0)
+    { }
+
+    /// Map the file, parse the header and locate the records
+    /// @return false on error (message printed on std::cerr)
+    bool open(const char* file_name);
+
+    void close();
+
+    /// Load the whole file into 'mesh' (only vertices and triangles are set)
+    /// @pre open() succeeded
+    bool load(Mesh& mesh);
+
+    /// Size the vertices and triangles of 'mesh' before parsing the chunks
+    /// one by one with parse_vertices() and parse_faces()
+    void allocate(Mesh& mesh) const;
+
+    /// Parse the vertex records of the ith chunk into 'mesh._vertices'
+    /// which must be already allocated
+    /// @return false on error and set 'error'
+    bool parse_vertices(int i, Mesh& mesh, std::string& error) const;
+
+    /// Parse and triangulate the face records of the ith chunk into
+    /// 'mesh._triangles' which must be already allocated to nb_triangles()
+    /// @pre every vertex is parsed when the chunk holds polygons
+    /// (needed to triangulate concave polygons, see Chunk::_nb_polygons)
+    /// @return false on error and set 'error'
+    bool parse_faces(int i, Mesh& mesh, std::string& error) const;
+
+    int nb_vertices() const { return _nb_vertices; }
+    int nb_faces() const { return _nb_faces; }
+    /// Number of triangles once polygons are triangulated
+    int nb_triangles() const { return _nb_triangles; }
+    /// Number of faces with less than 3 vertices
+    int nb_skipped_faces() const { return _nb_skipped_faces; }
+    const std::vector<Chunk>& chunks() const { return _chunks; }
+
+private:
+    bool parse_header();
+    bool locate_records();
+    bool count_triangles();
+
+    std::string _file_name;
+    Mapped_file _file;
+    /// first line after the header
+    const char* _body;
+    int _nb_vertices;
+    int _nb_faces;
+    int _nb_triangles;
+    int _nb_skipped_faces;
+    std::vector<Chunk> _chunks;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Load an OFF file into 'mesh' with Off_reader
+/// (only vertices and triangles are set)
+/// @return false on error
+bool load_off(const char* file_name, Mesh& mesh);
+
+#endif // OFF_LOADER_HPP
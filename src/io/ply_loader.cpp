@@ -0,0 +1,703 @@
+#include "io/ply_loader.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "io/mapped_file.hpp"
+#include "io/text_parsing.hpp"
+#include "io/polygon_triangulation.hpp"
+#include "utils/parallel_for.hpp"
+
+// -----------------------------------------------------------------------------
+
+/// Faces of binary files are parsed in parallel by blocks of this size
+static const int g_face_block = 4096;
+
+enum Ply_type {
+    eINT8, eUINT8, eINT16, eUINT16, eINT32, eUINT32, eFLOAT32, eFLOAT64,
+    eINVALID_TYPE
+};
+
+enum Ply_format { eASCII, eBINARY_LE, eBINARY_BE };
+
+struct Ply_property {
+    std::string _name;
+    Ply_type _type;       ///< type of the value or of the list items
+    bool _is_list;
+    Ply_type _count_type; ///< type of the list size
+};
+
+struct Ply_element {
+    std::string _name;
+    int _count;
+    std::vector<Ply_property> _props;
+    /// Size in bytes of a binary record or -1 if it holds lists
+    int _stride;
+
+    /// @return index of the property or -1
+    int find(const char* name) const {
+        for(unsigned i = 0; i < _props.size(); ++i)
+            if( _props[i]._name == name )
+                return int(i);
+        return -1;
+    }
+};
+
+struct Ply_header {
+    Ply_format _format;
+    std::vector<Ply_element> _elements;
+    const char* _body; ///< first byte after "end_header"
+};
+
+// -----------------------------------------------------------------------------
+
+static int type_size(Ply_type type)
+{
+    static const int sizes[] = {1, 1, 2, 2, 4, 4, 4, 8, 0};
+    return sizes[type];
+}
+
+// -----------------------------------------------------------------------------
+
+static Ply_type parse_type(const std::string& name)
+{
+    if( name == "char"   || name == "int8"    ) return eINT8;
+    if( name == "uchar"  || name == "uint8"   ) return eUINT8;
+    if( name == "short"  || name == "int16"   ) return eINT16;
+    if( name == "ushort" || name == "uint16"  ) return eUINT16;
+    if( name == "int"    || name == "int32"   ) return eINT32;
+    if( name == "uint"   || name == "uint32"  ) return eUINT32;
+    if( name == "float"  || name == "float32" ) return eFLOAT32;
+    if( name == "double" || name == "float64" ) return eFLOAT64;
+    return eINVALID_TYPE;
+}
+
+// -----------------------------------------------------------------------------
+
+static bool is_host_little_endian()
+{
+    const uint16_t val = 1;
+    char byte;
+    std::memcpy(&byte, &val, 1);
+    return byte == 1;
+}
+
+// -----------------------------------------------------------------------------
+
+template<typename T>
+static T load(const char* p, bool swap)
+{
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, p, sizeof(T));
+    if( swap )
+        std::reverse(bytes, bytes + sizeof(T));
+    T val;
+    std::memcpy(&val, bytes, sizeof(T));
+    return val;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Read a binary value of any type
+/// @param swap : reverse the byte order
+static double read_value(const char* p, Ply_type type, bool swap)
+{
+    switch( type ) {
+    case eINT8:    return double( load<int8_t>  (p, swap) );
+    case eUINT8:   return double( load<uint8_t> (p, swap) );
+    case eINT16:   return double( load<int16_t> (p, swap) );
+    case eUINT16:  return double( load<uint16_t>(p, swap) );
+    case eINT32:   return double( load<int32_t> (p, swap) );
+    case eUINT32:  return double( load<uint32_t>(p, swap) );
+    case eFLOAT32: return double( load<float>   (p, swap) );
+    case eFLOAT64: return load<double>(p, swap);
+    default: return 0.0;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+static bool parse_header(const Mapped_file& file, Ply_header& header, const char* file_name)
+{
+    const char* end = file.end();
+    const char* p = file.data();
+    const char* word = nullptr;
+    size_t len = 0;
+    if( !Text::parse_word(p, end, word, len) || std::string(word, len) != "ply" ) {
+        std::cerr << "Not a PLY file: " << file_name << std::endl;
+        return false;
+    }
+
+    bool has_format = false;
+    header._body = nullptr;
+    for(p = Text::next_line(p, end); p < end && header._body == nullptr; p = Text::next_line(p, end))
+    {
+        if( !Text::parse_word(p, end, word, len) )
+            continue;
+
+        std::string key(word, len);
+        std::string line(word, size_t(Text::next_line(p, end) - word));
+        if( key == "comment" || key == "obj_info" )
+            continue;
+
+        bool ok = true;
+        if( key == "end_header" )
+        {
+            header._body = Text::next_line(p, end);
+        }
+        else if( key == "format" )
+        {
+            ok = Text::parse_word(p, end, word, len);
+            std::string format(word, ok ? len : 0);
+            if( format == "ascii" )                     header._format = eASCII;
+            else if( format == "binary_little_endian" ) header._format = eBINARY_LE;
+            else if( format == "binary_big_endian" )    header._format = eBINARY_BE;
+            else ok = false;
+            has_format = ok;
+        }
+        else if( key == "element" )
+        {
+            Ply_element elt;
+            ok = Text::parse_word(p, end, word, len) && Text::parse(p, end, elt._count) && elt._count >= 0;
+            if( ok ) {
+                elt._name.assign(word, len);
+                header._elements.push_back( elt );
+            }
+        }
+        else if( key == "property" && !header._elements.empty() )
+        {
+            Ply_property prop;
+            prop._is_list = false;
+            prop._count_type = eINVALID_TYPE;
+            ok = Text::parse_word(p, end, word, len);
+            std::string type(word, ok ? len : 0);
+            if( ok && type == "list" ) {
+                prop._is_list = true;
+                ok = Text::parse_word(p, end, word, len);
+                prop._count_type = ok ? parse_type(std::string(word, len)) : eINVALID_TYPE;
+                ok = ok && prop._count_type != eINVALID_TYPE && prop._count_type != eFLOAT32 &&
+                     prop._count_type != eFLOAT64 && Text::parse_word(p, end, word, len);
+                type.assign(word, ok ? len : 0);
+            }
+            prop._type = parse_type(type);
+            ok = ok && prop._type != eINVALID_TYPE && Text::parse_word(p, end, word, len);
+            if( ok ) {
+                prop._name.assign(word, len);
+                header._elements.back()._props.push_back( prop );
+            }
+        }
+        else
+        {
+            ok = false;
+        }
+
+        if( !ok ) {
+            std::cerr << "Invalid PLY header line '" << line.substr(0, line.find_first_of("\r\n"));
+            std::cerr << "': " << file_name << std::endl;
+            return false;
+        }
+    }
+
+    if( header._body == nullptr || !has_format ) {
+        std::cerr << "Incomplete PLY header: " << file_name << std::endl;
+        return false;
+    }
+
+    for(Ply_element& elt : header._elements) {
+        elt._stride = 0;
+        for(const Ply_property& prop : elt._props) {
+            if( prop._is_list ) {
+                elt._stride = -1;
+                break;
+            }
+            elt._stride += type_size(prop._type);
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Byte offset of a property inside a fixed size record
+static int property_offset(const Ply_element& elt, int prop)
+{
+    int offset = 0;
+    for(int i = 0; i < prop; ++i)
+        offset += type_size(elt._props[i]._type);
+    return offset;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Size in bytes of the binary value of 'prop' starting at 'p'
+/// @return -1 if the value goes past 'end'
+static int64_t property_size(const Ply_property& prop, const char* p, const char* end, bool swap)
+{
+    int64_t size = type_size(prop._type);
+    if( prop._is_list ) {
+        int count_size = type_size(prop._count_type);
+        if( end - p < count_size )
+            return -1;
+        int64_t nb = int64_t( read_value(p, prop._count_type, swap) );
+        if( nb < 0 )
+            return -1;
+        size = count_size + size * nb;
+    }
+    return end - p < size ? -1 : size;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Size of the binary record starting at 'p'
+/// @return -1 if the record goes past 'end'
+static int64_t record_size(const Ply_element& elt, const char* p, const char* end, bool swap)
+{
+    if( elt._stride >= 0 )
+        return end - p < elt._stride ? -1 : elt._stride;
+
+    const char* begin = p;
+    for(const Ply_property& prop : elt._props) {
+        int64_t size = property_size(prop, p, end, swap);
+        if( size < 0 )
+            return -1;
+        p += size;
+    }
+    return p - begin;
+}
+
+// -----------------------------------------------------------------------------
+
+static void read_binary_vertices(const Ply_element& elt,
+                                 const char* data,
+                                 bool swap,
+                                 Mesh& mesh)
+{
+    static_assert(sizeof(Vec3) == 3 * sizeof(float), "Vec3 must be tightly packed");
+    const int n = elt._count;
+    const size_t stride = size_t(elt._stride);
+    int idx[3] = {elt.find("x"), elt.find("y"), elt.find("z")};
+    int offset[3];
+    Ply_type type[3];
+    for(int k = 0; k < 3; ++k) {
+        offset[k] = property_offset(elt, idx[k]);
+        type[k] = elt._props[idx[k]]._type;
+    }
+
+    mesh._vertices.resize( n );
+    bool native_float = !swap &&
+            type[0] == eFLOAT32 && type[1] == eFLOAT32 && type[2] == eFLOAT32 &&
+            offset[1] == offset[0] + 4 && offset[2] == offset[0] + 8;
+
+    if( native_float && stride == sizeof(Vec3) ) {
+        if( n > 0 )
+            std::memcpy(mesh._vertices.data(), data, sizeof(Vec3) * size_t(n));
+        return;
+    }
+
+    parallel_for(0, n, [&](int i) {
+        const char* record = data + stride * size_t(i);
+        Vec3& v = mesh._vertices[i];
+        if( native_float ) {
+            std::memcpy(&v, record + offset[0], sizeof(Vec3));
+        } else {
+            for(int k = 0; k < 3; ++k)
+                v[k] = float( read_value(record + offset[k], type[k], swap) );
+        }
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+/// Blocks of faces of a binary file found by a sequential scan
+struct Ply_faces {
+    const char* _begin;
+    const char* _end;
+    /// First record of each block of g_face_block faces
+    std::vector<const char*> _blocks;
+    /// Index of the first triangle of each block (nb_blocks + 1 entries)
+    std::vector<int> _first_triangle;
+    int _nb_skipped;       ///< faces with less than 3 vertices
+    bool _only_triangles;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @return false if the element goes past 'end'
+static bool scan_binary_faces(const Ply_element& elt,
+                              int list_prop,
+                              const char* p,
+                              const char* end,
+                              bool swap,
+                              Ply_faces& faces)
+{
+    const Ply_property& list = elt._props[list_prop];
+    const int count_size = type_size(list._count_type);
+    // Size of the properties around the list when they are all scalars
+    int64_t fixed = 0;
+    bool simple = true;
+    for(int k = 0; k < int(elt._props.size()); ++k) {
+        if( k == list_prop ) continue;
+        simple = simple && !elt._props[k]._is_list;
+        fixed += type_size(elt._props[k]._type);
+    }
+    const int list_offset = property_offset(elt, list_prop);
+
+    faces._begin = p;
+    faces._nb_skipped = 0;
+    faces._only_triangles = true;
+    int nb_tris = 0;
+    for(int f = 0; f < elt._count; ++f)
+    {
+        if( f % g_face_block == 0 ) {
+            faces._blocks.push_back( p );
+            faces._first_triangle.push_back( nb_tris );
+        }
+
+        int64_t nb_verts;
+        int64_t size;
+        if( simple ) {
+            // Only one variable size property: no need to walk the record
+            if( end - p < list_offset + count_size )
+                return false;
+            nb_verts = int64_t( read_value(p + list_offset, list._count_type, swap) );
+            size = fixed + count_size + nb_verts * type_size(list._type);
+            if( nb_verts < 0 || end - p < size )
+                return false;
+        } else {
+            size = record_size(elt, p, end, swap);
+            if( size < 0 )
+                return false;
+            const char* q = p;
+            for(int k = 0; k < list_prop; ++k)
+                q += property_size(elt._props[k], q, end, swap);
+            nb_verts = int64_t( read_value(q, list._count_type, swap) );
+        }
+
+        if( nb_verts < 3 )
+            ++faces._nb_skipped;
+        else
+            nb_tris += int(nb_verts) - 2;
+        faces._only_triangles = faces._only_triangles && nb_verts == 3;
+        p += size;
+    }
+    faces._first_triangle.push_back( nb_tris );
+    faces._end = p;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+static void read_binary_faces(const Ply_element& elt,
+                              int list_prop,
+                              const Ply_faces& faces,
+                              bool swap,
+                              Mesh& mesh)
+{
+    const Ply_property& list = elt._props[list_prop];
+    const int count_size = type_size(list._count_type);
+    const int index_size = type_size(list._type);
+    const int nb_blocks = int(faces._blocks.size());
+    mesh._triangles.resize( faces._first_triangle[nb_blocks] );
+
+    bool native_int = !swap && (list._type == eINT32 || list._type == eUINT32);
+    if( faces._only_triangles && native_int && elt._props.size() == 1 )
+    {
+        // Fixed size records [count][a][b][c]: strided copy
+        const size_t stride = size_t(count_size + 3 * index_size);
+        const char* data = faces._begin + count_size;
+        parallel_for(0, elt._count, [&](int f) {
+            std::memcpy(&mesh._triangles[f], data + stride * size_t(f), sizeof(Tri_face));
+        });
+        return;
+    }
+
+    const int nv = int(mesh._vertices.size());
+    parallel_for_chunks(nb_blocks, [&](int b) {
+        std::vector<Vert_idx> poly;
+        Tri_face* tris = mesh._triangles.data() + faces._first_triangle[b];
+        const char* p = faces._blocks[b];
+        int last = std::min(elt._count, (b + 1) * g_face_block);
+        for(int f = b * g_face_block; f < last; ++f)
+        {
+            for(int k = 0; k < int(elt._props.size()); ++k)
+            {
+                const Ply_property& prop = elt._props[k];
+                if( !prop._is_list ) {
+                    p += type_size(prop._type);
+                    continue;
+                }
+                int nb = int( read_value(p, prop._count_type, swap) );
+                p += type_size(prop._count_type);
+                if( k == list_prop ) {
+                    poly.resize( nb );
+                    for(int i = 0; i < nb; ++i)
+                        poly[i] = Vert_idx( read_value(p + i * index_size, prop._type, swap) );
+                }
+                p += nb * type_size(prop._type);
+            }
+
+            bool valid = true;
+            for(Vert_idx v : poly)
+                valid = valid && v >= 0 && v < nv;
+            if( valid ) {
+                tris += triangulate_polygon(poly.data(), int(poly.size()), mesh._vertices.data(), tris);
+            } else {
+                // Leave invalid triangles behind, reported by load_ply()
+                for(int i = 2; i < int(poly.size()); ++i)
+                    *tris++ = Tri_face();
+            }
+        }
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+static bool load_binary(const Ply_header& header,
+                        const char* end,
+                        Mesh& mesh,
+                        int& nb_skipped,
+                        const char* file_name)
+{
+    bool swap = (header._format == eBINARY_LE) != is_host_little_endian();
+    const Ply_element* faces_elt = nullptr;
+    int list_prop = -1;
+    Ply_faces faces;
+
+    const char* p = header._body;
+    for(const Ply_element& elt : header._elements)
+    {
+        if( elt._name == "vertex" )
+        {
+            if( elt._stride < 0 ) {
+                std::cerr << "List properties in PLY vertices are not supported: " << file_name << std::endl;
+                return false;
+            }
+            if( (end - p) / std::max(elt._stride, 1) < elt._count ) {
+                std::cerr << "Unexpected end of file in PLY vertices: " << file_name << std::endl;
+                return false;
+            }
+            read_binary_vertices(elt, p, swap, mesh);
+            p += size_t(elt._stride) * size_t(elt._count);
+        }
+        else if( elt._name == "face" )
+        {
+            faces_elt = &elt;
+            list_prop = elt.find("vertex_indices");
+            if( list_prop < 0 )
+                list_prop = elt.find("vertex_index");
+            if( list_prop < 0 || !elt._props[list_prop]._is_list ) {
+                std::cerr << "No vertex_indices list in PLY faces: " << file_name << std::endl;
+                return false;
+            }
+            if( !scan_binary_faces(elt, list_prop, p, end, swap, faces) ) {
+                std::cerr << "Unexpected end of file in PLY faces: " << file_name << std::endl;
+                return false;
+            }
+            p = faces._end;
+        }
+        else
+        {
+            for(int i = 0; i < elt._count; ++i) {
+                int64_t size = record_size(elt, p, end, swap);
+                if( size < 0 ) {
+                    std::cerr << "Unexpected end of file in PLY element '" << elt._name;
+                    std::cerr << "': " << file_name << std::endl;
+                    return false;
+                }
+                p += size;
+            }
+        }
+    }
+
+    // Faces are read last: triangulating polygons needs the vertices
+    if( faces_elt != nullptr ) {
+        read_binary_faces(*faces_elt, list_prop, faces, swap, mesh);
+        nb_skipped = faces._nb_skipped;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+static bool load_ascii(const Ply_header& header,
+                       const char* end,
+                       Mesh& mesh,
+                       int& nb_skipped,
+                       const char* file_name)
+{
+    const Ply_element* faces_elt = nullptr;
+    const char* faces_begin = nullptr;
+
+    const char* p = header._body;
+    const char* word = nullptr;
+    size_t len = 0;
+    for(const Ply_element& elt : header._elements)
+    {
+        const bool is_vertex = elt._name == "vertex";
+        int idx[3] = {elt.find("x"), elt.find("y"), elt.find("z")};
+        if( elt._name == "face" ) {
+            faces_elt = &elt;
+            faces_begin = p;
+        }
+        if( is_vertex )
+            mesh._vertices.resize( elt._count );
+
+        for(int i = 0; i < elt._count; ++i, p = Text::next_line(p, end))
+        {
+            while( p < end && Text::is_end_of_line(p, end) )
+                p = Text::next_line(p, end);
+            if( p >= end ) {
+                std::cerr << "Unexpected end of file in PLY element '" << elt._name;
+                std::cerr << "': " << file_name << std::endl;
+                return false;
+            }
+            if( !is_vertex )
+                continue;
+
+            const char* q = p;
+            for(int k = 0; k < int(elt._props.size()); ++k)
+            {
+                bool ok = true;
+                if( elt._props[k]._is_list ) {
+                    int nb = 0;
+                    ok = Text::parse(q, end, nb);
+                    for(int j = 0; j < nb && ok; ++j)
+                        ok = Text::parse_word(q, end, word, len);
+                } else if( k == idx[0] || k == idx[1] || k == idx[2] ) {
+                    ok = Text::parse(q, end, mesh._vertices[i][k == idx[0] ? 0 : (k == idx[1] ? 1 : 2)]);
+                } else {
+                    ok = Text::parse_word(q, end, word, len);
+                }
+                if( !ok ) {
+                    std::cerr << "Can't read vertex " << i << ": " << file_name << std::endl;
+                    return false;
+                }
+            }
+        }
+    }
+
+    if( faces_elt == nullptr )
+        return true;
+
+    int list_prop = faces_elt->find("vertex_indices");
+    if( list_prop < 0 )
+        list_prop = faces_elt->find("vertex_index");
+    if( list_prop < 0 || !faces_elt->_props[list_prop]._is_list ) {
+        std::cerr << "No vertex_indices list in PLY faces: " << file_name << std::endl;
+        return false;
+    }
+
+    // Triangles are appended: the array grows geometrically
+    mesh._triangles.clear();
+    mesh._triangles.reserve( faces_elt->_count );
+    std::vector<Vert_idx> poly;
+    p = faces_begin;
+    for(int f = 0; f < faces_elt->_count; ++f, p = Text::next_line(p, end))
+    {
+        while( p < end && Text::is_end_of_line(p, end) )
+            p = Text::next_line(p, end);
+
+        const char* q = p;
+        bool ok = true;
+        for(int k = 0; k < int(faces_elt->_props.size()) && ok; ++k)
+        {
+            if( !faces_elt->_props[k]._is_list ) {
+                ok = Text::parse_word(q, end, word, len);
+                continue;
+            }
+            int nb = 0;
+            ok = Text::parse(q, end, nb) && nb >= 0;
+            if( k == list_prop ) {
+                poly.resize( ok ? nb : 0 );
+                for(int j = 0; j < nb && ok; ++j)
+                    ok = Text::parse(q, end, poly[j]);
+            } else {
+                for(int j = 0; j < nb && ok; ++j)
+                    ok = Text::parse_word(q, end, word, len);
+            }
+        }
+        if( !ok ) {
+            std::cerr << "Can't read face " << f << ": " << file_name << std::endl;
+            return false;
+        }
+
+        int nb_verts = int(poly.size());
+        if( nb_verts < 3 ) {
+            ++nb_skipped;
+            continue;
+        }
+        for(Vert_idx v : poly) {
+            if( v < 0 || v >= int(mesh._vertices.size()) ) {
+                std::cerr << "Invalid vertex index in face " << f << ": " << file_name << std::endl;
+                return false;
+            }
+        }
+        size_t first = mesh._triangles.size();
+        mesh._triangles.resize( first + nb_verts - 2 );
+        triangulate_polygon(poly.data(), nb_verts, mesh._vertices.data(), mesh._triangles.data() + first);
+    }
+    return true;
+}
+
+// =============================================================================
+
+bool load_ply(const char* file_name, Mesh& mesh)
+{
+    Mapped_file file;
+    if( !file.open(file_name) ) {
+        std::cerr << "Can't open file: " << file_name << std::endl;
+        return false;
+    }
+
+    Ply_header header;
+    if( !parse_header(file, header, file_name) )
+        return false;
+
+    bool has_vertices = false;
+    for(const Ply_element& elt : header._elements) {
+        if( elt._name != "vertex" )
+            continue;
+        has_vertices = elt.find("x") >= 0 && elt.find("y") >= 0 && elt.find("z") >= 0 &&
+                       !elt._props[elt.find("x")]._is_list &&
+                       !elt._props[elt.find("y")]._is_list &&
+                       !elt._props[elt.find("z")]._is_list;
+    }
+    if( !has_vertices ) {
+        std::cerr << "No x y z vertex properties: " << file_name << std::endl;
+        return false;
+    }
+
+    mesh._vertices.clear();
+    mesh._triangles.clear();
+    int nb_skipped = 0;
+    bool ok = header._format == eASCII ?
+                load_ascii (header, file.end(), mesh, nb_skipped, file_name) :
+                load_binary(header, file.end(), mesh, nb_skipped, file_name);
+    if( !ok )
+        return false;
+
+    if( nb_skipped > 0 ) {
+        std::cerr << "Warning: " << nb_skipped << " faces with less than 3 vertices ignored: ";
+        std::cerr << file_name << std::endl;
+    }
+
+    // Binary indices are copied without checks
+    const int nv = int(mesh._vertices.size());
+    std::atomic<int> nb_invalid(0);
+    parallel_for(0, int(mesh._triangles.size()), [&](int t) {
+        const Tri_face& tri = mesh._triangles[t];
+        for(int k = 0; k < 3; ++k)
+            if( tri[k] < 0 || tri[k] >= nv )
+                nb_invalid.fetch_add(1, std::memory_order_relaxed);
+    });
+    if( nb_invalid > 0 ) {
+        std::cerr << nb_invalid << " invalid vertex indices in faces: " << file_name << std::endl;
+        return false;
+    }
+    return true;
+}
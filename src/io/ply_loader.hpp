@@ -0,0 +1,25 @@
+#ifndef PLY_LOADER_HPP
+#define PLY_LOADER_HPP
+
+#include "mesh.hpp"
+
+/**
+ * @brief Load a PLY file into 'mesh' (only vertices and triangles are set)
+ *
+ * Binary little endian, big endian and ASCII files are supported. Only the x
+ * y z properties of the "vertex" element and the "vertex_indices" (or
+ * "vertex_index") list of the "face" element are read; any other element or
+ * property is skipped.
+ *
+ * Binary files are memory mapped. When vertices are stored as native
+ * float x y z their block is copied as is into 'mesh._vertices'; faces made
+ * only of triangles with native int indices are copied with a strided copy.
+ * Other layouts are converted in parallel. Polygons are triangulated with
+ * triangulate_polygon(), faces with less than 3 vertices are skipped with a
+ * warning.
+ *
+ * @return false on error (message printed on std::cerr)
+ */
+bool load_ply(const char* file_name, Mesh& mesh);
+
+#endif // PLY_LOADER_HPP
@@ -0,0 +1,158 @@
+#include "io/polygon_triangulation.hpp"
+
+#include <cmath>
+
+// -----------------------------------------------------------------------------
+
+static Tri_face make_tri(Vert_idx a, Vert_idx b, Vert_idx c)
+{
+    Tri_face tri;
+    tri.a = a; tri.b = b; tri.c = c;
+    return tri;
+}
+
+// -----------------------------------------------------------------------------
+
+static int fan(const Vert_idx* poly, int nb_verts, Tri_face* tris)
+{
+    for(int i = 1; i < nb_verts - 1; ++i)
+        tris[i-1] = make_tri(poly[0], poly[i], poly[i+1]);
+    return nb_verts - 2;
+}
+
+// -----------------------------------------------------------------------------
+
+/// 2D cross product of (b - a) and (c - a)
+static float cross_2d(const float* a, const float* b, const float* c)
+{
+    return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Is 'p' inside the counter clockwise triangle (a, b, c) (boundary included)
+static bool inside_2d(const float* p, const float* a, const float* b, const float* c)
+{
+    return cross_2d(a, b, p) >= 0.f && cross_2d(b, c, p) >= 0.f && cross_2d(c, a, p) >= 0.f;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Ear clipping of a simple polygon projected along its normal
+static int ear_clipping(const Vert_idx* poly,
+                        int nb_verts,
+                        const Vec3* vertices,
+                        const Vec3& normal,
+                        Tri_face* tris)
+{
+    // Project on the plane orthogonal to the dominant axis of the normal
+    int axis = 2;
+    Vec3 n(std::abs(normal.x), std::abs(normal.y), std::abs(normal.z));
+    if( n.x > n.y && n.x > n.z ) axis = 0;
+    else if( n.y > n.z ) axis = 1;
+    int u = (axis + 1) % 3;
+    int v = (axis + 2) % 3;
+    // Keep the polygon counter clockwise in 2D
+    float flip = normal[axis] < 0.f ? -1.f : 1.f;
+
+    float pts[g_max_polygon_size][2];
+    int remaining[g_max_polygon_size];
+    for(int i = 0; i < nb_verts; ++i) {
+        const Vec3& p = vertices[ poly[i] ];
+        pts[i][0] = p[u];
+        pts[i][1] = p[v] * flip;
+        remaining[i] = i;
+    }
+
+    int nb_tris = 0;
+    int nb = nb_verts;
+    while( nb > 3 )
+    {
+        int ear = -1;
+        for(int i = 0; i < nb && ear < 0; ++i)
+        {
+            int i0 = remaining[(i + nb - 1) % nb];
+            int i1 = remaining[i];
+            int i2 = remaining[(i + 1) % nb];
+            if( cross_2d(pts[i0], pts[i1], pts[i2]) <= 0.f )
+                continue; // reflex vertex
+
+            bool is_ear = true;
+            for(int j = 0; j < nb && is_ear; ++j) {
+                int k = remaining[j];
+                if( k == i0 || k == i1 || k == i2 )
+                    continue;
+                is_ear = !inside_2d(pts[k], pts[i0], pts[i1], pts[i2]);
+            }
+            if( is_ear )
+                ear = i;
+        }
+
+        // Degenerate or self intersecting polygon: clip anyway
+        if( ear < 0 )
+            ear = 0;
+
+        int i0 = remaining[(ear + nb - 1) % nb];
+        int i1 = remaining[ear];
+        int i2 = remaining[(ear + 1) % nb];
+        tris[nb_tris++] = make_tri(poly[i0], poly[i1], poly[i2]);
+        for(int i = ear; i < nb - 1; ++i)
+            remaining[i] = remaining[i + 1];
+        --nb;
+    }
+    tris[nb_tris++] = make_tri(poly[remaining[0]], poly[remaining[1]], poly[remaining[2]]);
+    return nb_tris;
+}
+
+// -----------------------------------------------------------------------------
+
+int triangulate_polygon(const Vert_idx* poly,
+                        int nb_verts,
+                        const Vec3* vertices,
+                        Tri_face* tris)
+{
+    if( nb_verts < 3 )
+        return 0;
+
+    if( nb_verts == 3 ) {
+        tris[0] = make_tri(poly[0], poly[1], poly[2]);
+        return 1;
+    }
+
+    // Newell's normal is robust to concave and slightly non planar polygons
+    Vec3 normal(0.f);
+    for(int i = 0; i < nb_verts; ++i) {
+        const Vec3& p = vertices[ poly[i] ];
+        const Vec3& q = vertices[ poly[(i + 1) % nb_verts] ];
+        normal.x += (p.y - q.y) * (p.z + q.z);
+        normal.y += (p.z - q.z) * (p.x + q.x);
+        normal.z += (p.x - q.x) * (p.y + q.y);
+    }
+
+    bool convex = true;
+    for(int i = 0; i < nb_verts && convex; ++i) {
+        const Vec3& p0 = vertices[ poly[(i + nb_verts - 1) % nb_verts] ];
+        const Vec3& p1 = vertices[ poly[i] ];
+        const Vec3& p2 = vertices[ poly[(i + 1) % nb_verts] ];
+        convex = (p1 - p0).cross(p2 - p1).dot(normal) >= 0.f;
+    }
+
+    if( convex || nb_verts > g_max_polygon_size )
+    {
+        if( nb_verts == 4 )
+        {
+            // Split along the shortest diagonal: better shaped triangles
+            // hence better conditioned cotangent weights
+            float d02 = (vertices[poly[2]] - vertices[poly[0]]).norm_squared();
+            float d13 = (vertices[poly[3]] - vertices[poly[1]]).norm_squared();
+            if( d13 < d02 ) {
+                tris[0] = make_tri(poly[1], poly[2], poly[3]);
+                tris[1] = make_tri(poly[1], poly[3], poly[0]);
+                return 2;
+            }
+        }
+        return fan(poly, nb_verts, tris);
+    }
+
+    return ear_clipping(poly, nb_verts, vertices, normal, tris);
+}
@@ -0,0 +1,27 @@
+#ifndef POLYGON_TRIANGULATION_HPP
+#define POLYGON_TRIANGULATION_HPP
+
+#include "mesh.hpp"
+
+/// Maximal number of vertices of a polygon we can triangulate
+const int g_max_polygon_size = 256;
+
+/**
+ * @brief Triangulate a polygon face given by its vertex indices.
+ *
+ * Triangles have the orientation of the polygon. Convex polygons are fan
+ * triangulated (quads are split along their shortest diagonal), concave
+ * ones are ear clipped in the plane of the polygon.
+ *
+ * @param poly : 'nb_verts' vertex indices of the polygon
+ * @param vertices : positions of the mesh vertices
+ * @param[out] tris : must hold (nb_verts - 2) triangles
+ * @return number of triangles written: always nb_verts - 2 (0 when
+ * nb_verts < 3)
+ */
+int triangulate_polygon(const Vert_idx* poly,
+                        int nb_verts,
+                        const Vec3* vertices,
+                        Tri_face* tris);
+
+#endif // POLYGON_TRIANGULATION_HPP
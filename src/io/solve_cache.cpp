@@ -0,0 +1,561 @@
+#include "io/solve_cache.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <filesystem>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <Eigen/Sparse>
+
+#include "boundary_spec.hpp"
+#include "utils/parallel_for.hpp"
+#include "utils/trace.hpp"
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+const char g_factor_magic[8]  = {'H','W','F','A','C','T','O','R'};
+const char g_weights_magic[8] = {'H','W','W','E','I','G','H','T'};
+/// Increment whenever the layout or the content of a section changes
+const uint32_t g_version = 2;
+
+const char* g_factor_ext  = ".hwfactor";
+const char* g_weights_ext = ".hwweights";
+
+/// Header stamps of a factor file: key, then precision
+enum { eSTAMP_PRECISION = 2 };
+
+/// Section ids
+enum {
+    eSECTION_OUTER = 1,
+    eSECTION_INNER,
+    eSECTION_VALUES,
+    eSECTION_DIAG,
+    eSECTION_PERM,
+    eSECTION_WEIGHTS
+};
+
+/// In memory entry: a factorization or a weight map
+struct Entry {
+    Hash128 _key;
+    bool _is_factor;
+    std::shared_ptr<const Cached_factor> _factor;
+    std::shared_ptr<const std::vector<double>> _weights;
+    size_t _bytes;
+};
+
+std::mutex g_mutex;
+bool g_enabled = false;
+/// Empty: entries are only kept in memory
+std::string g_dir;
+size_t g_memory_limit = size_t(256) << 20;
+size_t g_disk_limit = size_t(2) << 30;
+size_t g_memory_bytes = 0;
+/// Most recently used first
+std::list<Entry> g_lru;
+Solve_cache_stats g_stats;
+
+// -----------------------------------------------------------------------------
+
+std::string file_name(const Hash128& key, const char* ext)
+{
+    return (std::filesystem::path(g_dir) / (key.hex() + ext)).string();
+}
+
+// -----------------------------------------------------------------------------
+
+/// Move the entry of 'key' to the front
+/// @return the entry or nullptr (g_mutex locked by the caller)
+const Entry* lru_find(const Hash128& key, bool is_factor)
+{
+    for(std::list<Entry>::iterator it = g_lru.begin(); it != g_lru.end(); ++it) {
+        if( it->_key == key && it->_is_factor == is_factor ) {
+            g_lru.splice(g_lru.begin(), g_lru, it);
+            return &g_lru.front();
+        }
+    }
+    return nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Add to the front then evict the least recently used entries above the
+/// memory limit (g_mutex locked by the caller)
+void lru_insert(const Entry& entry)
+{
+    // Two threads may have solved the same problem
+    for(std::list<Entry>::iterator it = g_lru.begin(); it != g_lru.end(); ++it) {
+        if( it->_key == entry._key && it->_is_factor == entry._is_factor ) {
+            g_memory_bytes -= it->_bytes;
+            g_lru.erase( it );
+            break;
+        }
+    }
+    g_lru.push_front( entry );
+    g_memory_bytes += entry._bytes;
+    while( g_memory_bytes > g_memory_limit && g_lru.size() > 1 ) {
+        g_memory_bytes -= g_lru.back()._bytes;
+        g_lru.pop_back();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+/// @return true if the compressed columns (outer, inner) of 'n' columns
+/// hold a lower triangular factor as Eigen's simplicial Cholesky writes it:
+/// row indices strictly increasing in [0 n) from the diagonal (LL^T) or
+/// below it (LDL^T, 'unit_diagonal')
+bool is_lower_factor(const int* outer, const int* inner, int n, bool unit_diagonal)
+{
+    std::atomic<bool> ok(true);
+    parallel_for_ranges(0, n, [&](int begin, int end) {
+        for(int j = begin; j < end && ok; ++j) {
+            int prev = unit_diagonal ? j : j - 1;
+            for(int p = outer[j]; p < outer[j+1]; ++p) {
+                if( inner[p] <= prev || inner[p] >= n ) {
+                    ok = false;
+                    break;
+                }
+                prev = inner[p];
+            }
+            if( !unit_diagonal && (outer[j] == outer[j+1] || inner[outer[j]] != j) )
+                ok = false;
+        }
+    }, 1 << 12);
+    return ok;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Mark a file as recently used
+void touch(const std::string& name)
+{
+    std::error_code err;
+    std::filesystem::last_write_time(name, std::filesystem::file_time_type::clock::now(), err);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Remove the least recently written files above the disk limit
+void trim_directory()
+{
+    struct File {
+        std::filesystem::path _path;
+        std::filesystem::file_time_type _time;
+        uintmax_t _size;
+    };
+    std::vector<File> files;
+    uintmax_t total = 0;
+    std::error_code err;
+    for(const auto& entry : std::filesystem::directory_iterator(g_dir, err)) {
+        std::string ext = entry.path().extension().string();
+        if( ext != g_factor_ext && ext != g_weights_ext )
+            continue;
+        File f;
+        f._path = entry.path();
+        f._time = entry.last_write_time(err);
+        f._size = entry.file_size(err);
+        total += f._size;
+        files.push_back( f );
+    }
+    std::sort(files.begin(), files.end(), [](const File& a, const File& b) {
+        return a._time < b._time;
+    });
+    for(unsigned i = 0; i < files.size() && total > g_disk_limit; ++i) {
+        std::filesystem::remove(files[i]._path, err);
+        total -= files[i]._size;
+    }
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+bool Cached_factor::open(const std::string& name, const Hash128& key)
+{
+    if( !_reader.open(name, g_factor_magic, g_version) )
+        return false;
+    const Binary_container::Header& header = _reader.header();
+    if( header._stamp[0] != key._h[0] || header._stamp[1] != key._h[1] ) {
+        _reader.close();
+        return false;
+    }
+
+    uint64_t nb_outer = 0, nb_inner = 0, nb_values = 0, nb_diag = 0, nb_perm = 0;
+    _outer  = _reader.section<int>(eSECTION_OUTER, nb_outer);
+    _inner  = _reader.section<int>(eSECTION_INNER, nb_inner);
+    _values = _reader.section<double>(eSECTION_VALUES, nb_values);
+    _diag   = _reader.section<double>(eSECTION_DIAG, nb_diag);
+    _perm   = _reader.section<int>(eSECTION_PERM, nb_perm);
+    _n = nb_outer > 0 && nb_outer <= uint64_t(INT_MAX) ? int(nb_outer) - 1 : -1;
+    bool valid = _outer != nullptr && _inner != nullptr && _values != nullptr &&
+                 _n >= 0 && nb_inner == nb_values && nb_inner <= uint64_t(INT_MAX) &&
+                 (nb_diag == 0 || nb_diag == uint64_t(_n)) &&
+                 (nb_perm == 0 || nb_perm == uint64_t(_n)) &&
+                 header._stamp[eSTAMP_PRECISION] <= 1;
+    valid = valid && Binary_container::is_csr_offsets(_outer, _n, nb_inner) &&
+            is_lower_factor(_outer, _inner, _n, nb_diag > 0) &&
+            (nb_perm == 0 || Binary_container::is_permutation(_perm, _n));
+    if( !valid ) {
+        std::cerr << "Invalid solve cache file " << name << " (factorizing again)" << std::endl;
+        _reader.close();
+        _n = 0;
+        return false;
+    }
+    _nnz = int(nb_inner);
+    if( nb_diag == 0 ) _diag = nullptr;
+    if( nb_perm == 0 ) _perm = nullptr;
+    _single_precision = header._stamp[eSTAMP_PRECISION] == 1;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void Cached_factor::set(Cholesky_factor& factor)
+{
+    _owned = Cholesky_factor();
+    std::swap(_owned, factor);
+    _n = _owned._n;
+    _nnz = int(_owned._inner.size());
+    _outer = _owned._outer.data();
+    _inner = _owned._inner.data();
+    _values = _owned._values.data();
+    _diag = _owned._diag.empty() ? nullptr : _owned._diag.data();
+    _perm = _owned._perm.empty() ? nullptr : _owned._perm.data();
+    _single_precision = _owned._single_precision;
+}
+
+// -----------------------------------------------------------------------------
+
+size_t Cached_factor::bytes() const
+{
+    return size_t(_n + 1) * sizeof(int) + size_t(_nnz) * (sizeof(int) + sizeof(double)) +
+           (_diag != nullptr ? size_t(_n) * sizeof(double) : 0) +
+           (_perm != nullptr ? size_t(_n) * sizeof(int) : 0);
+}
+
+// -----------------------------------------------------------------------------
+
+void Cached_factor::solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) const
+{
+    // Same steps as Eigen's SimplicialCholeskyBase::_solve_impl()
+    Eigen::Map<const Eigen::SparseMatrix<double>> L(_n, _n, _nnz, _outer, _inner, _values);
+    Eigen::VectorXd y(_n);
+    if( _perm != nullptr ) {
+        for(int i = 0; i < _n; ++i)
+            y(_perm[i]) = b(i);
+    } else {
+        y = b;
+    }
+
+    if( _diag != nullptr ) {
+        L.triangularView<Eigen::UnitLower>().solveInPlace( y );
+        for(int i = 0; i < _n; ++i)
+            y(i) /= _diag[i];
+        L.transpose().triangularView<Eigen::UnitUpper>().solveInPlace( y );
+    } else {
+        L.triangularView<Eigen::Lower>().solveInPlace( y );
+        L.transpose().triangularView<Eigen::Upper>().solveInPlace( y );
+    }
+
+    x.resize(_n);
+    if( _perm != nullptr ) {
+        for(int i = 0; i < _n; ++i)
+            x(i) = y(_perm[i]);
+    } else {
+        x = y;
+    }
+}
+
+// =============================================================================
+// Keys
+// =============================================================================
+
+Hash128 solve_cache_mesh_key(const std::vector< Vec3 >& vertices,
+                             const std::vector< std::vector<int> >& edges,
+                             const std::vector<Tri_face>& triangles)
+{
+    Trace_scope trace("solve_cache_key");
+    Hasher h;
+    h.add( vertices );
+    h.add( triangles );
+    // Laplacian scheme: first rings or triangles
+    h.add( int(edges.size() > 0) );
+    for(const std::vector<int>& ring : edges)
+        h.add( ring );
+    return h.digest();
+}
+
+// -----------------------------------------------------------------------------
+
+Hash128 solve_cache_factor_key(const Hash128& mesh_key,
+                               const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                               const Solver_options& options)
+{
+    Hasher h;
+    h.add( mesh_key );
+    h.add( boundary_vertices_key(boundaries) );
+    h.add( options._solver );
+    h.add( int(options._single_precision) );
+    return h.digest();
+}
+
+// -----------------------------------------------------------------------------
+
+Hash128 solve_cache_result_key(const Hash128& mesh_key,
+                               const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                               const Solver_options& options)
+{
+    Hasher h;
+    h.add( mesh_key );
+    h.add( boundaries );
+    h.add( options._solver );
+    h.add( int(options._single_precision) );
+    h.add( options._tolerance );
+    h.add( options._max_iterations );
+    h.add( options._memory_budget );
+    return h.digest();
+}
+
+// =============================================================================
+// Settings
+// =============================================================================
+
+void set_solve_cache_dir(const std::string& dir)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if( !dir.empty() ) {
+        std::error_code err;
+        std::filesystem::create_directories(dir, err);
+        if( err )
+            std::cerr << "Can't create the solve cache directory " << dir << ": " << err.message() << std::endl;
+    }
+    g_dir = dir;
+    g_enabled = !dir.empty();
+    g_lru.clear();
+    g_memory_bytes = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+void set_solve_cache_enabled(bool state)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_enabled = state;
+    if( !state ) {
+        g_lru.clear();
+        g_memory_bytes = 0;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+std::string solve_cache_dir()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_dir;
+}
+
+// -----------------------------------------------------------------------------
+
+bool is_solve_cache_enabled()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_enabled;
+}
+
+// -----------------------------------------------------------------------------
+
+void set_solve_cache_memory(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_memory_limit = bytes;
+    while( g_memory_bytes > g_memory_limit && !g_lru.empty() ) {
+        g_memory_bytes -= g_lru.back()._bytes;
+        g_lru.pop_back();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void set_solve_cache_disk_limit(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_disk_limit = bytes;
+}
+
+// -----------------------------------------------------------------------------
+
+void clear_solve_cache_memory()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_lru.clear();
+    g_memory_bytes = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+Solve_cache_stats solve_cache_stats()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    Solve_cache_stats stats = g_stats;
+    stats._memory_bytes = g_memory_bytes;
+    return stats;
+}
+
+// =============================================================================
+// Lookup and storage
+// =============================================================================
+
+std::shared_ptr<const Cached_factor> find_cached_factor(const Hash128& key, bool single_precision)
+{
+    Trace_scope trace("find_cached_factor");
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if( !g_enabled )
+        return nullptr;
+    const Entry* found = lru_find(key, true);
+    if( found != nullptr && found->_factor->is_single_precision() == single_precision ) {
+        g_stats._factor_hits++;
+        return found->_factor;
+    }
+    if( g_dir.empty() ) {
+        g_stats._factor_misses++;
+        return nullptr;
+    }
+
+    std::string name = file_name(key, g_factor_ext);
+    std::shared_ptr<Cached_factor> factor = std::make_shared<Cached_factor>();
+    if( !factor->open(name, key) || factor->is_single_precision() != single_precision ) {
+        g_stats._factor_misses++;
+        return nullptr;
+    }
+    touch( name );
+    g_stats._factor_hits++;
+    Entry entry;
+    entry._key = key;
+    entry._is_factor = true;
+    entry._factor = factor;
+    entry._bytes = factor->bytes();
+    lru_insert( entry );
+    return factor;
+}
+
+// -----------------------------------------------------------------------------
+
+void store_cached_factor(const Hash128& key, Cholesky_factor& factor)
+{
+    Trace_scope trace("store_cached_factor");
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if( !g_enabled )
+        return;
+    std::shared_ptr<Cached_factor> cached = std::make_shared<Cached_factor>();
+    if( g_dir.empty() ) {
+        cached->set( factor );
+        Entry entry;
+        entry._key = key;
+        entry._is_factor = true;
+        entry._factor = cached;
+        entry._bytes = cached->bytes();
+        lru_insert( entry );
+        return;
+    }
+
+    std::string name = file_name(key, g_factor_ext);
+    Binary_container::Writer writer(g_factor_magic, g_version);
+    writer.set_stamp(0, key._h[0]);
+    writer.set_stamp(1, key._h[1]);
+    writer.set_stamp(eSTAMP_PRECISION, factor._single_precision ? 1 : 0);
+    writer.add_section(eSECTION_OUTER, factor._outer);
+    writer.add_section(eSECTION_INNER, factor._inner);
+    writer.add_section(eSECTION_VALUES, factor._values);
+    writer.add_section(eSECTION_DIAG, factor._diag);
+    writer.add_section(eSECTION_PERM, factor._perm);
+
+    // Map the file back so the factor is not held twice in memory
+    if( writer.write(name) && cached->open(name, key) ) {
+        factor = Cholesky_factor();
+        trim_directory();
+    } else {
+        std::cerr << "Can't write the solve cache file " << name << std::endl;
+        cached->set( factor );
+    }
+
+    Entry entry;
+    entry._key = key;
+    entry._is_factor = true;
+    entry._factor = cached;
+    entry._bytes = cached->bytes();
+    lru_insert( entry );
+}
+
+// -----------------------------------------------------------------------------
+
+bool find_cached_weights(const Hash128& key, std::vector<double>& weights)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if( !g_enabled )
+        return false;
+    if( const Entry* entry = lru_find(key, false) ) {
+        g_stats._result_hits++;
+        weights = *entry->_weights;
+        return true;
+    }
+    if( g_dir.empty() ) {
+        g_stats._result_misses++;
+        return false;
+    }
+
+    std::string name = file_name(key, g_weights_ext);
+    Binary_container::Reader reader;
+    uint64_t nb = 0;
+    const double* data = nullptr;
+    if( reader.open(name, g_weights_magic, g_version) &&
+        reader.header()._stamp[0] == key._h[0] &&
+        reader.header()._stamp[1] == key._h[1] )
+    {
+        data = reader.section<double>(eSECTION_WEIGHTS, nb);
+    }
+    if( data == nullptr ) {
+        g_stats._result_misses++;
+        return false;
+    }
+    touch( name );
+    g_stats._result_hits++;
+    weights.assign(data, data + nb);
+
+    Entry entry;
+    entry._key = key;
+    entry._is_factor = false;
+    entry._weights = std::make_shared<const std::vector<double>>( weights );
+    entry._bytes = weights.size() * sizeof(double);
+    lru_insert( entry );
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void store_cached_weights(const Hash128& key, const std::vector<double>& weights)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    if( !g_enabled )
+        return;
+    if( !g_dir.empty() ) {
+        std::string name = file_name(key, g_weights_ext);
+        Binary_container::Writer writer(g_weights_magic, g_version);
+        writer.set_stamp(0, key._h[0]);
+        writer.set_stamp(1, key._h[1]);
+        writer.add_section(eSECTION_WEIGHTS, weights);
+        if( writer.write(name) )
+            trim_directory();
+        else
+            std::cerr << "Can't write the solve cache file " << name << std::endl;
+    }
+
+    Entry entry;
+    entry._key = key;
+    entry._is_factor = false;
+    entry._weights = std::make_shared<const std::vector<double>>( weights );
+    entry._bytes = weights.size() * sizeof(double);
+    lru_insert( entry );
+}
@@ -0,0 +1,166 @@
+#ifndef SOLVE_CACHE_HPP
+#define SOLVE_CACHE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <Eigen/Core>
+
+#include "mesh.hpp"
+#include "solvers.hpp"
+#include "solver_backend.hpp"
+#include "io/binary_container.hpp"
+#include "utils/hash.hpp"
+
+/**
+ * @brief Content addressed cache of factorizations and weight maps, used
+ * by solve_laplace_equation() once a directory is set with
+ * set_solve_cache_dir().
+ *
+ * Entries are keyed by hashes of the inputs of the solve:
+ * - factor key: vertices, triangles, Laplacian scheme (first rings or
+ *   triangles), set of constrained vertices (see boundary_vertices_key()),
+ *   backend and precision.
+ *   Only Cholesky factorizations (ldlt, llt) are stored: L, D and the fill
+ *   reducing permutation in "<key>.hwfactor", with the precision of the
+ *   backend. The file is memory mapped and used in place, a new boundary
+ *   value on the same vertices only costs the back substitution. The
+ *   factors of the other backends (e.g. lu, the default) are not cached,
+ *   only their weight maps are.
+ * - result key: the factor key plus the boundary values and every solver
+ *   option. "<key>.hwweights" holds the weight map, returned as is.
+ *
+ * An in-memory LRU (set_solve_cache_memory()) keeps the recently used
+ * entries in front of the directory (or alone with set_solve_cache_enabled()
+ * and no directory, e.g. in the solve service). The directory is trimmed to
+ * set_solve_cache_disk_limit() by removing the least recently used files.
+ */
+
+/// @brief Factorization found in the cache, P^T L D L^T P
+/// (memory mapped from the cache file, or owned when the directory is not
+/// writable)
+class Cached_factor {
+public:
+    Cached_factor()
+        : _n(0)
+        , _nnz(0)
+        , _outer(nullptr)
+        , _inner(nullptr)
+        , _values(nullptr)
+        , _diag(nullptr)
+        , _perm(nullptr)
+        , _single_precision(false)
+    { }
+
+    /// Map "<key>.hwfactor"
+    /// @return false if the file does not exist or is invalid: indices out
+    /// of range, L not lower triangular with sorted columns, 'perm' not a
+    /// permutation...
+    bool open(const std::string& file_name, const Hash128& key);
+
+    /// Take ownership of 'factor'
+    void set(Cholesky_factor& factor);
+
+    int size() const { return _n; }
+
+    /// Factorized in float (see Cholesky_factor::_single_precision)
+    bool is_single_precision() const { return _single_precision; }
+
+    /// Bytes of the factors
+    size_t bytes() const;
+
+    /// Back substitution: x = A^-1 b
+    void solve(const Eigen::VectorXd& b, Eigen::VectorXd& x) const;
+
+private:
+    Binary_container::Reader _reader;
+    Cholesky_factor _owned;
+    int _n;
+    int _nnz;
+    const int* _outer;
+    const int* _inner;
+    const double* _values;
+    const double* _diag; ///< nullptr for LL^T
+    const int* _perm;    ///< nullptr for the identity
+    bool _single_precision;
+};
+
+// -----------------------------------------------------------------------------
+/// @name Keys
+// -----------------------------------------------------------------------------
+
+/// Hash of the vertices, the triangles and the first rings ('edges', the
+/// Laplacian is built from the triangles when empty)
+Hash128 solve_cache_mesh_key(const std::vector< Vec3 >& vertices,
+                             const std::vector< std::vector<int> >& edges,
+                             const std::vector<Tri_face>& triangles);
+
+/// Mesh key + constrained vertices + backend and precision of 'options'
+Hash128 solve_cache_factor_key(const Hash128& mesh_key,
+                               const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                               const Solver_options& options);
+
+/// Mesh key + boundary conditions + every option of 'options'
+Hash128 solve_cache_result_key(const Hash128& mesh_key,
+                               const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                               const Solver_options& options);
+
+// -----------------------------------------------------------------------------
+/// @name Settings (the cache is disabled by default)
+// -----------------------------------------------------------------------------
+
+/// Directory of the cache files, created if needed (empty: disable the cache)
+void set_solve_cache_dir(const std::string& dir);
+std::string solve_cache_dir();
+
+/// Enable / disable the cache, without a directory only the in-memory LRU
+/// is used
+void set_solve_cache_enabled(bool state);
+bool is_solve_cache_enabled();
+
+/// Bytes kept in the in-memory LRU (default 256 MB)
+void set_solve_cache_memory(size_t bytes);
+
+/// Bytes of cache files kept in the directory (default 2 GB)
+void set_solve_cache_disk_limit(size_t bytes);
+
+/// Drop the in-memory entries (files are kept)
+void clear_solve_cache_memory();
+
+struct Solve_cache_stats {
+    Solve_cache_stats()
+        : _factor_hits(0)
+        , _factor_misses(0)
+        , _result_hits(0)
+        , _result_misses(0)
+        , _memory_bytes(0)
+    { }
+
+    size_t _factor_hits;
+    size_t _factor_misses;
+    size_t _result_hits;
+    size_t _result_misses;
+    size_t _memory_bytes; ///< held by the in-memory LRU
+};
+
+Solve_cache_stats solve_cache_stats();
+
+// -----------------------------------------------------------------------------
+/// @name Lookup and storage (thread safe)
+// -----------------------------------------------------------------------------
+
+/// @return the factorization of 'key' computed in the precision
+/// 'single_precision', or nullptr
+std::shared_ptr<const Cached_factor> find_cached_factor(const Hash128& key, bool single_precision);
+
+/// Write 'factor' to the cache (it is moved into the cache)
+void store_cached_factor(const Hash128& key, Cholesky_factor& factor);
+
+/// @return false if 'key' is not in the cache
+bool find_cached_weights(const Hash128& key, std::vector<double>& weights);
+
+void store_cached_weights(const Hash128& key, const std::vector<double>& weights);
+
+#endif // SOLVE_CACHE_HPP
@@ -0,0 +1,135 @@
+#ifndef TEXT_PARSING_HPP
+#define TEXT_PARSING_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <charconv>
+
+/**
+ * @brief Low level helpers to parse ASCII mesh files held in memory
+ * (see Mapped_file).
+ *
+ * Every function takes a cursor 'p' and the end of the buffer 'end',
+ * buffers are not expected to be null terminated. Parsing never goes past
+ * the end of the current line unless stated otherwise.
+ */
+namespace Text {
+
+// -----------------------------------------------------------------------------
+
+/// Blank characters excluding the end of line
+inline bool is_blank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+/// Skip blank characters but stop at the end of line
+inline const char* skip_blanks(const char* p, const char* end) {
+    while( p < end && is_blank(*p) ) ++p;
+    return p;
+}
+
+/// @return pointer to the first character of the next line (or 'end')
+inline const char* next_line(const char* p, const char* end) {
+    const char* nl = (const char*)std::memchr(p, '\n', size_t(end - p));
+    return nl ? nl + 1 : end;
+}
+
+/// @return true if nothing else than blanks or a comment remains on the line
+/// @param comment : character starting a comment
+inline bool is_end_of_line(const char* p, const char* end, char comment = '#') {
+    p = skip_blanks(p, end);
+    return p >= end || *p == '\n' || *p == comment;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Parse a floating point value after skipping blanks
+/// @return false if no number could be read, 'p' is left untouched then.
+inline bool parse(const char*& p, const char* end, float& val)
+{
+    const char* s = skip_blanks(p, end);
+    // from_chars() does not accept a leading '+'
+    if( s < end && *s == '+' ) ++s;
+#if defined(__cpp_lib_to_chars)
+    std::from_chars_result res = std::from_chars(s, end, val);
+    if( res.ec != std::errc() )
+        return false;
+    p = res.ptr;
+#else
+    // Fallback for standard libraries without floating point from_chars()
+    char buff[64];
+    size_t len = 0;
+    while( s + len < end && len < sizeof(buff) - 1 &&
+           !is_blank(s[len]) && s[len] != '\n' )
+    {
+        buff[len] = s[len];
+        ++len;
+    }
+    buff[len] = '\0';
+    char* stop = nullptr;
+    val = std::strtof(buff, &stop);
+    if( stop == buff )
+        return false;
+    p = s + (stop - buff);
+#endif
+    return true;
+}
+
+/// Parse an integer after skipping blanks
+/// @return false if no number could be read, 'p' is left untouched then.
+inline bool parse(const char*& p, const char* end, int& val)
+{
+    const char* s = skip_blanks(p, end);
+    if( s < end && *s == '+' ) ++s;
+    std::from_chars_result res = std::from_chars(s, end, val);
+    if( res.ec != std::errc() )
+        return false;
+    p = res.ptr;
+    return true;
+}
+
+/// Parse a word (sequence of non blank characters) after skipping blanks
+/// @return false if the line is empty
+inline bool parse_word(const char*& p, const char* end,
+                       const char*& word, size_t& len)
+{
+    const char* s = skip_blanks(p, end);
+    const char* e = s;
+    while( e < end && !is_blank(*e) && *e != '\n' ) ++e;
+    if( e == s )
+        return false;
+    word = s;
+    len = size_t(e - s);
+    p = e;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Split [begin end) in 'nb_chunks' ranges whose boundaries are at the start
+/// of a line.
+/// @param[out] bounds : nb_chunks+1 pointers, chunk i is [bounds[i] bounds[i+1])
+/// (some chunks may be empty)
+inline void split_lines(const char* begin, const char* end, int nb_chunks,
+                        std::vector<const char*>& bounds)
+{
+    bounds.resize( nb_chunks + 1 );
+    bounds[0] = begin;
+    size_t size = size_t(end - begin);
+    for(int i = 1; i < nb_chunks; ++i)
+    {
+        const char* p = begin + size * size_t(i) / size_t(nb_chunks);
+        p = std::max(p, bounds[i-1]);
+        // move to the beginning of the next line
+        if( p > begin && p[-1] != '\n' )
+            p = next_line(p, end);
+        bounds[i] = p;
+    }
+    bounds[nb_chunks] = end;
+}
+
+}// END Text NAMESPACE ===========================================================
+
+#endif // TEXT_PARSING_HPP
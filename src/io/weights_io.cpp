@@ -0,0 +1,71 @@
+#include "io/weights_io.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+// -----------------------------------------------------------------------------
+
+static bool has_extension(const char* file_name, const char* ext)
+{
+    size_t len = std::strlen(file_name);
+    size_t ext_len = std::strlen(ext);
+    return len >= ext_len && std::strcmp(file_name + len - ext_len, ext) == 0;
+}
+
+// -----------------------------------------------------------------------------
+
+bool write_weights(const char* file_name, const std::vector<double>& weights)
+{
+    const bool binary = has_extension(file_name, ".bin");
+    FILE* file = std::fopen(file_name, binary ? "wb" : "w");
+    if( file == nullptr ) {
+        std::cerr << "Can't open file for writing: " << file_name << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    if( binary ) {
+        ok = std::fwrite(weights.data(), sizeof(double), weights.size(), file) == weights.size();
+    } else {
+        // %.17g: enough digits to read back the exact same double
+        for(double w : weights)
+            ok = ok && std::fprintf(file, "%.17g\n", w) > 0;
+    }
+
+    ok = (std::fclose(file) == 0) && ok;
+    if( !ok )
+        std::cerr << "Error while writing: " << file_name << std::endl;
+    return ok;
+}
+
+// -----------------------------------------------------------------------------
+
+bool read_points(const char* file_name, std::vector<Vec3>& points)
+{
+    points.clear();
+    const bool binary = has_extension(file_name, ".bin");
+    FILE* file = std::fopen(file_name, binary ? "rb" : "r");
+    if( file == nullptr ) {
+        std::cerr << "Can't open file for reading: " << file_name << std::endl;
+        return false;
+    }
+
+    bool ok = true;
+    float xyz[3];
+    if( binary ) {
+        while( std::fread(xyz, sizeof(float), 3, file) == 3 )
+            points.push_back( Vec3(xyz[0], xyz[1], xyz[2]) );
+        ok = !std::ferror(file) && std::ftell(file) % long(3 * sizeof(float)) == 0;
+    } else {
+        int nb = 0;
+        while( (nb = std::fscanf(file, "%f %f %f", xyz, xyz + 1, xyz + 2)) == 3 )
+            points.push_back( Vec3(xyz[0], xyz[1], xyz[2]) );
+        ok = nb == EOF && !std::ferror(file);
+    }
+
+    std::fclose(file);
+    if( !ok )
+        std::cerr << "Error while reading points: " << file_name << std::endl;
+    return ok;
+}
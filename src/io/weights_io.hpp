@@ -0,0 +1,21 @@
+#ifndef WEIGHTS_IO_HPP
+#define WEIGHTS_IO_HPP
+
+#include <vector>
+
+#include "vec3.hpp"
+
+/// Write one weight per vertex to 'file_name'.
+/// Files ending with ".bin" hold raw doubles (native endianness), any other
+/// extension gives a text file with one value per line.
+/// @return false on error (message printed on std::cerr)
+bool write_weights(const char* file_name, const std::vector<double>& weights);
+
+/// Read points to sample weights at (see Weight_sampler).
+/// Files ending with ".bin" hold raw floats x y z (native endianness), any
+/// other extension is read as text, three coordinates per point separated by
+/// spaces or line breaks.
+/// @return false on error (message printed on std::cerr)
+bool read_points(const char* file_name, std::vector<Vec3>& points);
+
+#endif // WEIGHTS_IO_HPP
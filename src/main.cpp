@@ -1,14 +1,28 @@
+// Prototypes of the buffer object functions (OpenGL 1.5)
+#define GL_GLEXT_PROTOTYPES
 #include <GL/glut.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <utility>
 #include <cmath>
 
 #include "mesh.hpp"
+#include "mesh_cleanup.hpp"
+#include "mesh_normals.hpp"
 #include "topology/vertex_to_face.hpp"
 #include "topology/vertex_to_1st_ring_vertices.hpp"
+#include "io/mesh_cache.hpp"
+#include "boundary_conditions.hpp"
 #include "solvers.hpp"
+#include "solve_async.hpp"
+#include "retained_solve.hpp"
+#include "utils/parallel_for.hpp"
+#include "utils/timer.hpp"
 
 // compatibility with original GLUT
 #if !defined(GLUT_WHEEL_UP)
@@ -16,6 +30,12 @@
 #  define GLUT_WHEEL_DOWN 4
 #endif
 
+// Vertex buffer objects need the OpenGL 1.5 headers, client arrays are used
+// otherwise (e.g. the OpenGL 1.1 headers of Windows)
+#if defined(GL_VERSION_1_5)
+#  define USE_VBO
+#endif
+
 // =============================================================================
 // hard coded settings
 // =============================================================================
@@ -36,18 +56,20 @@
 // Could be a good start.
 //const char* _sample_path = "samples/plane_wholes.off";
 
-const char* _g_sample_path = "samples/plane_iregular_1.off";
-
+// Generated meshes work too (see generate_mesh()):
+//const char* _sample_path = "gen:holes:20K";
 
+const char* _g_sample_path = "samples/plane_iregular_1.off";
 
-enum Boundary_type {
-    eSTRIP,
-    eCONE
-};
 
 
 Boundary_type _g_boundary_type = eCONE; /*eSTRIP*/
 
+// Declarative boundary conditions used instead of the preset above, inline
+// JSON or a ".json" file (see boundary_spec.hpp). Also given on the command
+// line: harmonic_weights [boundary spec]
+const char* _g_boundary_spec = nullptr;
+
 // When 'true' Automatically turn around the 3D model (you can adjust angle of
 // view with the scroll wheel.
 // In addition, displace the sample model vertices along the Z axis giventhe
@@ -61,6 +83,11 @@ bool _g_3d_view = true;
 // Laplacian matrix but only the list of triangles.
 bool _g_use_half_edges = true;
 
+// Weld duplicated vertices and remove degenerate triangles after loading.
+// Useful for scanned or exported meshes (seams, zero area triangles) which
+// otherwise give badly conditioned Laplacian matrices.
+bool _g_cleanup_mesh = false;
+
 // =============================================================================
 // Global variables
 // =============================================================================
@@ -69,16 +96,209 @@ bool _g_use_half_edges = true;
 float _g_table_angle = 0.0f;
 static int _g_win_number;
 Mesh* _g_mesh;
+// Vertex positions before deform_mesh(), a new solve starts from them
+std::vector<Vec3> _g_rest_vertices;
+// Normals of _g_mesh, updated around the vertices moved by a re-solve
+Vertex_normals _g_normals;
+// First ring of each vertex
+std::vector< std::vector<int> > _g_edges;
+// Solve running in the background, the flat mesh is displayed meanwhile
+Solve_handle _g_solve;
+// Boundaries from _g_boundary_spec rather than _g_boundary_type
+bool _g_use_boundary_spec = false;
+// Boundary conditions of the current solve, values are edited by dragging
+std::vector<std::pair<Vert_idx, float> > _g_boundaries;
+// Factorization of the current boundary vertices, kept by the first solve:
+// dragging a handle only changes the right hand side
+std::shared_ptr<Retained_solve> _g_system;
+// Re-solve for the dragged values running in the background
+Solve_handle _g_resolve;
+
+/// Constrained vertices picked with the left button and dragged vertically
+/// to change their value (every vertex sharing the value of the picked one,
+/// shift + click to pick a single vertex)
+struct Drag_state {
+    Drag_state() : _active(false), _last_y(0), _value(0.f), _changed(false) { }
+
+    bool _active;            ///< left button down on a handle
+    int _last_y;
+    float _value;            ///< of the handle, in [0 1]
+    std::vector<int> _slots; ///< entries of _g_boundaries in the handle
+    bool _changed;           ///< values not sent to a re-solve yet
+    Timer _oldest_change;    ///< first change not sent yet
+    Timer _request;          ///< first change of the re-solve running
+};
+Drag_state _g_drag;
+
+// Transformations of the last frame, to pick constrained vertices
+GLdouble _g_modelview[16];
+GLdouble _g_projection[16];
+GLint _g_viewport[4];
 
 // List of GL_POINTS to display
 // (represents boundary conditions of the Laplace PDE, i.e the vertices
-// where we fix values by hand)
+// where we fix values by hand) one per entry of _g_boundaries
 std::vector<std::pair<Vec3/*position*/, Vec3/*color*/>> _g_ogl_points;
+// Boundary colors: values below 0.5 in red (green otherwise) or the opposite
+bool _g_low_in_red = false;
+// Weights currently displayed (empty for the flat mesh)
+std::vector<double> _g_weights;
+
+/// Vertices modified since the last upload, tracked per block of
+/// eBLOCK_SIZE vertices: handles dragged at both ends of the mesh only
+/// upload the blocks around them
+struct Dirty_blocks {
+    enum { eBLOCK_SIZE = 4096 };
+
+    Dirty_blocks() : _nb_dirty(0) { }
+
+    /// Mark vertices [begin end)
+    void add(int begin, int end) {
+        if( begin >= end )
+            return;
+        const int first = begin / eBLOCK_SIZE;
+        const int last = (end - 1) / eBLOCK_SIZE;
+        if( last >= int(_is_dirty.size()) )
+            _is_dirty.resize(last + 1, 0);
+        for(int b = first; b <= last; ++b) {
+            _nb_dirty += _is_dirty[b] ? 0 : 1;
+            _is_dirty[b] = 1;
+        }
+    }
+    bool empty() const { return _nb_dirty == 0; }
+    void clear() { _is_dirty.assign(_is_dirty.size(), 0); _nb_dirty = 0; }
+
+    std::vector<char> _is_dirty; ///< per block of vertices
+    int _nb_dirty;
+};
+
+/// The mesh and the boundary points on the GPU: buffer objects created on
+/// the first frame, then only the dirty blocks of the vertex attributes are
+/// uploaded (nothing while the turntable spins)
+struct Gpu_buffers {
+    Gpu_buffers()
+        : _positions(0), _normals(0), _colors(0), _indices(0), _points(0)
+        , _nb_vertices(0), _nb_indices(0), _nb_points(0)
+        , _dirty_indices(true), _dirty_points(true)
+    { }
+
+    GLuint _positions, _normals, _colors, _indices, _points;
+    int _nb_vertices; ///< allocated in each vertex buffer
+    int _nb_indices;
+    int _nb_points;   ///< allocated in _points
+    Dirty_blocks _dirty_positions, _dirty_normals, _dirty_colors;
+    bool _dirty_indices;
+    bool _dirty_points;
+};
+Gpu_buffers _g_gpu;
+
+/// Every vertex attribute of the mesh changed
+void mark_mesh_dirty()
+{
+    int nv = int(_g_mesh->nb_vertices());
+    _g_gpu._dirty_positions.add(0, nv);
+    _g_gpu._dirty_normals.add(0, nv);
+    _g_gpu._dirty_colors.add(0, nv);
+}
 
 // =============================================================================
 // GLUT
 // =============================================================================
 
+#ifdef USE_VBO
+
+/// Upload the dirty blocks of 'blocks' (then cleared) from 'data' to
+/// 'buffer', one call per run of consecutive dirty blocks
+void upload_blocks(GLuint buffer, const std::vector<Vec3>& data, Dirty_blocks& blocks)
+{
+    if( blocks.empty() )
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    const int nb_blocks = int(blocks._is_dirty.size());
+    const int nv = int(data.size());
+    for(int b = 0; b < nb_blocks; )
+    {
+        if( !blocks._is_dirty[b] ) {
+            ++b;
+            continue;
+        }
+        int e = b + 1;
+        while( e < nb_blocks && blocks._is_dirty[e] )
+            ++e;
+        const int begin = b * Dirty_blocks::eBLOCK_SIZE;
+        const int end = std::min(e * Dirty_blocks::eBLOCK_SIZE, nv);
+        if( begin < end )
+            glBufferSubData(GL_ARRAY_BUFFER,
+                            GLintptr(begin) * sizeof(Vec3),
+                            GLsizeiptr(end - begin) * sizeof(Vec3),
+                            data.data() + begin);
+        b = e;
+    }
+    blocks.clear();
+}
+
+// -----------------------------------------------------------------------------
+
+/// Bring the buffers of _g_gpu up to date with 'mesh' and _g_ogl_points
+void upload_buffers(const Mesh& mesh)
+{
+    Gpu_buffers& gpu = _g_gpu;
+    if( gpu._positions == 0 ) {
+        GLuint ids[5];
+        glGenBuffers(5, ids);
+        gpu._positions = ids[0];
+        gpu._normals   = ids[1];
+        gpu._colors    = ids[2];
+        gpu._indices   = ids[3];
+        gpu._points    = ids[4];
+    }
+
+    // (Re)allocation uploads everything
+    const int nv = int(mesh.nb_vertices());
+    if( gpu._nb_vertices != nv ) {
+        const GLuint buffers[] = {gpu._positions, gpu._normals, gpu._colors};
+        const std::vector<Vec3>* data[] = {&mesh._vertices, &mesh._normals, &mesh._colors};
+        for(int i = 0; i < 3; ++i) {
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+            glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(nv) * sizeof(Vec3), data[i]->data(), GL_DYNAMIC_DRAW);
+        }
+        gpu._nb_vertices = nv;
+        gpu._dirty_positions.clear();
+        gpu._dirty_normals.clear();
+        gpu._dirty_colors.clear();
+    }
+    upload_blocks(gpu._positions, mesh._vertices, gpu._dirty_positions);
+    upload_blocks(gpu._normals  , mesh._normals , gpu._dirty_normals  );
+    upload_blocks(gpu._colors   , mesh._colors  , gpu._dirty_colors   );
+
+    if( gpu._dirty_indices ) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpu._indices);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(mesh._triangles.size()) * sizeof(Tri_face),
+                     mesh._triangles.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        gpu._nb_indices = int(mesh._triangles.size()) * 3;
+        gpu._dirty_indices = false;
+    }
+
+    // Few points: the whole buffer, reallocated when the count changes
+    if( gpu._dirty_points ) {
+        const int nb = int(_g_ogl_points.size());
+        const GLsizeiptr bytes = GLsizeiptr(nb) * sizeof(_g_ogl_points[0]);
+        glBindBuffer(GL_ARRAY_BUFFER, gpu._points);
+        if( nb != gpu._nb_points )
+            glBufferData(GL_ARRAY_BUFFER, bytes, _g_ogl_points.data(), GL_DYNAMIC_DRAW);
+        else
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, _g_ogl_points.data());
+        gpu._nb_points = nb;
+        gpu._dirty_points = false;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+#endif
+
+// -----------------------------------------------------------------------------
+
 void draw_mesh(const Mesh& mesh) {
     glEnable(GL_COLOR_MATERIAL);
     glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
@@ -87,10 +307,24 @@ void draw_mesh(const Mesh& mesh) {
     glEnableClientState(GL_NORMAL_ARRAY);
     glEnableClientState(GL_COLOR_ARRAY);
 
+#ifdef USE_VBO
+    upload_buffers( mesh );
+    glBindBuffer(GL_ARRAY_BUFFER, _g_gpu._positions);
+    glVertexPointer(3, GL_FLOAT, 0, nullptr);
+    glBindBuffer(GL_ARRAY_BUFFER, _g_gpu._normals);
+    glNormalPointer(GL_FLOAT, 0, nullptr);
+    glBindBuffer(GL_ARRAY_BUFFER, _g_gpu._colors);
+    glColorPointer(3, GL_FLOAT, 0, nullptr);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _g_gpu._indices);
+    glDrawElements(GL_TRIANGLES, _g_gpu._nb_indices, GL_UNSIGNED_INT, nullptr);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+#else
     glVertexPointer(3, GL_FLOAT, 0, mesh._vertices.data());
     glNormalPointer(GL_FLOAT, 0, mesh._normals.data());
     glColorPointer(3, GL_FLOAT, 0, mesh._colors.data());
     glDrawElements(GL_TRIANGLES, mesh._triangles.size()*3, GL_UNSIGNED_INT, mesh._triangles.data());
+#endif
 
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_NORMAL_ARRAY);
@@ -99,6 +333,39 @@ void draw_mesh(const Mesh& mesh) {
 
 // -----------------------------------------------------------------------------
 
+/// Boundary conditions as GL_POINTS (position and color interleaved in
+/// _g_ogl_points)
+void draw_points()
+{
+    const GLsizei stride = sizeof(_g_ogl_points[0]);
+    glPointSize(6.0f);
+    glPushMatrix();
+    glTranslatef(0.f, 0.f, 0.00001f); // put them slightly forward
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+#ifdef USE_VBO
+    // (uploaded by draw_mesh())
+    glBindBuffer(GL_ARRAY_BUFFER, _g_gpu._points);
+    glVertexPointer(3, GL_FLOAT, stride, nullptr);
+    glColorPointer(3, GL_FLOAT, stride, (const GLvoid*)sizeof(Vec3));
+    glDrawArrays(GL_POINTS, 0, _g_gpu._nb_points);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+#else
+    if( !_g_ogl_points.empty() ) {
+        glVertexPointer(3, GL_FLOAT, stride, &_g_ogl_points[0].first);
+        glColorPointer(3, GL_FLOAT, stride, &_g_ogl_points[0].second);
+        glDrawArrays(GL_POINTS, 0, GLsizei(_g_ogl_points.size()));
+    }
+#endif
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glPopMatrix();
+}
+
+// -----------------------------------------------------------------------------
+
+void start_harmonic_map();
+
 void key_stroke (unsigned char c, int /*mouseX*/, int /*mouseY*/) {
     static bool _wires  = false;
 
@@ -108,6 +375,21 @@ void key_stroke (unsigned char c, int /*mouseX*/, int /*mouseY*/) {
         glutDestroyWindow(_g_win_number);
         exit (0);
         break;
+    case 'b' :
+        // Switch boundary conditions: spec (when given), cone, strip
+        // the running solve is abandoned
+        if( _g_use_boundary_spec ) {
+            _g_use_boundary_spec = false;
+            _g_boundary_type = eCONE;
+        } else if( _g_boundary_type == eCONE ) {
+            _g_boundary_type = eSTRIP;
+        } else {
+            _g_use_boundary_spec = _g_boundary_spec != nullptr;
+            _g_boundary_type = eCONE;
+        }
+        start_harmonic_map();
+        glutPostRedisplay();
+        break;
     case 'w' :
         if(!_wires) {
             glPolygonMode (GL_FRONT_AND_BACK, GL_LINE);
@@ -126,12 +408,57 @@ void key_stroke (unsigned char c, int /*mouseX*/, int /*mouseY*/) {
 
 // -----------------------------------------------------------------------------
 
+bool pick_handle(int x, int y, bool single_vertex);
+void update_ogl_points();
+
 void mouse_keys (int button, int state, int x, int y)
 {
     if(button == GLUT_WHEEL_UP)
         _g_table_angle += 1.0f;
     if(button == GLUT_WHEEL_DOWN)
         _g_table_angle -= 1.0f;
+    if(button == GLUT_LEFT_BUTTON)
+    {
+        if(state == GLUT_DOWN) {
+            bool shift = (glutGetModifiers() & GLUT_ACTIVE_SHIFT) != 0;
+            _g_drag._active = pick_handle(x, y, shift);
+            _g_drag._last_y = y;
+        } else {
+            // Released: the handle is no longer highlighted
+            _g_drag._active = false;
+            _g_drag._slots.clear();
+        }
+        update_ogl_points();
+        glutPostRedisplay();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void start_resolve();
+
+/// Left button held: moving up raises the value of the picked handle
+void mouse_motion(int /*x*/, int y)
+{
+    if( !_g_drag._active )
+        return;
+    float value = _g_drag._value + float(_g_drag._last_y - y) * 0.004f;
+    value = std::min(std::max(value, 0.f), 1.f);
+    _g_drag._last_y = y;
+    if( value == _g_drag._value )
+        return;
+    _g_drag._value = value;
+    for(int slot : _g_drag._slots)
+        _g_boundaries[slot].second = value;
+    if( !_g_drag._changed ) {
+        _g_drag._changed = true;
+        _g_drag._oldest_change.start();
+    }
+    // One re-solve at a time, the last values are sent when it is over
+    if( !_g_resolve.valid() )
+        start_resolve();
+    update_ogl_points();
+    glutPostRedisplay();
 }
 
 // -----------------------------------------------------------------------------
@@ -158,8 +485,10 @@ void display(void)
         glRotatef(45.0f, -1.0f, 0.0f, 0.0f);
         glRotatef(_g_table_angle, -1.0f, 0.0f, 0.0f);
 
+        // The turntable stops while a handle is dragged
         static float angle = 0.0f;
-        angle = fmodf(angle+0.3f, 360.f);
+        if( !_g_drag._active )
+            angle = fmodf(angle+0.3f, 360.f);
         //glRotatef(angle, 1.0f, 0.0f, 0.0f);
         glRotatef(angle, 0.0f, 0.0f, 1.0f);
         glutPostRedisplay();
@@ -168,18 +497,11 @@ void display(void)
         glTranslatef(0.0, 0.0, -1.0);
     float s = 0.5f;
     glScalef(s, s, s);
+    glGetDoublev(GL_MODELVIEW_MATRIX, _g_modelview);
+    glGetDoublev(GL_PROJECTION_MATRIX, _g_projection);
+    glGetIntegerv(GL_VIEWPORT, _g_viewport);
     draw_mesh(*_g_mesh);
-
-
-    glPointSize(6.0f);
-    glBegin(GL_POINTS);
-    for(auto elt : _g_ogl_points){
-        Vec3 v = elt.first;
-        Vec3 c = elt.second;
-        glColor3f ( c.x, c.y, c.z);
-        glVertex3f( v.x, v.y, v.z+0.00001f /*put it slightly forward*/ );
-    }
-    glEnd();
+    draw_points();
 
     glutSwapBuffers();
     glFlush ();
@@ -222,184 +544,279 @@ float level_curves_greyscale(float f, float scale = 1.)
 
 // -----------------------------------------------------------------------------
 
-void set_strip_boundaries(std::vector<std::pair<Vert_idx, float> >& boundaries,
-                          const Mesh& mesh,
-                          float length = 0.1f)
-{
-    /*
-     *  Our sample models coordinates should roughly lie between [-1, 1]
-     *  We are going to select a thin strip of vertices on the top and bottom
-     *  of the model:
-
-        -----------------------▲  ▲ (1)
-            ___                   |
-           //_\\_                 |
-         ."\\    ".  ----------▼  |
-        /          \              |
-        |           \_            |
-        |       ,--.-.)           |
-        \     /  o \o\            + (0)
-        /\/\  \    /_/            |
-         (_.   `--'__)            |
-          |     .-'  \            |
-          |  .-'.     )           |
-          | (  _/--.-'            |
-          |  `.___.' ----------▲  |
-                (                 |
-                                  |
-        -----------------------▼  ▼ (-1)
-
-     *
-    */
-
-    boundaries.resize(mesh.nb_vertices());
-    int acc = 0;
-    for(int i = 0; i < mesh.nb_vertices(); ++i)
-    {
-        float dist = (mesh._vertices[i].y + 1.0f) * 0.5f;
-        if( dist < length) {
-            boundaries[acc++] = std::make_pair(i, dist);
-            _g_ogl_points.emplace_back( mesh._vertices[i], Vec3(1.0f, 0.0f, 0.0f) );
-        }
+// -----------------------------------------------------------------------------
 
-        if( dist > (1.0f-length) ) {
-            boundaries[acc++] = std::make_pair(i, dist);
-            _g_ogl_points.emplace_back( mesh._vertices[i], Vec3(0.0f, 1.0f, 0.0f) );
-        }
-    }
-    boundaries.resize( acc );
+/// Displace the rest positions along Z by the weights
+void deform_mesh(std::vector<Vec3>& vertices, const std::vector<double>& weight_map){
+    float s = 1.0f;
+    vertices.resize( _g_rest_vertices.size() );
+    parallel_for(0, int(vertices.size()), [&](int i) {
+        Vec3& v = vertices[i];
+        v = _g_rest_vertices[i];
+        v.z = v.z + float(weight_map[i]) * s;
+    });
 }
 
 // -----------------------------------------------------------------------------
 
-/*
-
-    Set boundary conditions to look like this:
-
-
-        0   0   0   0   0   0   0   0
-
-        0                           0
-                    1  1
-        0        1       1          0
-                1          1
-        0       1          1        0
-                 1        1
-        0           1  1            0
-
-        0                           0
-                                      ▲
-        0   0   0   0   0   0   0   0 | length
-                                 <--> ▼
-                                length
-
-    0s on all sides and 1s in the middle
-
-*/
-void set_cone_boundaries(std::vector<std::pair<Vert_idx, float> >& boundaries,
-                         const Mesh& mesh,
-                         float length = 0.01f)
+/// Set the colors and positions of the mesh from the weights, the vertices
+/// which changed since the last call are marked for the next upload
+void apply_harmonic_map(const std::vector<double>& weight_map)
 {
-    boundaries.resize(mesh.nb_vertices());
-    int acc = 0;
-    for(int i = 0; i < mesh.nb_vertices(); ++i)
+    Mesh& mesh = *_g_mesh;
+    const int nv = int(mesh.nb_vertices());
+    // A new solve changes every vertex, a dragged handle mostly the weights
+    // around it
+    static std::vector<Vert_idx> touched;
+    const bool all = _g_weights.size() != weight_map.size();
+    touched.clear();
+    if( !all ) {
+        for(int v = 0; v < nv; ++v)
+            if( _g_weights[v] != weight_map[v] )
+                touched.push_back( v );
+    }
+    _g_weights = weight_map;
+
+    auto shade = [&](int v) { mesh._colors[v] = (mesh._normals[v]+1.0f)*0.5f; };
+    auto heat = [&](int v) {
+        float x = weight_map[v];
+        mesh._colors[v] = heat_color(x) * level_curves_greyscale(x, 10.0f);
+    };
+    if( all )
     {
-        Vec3 pos = mesh._vertices[i];
-        float dist = (pos.y + 1.0f) * 0.5f;
-        // Set bottom strip
-        if( dist < length) {
-            boundaries[acc++] = std::make_pair(i, 0.0f);
-            _g_ogl_points.emplace_back( mesh._vertices[i], Vec3(0.0f, 1.0f, 0.0f) );
+        if(_g_3d_view)
+        {
+            // Displace vertices along Z axis
+            deform_mesh(mesh._vertices, weight_map);
+            _g_normals.compute( mesh );
+            parallel_for(0, nv, shade);
         }
-
-        // Set top strip
-        if( dist > (1.0f-length) ) {
-            boundaries[acc++] = std::make_pair(i, 0.0f);
-            _g_ogl_points.emplace_back( mesh._vertices[i], Vec3(0.0f, 1.0f, 0.0f) );
+        else
+        {
+            /// Set mesh color according to the computed weight map
+            parallel_for(0, nv, heat);
         }
-
-        dist = (pos.x + 1.0f) * 0.5f;
-        // set left strip
-        if( dist < length) {
-            boundaries[acc++] = std::make_pair(i, 0.0f);
-            _g_ogl_points.emplace_back( mesh._vertices[i], Vec3(0.0f, 1.0f, 0.0f) );
+        mark_mesh_dirty();
+    }
+    else if(_g_3d_view)
+    {
+        for(Vert_idx v : touched) {
+            mesh._vertices[v] = _g_rest_vertices[v];
+            mesh._vertices[v].z += float(weight_map[v]);
+            _g_gpu._dirty_positions.add(v, v + 1);
         }
-
-        // set right strip
-        if( dist > (1.0f-length) ) {
-            boundaries[acc++] = std::make_pair(i, 0.0f);
-            _g_ogl_points.emplace_back( mesh._vertices[i], Vec3(0.0f, 1.0f, 0.0f) );
+        // Normals (hence colors) change on the triangles around moved vertices
+        _g_normals.update(mesh, touched);
+        for(Vert_idx v : _g_normals.updated_vertices()) {
+            shade( v );
+            _g_gpu._dirty_normals.add(v, v + 1);
+            _g_gpu._dirty_colors.add(v, v + 1);
         }
-
-        // Set central values
-        dist = (pos.x*pos.x + pos.y*pos.y);
-        if( dist < length) {
-            boundaries[acc++] = std::make_pair(i, 1.0f);
-            _g_ogl_points.emplace_back( mesh._vertices[i], Vec3(1.0f, 0.0f, 0.0f) );
+    }
+    else
+    {
+        for(Vert_idx v : touched) {
+            heat( v );
+            _g_gpu._dirty_colors.add(v, v + 1);
         }
     }
-    boundaries.resize( acc );
 }
 
 // -----------------------------------------------------------------------------
 
-void deform_mesh(std::vector<Vec3>& vertices, const std::vector<double>& weight_map){
-    float s = 1.0f;
-    for (std::size_t i = 0; i < vertices.size(); ++i) {
-        Vec3& v = vertices[i];
-        v.z = v.z + float(weight_map[i]) * s;
+/// Positions (on the displaced mesh) and colors of the constrained vertices,
+/// the dragged handle in yellow
+void update_ogl_points()
+{
+    const Mesh& mesh = *_g_mesh;
+    std::vector<bool> picked(_g_boundaries.size(), false);
+    for(int slot : _g_drag._slots)
+        picked[slot] = true;
+    _g_ogl_points.resize( _g_boundaries.size() );
+    for(unsigned i = 0; i < _g_boundaries.size(); ++i) {
+        const std::pair<Vert_idx, float>& elt = _g_boundaries[i];
+        bool low = elt.second < 0.5f;
+        Vec3 color = (low == _g_low_in_red) ? Vec3(1.0f, 0.0f, 0.0f) : Vec3(0.0f, 1.0f, 0.0f);
+        if( picked[i] )
+            color = Vec3(1.0f, 1.0f, 0.0f);
+        _g_ogl_points[i] = std::make_pair(mesh._vertices[elt.first], color);
     }
+    _g_gpu._dirty_points = true;
 }
 
 // -----------------------------------------------------------------------------
 
-void compute_harmonic_map()
+/// Select the constrained vertex closest to the cursor (within a few pixels)
+/// and the ones of the same value, unless 'single_vertex'
+/// @return false if nothing can be dragged there (or the solve is running)
+bool pick_handle(int x, int y, bool single_vertex)
 {
-    _g_mesh = build_mesh(_g_sample_path);
-    Mesh& mesh = *_g_mesh;
+    _g_drag._slots.clear();
+    if( _g_system == nullptr || !_g_system->is_factorized() || _g_solve.valid() )
+        return false;
+
+    const double max_dist = 12.0; // pixels
+    double best = max_dist * max_dist;
+    int picked = -1;
+    double win_y = double(_g_viewport[3] - y);
+    for(unsigned i = 0; i < _g_ogl_points.size(); ++i) {
+        const Vec3& p = _g_ogl_points[i].first;
+        GLdouble px, py, pz;
+        if( !gluProject(p.x, p.y, p.z, _g_modelview, _g_projection, _g_viewport, &px, &py, &pz) )
+            continue;
+        double d = (px - x) * (px - x) + (py - win_y) * (py - win_y);
+        if( d < best ) {
+            best = d;
+            picked = int(i);
+        }
+    }
+    if( picked < 0 )
+        return false;
+
+    _g_drag._value = _g_boundaries[picked].second;
+    for(unsigned i = 0; i < _g_boundaries.size(); ++i)
+        if( int(i) == picked || (!single_vertex && _g_boundaries[i].second == _g_drag._value) )
+            _g_drag._slots.push_back( int(i) );
+    return true;
+}
 
-    // Compute first ring
-    Vertex_to_face v_to_face;
-    v_to_face.compute( mesh );
-    Vertex_to_1st_ring_vertices first_ring;
-    first_ring.compute(mesh, v_to_face );
+// -----------------------------------------------------------------------------
 
-    std::vector< std::vector<int> > edges = first_ring._rings_per_vertex;
+/// Solve again for the values of _g_boundaries with the retained
+/// factorization (right hand side and back substitution only)
+void start_resolve()
+{
+    _g_resolve = resolve_laplace_equation_async(_g_system, _g_boundaries);
+    _g_drag._request = _g_drag._oldest_change;
+    _g_drag._changed = false;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Set the boundary conditions and solve in the background
+/// (a solve still running is cancelled)
+void start_harmonic_map()
+{
+    if( _g_solve.valid() )
+        _g_solve.cancel();
+    if( _g_resolve.valid() )
+        _g_resolve.cancel();
+    _g_resolve = Solve_handle();
+    _g_drag = Drag_state();
+
+    // Back to the flat mesh
+    Mesh& mesh = *_g_mesh;
+    mesh._vertices = _g_rest_vertices;
+    _g_normals.compute( mesh );
+    mesh._colors.assign( mesh.nb_vertices(), Vec3(0.7f) );
+    mark_mesh_dirty();
+    _g_weights.clear();
 
     /// Define boundary conditions
     std::vector<std::pair<Vert_idx, float> > boundaries;
-    switch (_g_boundary_type) {
-    case eSTRIP: set_strip_boundaries(boundaries, mesh); break;
-    case eCONE:  set_cone_boundaries(boundaries, mesh);  break;
+    if( _g_use_boundary_spec && !set_boundaries(_g_boundary_spec, mesh, boundaries) )
+        _g_use_boundary_spec = false;
+    if( !_g_use_boundary_spec ) {
+        switch (_g_boundary_type) {
+        case eSTRIP: set_strip_boundaries(boundaries, mesh); break;
+        case eCONE:  set_cone_boundaries(boundaries, mesh);  break;
+        }
     }
+    // Display boundaries: strip bottom in red and top in green,
+    // cone sides in green and center in red, spec values below 0.5 in red
+    _g_low_in_red = _g_use_boundary_spec || _g_boundary_type == eSTRIP;
+    _g_boundaries = boundaries;
+    update_ogl_points();
+
+    // The factorization is kept for the re-solves of dragged handles
+    _g_system = std::make_shared<Retained_solve>();
+    Solve_input input;
+    input._retained = _g_system;
+    input._vertices = mesh._vertices;
+    if( _g_use_half_edges )
+        input._edges = _g_edges;
+    input._triangles = mesh._triangles;
+    input._boundaries.swap( boundaries );
+    _g_solve = solve_laplace_equation_async( std::move(input) );
+}
 
-    if( !_g_use_half_edges ){
-        edges.clear();
-    }
-    std::vector<double> weight_map( mesh.nb_vertices() );
-    solve_laplace_equation(mesh._vertices,
-                           edges,
-                           mesh._triangles,
-                           boundaries,
-                           weight_map);
-
-    if(_g_3d_view)
+// -----------------------------------------------------------------------------
+
+/// Timer callback: show the progress of the solve in the title of the window
+/// and display the weights once it is over
+void poll_solve(int /*value*/)
+{
+    static char title[128] = "";
+    char buff[128];
+    if( _g_solve.valid() )
     {
-        // Displace vertices along Z axis
-        deform_mesh(_g_mesh->_vertices, weight_map);
-        compute_normals(*_g_mesh);
-        for(unsigned v = 0; v < mesh.nb_vertices(); ++v)
-            mesh._colors[v] = (mesh._normals[v]+1.0f)*0.5f;
+        Solve_progress p = _g_solve.progress();
+        if( p._iterations > 0 )
+            snprintf(buff, sizeof(buff), "Solving: %s (%d iterations) %.1fs",
+                     solve_phase_name(p._phase), p._iterations, p._elapsed);
+        else
+            snprintf(buff, sizeof(buff), "Solving: %s %.1fs",
+                     solve_phase_name(p._phase), p._elapsed);
+
+        if( _g_solve.is_ready() ) {
+            const Solve_result& res = _g_solve.get();
+            if( res._ok ) {
+                apply_harmonic_map( res._weights );
+                update_ogl_points();
+            }
+            snprintf(buff, sizeof(buff), "Harmonic weights (%s in %.1fs)%s",
+                     res._ok ? "solved" : "solve failed", p._elapsed,
+                     res._ok ? " - drag the boundary points" : "");
+            _g_solve = Solve_handle();
+            glutPostRedisplay();
+        }
+        if( strcmp(buff, title) != 0 ) {
+            strcpy(title, buff);
+            glutSetWindowTitle( title );
+        }
     }
-    else
+
+    // Re-solve of a dragged handle: show the weights and the latency from
+    // the mouse motion to the display, then send the values changed meanwhile
+    if( _g_resolve.valid() && _g_resolve.is_ready() )
     {
-        /// Set mesh color according to the computed weight map
-        for(unsigned v = 0; v < mesh.nb_vertices(); ++v)
-        {
-            float x = weight_map[v];
-            mesh._colors[v] = heat_color(x) * level_curves_greyscale(x, 10.0f);
+        const Solve_result& res = _g_resolve.get();
+        if( res._ok ) {
+            apply_harmonic_map( res._weights );
+            update_ogl_points();
+            snprintf(title, sizeof(title), "Handle %.3f: %s re-solve %.1f ms, latency %.1f ms",
+                     _g_drag._value, _g_system->backend_name().c_str(),
+                     (res._timings._assembly + res._timings._solve) * 1000.0,
+                     _g_drag._request.elapsed() * 1000.0);
+            glutSetWindowTitle( title );
         }
+        _g_resolve = Solve_handle();
+        if( _g_drag._changed )
+            start_resolve();
+        glutPostRedisplay();
     }
+    // Poll faster while dragging: a re-solve is displayed within a frame
+    bool dragging = _g_drag._active || _g_resolve.valid();
+    glutTimerFunc(dragging ? 5 : 50, poll_solve, 0);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Load the mesh and start solving in the background: the window shows up
+/// right away and displays the weights when the solve is over
+void compute_harmonic_map()
+{
+    Cleanup_options cleanup;
+    Cleanup_report report;
+    // First ring from the cache or computed along with it
+    _g_mesh = build_mesh(_g_sample_path, _g_cleanup_mesh ? &cleanup : nullptr, &report, &_g_edges);
+    Mesh& mesh = *_g_mesh;
+    if( _g_cleanup_mesh )
+        report.print();
+    _g_rest_vertices = mesh._vertices;
+    _g_normals.init( mesh );
+
+    start_harmonic_map();
 }
 
 // -----------------------------------------------------------------------------
@@ -419,7 +836,9 @@ void setup_glut(int argc, char** argv)
 
     glutKeyboardFunc(key_stroke);
     glutMouseFunc(mouse_keys);
+    glutMotionFunc(mouse_motion);
     glutDisplayFunc(display);
+    glutTimerFunc(50, poll_solve, 0);
 }
 
 // -----------------------------------------------------------------------------
@@ -432,6 +851,10 @@ int main (int argc, char** argv)
 #else
     std::cout << "release" << std::endl;
 #endif
+    if( argc > 1 )
+        _g_boundary_spec = argv[1];
+    _g_use_boundary_spec = _g_boundary_spec != nullptr;
+    // Returns right away, the solve runs on a worker thread
     compute_harmonic_map();
     setup_glut(argc, argv);
     glutMainLoop();
@@ -0,0 +1,98 @@
+#include "mesh.hpp"
+
+#include "io/mesh_loader.hpp"
+#include "io/mesh_cache.hpp"
+#include "mesh_cleanup.hpp"
+#include "mesh_generators.hpp"
+#include "mesh_normals.hpp"
+#include "topology/csr_adjacency.hpp"
+#include "topology/vertex_to_face.hpp"
+#include "topology/vertex_to_1st_ring_vertices.hpp"
+#include "utils/trace.hpp"
+
+// -----------------------------------------------------------------------------
+
+Mesh* build_mesh(const char* file_name,
+                 const Cleanup_options* cleanup,
+                 Cleanup_report* report,
+                 std::vector< std::vector<int> >* rings)
+{
+    Trace_scope trace("build_mesh");
+    Mesh* ptr = new Mesh();
+    Mesh& mesh = *ptr;
+
+    Mesh_cache cache;
+    // Topology of a file loaded without cache, computed once for the cache
+    // the normals and 'rings'
+    Vertex_to_face v_to_face;
+    Vertex_to_1st_ring_vertices first_ring;
+    if( is_generator_spec(file_name) )
+    {
+        Trace_scope trace_gen("generate_mesh");
+        if( !generate_mesh(file_name, mesh) ) {
+            delete ptr;
+            return nullptr;
+        }
+    }
+    else if( is_mesh_cache_enabled() && cache.open(file_name) )
+    {
+        Trace_scope trace_cache("read_mesh_cache");
+        cache.fill(mesh);
+    }
+    else
+    {
+        {
+            Trace_scope trace_load("load_mesh");
+            if( !load_mesh(file_name, mesh) ) {
+                delete ptr;
+                return nullptr;
+            }
+        }
+
+        if( is_mesh_cache_enabled() ) {
+            {
+                Trace_scope trace_topology("topology");
+                v_to_face.compute( mesh );
+                first_ring.compute(mesh, v_to_face);
+            }
+            Trace_scope trace_cache("write_mesh_cache");
+            if( !write_mesh_cache(file_name, mesh, Mesh_cache::eDEFAULT, &v_to_face, &first_ring) )
+                std::cerr << "Can't write mesh cache: " << mesh_cache_path(file_name) << std::endl;
+        }
+    }
+
+    if( cleanup != nullptr ) {
+        Trace_scope trace_cleanup("cleanup_mesh");
+        Cleanup_report tmp;
+        cleanup_mesh(mesh, *cleanup, report != nullptr ? *report : tmp);
+    }
+
+    mesh._colors.assign( mesh.nb_vertices(), Vec3(0.0f));
+    // The vertex to face lists of the cache are used in place (still
+    // mapped) or the ones just computed, unless the cleanup changed the
+    // triangles
+    const bool raw_topology = cleanup == nullptr && !v_to_face._1st_ring_tris.empty();
+    if( cleanup == nullptr && cache.nb_vertices() > 0 && !cache.vertex_to_face().empty() ) {
+        compute_normals(mesh, cache.vertex_to_face());
+    } else if( raw_topology ) {
+        Csr_adjacency adjacency;
+        adjacency.compute( v_to_face._1st_ring_tris );
+        compute_normals(mesh, adjacency.view());
+    } else {
+        compute_normals(mesh);
+    }
+
+    if( rings != nullptr )
+    {
+        Trace_scope trace_topology("topology");
+        if( raw_topology ) {
+            rings->swap( first_ring._rings_per_vertex );
+        } else if( cleanup != nullptr || cache.nb_vertices() == 0 || !cache.fill(*rings) ) {
+            // The cache holds the topology of the mesh before cleanup
+            v_to_face.compute( mesh );
+            first_ring.compute(mesh, v_to_face);
+            rings->swap( first_ring._rings_per_vertex );
+        }
+    }
+    return ptr;
+}
@@ -1,12 +1,12 @@
 #ifndef MESH_HPP
 #define MESH_HPP
 
-#include <fstream>
 #include <iostream>
 #include <vector>
 #include <cassert>
 
 #include "vec3.hpp"
+#include "utils/memory_usage.hpp"
 
 // -----------------------------------------------------------------------------
 
@@ -45,80 +45,32 @@ struct Mesh {
     std::vector<Tri_face> _triangles;
     unsigned nb_vertices() const { return  _vertices.size(); }
     unsigned nb_triangles() const { return  _triangles.size(); }
-};
-
-// -----------------------------------------------------------------------------
-
-// Recompute 'mesh._normals'
-static void compute_normals(Mesh& mesh)
-{
-    unsigned nb_vertices = 0;
-    mesh._normals.assign( nb_vertices, Vec3(0.0f));
-    for(unsigned i = 0; i < mesh._triangles.size(); i++ ) {
-        const Tri_face& tri = mesh._triangles[i];
-        // Compute normals:
-        Vec3 v1 = mesh._vertices[tri.b] - mesh._vertices[tri.a];
-        Vec3 v2 = mesh._vertices[tri.c] - mesh._vertices[tri.a];
-
-        Vec3 n = v1.cross( v2 );
-        n.normalize();
-
-        mesh._normals[ tri.a ] += n;
-        mesh._normals[ tri.b ] += n;
-        mesh._normals[ tri.c ] += n;
+    /// Bytes allocated by the arrays
+    size_t memory_bytes() const {
+        return heap_bytes(_vertices) + heap_bytes(_normals) +
+               heap_bytes(_colors) + heap_bytes(_triangles);
     }
-}
+};
 
 // -----------------------------------------------------------------------------
 
-/// @brief Load mesh from an OFF file
-static Mesh* build_mesh(const char* file_name)
-{
-    Mesh* ptr = new Mesh();
-    Mesh& mesh = *ptr;
-
-    std::ifstream file( file_name );
-
-    if( !file.is_open() ){
-        std::cerr << "Can't open file: " << file_name << std::endl;
-        return nullptr;
-    }
-
-    std::string format;
-    unsigned nb_vertices = 0;
-    unsigned nb_faces = 0;
-    int nil;
-
-    file >> format;
-    file >> nb_vertices >> nb_faces >> nil;
-
-    mesh._vertices.resize( nb_vertices );
-    for (unsigned i=0; i < nb_vertices; i++ ){
-        Vec3 p;
-        file >> p.x >> p.y >> p.z;
-        mesh._vertices[i] = p;
-    }
-
-    mesh._triangles.resize( nb_faces );
-    mesh._colors.assign( nb_vertices, Vec3(0.0f));
-
-    mesh._normals.assign( nb_vertices, Vec3(0.0f));
-    for(unsigned i = 0; i < nb_faces; i++ )
-    {
-        int nb_verts_face;
-        file >> nb_verts_face;
-
-        if(nb_verts_face != 3) {
-            std::cerr << "We only handle triangle faces" << std::endl;
-            continue;
-        }
-
-        Tri_face& tri = mesh._triangles[i];
-        file >> tri.a >> tri.b >> tri.c;
-    }
-    compute_normals(mesh);
-    file.close();
-    return ptr;
-}
+struct Cleanup_options;
+struct Cleanup_report;
+
+/// @brief Load mesh from an OFF, PLY or OBJ file
+/// (memory mapped and parsed in parallel see load_mesh())
+/// or generate it when 'file_name' starts with "gen:" (see generate_mesh())
+/// @param cleanup : when not null, weld vertices and remove degenerate
+/// triangles after loading (see cleanup_mesh()). The topology stored in the
+/// mesh cache is then the one of the raw file, don't use it.
+/// @param[out] report : what the cleanup did (optional)
+/// @param[out] rings : when not null, set to the ordered first ring of each
+/// vertex (Vertex_to_1st_ring_vertices::_rings_per_vertex): read from the
+/// mesh cache, or computed once for both the new cache and the caller
+/// @return nullptr on error
+Mesh* build_mesh(const char* file_name,
+                 const Cleanup_options* cleanup = nullptr,
+                 Cleanup_report* report = nullptr,
+                 std::vector< std::vector<int> >* rings = nullptr);
 
 #endif // MESH_HPP
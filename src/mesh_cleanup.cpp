@@ -0,0 +1,303 @@
+#include "mesh_cleanup.hpp"
+
+#include <array>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "utils/parallel_for.hpp"
+
+// -----------------------------------------------------------------------------
+
+/// Hash of integer cell coordinates. Collisions only cost extra distance
+/// tests: lookups compute keys the same way as insertions.
+static uint64_t cell_key(int64_t x, int64_t y, int64_t z)
+{
+    uint64_t h = uint64_t(x) * 0x9E3779B97F4A7C15ull;
+    h ^= uint64_t(y) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+    h ^= uint64_t(z) * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+    return h;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Bit pattern of 'f' (-0 and +0 are the same)
+static int64_t float_bits(float f)
+{
+    f += 0.0f;
+    int32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Root of 'v' with path halving
+static int find_root(std::atomic<int>* parent, int v)
+{
+    while( true ) {
+        int p = parent[v].load(std::memory_order_relaxed);
+        if( p == v )
+            return v;
+        int gp = parent[p].load(std::memory_order_relaxed);
+        parent[v].compare_exchange_weak(p, gp, std::memory_order_relaxed);
+        v = gp;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+/// Merge the sets of 'a' and 'b'. Roots are always linked to a smaller index
+/// which rules out cycles and makes the root the smallest index of the set.
+static void unite(std::atomic<int>* parent, int a, int b)
+{
+    while( true ) {
+        a = find_root(parent, a);
+        b = find_root(parent, b);
+        if( a == b )
+            return;
+        if( a < b )
+            std::swap(a, b);
+        int expected = a;
+        if( parent[a].compare_exchange_strong(expected, b) )
+            return;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+/// @param[out] rep : representative (smallest index) of the group of each vertex
+/// @return number of vertices merged into another one
+static int weld_vertices(const std::vector<Vec3>& vertices,
+                         float tolerance,
+                         std::vector<Vert_idx>& rep)
+{
+    const int nv = int(vertices.size());
+    const bool exact = tolerance <= 0.f;
+    const float tol2 = tolerance * tolerance;
+    const int range = exact ? 0 : 1;
+
+    Vec3 lower = nv > 0 ? vertices[0] : Vec3(0.f);
+    for(const Vec3& v : vertices)
+        for(int k = 0; k < 3; ++k)
+            lower[k] = std::min(lower[k], v[k]);
+
+    // Integer cell coordinates of a vertex
+    auto cell_of = [&](const Vec3& p, int64_t* cell) {
+        for(int k = 0; k < 3; ++k)
+            cell[k] = exact ? float_bits(p[k]) : int64_t( std::floor((p[k] - lower[k]) / tolerance) );
+    };
+
+    // Spatial hash: vertices sorted by cell key, then an open addressing
+    // table maps each key to its range of vertices
+    std::vector< std::pair<uint64_t, int> > keys( nv );
+    parallel_for(0, nv, [&](int i) {
+        int64_t c[3];
+        cell_of(vertices[i], c);
+        keys[i] = std::make_pair(cell_key(c[0], c[1], c[2]), i);
+    });
+    std::sort(keys.begin(), keys.end());
+
+    struct Bucket { uint64_t _key; int _begin; int _end; };
+    size_t table_size = 16;
+    while( table_size < size_t(nv) * 2 )
+        table_size *= 2;
+    const size_t mask = table_size - 1;
+    std::vector<Bucket> table( table_size, Bucket{0, 0, 0} );
+    for(int b = 0; b < nv; )
+    {
+        int e = b + 1;
+        while( e < nv && keys[e].first == keys[b].first )
+            ++e;
+        size_t slot = size_t(keys[b].first) & mask;
+        while( table[slot]._end != 0 )
+            slot = (slot + 1) & mask;
+        table[slot] = Bucket{keys[b].first, b, e};
+        b = e;
+    }
+
+    std::unique_ptr<std::atomic<int>[]> parent( new std::atomic<int>[nv] );
+    parallel_for(0, nv, [&](int i) { parent[i].store(i, std::memory_order_relaxed); });
+
+    parallel_for(0, nv, [&](int i) {
+        const Vec3& p = vertices[i];
+        int64_t c[3];
+        cell_of(p, c);
+        for(int dx = -range; dx <= range; ++dx)
+        for(int dy = -range; dy <= range; ++dy)
+        for(int dz = -range; dz <= range; ++dz)
+        {
+            uint64_t key = cell_key(c[0] + dx, c[1] + dy, c[2] + dz);
+            size_t slot = size_t(key) & mask;
+            while( table[slot]._end != 0 && table[slot]._key != key )
+                slot = (slot + 1) & mask;
+
+            for(int k = table[slot]._begin; k < table[slot]._end; ++k)
+            {
+                int j = keys[k].second;
+                // Each pair is tested once, from its largest index
+                if( j >= i )
+                    continue;
+                bool close = exact ? (vertices[j] == p) : (vertices[j] - p).norm_squared() <= tol2;
+                if( close )
+                    unite(parent.get(), i, j);
+            }
+        }
+    });
+
+    rep.resize( nv );
+    std::atomic<int> nb_welded(0);
+    parallel_for(0, nv, [&](int i) {
+        rep[i] = find_root(parent.get(), i);
+        if( rep[i] != i )
+            nb_welded.fetch_add(1, std::memory_order_relaxed);
+    });
+    return nb_welded;
+}
+
+// -----------------------------------------------------------------------------
+
+static bool is_degenerate(const Tri_face& tri,
+                          const std::vector<Vec3>& vertices,
+                          float ratio)
+{
+    if( tri.a == tri.b || tri.b == tri.c || tri.c == tri.a )
+        return true;
+    const Vec3& a = vertices[tri.a];
+    const Vec3& b = vertices[tri.b];
+    const Vec3& c = vertices[tri.c];
+    float longest = std::max((b - a).norm_squared(),
+                             std::max((c - b).norm_squared(), (a - c).norm_squared()));
+    float twice_area = (b - a).cross(c - a).norm();
+    return twice_area <= ratio * longest;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Compact per vertex attributes 'attr' if they are defined
+static void compact(std::vector<Vec3>& attr, const std::vector<Vert_idx>& new_to_old, int nb_old)
+{
+    if( int(attr.size()) != nb_old )
+        return;
+    std::vector<Vec3> tmp( new_to_old.size() );
+    parallel_for(0, int(new_to_old.size()), [&](int i) { tmp[i] = attr[ new_to_old[i] ]; });
+    attr.swap( tmp );
+}
+
+// =============================================================================
+
+void Cleanup_report::print() const
+{
+    std::cout << "Mesh cleanup: removed " << nb_removed_vertices() << " vertices (";
+    std::cout << _nb_welded_vertices << " welded, " << _nb_unreferenced_vertices << " unreferenced) and ";
+    std::cout << nb_removed_triangles() << " triangles (" << _nb_degenerate_triangles << " degenerate, ";
+    std::cout << _nb_duplicate_triangles << " duplicates)" << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+
+void cleanup_mesh(Mesh& mesh,
+                  const Cleanup_options& options,
+                  Cleanup_report& report)
+{
+    const int nv = int(mesh.nb_vertices());
+    const int nt = int(mesh.nb_triangles());
+    report._nb_welded_vertices = 0;
+    report._nb_unreferenced_vertices = 0;
+    report._nb_degenerate_triangles = 0;
+    report._nb_duplicate_triangles = 0;
+
+    // Weld
+    std::vector<Vert_idx> rep;
+    if( options._weld_tolerance >= 0.f && nv > 0 )
+    {
+        Vec3 lower = mesh._vertices[0], upper = mesh._vertices[0];
+        for(const Vec3& v : mesh._vertices)
+            for(int k = 0; k < 3; ++k) {
+                lower[k] = std::min(lower[k], v[k]);
+                upper[k] = std::max(upper[k], v[k]);
+            }
+        float tolerance = options._weld_tolerance * (upper - lower).norm();
+        report._nb_welded_vertices = weld_vertices(mesh._vertices, tolerance, rep);
+    }
+    else
+    {
+        rep.resize( nv );
+        for(int i = 0; i < nv; ++i)
+            rep[i] = i;
+    }
+
+    // Remap triangles and flag the ones to remove
+    std::vector<char> keep( nt );
+    parallel_for(0, nt, [&](int t) {
+        Tri_face& tri = mesh._triangles[t];
+        for(int k = 0; k < 3; ++k)
+            tri[k] = rep[ tri[k] ];
+        keep[t] = !is_degenerate(tri, mesh._vertices, options._degenerate_ratio);
+    });
+    for(int t = 0; t < nt; ++t)
+        report._nb_degenerate_triangles += keep[t] ? 0 : 1;
+
+    if( options._remove_duplicates )
+    {
+        // Sort triangles by their sorted vertex indices, keep the first one
+        std::vector< std::pair<std::array<Vert_idx, 3>, Tri_idx> > sorted( nt );
+        parallel_for(0, nt, [&](int t) {
+            const Tri_face& tri = mesh._triangles[t];
+            std::array<Vert_idx, 3> k = {{tri.a, tri.b, tri.c}};
+            std::sort(k.begin(), k.end());
+            sorted[t] = std::make_pair(k, t);
+        });
+        std::sort(sorted.begin(), sorted.end());
+        for(int i = 1; i < nt; ++i) {
+            Tri_idx t = sorted[i].second;
+            if( keep[t] && sorted[i].first == sorted[i-1].first ) {
+                keep[t] = false;
+                ++report._nb_duplicate_triangles;
+            }
+        }
+    }
+
+    int acc = 0;
+    for(int t = 0; t < nt; ++t)
+        if( keep[t] )
+            mesh._triangles[acc++] = mesh._triangles[t];
+    mesh._triangles.resize( acc );
+
+    // Kept vertices: representatives, used by a triangle if requested
+    std::vector<char> used( nv, 0 );
+    if( options._remove_unreferenced ) {
+        for(const Tri_face& tri : mesh._triangles)
+            used[tri.a] = used[tri.b] = used[tri.c] = 1;
+    } else {
+        for(int i = 0; i < nv; ++i)
+            used[ rep[i] ] = 1;
+    }
+
+    std::vector<Vert_idx> new_idx( nv, -1 );
+    report._new_to_old.clear();
+    for(int i = 0; i < nv; ++i) {
+        if( used[i] ) {
+            new_idx[i] = int(report._new_to_old.size());
+            report._new_to_old.push_back( i );
+        } else if( rep[i] == i ) {
+            ++report._nb_unreferenced_vertices;
+        }
+    }
+
+    report._old_to_new.resize( nv );
+    parallel_for(0, nv, [&](int i) { report._old_to_new[i] = new_idx[ rep[i] ]; });
+    parallel_for(0, int(mesh._triangles.size()), [&](int t) {
+        Tri_face& tri = mesh._triangles[t];
+        for(int k = 0; k < 3; ++k)
+            tri[k] = new_idx[ tri[k] ];
+    });
+
+    compact(mesh._vertices, report._new_to_old, nv);
+    compact(mesh._normals , report._new_to_old, nv);
+    compact(mesh._colors  , report._new_to_old, nv);
+}
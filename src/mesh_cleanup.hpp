@@ -0,0 +1,95 @@
+#ifndef MESH_CLEANUP_HPP
+#define MESH_CLEANUP_HPP
+
+#include <vector>
+#include "mesh.hpp"
+
+/// @brief Parameters of cleanup_mesh()
+struct Cleanup_options {
+    Cleanup_options()
+        : _weld_tolerance(1e-6f)
+        , _degenerate_ratio(1e-6f)
+        , _remove_duplicates(true)
+        , _remove_unreferenced(true)
+    { }
+
+    /// Vertices closer than this distance are merged, relative to the
+    /// diagonal of the bounding box of the mesh.
+    /// 0 only merges vertices with the exact same position, a negative value
+    /// disables welding.
+    float _weld_tolerance;
+
+    /// A triangle is degenerate when twice its area is below
+    /// _degenerate_ratio * (longest edge)^2 (i.e. its smallest angle is
+    /// roughly below _degenerate_ratio radians). Those produce exploding
+    /// cotangent weights. Triangles with two identical vertices are always
+    /// removed.
+    float _degenerate_ratio;
+
+    /// Remove triangles with the same vertices as a previous one
+    /// (regardless of orientation)
+    bool _remove_duplicates;
+
+    /// Remove vertices not referenced by any triangle (they would
+    /// make the Laplacian singular)
+    bool _remove_unreferenced;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @brief What cleanup_mesh() did
+struct Cleanup_report {
+    int _nb_welded_vertices;       ///< merged into another vertex
+    int _nb_unreferenced_vertices; ///< removed because no triangle uses them
+    int _nb_degenerate_triangles;
+    int _nb_duplicate_triangles;
+
+    /// _old_to_new[original vertex index] = index in the cleaned mesh
+    /// (-1 if the vertex was removed)
+    std::vector<Vert_idx> _old_to_new;
+    /// _new_to_old[cleaned vertex index] = original index of the vertex kept
+    std::vector<Vert_idx> _new_to_old;
+
+    int nb_removed_vertices() const { return _nb_welded_vertices + _nb_unreferenced_vertices; }
+    int nb_removed_triangles() const { return _nb_degenerate_triangles + _nb_duplicate_triangles; }
+
+    /// Print a one line summary on std::cout
+    void print() const;
+};
+
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Weld coincident vertices, remove degenerate and duplicate triangles
+ * as well as unreferenced vertices.
+ *
+ * Welding goes through a spatial hash: vertices are sorted by the key of
+ * the cell (of size the tolerance) holding them, then each vertex looks for
+ * close vertices in the 27 neighbor cells in parallel and merges with them
+ * through a lock free union find. Merged vertices take the position of the
+ * vertex of smallest index in their group so the result does not depend on
+ * thread scheduling.
+ *
+ * Vertex and triangle order is preserved otherwise. Per vertex attributes
+ * (normals, colors) are compacted along.
+ */
+void cleanup_mesh(Mesh& mesh,
+                  const Cleanup_options& options,
+                  Cleanup_report& report);
+
+/// Map per vertex values of the cleaned mesh back to the original vertices
+/// (e.g. output harmonic weights). Removed vertices get 'default_value'.
+template<typename T>
+void to_original_vertices(const Cleanup_report& report,
+                          const std::vector<T>& values,
+                          std::vector<T>& original_values,
+                          const T& default_value = T())
+{
+    original_values.resize( report._old_to_new.size() );
+    for(unsigned i = 0; i < report._old_to_new.size(); ++i) {
+        Vert_idx v = report._old_to_new[i];
+        original_values[i] = v < 0 ? default_value : values[v];
+    }
+}
+
+#endif // MESH_CLEANUP_HPP
@@ -0,0 +1,487 @@
+#include "mesh_generators.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "utils/parallel_for.hpp"
+
+#ifndef M_PI
+    #define M_PI 3.14159265358979323846
+#endif
+
+// -----------------------------------------------------------------------------
+
+/// @return a random number in [0 1) from a seed and an index (splitmix64).
+/// Stateless so that threads don't need to share a generator.
+static float random_unit(unsigned seed, uint64_t idx)
+{
+    uint64_t z = (uint64_t(seed) << 32) ^ (idx + 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z = z ^ (z >> 31);
+    // 24 bits: exactly representable by a float
+    return float(z >> 40) * (1.f / 16777216.f);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Stream compaction over large arrays: counts per block in parallel,
+/// prefix sum of the counts, then each block writes its new indices.
+/// @param[out] new_idx : rank of 'i' among kept elements, -1 if removed
+/// @return number of kept elements
+static int compact_indices(const std::vector<char>& keep, std::vector<int>& new_idx)
+{
+    const int n = int(keep.size());
+    const int block = 1 << 16;
+    const int nb_blocks = (n + block - 1) / block;
+    std::vector<int> offsets( nb_blocks + 1, 0 );
+    parallel_for_chunks(nb_blocks, [&](int b) {
+        int count = 0;
+        for(int i = b * block; i < std::min(n, (b + 1) * block); ++i)
+            count += keep[i] ? 1 : 0;
+        offsets[b + 1] = count;
+    });
+    for(int b = 0; b < nb_blocks; ++b)
+        offsets[b + 1] += offsets[b];
+
+    new_idx.resize( n );
+    parallel_for_chunks(nb_blocks, [&](int b) {
+        int acc = offsets[b];
+        for(int i = b * block; i < std::min(n, (b + 1) * block); ++i)
+            new_idx[i] = keep[i] ? acc++ : -1;
+    });
+    return offsets[nb_blocks];
+}
+
+// =============================================================================
+// Planes
+// =============================================================================
+
+void generate_grid(int nb_x, int nb_y, Mesh& mesh)
+{
+    generate_jittered_grid(nb_x, nb_y, 0.f, 0, mesh);
+}
+
+// -----------------------------------------------------------------------------
+
+void generate_jittered_grid(int nb_x, int nb_y, float jitter, unsigned seed, Mesh& mesh)
+{
+    nb_x = std::max(nb_x, 2);
+    nb_y = std::max(nb_y, 2);
+    mesh._vertices.resize( size_t(nb_x) * nb_y );
+    mesh._triangles.resize( size_t(nb_x - 1) * (nb_y - 1) * 2 );
+
+    const float dx = 2.f / float(nb_x - 1);
+    const float dy = 2.f / float(nb_y - 1);
+    parallel_for(0, nb_y, [&](int j) {
+        float y = -1.f + dy * float(j);
+        bool border_y = j == 0 || j == nb_y - 1;
+        for(int i = 0; i < nb_x; ++i)
+        {
+            Vert_idx v = j * nb_x + i;
+            Vec3 p(-1.f + dx * float(i), y, 0.f);
+            if( jitter > 0.f ) {
+                // Border vertices only slide along the border
+                bool border_x = i == 0 || i == nb_x - 1;
+                if( !border_x ) p.x += (random_unit(seed, 2 * uint64_t(v)    ) - 0.5f) * jitter * dx;
+                if( !border_y ) p.y += (random_unit(seed, 2 * uint64_t(v) + 1) - 0.5f) * jitter * dy;
+            }
+            mesh._vertices[v] = p;
+        }
+    }, 16);
+
+    parallel_for(0, nb_y - 1, [&](int j) {
+        Tri_face* tri = mesh._triangles.data() + size_t(j) * (nb_x - 1) * 2;
+        for(int i = 0; i < nb_x - 1; ++i)
+        {
+            Vert_idx v00 = j * nb_x + i;
+            Vert_idx v10 = v00 + 1;
+            Vert_idx v01 = v00 + nb_x;
+            Vert_idx v11 = v01 + 1;
+            tri->a = v00; tri->b = v10; tri->c = v11; ++tri;
+            tri->a = v00; tri->b = v11; tri->c = v01; ++tri;
+        }
+    }, 16);
+}
+
+// -----------------------------------------------------------------------------
+
+void generate_perforated_plane(int nb_x, int nb_y,
+                               int nb_holes, float hole_radius,
+                               unsigned seed, Mesh& mesh)
+{
+    generate_grid(nb_x, nb_y, mesh);
+
+    // Disc centers, far enough from the border
+    hole_radius = std::max(0.f, std::min(hole_radius, 0.8f));
+    const float extent = 0.8f - hole_radius;
+    std::vector<Vec3> centers( std::max(nb_holes, 0) );
+    for(unsigned h = 0; h < centers.size(); ++h) {
+        centers[h].x = (random_unit(seed, 2 * h    ) * 2.f - 1.f) * extent;
+        centers[h].y = (random_unit(seed, 2 * h + 1) * 2.f - 1.f) * extent;
+    }
+
+    // Remove triangles with a vertex inside a disc
+    const int nv = int(mesh.nb_vertices());
+    const int nt = int(mesh.nb_triangles());
+    const float r2 = hole_radius * hole_radius;
+    std::vector<char> outside( nv );
+    parallel_for(0, nv, [&](int v) {
+        bool out = true;
+        for(const Vec3& c : centers)
+            out = out && (mesh._vertices[v] - c).norm_squared() >= r2;
+        outside[v] = out;
+    });
+    std::vector<char> keep_tri( nt );
+    parallel_for(0, nt, [&](int t) {
+        const Tri_face& tri = mesh._triangles[t];
+        keep_tri[t] = outside[tri.a] && outside[tri.b] && outside[tri.c];
+    });
+
+    // Then vertices left without triangles (e.g. between two close discs).
+    // Triangles around vertex (i, j) are found from the grid layout:
+    // quad (qi, qj) holds triangles (v00, v10, v11) and (v00, v11, v01)
+    nb_x = std::max(nb_x, 2);
+    nb_y = std::max(nb_y, 2);
+    auto kept = [&](int qi, int qj, int k) {
+        return qi >= 0 && qj >= 0 && qi < nb_x - 1 && qj < nb_y - 1 &&
+               keep_tri[ (size_t(qj) * (nb_x - 1) + qi) * 2 + k ];
+    };
+    std::vector<char> keep_vert( nv );
+    parallel_for(0, nv, [&](int v) {
+        int i = v % nb_x;
+        int j = v / nb_x;
+        keep_vert[v] = kept(i    , j    , 0) || kept(i    , j    , 1) || // v00
+                       kept(i - 1, j    , 0) ||                          // v10
+                       kept(i - 1, j - 1, 0) || kept(i - 1, j - 1, 1) || // v11
+                       kept(i    , j - 1, 1);                            // v01
+    });
+
+    std::vector<int> new_vert, new_tri;
+    int nb_verts = compact_indices(keep_vert, new_vert);
+    int nb_tris = compact_indices(keep_tri, new_tri);
+
+    std::vector<Vec3> vertices( nb_verts );
+    parallel_for(0, nv, [&](int v) {
+        if( new_vert[v] >= 0 )
+            vertices[ new_vert[v] ] = mesh._vertices[v];
+    });
+    std::vector<Tri_face> triangles( nb_tris );
+    parallel_for(0, nt, [&](int t) {
+        if( new_tri[t] < 0 )
+            return;
+        Tri_face& tri = triangles[ new_tri[t] ];
+        for(int k = 0; k < 3; ++k)
+            tri[k] = new_vert[ mesh._triangles[t][k] ];
+    });
+    mesh._vertices.swap( vertices );
+    mesh._triangles.swap( triangles );
+}
+
+// =============================================================================
+// Closed surfaces
+// =============================================================================
+
+namespace {
+
+/**
+ * @brief Vertex numbering of the subdivided icosahedron:
+ * 12 corners, then the (frequency - 1) inner vertices of each of the 30
+ * edges, then the inner vertices of each of the 20 faces.
+ * A point of a face is given by its coordinates (i, j) along its first two
+ * edges: A + i/n (B - A) + j/n (C - A) with i + j <= n.
+ */
+struct Icosahedron {
+    static const int s_faces[20][3];
+
+    Icosahedron(int frequency) : _n(frequency) {
+        const float t = (1.f + std::sqrt(5.f)) * 0.5f;
+        const float c[12][3] = {
+            {-1,  t,  0}, { 1,  t,  0}, {-1, -t,  0}, { 1, -t,  0},
+            { 0, -1,  t}, { 0,  1,  t}, { 0, -1, -t}, { 0,  1, -t},
+            { t,  0, -1}, { t,  0,  1}, {-t,  0, -1}, {-t,  0,  1}
+        };
+        for(int i = 0; i < 12; ++i)
+            _corners[i] = Vec3(c[i][0], c[i][1], c[i][2]);
+        int nb = 0;
+        for(int f = 0; f < 20; ++f)
+            for(int k = 0; k < 3; ++k) {
+                int a = std::min(s_faces[f][k], s_faces[f][(k + 1) % 3]);
+                int b = std::max(s_faces[f][k], s_faces[f][(k + 1) % 3]);
+                if( edge(a, b) < 0 ) {
+                    _edges[nb][0] = a;
+                    _edges[nb][1] = b;
+                    ++nb;
+                }
+            }
+    }
+
+    /// @return index in _edges of the edge (a, b) with a < b, -1 if unknown
+    int edge(int a, int b) const {
+        for(int e = 0; e < 30; ++e)
+            if( _edges[e][0] == a && _edges[e][1] == b )
+                return e;
+        return -1;
+    }
+
+    int nb_vertices() const { return 10 * _n * _n + 2; }
+    int nb_edge_vertices() const { return _n - 1; }
+    int nb_face_vertices() const { return (_n - 1) * (_n - 2) / 2; }
+
+    /// Vertex 't' steps from corner 'u' to corner 'v'
+    Vert_idx edge_vertex(int u, int v, int t) const {
+        if( t == 0 ) return u;
+        if( t == _n ) return v;
+        int e = edge(std::min(u, v), std::max(u, v));
+        int param = u < v ? t : _n - t;
+        return 12 + e * nb_edge_vertices() + param - 1;
+    }
+
+    /// Vertex (i, j) of face 'f'
+    Vert_idx face_vertex(int f, int i, int j) const {
+        const int* c = s_faces[f];
+        if( j == 0 )
+            return edge_vertex(c[0], c[1], i);
+        if( i == 0 )
+            return edge_vertex(c[0], c[2], j);
+        if( i + j == _n )
+            return edge_vertex(c[1], c[2], j);
+        // Inner vertices by rows of constant j
+        int row = (j - 1) * (_n - 1) - (j - 1) * j / 2;
+        return 12 + 30 * nb_edge_vertices() + f * nb_face_vertices() + row + i - 1;
+    }
+
+    int _n;
+    Vec3 _corners[12];
+    int _edges[30][2];
+};
+
+// Counter clockwise seen from outside
+const int Icosahedron::s_faces[20][3] = {
+    {0, 11, 5}, {0, 5, 1}, {0, 1, 7}, {0, 7, 10}, {0, 10, 11},
+    {1, 5, 9}, {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+    {3, 9, 4}, {3, 4, 2}, {3, 2, 6}, {3, 6, 8}, {3, 8, 9},
+    {4, 9, 5}, {2, 4, 11}, {6, 2, 10}, {8, 6, 7}, {9, 8, 1}
+};
+
+} // END anonymous namespace
+
+// -----------------------------------------------------------------------------
+
+void generate_icosphere(int frequency, Mesh& mesh)
+{
+    const int n = std::max(frequency, 1);
+    const Icosahedron ico( n );
+    mesh._vertices.resize( ico.nb_vertices() );
+    mesh._triangles.resize( size_t(20) * n * n );
+
+    // Every vertex is computed once, by the corner, edge or face owning it
+    auto unit = [](const Vec3& p) { return p / p.norm(); };
+    for(int c = 0; c < 12; ++c)
+        mesh._vertices[c] = unit(ico._corners[c]);
+    parallel_for(0, 30, [&](int e) {
+        const Vec3& a = ico._corners[ ico._edges[e][0] ];
+        const Vec3& b = ico._corners[ ico._edges[e][1] ];
+        for(int t = 1; t < n; ++t)
+            mesh._vertices[ 12 + e * ico.nb_edge_vertices() + t - 1 ] = unit(a + (b - a) * (float(t) / float(n)));
+    }, 1);
+
+    // Faces are processed by rows: 20 faces alone would not keep threads busy
+    parallel_for(0, 20 * n, [&](int task) {
+        const int f = task / n;
+        const int j = task % n;
+        const Vec3& a = ico._corners[ Icosahedron::s_faces[f][0] ];
+        const Vec3& b = ico._corners[ Icosahedron::s_faces[f][1] ];
+        const Vec3& c = ico._corners[ Icosahedron::s_faces[f][2] ];
+        for(int i = 1; i + j < n; ++i) {
+            if( j > 0 )
+                mesh._vertices[ ico.face_vertex(f, i, j) ] =
+                        unit(a + (b - a) * (float(i) / float(n)) + (c - a) * (float(j) / float(n)));
+        }
+
+        // Row 'j' holds 2 (n - j) - 1 triangles
+        Tri_face* tri = mesh._triangles.data() + size_t(f) * n * n + 2 * n * j - j * j;
+        for(int i = 0; i + j < n; ++i)
+        {
+            tri->a = ico.face_vertex(f, i    , j    );
+            tri->b = ico.face_vertex(f, i + 1, j    );
+            tri->c = ico.face_vertex(f, i    , j + 1);
+            ++tri;
+            if( i + j < n - 1 ) {
+                tri->a = ico.face_vertex(f, i + 1, j    );
+                tri->b = ico.face_vertex(f, i + 1, j + 1);
+                tri->c = ico.face_vertex(f, i    , j + 1);
+                ++tri;
+            }
+        }
+    }, 1);
+}
+
+// -----------------------------------------------------------------------------
+
+void generate_torus(int nb_major, int nb_minor,
+                    float major_radius, float minor_radius,
+                    Mesh& mesh)
+{
+    nb_major = std::max(nb_major, 3);
+    nb_minor = std::max(nb_minor, 3);
+    mesh._vertices.resize( size_t(nb_major) * nb_minor );
+    mesh._triangles.resize( size_t(nb_major) * nb_minor * 2 );
+
+    parallel_for(0, nb_major, [&](int i) {
+        double u = 2.0 * M_PI * double(i) / double(nb_major);
+        for(int j = 0; j < nb_minor; ++j)
+        {
+            double v = 2.0 * M_PI * double(j) / double(nb_minor);
+            double r = major_radius + minor_radius * std::cos(v);
+            mesh._vertices[i * nb_minor + j] = Vec3(float(r * std::cos(u)),
+                                                    float(r * std::sin(u)),
+                                                    float(minor_radius * std::sin(v)));
+        }
+
+        // Quads (i, j) (i+1, j) (i+1, j+1) (i, j+1), normals point outward
+        int i1 = (i + 1) % nb_major;
+        Tri_face* tri = mesh._triangles.data() + size_t(i) * nb_minor * 2;
+        for(int j = 0; j < nb_minor; ++j)
+        {
+            int j1 = (j + 1) % nb_minor;
+            Vert_idx v00 = i  * nb_minor + j;
+            Vert_idx v10 = i1 * nb_minor + j;
+            Vert_idx v11 = i1 * nb_minor + j1;
+            Vert_idx v01 = i  * nb_minor + j1;
+            tri->a = v00; tri->b = v10; tri->c = v11; ++tri;
+            tri->a = v00; tri->b = v11; tri->c = v01; ++tri;
+        }
+    }, 16);
+}
+
+// =============================================================================
+// Textual description
+// =============================================================================
+
+bool is_generator_spec(const char* spec)
+{
+    return std::strncmp(spec, "gen:", 4) == 0;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Parse "250", "250K", "1.5M"...
+static bool parse_count(const std::string& str, double& count)
+{
+    char* end = nullptr;
+    count = std::strtod(str.c_str(), &end);
+    if( end == str.c_str() || count <= 0. )
+        return false;
+    switch( std::toupper((unsigned char)*end) ) {
+    case '\0': return true;
+    case 'K': count *= 1e3; break;
+    case 'M': count *= 1e6; break;
+    case 'G': count *= 1e9; break;
+    default: return false;
+    }
+    return *(end + 1) == '\0';
+}
+
+// -----------------------------------------------------------------------------
+
+bool generate_mesh(const char* spec, Mesh& mesh)
+{
+    if( !is_generator_spec(spec) ) {
+        std::cerr << "Not a mesh generator: '" << spec << "'" << std::endl;
+        return false;
+    }
+
+    // Split "gen:kind:count:key=value" on ':'
+    std::vector<std::string> tokens;
+    std::string str(spec + 4);
+    for(size_t b = 0; b <= str.size(); ) {
+        size_t e = std::min(str.find(':', b), str.size());
+        tokens.push_back( str.substr(b, e - b) );
+        b = e + 1;
+    }
+
+    const std::string& kind = tokens[0];
+    bool plane = kind == "grid" || kind == "jittered" || kind == "holes";
+    if( !plane && kind != "icosphere" && kind != "torus" ) {
+        std::cerr << "Unknown mesh generator '" << kind << "' in '" << spec;
+        std::cerr << "' (expected grid, jittered, holes, icosphere or torus)" << std::endl;
+        return false;
+    }
+
+    double count = 10000.;
+    unsigned seed = 1;
+    float jitter = 0.25f;
+    int nb_holes = 5;
+    float radius = 0.1f;
+    for(unsigned t = 1; t < tokens.size(); ++t)
+    {
+        const std::string& tok = tokens[t];
+        size_t eq = tok.find('=');
+        if( eq == std::string::npos ) {
+            if( t != 1 || !parse_count(tok, count) ) {
+                std::cerr << "Invalid vertex count '" << tok << "' in '" << spec << "'" << std::endl;
+                return false;
+            }
+            continue;
+        }
+
+        std::string key = tok.substr(0, eq);
+        const char* value = tok.c_str() + eq + 1;
+        char* end = nullptr;
+        if( key == "seed" )
+            seed = unsigned(std::strtoul(value, &end, 10));
+        else if( key == "jitter" && kind == "jittered" )
+            jitter = std::strtof(value, &end);
+        else if( key == "holes" && kind == "holes" )
+            nb_holes = int(std::strtol(value, &end, 10));
+        else if( key == "radius" && kind == "holes" )
+            radius = std::strtof(value, &end);
+        else {
+            std::cerr << "Unknown parameter '" << key << "' for generator '" << kind << "'" << std::endl;
+            return false;
+        }
+        if( end == value || *end != '\0' ) {
+            std::cerr << "Invalid value for '" << key << "' in '" << spec << "'" << std::endl;
+            return false;
+        }
+    }
+
+    if( count > 2e9 ) {
+        std::cerr << "Too many vertices requested: '" << spec << "'" << std::endl;
+        return false;
+    }
+
+    mesh = Mesh();
+    if( plane )
+    {
+        int side = std::max(2, int( std::lround(std::sqrt(count)) ));
+        if( kind == "grid" )
+            generate_grid(side, side, mesh);
+        else if( kind == "jittered" )
+            generate_jittered_grid(side, side, jitter, seed, mesh);
+        else
+            generate_perforated_plane(side, side, nb_holes, radius, seed, mesh);
+    }
+    else if( kind == "icosphere" )
+    {
+        int frequency = int( std::lround(std::sqrt(std::max(count - 2., 10.) / 10.)) );
+        generate_icosphere(frequency, mesh);
+    }
+    else
+    {
+        // Same proportions as samples/donut.off: about 4 times more
+        // vertices around the z axis than around the tube
+        int nb_minor = std::max(3, int( std::lround(std::sqrt(count / 4.)) ));
+        int nb_major = std::max(3, int( std::lround(count / nb_minor) ));
+        generate_torus(nb_major, nb_minor, 1.0f, 0.25f, mesh);
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef MESH_GENERATORS_HPP
+#define MESH_GENERATORS_HPP
+
+#include "mesh.hpp"
+
+/*
+ * Procedural meshes built directly into a Mesh, in parallel, for
+ * benchmarks and accuracy tests at scales we don't want to store as files.
+ * Only vertices and triangles are set. Random generators are driven by a
+ * seed and give the same mesh whatever the number of threads.
+ */
+
+/// @brief Regular grid over [-1 1] x [-1 1] on the (x,y) plane, like
+/// our sample models, so that the boundary presets apply.
+/// Each quad is split along its diagonal.
+/// @param nb_x, nb_y : number of vertices along x and y (at least 2)
+void generate_grid(int nb_x, int nb_y, Mesh& mesh);
+
+/// @brief Same as generate_grid() with vertices randomly displaced by up to
+/// +/- 'jitter' / 2 times the cell size along x and y. Border vertices only
+/// slide along the border, corners don't move.
+/// @param jitter : in [0 1), values above 0.5 may fold triangles
+void generate_jittered_grid(int nb_x, int nb_y, float jitter, unsigned seed, Mesh& mesh);
+
+/// @brief Grid over [-1 1] x [-1 1] pierced with 'nb_holes' random discs
+/// (like samples/plane_wholes.off). Triangles touching a vertex inside a
+/// disc are removed, then vertices left without triangles. Discs stay
+/// inside [-0.8 0.8]^2 so the outer border is intact.
+/// @param hole_radius : radius of the discs
+void generate_perforated_plane(int nb_x, int nb_y,
+                               int nb_holes, float hole_radius,
+                               unsigned seed, Mesh& mesh);
+
+/// @brief Unit sphere made by subdividing each face of an icosahedron into
+/// frequency^2 triangles projected onto the sphere.
+/// Vertex count is 10 * frequency^2 + 2 (frequency = 2^n gives the usual
+/// n times subdivided icosphere).
+void generate_icosphere(int frequency, Mesh& mesh);
+
+/// @brief Torus around the z axis (like samples/donut.off with the default
+/// radii)
+/// @param nb_major : number of vertices around the z axis (at least 3)
+/// @param nb_minor : number of vertices around the tube (at least 3)
+void generate_torus(int nb_major, int nb_minor,
+                    float major_radius, float minor_radius,
+                    Mesh& mesh);
+
+// -----------------------------------------------------------------------------
+
+/// @return true if 'spec' describes a generated mesh (starts with "gen:")
+bool is_generator_spec(const char* spec);
+
+/**
+ * @brief Build a mesh from a textual description:
+ * "gen:<kind>[:<nb_vertices>][:<key>=<value>...]"
+ *
+ * - kind: grid, jittered, holes (perforated plane), icosphere, torus
+ * - nb_vertices: approximate target, accepts K, M and G suffixes
+ *   (default 10K). The closest resolution of the kind is chosen.
+ * - keys: seed, jitter (jittered), holes and radius (holes)
+ *
+ * e.g. "gen:grid:1M", "gen:holes:250K:holes=20:radius=0.05"
+ * @return false if 'spec' is invalid (message printed on std::cerr)
+ */
+bool generate_mesh(const char* spec, Mesh& mesh);
+
+#endif // MESH_GENERATORS_HPP
@@ -0,0 +1,206 @@
+#include "mesh_normals.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#include "utils/parallel_for.hpp"
+#include "utils/trace.hpp"
+
+// -----------------------------------------------------------------------------
+
+/// Vectors normalized together by normalize_normals()
+static const int g_block_size = 16;
+
+/// Minimal amount of dirty elements per thread in update(): small updates
+/// (e.g. a brush stroke) are not worth waking threads
+static const int g_update_grain = 4096;
+
+// -----------------------------------------------------------------------------
+
+void normalize_normals(Vec3* normals, int nb)
+{
+    parallel_for_ranges(0, (nb + g_block_size - 1) / g_block_size, [&](int b_begin, int b_end) {
+        float scale[g_block_size];
+        for(int b = b_begin; b < b_end; ++b)
+        {
+            Vec3* n = normals + b * g_block_size;
+            int size = std::min(g_block_size, nb - b * g_block_size);
+            if( size == g_block_size )
+            {
+                // Fixed trip counts: vectorized
+                for(int i = 0; i < g_block_size; ++i)
+                    scale[i] = n[i].x * n[i].x + n[i].y * n[i].y + n[i].z * n[i].z;
+                for(int i = 0; i < g_block_size; ++i)
+                    scale[i] = scale[i] > 0.f ? 1.f / std::sqrt(scale[i]) : 1.f;
+                for(int i = 0; i < g_block_size; ++i) {
+                    n[i].x *= scale[i];
+                    n[i].y *= scale[i];
+                    n[i].z *= scale[i];
+                }
+            }
+            else
+            {
+                for(int i = 0; i < size; ++i) {
+                    float len = n[i].norm();
+                    if( len > 0.f )
+                        n[i] = n[i] / len;
+                }
+            }
+        }
+    }, 64);
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_normals::init(const Mesh& mesh)
+{
+    Trace_scope trace("normals_adjacency");
+    _vert_to_face.compute_vertex_to_face( mesh );
+    init(mesh, _vert_to_face.view());
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_normals::init(const Mesh& mesh, const Csr_view& vert_to_face)
+{
+    if( vert_to_face._indices != _vert_to_face._indices.data() )
+        _vert_to_face.clear();
+    _view = vert_to_face;
+    _face_normals.resize( mesh.nb_triangles() );
+    _is_dirty_face.assign( mesh.nb_triangles(), 0 );
+    _is_dirty_vert.assign( mesh.nb_vertices(), 0 );
+}
+
+// -----------------------------------------------------------------------------
+
+static Vec3 face_normal(const Mesh& mesh, const Tri_face& tri)
+{
+    const Vec3& a = mesh._vertices[tri.a];
+    return (mesh._vertices[tri.b] - a).cross(mesh._vertices[tri.c] - a);
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_normals::gather(Mesh& mesh,
+                            int vert,
+                            Normal_weighting weighting,
+                            bool normalize) const
+{
+    Vec3 sum(0.f);
+    const Csr_view& vert_to_face = _view;
+    for(const int* t = vert_to_face.begin(vert); t < vert_to_face.end(vert); ++t)
+    {
+        const Vec3& n = _face_normals[*t];
+        if( weighting == eAREA ) {
+            sum += n;
+            continue;
+        }
+
+        float len = n.norm();
+        if( len <= 0.f )
+            continue;
+
+        float w = 1.f;
+        if( weighting == eANGLE ) {
+            const Tri_face& tri = mesh._triangles[*t];
+            int k = tri.a == vert ? 0 : (tri.b == vert ? 1 : 2);
+            const Vec3& p = mesh._vertices[vert];
+            Vec3 e0 = mesh._vertices[ tri[(k + 1) % 3] ] - p;
+            Vec3 e1 = mesh._vertices[ tri[(k + 2) % 3] ] - p;
+            w = std::atan2(len, e0.dot(e1));
+        }
+        sum += n * (w / len);
+    }
+    float len = normalize ? sum.norm() : 0.f;
+    mesh._normals[vert] = len > 0.f ? sum / len : sum;
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_normals::compute(Mesh& mesh, Normal_weighting weighting)
+{
+    const int nv = int(mesh.nb_vertices());
+    const int nt = int(mesh.nb_triangles());
+    mesh._normals.resize( nv );
+    Trace_scope trace("vertex_normals");
+
+    {
+        Trace_scope trace_faces("face_normals");
+        parallel_for(0, nt, [&](int t) {
+            _face_normals[t] = face_normal(mesh, mesh._triangles[t]);
+        });
+    }
+
+    {
+        Trace_scope trace_gather("gather_normals");
+        parallel_for(0, nv, [&](int v) {
+            gather(mesh, v, weighting, false);
+        });
+    }
+
+    Trace_scope trace_normalize("normalize_normals");
+    normalize_normals(mesh._normals.data(), nv);
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_normals::update(Mesh& mesh,
+                            const std::vector<Vert_idx>& touched,
+                            Normal_weighting weighting)
+{
+    Trace_scope trace("update_normals");
+    // Dirty faces: incident to a touched vertex
+    // Dirty vertices: belong to a dirty face
+    _dirty_faces.clear();
+    _dirty_verts.clear();
+    const Csr_view& vert_to_face = _view;
+    for(Vert_idx v : touched) {
+        for(const int* t = vert_to_face.begin(v); t < vert_to_face.end(v); ++t)
+        {
+            if( _is_dirty_face[*t] )
+                continue;
+            _is_dirty_face[*t] = 1;
+            _dirty_faces.push_back( *t );
+            const Tri_face& tri = mesh._triangles[*t];
+            for(int k = 0; k < 3; ++k) {
+                if( !_is_dirty_vert[tri[k]] ) {
+                    _is_dirty_vert[tri[k]] = 1;
+                    _dirty_verts.push_back( tri[k] );
+                }
+            }
+        }
+    }
+
+    parallel_for(0, int(_dirty_faces.size()), [&](int i) {
+        Tri_idx t = _dirty_faces[i];
+        _face_normals[t] = face_normal(mesh, mesh._triangles[t]);
+    }, g_update_grain);
+    parallel_for(0, int(_dirty_verts.size()), [&](int i) {
+        gather(mesh, _dirty_verts[i], weighting, true);
+    }, g_update_grain);
+
+    for(Tri_idx t : _dirty_faces)
+        _is_dirty_face[t] = 0;
+    for(Vert_idx v : _dirty_verts)
+        _is_dirty_vert[v] = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+void compute_normals(Mesh& mesh, Normal_weighting weighting)
+{
+    Vertex_normals normals;
+    normals.init( mesh );
+    normals.compute( mesh, weighting );
+}
+
+// -----------------------------------------------------------------------------
+
+void compute_normals(Mesh& mesh,
+                     const Csr_view& vert_to_face,
+                     Normal_weighting weighting)
+{
+    Vertex_normals normals;
+    normals.init( mesh, vert_to_face );
+    normals.compute( mesh, weighting );
+}
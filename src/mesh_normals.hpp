@@ -0,0 +1,88 @@
+#ifndef MESH_NORMALS_HPP
+#define MESH_NORMALS_HPP
+
+#include <vector>
+#include "mesh.hpp"
+#include "topology/csr_adjacency.hpp"
+
+/// How face normals contribute to the normal of a vertex
+enum Normal_weighting {
+    eUNIFORM, ///< every incident face counts the same
+    eAREA,    ///< weighted by the area of the face
+    eANGLE    ///< weighted by the angle of the face at the vertex
+};
+
+/**
+ * @brief Per vertex normals of a mesh, recomputed without allocation.
+ *
+ * init() builds the vertex to face adjacency (CSR) once. compute() then
+ * evaluates face normals in parallel and each vertex gathers the normals of
+ * its incident faces: no scattering, hence no atomics nor per thread
+ * buffers. Normals are normalized by blocks (see normalize_normals()).
+ *
+ * update() only recomputes the normals affected by moving a few vertices:
+ * their incident faces and every vertex of these faces.
+ *
+ * @note the topology of the mesh must not change between init() and
+ * compute() / update()
+ */
+struct Vertex_normals {
+
+    Vertex_normals() { }
+    // _view may point to our own arrays
+    Vertex_normals(const Vertex_normals&) = delete;
+    Vertex_normals& operator=(const Vertex_normals&) = delete;
+
+    /// Build the vertex to face adjacency of 'mesh'
+    void init(const Mesh& mesh);
+
+    /// Use the vertex to face lists 'vert_to_face' of 'mesh' instead of
+    /// building them (e.g. Mesh_cache::vertex_to_face() read in place from
+    /// the mapped file). The view is not copied, its arrays must outlive
+    /// this object.
+    void init(const Mesh& mesh, const Csr_view& vert_to_face);
+
+    /// Recompute every normal of 'mesh._normals' (resized if needed)
+    void compute(Mesh& mesh, Normal_weighting weighting = eUNIFORM);
+
+    /// Recompute the normals changed by displacing the vertices 'touched'
+    /// @pre compute() was called once
+    void update(Mesh& mesh,
+                const std::vector<Vert_idx>& touched,
+                Normal_weighting weighting = eUNIFORM);
+
+    /// Vertices whose normal was recomputed by the last update()
+    const std::vector<Vert_idx>& updated_vertices() const { return _dirty_verts; }
+
+private:
+    /// Sum the normals of the faces around 'vert' into 'mesh._normals'
+    void gather(Mesh& mesh, int vert, Normal_weighting weighting, bool normalize) const;
+
+    Csr_adjacency _vert_to_face;
+    /// Lists in use: _vert_to_face or external ones
+    Csr_view _view;
+    /// Unnormalized face normals (length is twice the area)
+    std::vector<Vec3> _face_normals;
+    /// Buffers of update()
+    std::vector<char> _is_dirty_face;
+    std::vector<char> _is_dirty_vert;
+    std::vector<Tri_idx> _dirty_faces;
+    std::vector<Vert_idx> _dirty_verts;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Normalize 'nb' vectors in place (null vectors are left untouched).
+/// Processed by fixed size blocks so that the compiler vectorizes the
+/// length and reciprocal computations.
+void normalize_normals(Vec3* normals, int nb);
+
+/// Recompute 'mesh._normals' (one shot version of Vertex_normals)
+void compute_normals(Mesh& mesh, Normal_weighting weighting = eUNIFORM);
+
+/// Same as above with the vertex to face lists of 'mesh' already built
+void compute_normals(Mesh& mesh,
+                     const Csr_view& vert_to_face,
+                     Normal_weighting weighting = eUNIFORM);
+
+#endif // MESH_NORMALS_HPP
@@ -0,0 +1,194 @@
+#include "mesh_pipeline.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#include "io/mesh_loader.hpp"
+#include "io/off_loader.hpp"
+#include "mesh_generators.hpp"
+#include "utils/task_graph.hpp"
+#include "utils/timer.hpp"
+#include "utils/trace.hpp"
+
+// -----------------------------------------------------------------------------
+
+/// Blocks of vertices smaller than this are not worth a task
+static const int g_min_block_size = 1 << 14;
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// (vertex, triangle) pairs of a chunk of faces falling in a block of vertices
+typedef std::vector<std::pair<Vert_idx, Tri_idx> > Incidences;
+
+/// Accumulate the time of the tasks of each stage
+class Stage_clock {
+public:
+    explicit Stage_clock(Pipeline_timings& time) : _time(time) { }
+
+    /// Add the time elapsed since 'timer' started to 'stage'
+    void add(double Pipeline_timings::* stage, const Timer& timer)
+    {
+        double seconds = timer.elapsed();
+        std::lock_guard<std::mutex> lock(_mutex);
+        _time.*stage += seconds;
+    }
+
+private:
+    Pipeline_timings& _time;
+    std::mutex _mutex;
+};
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+bool can_pipeline(const char* file_name)
+{
+    return !is_generator_spec(file_name) && detect_mesh_format(file_name) == eOFF;
+}
+
+// -----------------------------------------------------------------------------
+
+bool build_mesh_pipelined(const char* file_name,
+                          bool laplacian_from_triangles,
+                          Mesh& mesh,
+                          Vertex_to_face& vert_to_face,
+                          Vertex_to_1st_ring_vertices& first_ring,
+                          std::vector<std::vector<Triplet>>& mat_elemts,
+                          Pipeline_timings* timings)
+{
+    Trace_scope trace("build_mesh_pipelined");
+    Pipeline_timings local_timings;
+    Pipeline_timings& time = timings != nullptr ? *timings : local_timings;
+    time = Pipeline_timings();
+    Timer wall;
+
+    Off_reader reader;
+    {
+        Trace_scope trace_open("open_off");
+        if( !reader.open(file_name) )
+            return false;
+    }
+    time._open = wall.elapsed();
+
+    mesh = Mesh();
+    reader.allocate( mesh );
+    const int nv = reader.nb_vertices();
+    const std::vector<Off_reader::Chunk>& chunks = reader.chunks();
+    const int nb_chunks = int(chunks.size());
+
+    // A few blocks per thread to balance the load
+    const int nb_blocks = std::max(1, std::min(int(get_nb_threads()) * 4, nv / g_min_block_size));
+    const int block_size = std::max(1, (nv + nb_blocks - 1) / nb_blocks);
+    auto block_begin = [&](int b) { return std::min(nv, b * block_size); };
+
+    vert_to_face.allocate( nv );
+    first_ring.allocate( laplacian_from_triangles ? 0 : nv );
+    std::vector<uint8_t> flags( nv, 0 );
+    mat_elemts.clear();
+    mat_elemts.resize( nv );
+
+    std::vector<std::string> errors( nb_chunks );
+    std::vector<std::vector<Incidences>> incidences( nb_chunks, std::vector<Incidences>(nb_blocks) );
+    Stage_clock clock( time );
+
+    Task_graph graph;
+    std::vector<int> vertex_tasks;
+    for(int c = 0; c < nb_chunks; ++c) {
+        if( chunks[c]._first_record >= nv )
+            continue;
+        vertex_tasks.push_back( graph.add("parse_vertices", [&, c] {
+            Timer timer;
+            bool ok = reader.parse_vertices(c, mesh, errors[c]);
+            clock.add(&Pipeline_timings::_vertices, timer);
+            return ok;
+        }) );
+    }
+
+    std::vector<int> scatter_tasks;
+    for(int c = 0; c < nb_chunks; ++c) {
+        const Off_reader::Chunk& chunk = chunks[c];
+        if( chunk._nb_triangles == 0 )
+            continue;
+        // Triangles are read as is, polygons need the vertex positions
+        std::vector<int> deps;
+        if( chunk._nb_polygons > 0 )
+            deps = vertex_tasks;
+        int parse = graph.add("parse_faces", [&, c] {
+            Timer timer;
+            bool ok = reader.parse_faces(c, mesh, errors[c]);
+            clock.add(&Pipeline_timings::_faces, timer);
+            return ok;
+        }, deps);
+
+        scatter_tasks.push_back( graph.add("vertex_to_face_scatter", [&, c] {
+            Timer timer;
+            const Off_reader::Chunk& ch = chunks[c];
+            std::vector<Incidences>& out = incidences[c];
+            for(int t = ch._first_triangle; t < ch._first_triangle + ch._nb_triangles; ++t) {
+                const Tri_face& tri = mesh._triangles[t];
+                for(int k = 0; k < 3; ++k)
+                    out[tri[k] / block_size].push_back( std::make_pair(tri[k], t) );
+            }
+            clock.add(&Pipeline_timings::_vertex_to_face, timer);
+            return true;
+        }, {parse}) );
+    }
+
+    for(int b = 0; b < nb_blocks; ++b)
+    {
+        // Chunks in file order: triangles are listed by increasing index
+        // as Vertex_to_face::compute() does
+        int merge = graph.add("vertex_to_face", [&, b] {
+            Timer timer;
+            for(int c = 0; c < nb_chunks; ++c) {
+                for(const std::pair<Vert_idx, Tri_idx>& elt : incidences[c][b])
+                    vert_to_face._1st_ring_tris[elt.first].push_back( elt.second );
+                Incidences().swap( incidences[c][b] );
+            }
+            clock.add(&Pipeline_timings::_vertex_to_face, timer);
+            return true;
+        }, scatter_tasks);
+
+        int rows_dep = merge;
+        if( !laplacian_from_triangles ) {
+            rows_dep = graph.add("first_ring", [&, b] {
+                Timer timer;
+                first_ring.compute_rings(mesh, vert_to_face, block_begin(b), block_begin(b + 1), flags.data());
+                clock.add(&Pipeline_timings::_rings, timer);
+                return true;
+            }, {merge});
+        }
+
+        // Rows read the positions of the neighbors
+        std::vector<int> deps = vertex_tasks;
+        deps.push_back( rows_dep );
+        graph.add("laplacian_rows", [&, b] {
+            Timer timer;
+            if( laplacian_from_triangles )
+                get_laplacian_rows(mesh._vertices, mesh._triangles, vert_to_face._1st_ring_tris,
+                                   block_begin(b), block_begin(b + 1), mat_elemts);
+            else
+                get_laplacian_rows(mesh._vertices, first_ring._rings_per_vertex,
+                                   block_begin(b), block_begin(b + 1), mat_elemts);
+            clock.add(&Pipeline_timings::_laplacian, timer);
+            return true;
+        }, deps);
+    }
+
+    bool ok = graph.run();
+    for(const std::string& err : errors)
+        if( !err.empty() )
+            std::cerr << err << ": " << file_name << std::endl;
+
+    if( ok ) {
+        vert_to_face.update_connected();
+        if( !laplacian_from_triangles )
+            first_ring.set_flags( flags.data() );
+    }
+    time._wall = wall.elapsed();
+    return ok;
+}
@@ -0,0 +1,74 @@
+#ifndef MESH_PIPELINE_HPP
+#define MESH_PIPELINE_HPP
+
+#include <vector>
+
+#include "mesh.hpp"
+#include "solvers.hpp"
+#include "topology/vertex_to_face.hpp"
+#include "topology/vertex_to_1st_ring_vertices.hpp"
+
+/**
+ * @brief Load an OFF file and build its topology and Laplacian rows in one
+ * task graph (see Task_graph) instead of one phase after another.
+ *
+ * Stages and what each task waits for:
+ * - parse_vertices: one task per chunk of the file (see Off_reader)
+ * - parse_faces: one task per chunk, waits for the vertices only when the
+ *   chunk holds polygons to triangulate
+ * - vertex_to_face_scatter: sorts the (vertex, triangle) pairs of a chunk
+ *   of faces by block of vertices, as soon as the chunk is parsed
+ * - vertex_to_face: the triangle lists of a block of vertices, once every
+ *   chunk is scattered (the last face of the file may use any vertex)
+ * - first_ring: orders the rings of a block as soon as its lists are done
+ * - laplacian_rows: the rows of a block as soon as its rings are done
+ *
+ * So parsing overlaps with the vertex to face accumulation, and ring
+ * ordering with the Laplacian, and every stage runs on every thread.
+ * Results are identical to build_mesh(), Vertex_to_face::compute(),
+ * Vertex_to_1st_ring_vertices::compute() and get_laplacian().
+ */
+
+/// Time spent in each stage of build_mesh_pipelined() (in seconds),
+/// summed over the tasks of the stage
+struct Pipeline_timings {
+    Pipeline_timings()
+        : _open(0.), _vertices(0.), _faces(0.), _vertex_to_face(0.)
+        , _rings(0.), _laplacian(0.), _wall(0.)
+    { }
+
+    double _open;           ///< header and location of the records (Off_reader::open())
+    double _vertices;
+    double _faces;
+    double _vertex_to_face; ///< scatter and merge
+    double _rings;
+    double _laplacian;
+    double _wall;           ///< elapsed during build_mesh_pipelined()
+
+    /// Time of the stages run one after another on a single thread
+    double sum() const { return _open + _vertices + _faces + _vertex_to_face + _rings + _laplacian; }
+};
+
+// -----------------------------------------------------------------------------
+
+/// @return true if build_mesh_pipelined() can read 'file_name'
+/// (ASCII OFF files)
+bool can_pipeline(const char* file_name);
+
+/// @brief Load 'file_name' and compute its topology and Laplacian rows
+/// @param laplacian_from_triangles : rows as get_laplacian(vertices, triangles)
+/// returns them, 'first_ring' is then left empty
+/// @param[out] mesh : vertices and triangles (no cleanup, the mesh cache is
+/// neither read nor written)
+/// @param[out] mat_elemts : Laplacian rows, see get_laplacian()
+/// @param[out] timings : optional
+/// @return false on error (message printed on std::cerr)
+bool build_mesh_pipelined(const char* file_name,
+                          bool laplacian_from_triangles,
+                          Mesh& mesh,
+                          Vertex_to_face& vert_to_face,
+                          Vertex_to_1st_ring_vertices& first_ring,
+                          std::vector<std::vector<Triplet>>& mat_elemts,
+                          Pipeline_timings* timings = nullptr);
+
+#endif // MESH_PIPELINE_HPP
@@ -0,0 +1,279 @@
+#include "retained_solve.hpp"
+
+#include <iostream>
+
+#include "solver_planner.hpp"
+#include "utils/timer.hpp"
+#include "utils/trace.hpp"
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Report 'phase' to 'control' (optional)
+/// @return false if the solve was cancelled
+bool enter_phase(Solve_control* control, Solve_phase phase)
+{
+    return control == nullptr || control->enter_phase(phase);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Analyze and factorize 'A' converted to the precision of 'backend'
+/// @param[out] mat : 'A' converted, iterative backends keep a reference
+/// to it until the last solve
+template<typename Scalar>
+bool factorize(Solver_backend<Scalar>& backend,
+               const Solver_backend_info& info,
+               const Eigen::SparseMatrix<double>& A,
+               typename Solver_backend<Scalar>::Matrix& mat)
+{
+    mat = A.cast<Scalar>();
+    return factorize_system(backend, info, mat);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Solve with the last factorization of 'backend'
+template<typename Scalar>
+bool back_substitute(Solver_backend<Scalar>& backend,
+                     const std::string& name,
+                     const Eigen::VectorXd& rhs,
+                     Eigen::VectorXd& res,
+                     Solve_timings& time)
+{
+    typename Solver_backend<Scalar>::Vector x;
+    if( !backend.solve(rhs.cast<Scalar>(), x) ) {
+        if( backend.control() == nullptr || !backend.control()->is_cancelled() )
+            std::cerr << name << " solve failed: " << backend.error() << std::endl;
+        return false;
+    }
+    res = x.template cast<double>();
+    Backend_stats stats = backend.stats();
+    time._iterations = stats._iterations;
+    time._residual = stats._residual;
+    return true;
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+Retained_solve::Retained_solve()
+    : _factorized(false)
+    , _nb_vertices(0)
+    , _full_system(false)
+{ }
+
+// -----------------------------------------------------------------------------
+
+std::string Retained_solve::backend_name() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _backend_name;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Retained_solve::solve(const std::vector< Vec3 >& vertices,
+                           const std::vector< std::vector<int> >& edges,
+                           const std::vector<Tri_face>& triangles,
+                           const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                           std::vector<double>& harmonic_weight_map,
+                           Solve_timings* timings,
+                           const Solver_options* options,
+                           Solve_control* control)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Trace_scope trace("retained_solve");
+    Solve_timings local_timings;
+    Solve_timings& time = timings != nullptr ? *timings : local_timings;
+    time = Solve_timings();
+    const Solver_options default_options;
+    Solver_options opt = options != nullptr ? *options : default_options;
+    Timer timer;
+
+    _factorized = false;
+    _backend_float.reset();
+    _backend_double.reset();
+    _matrix_float.resize(0, 0);
+    _matrix_double.resize(0, 0);
+    _backend_name.clear();
+
+    // Fails (and reports the phase to 'control') after a cancellation
+    auto stop = [&]() {
+        if( control != nullptr )
+            control->enter_phase(control->is_cancelled() ? ePHASE_CANCELLED : ePHASE_FAILED);
+        return false;
+    };
+
+    if( !enter_phase(control, ePHASE_LAPLACIAN) )
+        return stop();
+    std::vector<std::vector<Triplet>> mat_elemts;
+    {
+        Trace_scope trace_laplacian("laplacian");
+        mat_elemts = edges.size() > 0 ? get_laplacian(vertices, edges) :
+                                        get_laplacian(vertices, triangles);
+    }
+    time._laplacian = timer.lap();
+
+    std::vector<int> ordering;
+    if( !choose_solver(mat_elemts, boundaries, control, opt, ordering) )
+        return stop();
+    time._planning = timer.lap();
+    Solver_backend_info info;
+    if( opt._single_precision )
+        _backend_float.reset( make_solver_backend<float>(opt, info) );
+    else
+        _backend_double.reset( make_solver_backend<double>(opt, info) );
+    if( _backend_float == nullptr && _backend_double == nullptr )
+        return stop();
+    _backend_name = info._name;
+    if( !ordering.empty() && !info._full_system ) {
+        if( _backend_float != nullptr )
+            _backend_float->set_ordering( ordering );
+        else
+            _backend_double->set_ordering( ordering );
+    }
+
+    // Assembly: same systems as solve_laplace_equation(), the couplings
+    // between free and boundary vertices are kept to build the right hand
+    // side of later solves
+    if( !enter_phase(control, ePHASE_ASSEMBLY) )
+        return stop();
+    const int nv = int(mat_elemts.size());
+    _nb_vertices = nv;
+    _full_system = info._full_system;
+    reduced_indices(nv, boundaries, _indices);
+
+    Eigen::SparseMatrix<double> A;
+    if( _full_system ) {
+        assemble_full_system<double>(mat_elemts, _indices, A);
+        _coupling.resize(0, 0);
+    } else {
+        assemble_reduced_system<double>(mat_elemts, _indices, &A, &_coupling);
+    }
+    mat_elemts.clear();
+    mat_elemts.shrink_to_fit();
+    time._assembly = timer.lap();
+
+    if( A.rows() > 0 )
+    {
+        if( !enter_phase(control, ePHASE_FACTORIZATION) )
+            return stop();
+        bool ok = _backend_float != nullptr ?
+                    factorize<float >(*_backend_float , info, A, _matrix_float ) :
+                    factorize<double>(*_backend_double, info, A, _matrix_double);
+        time._factorization = timer.lap();
+        if( !ok )
+            return stop();
+    }
+    _factorized = true;
+
+    Solve_timings resolve_time;
+    if( !resolve_locked(boundaries, harmonic_weight_map, resolve_time, control) ) {
+        if( control != nullptr && control->is_cancelled() )
+            _factorized = false;
+        return stop();
+    }
+    time._solve = resolve_time._assembly + resolve_time._solve;
+    time._iterations = resolve_time._iterations;
+    time._residual = resolve_time._residual;
+    if( control != nullptr )
+        control->enter_phase( ePHASE_DONE );
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Retained_solve::resolve(const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                             std::vector<double>& harmonic_weight_map,
+                             Solve_timings* timings,
+                             Solve_control* control)
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Solve_timings local_timings;
+    Solve_timings& time = timings != nullptr ? *timings : local_timings;
+    time = Solve_timings();
+    bool ok = _factorized && resolve_locked(boundaries, harmonic_weight_map, time, control);
+    if( control != nullptr )
+        control->enter_phase(ok ? ePHASE_DONE : control->is_cancelled() ? ePHASE_CANCELLED : ePHASE_FAILED);
+    return ok;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Retained_solve::resolve_locked(const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                                    std::vector<double>& harmonic_weight_map,
+                                    Solve_timings& time,
+                                    Solve_control* control)
+{
+    Timer timer;
+    if( !enter_phase(control, ePHASE_ASSEMBLY) )
+        return false;
+
+    // Boundary values, the set of vertices must be the factorized one
+    Eigen::VectorXd values = Eigen::VectorXd::Zero( _indices._nb_boundaries );
+    std::vector<bool> given( _indices._nb_boundaries, false );
+    int nb_given = 0;
+    for(const std::pair<Vert_idx, float>& elt : boundaries)
+    {
+        int b = size_t(elt.first) < _indices._boundary_idx.size() ? _indices._boundary_idx[elt.first] : -1;
+        if( b < 0 ) {
+            std::cerr << "Retained solve: vertex " << elt.first;
+            std::cerr << " is not a boundary of the factorized system" << std::endl;
+            return false;
+        }
+        nb_given += given[b] ? 0 : 1;
+        given[b] = true;
+        values(b) = double(elt.second);
+    }
+    if( nb_given != _indices._nb_boundaries ) {
+        std::cerr << "Retained solve: " << (_indices._nb_boundaries - nb_given);
+        std::cerr << " boundary vertices of the factorized system have no value" << std::endl;
+        return false;
+    }
+
+    std::vector<double>& x = harmonic_weight_map;
+    x.resize( _nb_vertices );
+    Eigen::VectorXd rhs;
+    if( _full_system ) {
+        rhs = Eigen::VectorXd::Zero( _nb_vertices );
+        for(int i = 0; i < _nb_vertices; ++i)
+            if( _indices._boundary_idx[i] >= 0 )
+                rhs(i) = values( _indices._boundary_idx[i] );
+    } else {
+        rhs = _coupling * values;
+    }
+    time._assembly = timer.lap();
+
+    if( rhs.size() > 0 )
+    {
+        if( !enter_phase(control, ePHASE_SOLVE) )
+            return false;
+        Trace_scope trace("solve");
+        Eigen::VectorXd res;
+        bool ok = false;
+        if( _backend_float != nullptr ) {
+            _backend_float->set_control( control );
+            ok = back_substitute<float>(*_backend_float, _backend_name, rhs, res, time);
+            _backend_float->set_control( nullptr );
+        } else {
+            _backend_double->set_control( control );
+            ok = back_substitute<double>(*_backend_double, _backend_name, rhs, res, time);
+            _backend_double->set_control( nullptr );
+        }
+        if( !ok )
+            return false;
+        for(int i = 0; i < _nb_vertices; ++i) {
+            if( _full_system )
+                x[i] = res(i);
+            else if( _indices._free_idx[i] >= 0 )
+                x[i] = res( _indices._free_idx[i] );
+        }
+    }
+    // Boundary vertices exactly at their values
+    for(int i = 0; i < _nb_vertices; ++i)
+        if( _indices._boundary_idx[i] >= 0 )
+            x[i] = values( _indices._boundary_idx[i] );
+    time._solve = timer.lap();
+    return true;
+}
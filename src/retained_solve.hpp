@@ -0,0 +1,91 @@
+#ifndef RETAINED_SOLVE_HPP
+#define RETAINED_SOLVE_HPP
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include <Eigen/Sparse>
+
+#include "mesh.hpp"
+#include "solvers.hpp"
+#include "solver_backend.hpp"
+#include "solve_control.hpp"
+
+/**
+ * @brief solve_laplace_equation() keeping the factorized system, so that
+ * new values on the same boundary vertices only cost the right hand side
+ * and the back substitution (interactive editing of handles).
+ *
+ * @code
+ * Retained_solve system;
+ * system.solve(vertices, rings, triangles, boundaries, weights);
+ * // ... the user drags a handle:
+ * boundaries[i].second = new_value;
+ * system.resolve(boundaries, weights);
+ * @endcode
+ * Any backend works, including lu and iterative ones (the preconditioner
+ * is kept). Unlike the solve cache (io/solve_cache.hpp) nothing is hashed
+ * nor copied, the backend itself stays alive with its factors.
+ * Calls are serialized by a mutex, the object can be shared with the
+ * asynchronous solves (see Solve_input::_retained).
+ */
+class Retained_solve {
+public:
+    Retained_solve();
+
+    /// @brief Same as solve_laplace_equation(), the factorization is kept
+    /// for resolve() (the solve cache is not used)
+    /// @return false if the factorization failed (message printed on
+    /// std::cerr) or the solve was cancelled
+    bool solve(const std::vector< Vec3 >& vertices,
+               const std::vector< std::vector<int> >& edges,
+               const std::vector<Tri_face>& triangles,
+               const std::vector<std::pair<Vert_idx, float> >& boundaries,
+               std::vector<double>& harmonic_weight_map,
+               Solve_timings* timings = nullptr,
+               const Solver_options* options = nullptr,
+               Solve_control* control = nullptr);
+
+    /// @brief Solve again with new boundary values
+    /// @param boundaries : the vertices given to solve(), in any order
+    /// @param[out] timings : only _assembly (right hand side) and _solve
+    /// @return false if the vertices differ from the ones given to solve()
+    /// (message printed on std::cerr), nothing was factorized yet or the
+    /// solve was cancelled
+    bool resolve(const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                 std::vector<double>& harmonic_weight_map,
+                 Solve_timings* timings = nullptr,
+                 Solve_control* control = nullptr);
+
+    /// true once solve() succeeded (does not wait for a running solve)
+    bool is_factorized() const { return _factorized; }
+
+    /// Name of the backend holding the factorization (e.g. "ldlt")
+    std::string backend_name() const;
+
+private:
+    bool resolve_locked(const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                        std::vector<double>& harmonic_weight_map,
+                        Solve_timings& time,
+                        Solve_control* control);
+
+    mutable std::mutex _mutex;
+    std::atomic<bool> _factorized;
+    int _nb_vertices;
+    /// Dirichlet rows replaced by identity rows instead of a reduced system
+    bool _full_system;
+    Reduced_indices _indices;
+    /// L_FB: right hand side of the reduced system from the boundary values
+    Eigen::SparseMatrix<double, Eigen::RowMajor> _coupling;
+    std::string _backend_name;
+    /// Only one backend and its matrix are set, depending on the precision
+    std::unique_ptr<Solver_backend<float > > _backend_float;
+    std::unique_ptr<Solver_backend<double> > _backend_double;
+    Eigen::SparseMatrix<float > _matrix_float;
+    Eigen::SparseMatrix<double> _matrix_double;
+};
+
+#endif // RETAINED_SOLVE_HPP
@@ -0,0 +1,407 @@
+#include "service/solve_protocol.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+    #include <sys/socket.h>
+    #include <sys/stat.h>
+    #include <sys/un.h>
+    #include <unistd.h>
+#endif
+
+namespace Solve_protocol {
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+struct Field_header {
+    uint32_t _tag;
+    uint32_t _pad;
+    uint64_t _nb_bytes;
+};
+
+/// Responses above this size are rejected (corrupted stream), requests are
+/// limited by the caller of receive_request()
+const uint64_t g_max_response_bytes = uint64_t(1) << 36;
+
+// -----------------------------------------------------------------------------
+
+bool write_all(int fd, const void* data, size_t nb_bytes)
+{
+#ifndef _WIN32
+    const char* ptr = (const char*)data;
+    while( nb_bytes > 0 ) {
+#ifdef MSG_NOSIGNAL
+        ssize_t n = ::send(fd, ptr, nb_bytes, MSG_NOSIGNAL);
+#else
+        ssize_t n = ::write(fd, ptr, nb_bytes);
+#endif
+        if( n < 0 && errno == EINTR )
+            continue;
+        if( n <= 0 )
+            return false;
+        ptr += n;
+        nb_bytes -= size_t(n);
+    }
+    return true;
+#else
+    (void)fd; (void)data; (void)nb_bytes;
+    return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+
+/// @param[out] nb_read : bytes read before a failure
+bool read_all(int fd, void* data, size_t nb_bytes, size_t& nb_read)
+{
+    nb_read = 0;
+#ifndef _WIN32
+    char* ptr = (char*)data;
+    while( nb_read < nb_bytes ) {
+        ssize_t n = ::read(fd, ptr + nb_read, nb_bytes - nb_read);
+        if( n < 0 && errno == EINTR )
+            continue;
+        if( n <= 0 )
+            return false;
+        nb_read += size_t(n);
+    }
+    return true;
+#else
+    (void)fd; (void)data; (void)nb_bytes;
+    return false;
+#endif
+}
+
+bool read_all(int fd, void* data, size_t nb_bytes)
+{
+    size_t nb_read = 0;
+    return read_all(fd, data, nb_bytes, nb_read);
+}
+
+// -----------------------------------------------------------------------------
+
+bool write_field(int fd, uint32_t tag, const void* data, size_t nb_bytes)
+{
+    Field_header header = {tag, 0, uint64_t(nb_bytes)};
+    return write_all(fd, &header, sizeof(header)) &&
+           (nb_bytes == 0 || write_all(fd, data, nb_bytes));
+}
+
+bool write_field(int fd, uint32_t tag, const std::string& str)
+{
+    return write_field(fd, tag, str.data(), str.size());
+}
+
+template<class T>
+bool write_field(int fd, uint32_t tag, const std::vector<T>& array)
+{
+    return write_field(fd, tag, array.data(), array.size() * sizeof(T));
+}
+
+bool write_field(int fd, uint32_t tag, uint32_t val)
+{
+    return write_field(fd, tag, &val, sizeof(val));
+}
+
+bool write_end(int fd)
+{
+    return write_field(fd, eFIELD_END, nullptr, 0);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Read the payload of a field into 'str'
+bool read_payload(int fd, uint64_t nb_bytes, std::string& str)
+{
+    str.resize( size_t(nb_bytes) );
+    return nb_bytes == 0 || read_all(fd, &str[0], size_t(nb_bytes));
+}
+
+template<class T>
+bool read_payload(int fd, uint64_t nb_bytes, std::vector<T>& array, uint32_t tag)
+{
+    if( nb_bytes % sizeof(T) != 0 ) {
+        std::cerr << "Solve protocol: size of field " << tag << " is not a multiple of ";
+        std::cerr << sizeof(T) << " bytes" << std::endl;
+        return false;
+    }
+    array.resize( size_t(nb_bytes / sizeof(T)) );
+    return nb_bytes == 0 || read_all(fd, array.data(), size_t(nb_bytes));
+}
+
+bool read_payload(int fd, uint64_t nb_bytes, uint32_t& val, uint32_t tag)
+{
+    if( nb_bytes != sizeof(val) ) {
+        std::cerr << "Solve protocol: field " << tag << " should hold 4 bytes" << std::endl;
+        return false;
+    }
+    return read_all(fd, &val, sizeof(val));
+}
+
+/// Read and drop the payload of an unknown field
+bool skip_payload(int fd, uint64_t nb_bytes)
+{
+    char buff[4096];
+    while( nb_bytes > 0 ) {
+        size_t n = size_t(std::min<uint64_t>(nb_bytes, sizeof(buff)));
+        if( !read_all(fd, buff, n) )
+            return false;
+        nb_bytes -= n;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// @param[out] closed : set when the stream ends cleanly before the header
+/// @param[in,out] budget : bytes the remaining fields of the message may
+/// hold, the payload of 'header' is subtracted
+bool read_header(int fd, Field_header& header, bool* closed, uint64_t& budget)
+{
+    size_t nb_read = 0;
+    if( !read_all(fd, &header, sizeof(header), nb_read) ) {
+        if( closed != nullptr && nb_read == 0 )
+            *closed = true;
+        else
+            std::cerr << "Solve protocol: connection closed in the middle of a message" << std::endl;
+        return false;
+    }
+    if( header._nb_bytes > budget ) {
+        std::cerr << "Solve protocol: field " << header._tag << " too large (";
+        std::cerr << header._nb_bytes << " bytes, " << budget << " left for the message)" << std::endl;
+        return false;
+    }
+    budget -= header._nb_bytes;
+    return true;
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+bool send_request(int fd, const Request& request)
+{
+    bool ok = write_field(fd, eFIELD_COMMAND, request._command) &&
+              write_field(fd, eFIELD_FLAGS, request._flags);
+    if( ok && !request._mesh_path.empty() )
+        ok = write_field(fd, eFIELD_MESH_PATH, request._mesh_path);
+    if( ok && request._mesh_path.empty() && !request._vertices.empty() )
+        ok = write_field(fd, eFIELD_VERTICES, request._vertices) &&
+             write_field(fd, eFIELD_TRIANGLES, request._triangles);
+    if( ok && !request._boundary_spec.empty() )
+        ok = write_field(fd, eFIELD_BOUNDARY_SPEC, request._boundary_spec);
+    if( ok && !request._boundaries.empty() )
+        ok = write_field(fd, eFIELD_BOUNDARIES, request._boundaries);
+    if( ok && !request._solver.empty() )
+        ok = write_field(fd, eFIELD_SOLVER, request._solver);
+    return ok && write_end(fd);
+}
+
+// -----------------------------------------------------------------------------
+
+bool receive_request(int fd, Request& request, bool& closed, uint64_t max_bytes)
+{
+    request = Request();
+    closed = false;
+    bool first = true;
+    uint64_t budget = max_bytes;
+    while( true ) {
+        Field_header header;
+        if( !read_header(fd, header, first ? &closed : nullptr, budget) )
+            return false;
+        first = false;
+
+        bool ok = true;
+        switch( header._tag ) {
+        case eFIELD_END:           return true;
+        case eFIELD_COMMAND:       ok = read_payload(fd, header._nb_bytes, request._command); break;
+        case eFIELD_MESH_PATH:     ok = read_payload(fd, header._nb_bytes, request._mesh_path); break;
+        case eFIELD_VERTICES:      ok = read_payload(fd, header._nb_bytes, request._vertices, header._tag); break;
+        case eFIELD_TRIANGLES:     ok = read_payload(fd, header._nb_bytes, request._triangles, header._tag); break;
+        case eFIELD_BOUNDARY_SPEC: ok = read_payload(fd, header._nb_bytes, request._boundary_spec); break;
+        case eFIELD_BOUNDARIES:    ok = read_payload(fd, header._nb_bytes, request._boundaries, header._tag); break;
+        case eFIELD_SOLVER:        ok = read_payload(fd, header._nb_bytes, request._solver); break;
+        case eFIELD_FLAGS:         ok = read_payload(fd, header._nb_bytes, request._flags, header._tag); break;
+        default:                   ok = skip_payload(fd, header._nb_bytes); break;
+        }
+        if( !ok )
+            return false;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+bool send_response(int fd, const Response& response)
+{
+    bool ok = write_field(fd, eFIELD_STATUS, response._status) &&
+              write_field(fd, eFIELD_RESIDENT, response._resident) &&
+              write_field(fd, eFIELD_TIMINGS, response._timings);
+    if( ok && !response._error.empty() )
+        ok = write_field(fd, eFIELD_ERROR, response._error);
+    if( ok && !response._text.empty() )
+        ok = write_field(fd, eFIELD_TEXT, response._text);
+    if( ok && !response._weights.empty() )
+        ok = write_field(fd, eFIELD_WEIGHTS, response._weights);
+    return ok && write_end(fd);
+}
+
+// -----------------------------------------------------------------------------
+
+bool receive_response(int fd, Response& response)
+{
+    response = Response();
+    uint64_t budget = g_max_response_bytes;
+    while( true ) {
+        Field_header header;
+        if( !read_header(fd, header, nullptr, budget) )
+            return false;
+
+        bool ok = true;
+        switch( header._tag ) {
+        case eFIELD_END:      return true;
+        case eFIELD_STATUS:   ok = read_payload(fd, header._nb_bytes, response._status, header._tag); break;
+        case eFIELD_RESIDENT: ok = read_payload(fd, header._nb_bytes, response._resident, header._tag); break;
+        case eFIELD_ERROR:    ok = read_payload(fd, header._nb_bytes, response._error); break;
+        case eFIELD_TEXT:     ok = read_payload(fd, header._nb_bytes, response._text); break;
+        case eFIELD_WEIGHTS:  ok = read_payload(fd, header._nb_bytes, response._weights, header._tag); break;
+        case eFIELD_TIMINGS:
+            ok = read_payload(fd, header._nb_bytes, response._timings, header._tag);
+            response._timings.resize(eNB_TIMINGS, 0.);
+            break;
+        default:              ok = skip_payload(fd, header._nb_bytes); break;
+        }
+        if( !ok )
+            return false;
+    }
+}
+
+// =============================================================================
+// Unix domain sockets
+// =============================================================================
+
+#ifndef _WIN32
+
+/// Fill the address of 'path'
+/// @return false if the path is too long
+static bool socket_address(const std::string& path, sockaddr_un& addr)
+{
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if( path.size() >= sizeof(addr.sun_path) ) {
+        std::cerr << "Socket path too long: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+int listen_unix_socket(const std::string& path)
+{
+    sockaddr_un addr;
+    if( !socket_address(path, addr) )
+        return -1;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if( fd < 0 ) {
+        std::cerr << "Can't create a socket: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+    // Replace the socket file of a previous run (but nothing else)
+    struct stat st;
+    if( ::stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) )
+        ::unlink(path.c_str());
+    if( ::bind(fd, (const sockaddr*)&addr, sizeof(addr)) != 0 ||
+        ::listen(fd, 64) != 0 )
+    {
+        std::cerr << "Can't listen on " << path << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// -----------------------------------------------------------------------------
+
+int connect_unix_socket(const std::string& path)
+{
+    sockaddr_un addr;
+    if( !socket_address(path, addr) )
+        return -1;
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if( fd < 0 ) {
+        std::cerr << "Can't create a socket: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+    if( ::connect(fd, (const sockaddr*)&addr, sizeof(addr)) != 0 ) {
+        std::cerr << "Can't connect to " << path << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// -----------------------------------------------------------------------------
+
+int accept_connection(int listen_fd)
+{
+    while( true ) {
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if( fd >= 0 || errno != EINTR )
+            return fd;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void close_socket(int fd)
+{
+    if( fd >= 0 )
+        ::close(fd);
+}
+
+// -----------------------------------------------------------------------------
+
+void shutdown_socket(int fd)
+{
+    if( fd >= 0 )
+        ::shutdown(fd, SHUT_RDWR);
+}
+
+// -----------------------------------------------------------------------------
+
+void remove_unix_socket(const std::string& path)
+{
+    struct stat st;
+    if( ::stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode) )
+        ::unlink(path.c_str());
+}
+
+#else
+
+int listen_unix_socket(const std::string& path)
+{
+    std::cerr << "Can't listen on " << path << ": Unix domain sockets are not supported on Windows" << std::endl;
+    return -1;
+}
+
+int connect_unix_socket(const std::string& path)
+{
+    std::cerr << "Can't connect to " << path << ": Unix domain sockets are not supported on Windows" << std::endl;
+    return -1;
+}
+
+int accept_connection(int) { return -1; }
+
+void close_socket(int) { }
+
+void shutdown_socket(int) { }
+
+void remove_unix_socket(const std::string&) { }
+
+#endif
+
+}// END Solve_protocol NAMESPACE ===============================================
@@ -0,0 +1,148 @@
+#ifndef SOLVE_PROTOCOL_HPP
+#define SOLVE_PROTOCOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "mesh.hpp"
+
+/**
+ * @brief Binary protocol of the solve service (service/solve_service.hpp)
+ * over a Unix domain socket.
+ *
+ * A message is a list of fields closed by eFIELD_END, each field being:
+ * @code
+ * [uint32 tag][uint32 0][uint64 nb_bytes][payload of nb_bytes]
+ * @endcode
+ * in the byte order of the host (the socket is local). A connection carries
+ * any number of request / response pairs, the client sends a request then
+ * reads its response. Unknown fields are skipped so that older peers can
+ * talk to newer ones.
+ */
+namespace Solve_protocol {
+
+enum Field {
+    eFIELD_END = 0,
+    // Request
+    eFIELD_COMMAND,       ///< string "solve" (default), "stats" or "shutdown"
+    eFIELD_MESH_PATH,     ///< string, file or "gen:" mesh read by the service
+    eFIELD_VERTICES,      ///< Vec3[] inline mesh (when there is no path)
+    eFIELD_TRIANGLES,     ///< Tri_face[] inline mesh
+    eFIELD_BOUNDARY_SPEC, ///< string, preset of set_boundaries()
+    eFIELD_BOUNDARIES,    ///< std::pair<Vert_idx, float>[] explicit conditions
+    eFIELD_SOLVER,        ///< string, see parse_solver_options()
+    eFIELD_FLAGS,         ///< uint32 Request_flags
+    // Response
+    eFIELD_STATUS = 64,   ///< uint32 Status
+    eFIELD_ERROR,         ///< string
+    eFIELD_TEXT,          ///< string, answer to "stats"
+    eFIELD_WEIGHTS,       ///< double[], one weight per vertex
+    eFIELD_TIMINGS,       ///< double[eNB_TIMINGS] seconds spent by the service
+    eFIELD_RESIDENT       ///< uint32 Resident_flags
+};
+
+enum Request_flags {
+    /// Build the Laplacian from the triangles (see '--triangles')
+    eTRIANGLE_LAPLACIAN = 1
+};
+
+enum Status {
+    eSTATUS_OK = 0,
+    eSTATUS_FAILED
+};
+
+/// What the service found already in memory
+enum Resident_flags {
+    eRESIDENT_MESH = 1,    ///< mesh and topology
+    eRESIDENT_WEIGHTS = 2, ///< same solve already done
+    eRESIDENT_FACTOR = 4   ///< factorization of the same system
+};
+
+/// Entries of eFIELD_TIMINGS
+enum Timing {
+    eTIMING_MESH = 0, ///< load or reuse of the mesh and its topology
+    eTIMING_LAPLACIAN,
+    eTIMING_ASSEMBLY,
+    eTIMING_FACTORIZATION,
+    eTIMING_SOLVE,
+    eTIMING_TOTAL,
+    eNB_TIMINGS
+};
+
+// -----------------------------------------------------------------------------
+
+struct Request {
+    Request() : _command("solve"), _flags(0) { }
+
+    std::string _command;
+    /// Mesh loaded by the service, when empty _vertices and _triangles are
+    /// the mesh
+    std::string _mesh_path;
+    std::vector<Vec3> _vertices;
+    std::vector<Tri_face> _triangles;
+    /// Preset of set_boundaries(), when empty _boundaries is used
+    std::string _boundary_spec;
+    std::vector<std::pair<Vert_idx, float> > _boundaries;
+    /// Empty for the default solver
+    std::string _solver;
+    uint32_t _flags;
+};
+
+struct Response {
+    Response() : _status(eSTATUS_OK), _resident(0), _timings(eNB_TIMINGS, 0.) { }
+
+    uint32_t _status;
+    std::string _error;
+    std::string _text;
+    std::vector<double> _weights;
+    uint32_t _resident;
+    std::vector<double> _timings;
+};
+
+// -----------------------------------------------------------------------------
+/// @name Messages
+/// All return false when the connection is closed or broken, or when the
+/// message is invalid (message printed on std::cerr)
+// -----------------------------------------------------------------------------
+
+bool send_request(int fd, const Request& request);
+
+/// @param[out] closed : true if the peer closed the connection before
+/// the first byte of the request (not an error)
+/// @param max_bytes : requests whose fields hold more bytes are rejected
+/// before allocating them (the service passes its memory cap)
+bool receive_request(int fd, Request& request, bool& closed, uint64_t max_bytes);
+
+/// The weights are sent straight from 'response._weights' (no copy)
+bool send_response(int fd, const Response& response);
+
+bool receive_response(int fd, Response& response);
+
+// -----------------------------------------------------------------------------
+/// @name Unix domain sockets (not available on Windows)
+// -----------------------------------------------------------------------------
+
+/// Bind and listen on 'path', a stale socket file is replaced
+/// @return the socket or -1 on error
+int listen_unix_socket(const std::string& path);
+
+/// @return the connected socket or -1 on error
+int connect_unix_socket(const std::string& path);
+
+/// @return connected socket of the next client, -1 on error
+int accept_connection(int listen_fd);
+
+void close_socket(int fd);
+
+/// Stop the reads and writes of 'fd', blocked calls return
+void shutdown_socket(int fd);
+
+/// Delete the socket file created by listen_unix_socket()
+void remove_unix_socket(const std::string& path);
+
+}// END Solve_protocol NAMESPACE ===============================================
+
+#endif // SOLVE_PROTOCOL_HPP
@@ -0,0 +1,455 @@
+#include "service/solve_service.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "boundary_conditions.hpp"
+#include "boundary_spec.hpp"
+#include "solvers.hpp"
+#include "io/mesh_cache.hpp"
+#include "io/solve_cache.hpp"
+#include "topology/vertex_to_1st_ring_vertices.hpp"
+#include "topology/vertex_to_face.hpp"
+#include "utils/hash.hpp"
+#include "utils/thread_pool.hpp"
+#include "utils/timer.hpp"
+#include "utils/trace.hpp"
+
+using namespace Solve_protocol;
+
+// -----------------------------------------------------------------------------
+
+struct Solve_service::Resident_mesh {
+    Resident_mesh() : _loaded(false), _listed(true), _bytes(0), _file_size(0), _file_time(0) { }
+
+    /// "path:<mesh path>" or "inline:<hash of the arrays>"
+    std::string _key;
+    Mesh _mesh;
+    /// First rings, empty until a request needs them
+    std::vector< std::vector<int> > _rings;
+    /// Built by the first request with a declarative boundary spec
+    Spatial_index _index;
+    /// Guards the loading of _mesh, _rings and _index, all read only afterwards
+    std::mutex _mutex;
+    bool _loaded;
+    /// Still in Solve_service::_meshes (guarded by Solve_service::_mutex)
+    bool _listed;
+    /// Counted in Solve_service::_mesh_bytes
+    size_t _bytes;
+    /// Size and modification time of the mesh file when it was looked up,
+    /// a mesh file rewritten since is loaded again (0 for inline meshes)
+    uint64_t _file_size;
+    uint64_t _file_time;
+};
+
+// -----------------------------------------------------------------------------
+
+Solve_service::Solve_service(size_t memory_cap)
+    : _memory_cap(memory_cap)
+    , _mesh_bytes(0)
+    , _nb_requests(0)
+    , _nb_mesh_hits(0)
+{
+    // Factorizations and weights stay in memory, and on disk when a
+    // directory was set beforehand
+    set_solve_cache_enabled(true);
+    set_solve_cache_memory(memory_cap);
+}
+
+// -----------------------------------------------------------------------------
+
+/// @return false if a triangle of the inline mesh of 'request' is invalid
+static bool check_inline_mesh(const Request& request, std::string& error)
+{
+    if( request._vertices.empty() || request._triangles.empty() ) {
+        error = "No mesh path nor inline mesh in the request";
+        return false;
+    }
+    int nv = int(request._vertices.size());
+    for(const Tri_face& f : request._triangles) {
+        if( f.a < 0 || f.b < 0 || f.c < 0 || f.a >= nv || f.b >= nv || f.c >= nv ) {
+            error = "Inline mesh: triangle vertex out of range";
+            return false;
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Size and modification time of 'mesh_path' (0 if it can't be read, the
+/// load fails later on)
+static void file_stamp(const std::string& mesh_path, uint64_t& size, uint64_t& time)
+{
+    size = 0;
+    time = 0;
+    std::error_code err;
+    uint64_t nb_bytes = uint64_t( std::filesystem::file_size(mesh_path, err) );
+    if( err ) return;
+    std::filesystem::file_time_type t = std::filesystem::last_write_time(mesh_path, err);
+    if( err ) return;
+    size = nb_bytes;
+    time = uint64_t( t.time_since_epoch().count() );
+}
+
+// -----------------------------------------------------------------------------
+
+std::shared_ptr<const Solve_service::Resident_mesh>
+Solve_service::acquire_mesh(const Request& request, bool& resident, std::string& error)
+{
+    Trace_scope trace("acquire_mesh");
+    std::string key;
+    uint64_t file_size = 0, file_time = 0;
+    if( !request._mesh_path.empty() ) {
+        key = "path:" + request._mesh_path;
+        file_stamp(request._mesh_path, file_size, file_time);
+    } else {
+        if( !check_inline_mesh(request, error) )
+            return nullptr;
+        Hasher h;
+        h.add( request._vertices );
+        h.add( request._triangles );
+        key = "inline:" + h.digest().hex();
+    }
+    bool need_rings = (request._flags & eTRIANGLE_LAPLACIAN) == 0;
+    bool need_index = is_boundary_spec_json( request._boundary_spec.c_str() );
+
+    std::shared_ptr<Resident_mesh> entry;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(auto it = _meshes.begin(); it != _meshes.end(); ++it) {
+            if( (*it)->_key != key )
+                continue;
+            if( (*it)->_file_size == file_size && (*it)->_file_time == file_time ) {
+                _meshes.splice(_meshes.begin(), _meshes, it);
+                entry = _meshes.front();
+            } else {
+                // The file changed: requests still using the old mesh keep
+                // it until they are done
+                (*it)->_listed = false;
+                _mesh_bytes -= (*it)->_bytes;
+                _meshes.erase( it );
+            }
+            break;
+        }
+        if( entry == nullptr ) {
+            entry = std::make_shared<Resident_mesh>();
+            entry->_key = key;
+            entry->_file_size = file_size;
+            entry->_file_time = file_time;
+            _meshes.push_front( entry );
+        }
+    }
+
+    // Other requests on the same mesh wait for the first one to load it
+    std::lock_guard<std::mutex> lock_entry(entry->_mutex);
+    resident = entry->_loaded && (!need_rings || !entry->_rings.empty()) &&
+               (!need_index || entry->_index.nb_vertices() > 0);
+    if( !entry->_loaded ) {
+        if( !request._mesh_path.empty() ) {
+            std::unique_ptr<Mesh> mesh( build_mesh(request._mesh_path.c_str(), nullptr, nullptr,
+                                                   need_rings ? &entry->_rings : nullptr) );
+            if( mesh != nullptr )
+                std::swap(entry->_mesh, *mesh);
+        } else {
+            entry->_mesh._vertices = request._vertices;
+            entry->_mesh._triangles = request._triangles;
+        }
+        if( entry->_mesh._vertices.empty() ) {
+            error = "Can't load the mesh " + request._mesh_path;
+            std::lock_guard<std::mutex> lock(_mutex);
+            if( entry->_listed ) {
+                _meshes.remove( entry );
+                entry->_listed = false;
+            }
+            return nullptr;
+        }
+        entry->_loaded = true;
+    }
+    if( need_rings && entry->_rings.empty() ) {
+        Trace_scope trace_topology("topology");
+        if( request._mesh_path.empty() ||
+            !load_cached_rings(request._mesh_path.c_str(), entry->_rings) )
+        {
+            Vertex_to_face v_to_face;
+            Vertex_to_1st_ring_vertices first_ring;
+            v_to_face.compute( entry->_mesh );
+            first_ring.compute(entry->_mesh, v_to_face);
+            entry->_rings.swap( first_ring._rings_per_vertex );
+        }
+    }
+    if( need_index && entry->_index.nb_vertices() == 0 )
+        entry->_index.build( entry->_mesh );
+
+    size_t bytes = entry->_mesh.memory_bytes() + heap_bytes(entry->_rings) + entry->_index.bytes();
+    std::lock_guard<std::mutex> lock(_mutex);
+    if( entry->_listed ) {
+        _mesh_bytes += bytes - entry->_bytes;
+        entry->_bytes = bytes;
+    }
+    if( resident )
+        _nb_mesh_hits++;
+    trim();
+    return entry;
+}
+
+// -----------------------------------------------------------------------------
+
+void Solve_service::trim()
+{
+    // The front mesh is the one being used, keep it whatever its size
+    while( _meshes.size() > 1 &&
+           _mesh_bytes + solve_cache_stats()._memory_bytes > _memory_cap )
+    {
+        std::shared_ptr<Resident_mesh> last = _meshes.back();
+        _meshes.pop_back();
+        last->_listed = false;
+        _mesh_bytes -= last->_bytes;
+    }
+    set_solve_cache_memory(_mesh_bytes < _memory_cap ? _memory_cap - _mesh_bytes : 0);
+}
+
+// -----------------------------------------------------------------------------
+
+void Solve_service::process(const Request& request, Response& response)
+{
+    Trace_scope trace("process_request");
+    Timer total;
+    Timer timer;
+    response = Response();
+    auto fail = [&](const std::string& message) {
+        response._status = eSTATUS_FAILED;
+        response._error = message;
+        response._timings[eTIMING_TOTAL] = total.elapsed();
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _nb_requests++;
+    }
+    if( request._command == "stats" ) {
+        response._text = stats();
+        return;
+    }
+    if( request._command != "solve" ) {
+        fail("Unknown command '" + request._command + "' (expected solve, stats or shutdown)");
+        return;
+    }
+
+    Solver_options options;
+    if( !request._solver.empty() && !parse_solver_options(request._solver.c_str(), options) ) {
+        fail("Invalid solver '" + request._solver + "'");
+        return;
+    }
+
+    bool resident = false;
+    std::string error;
+    std::shared_ptr<const Resident_mesh> entry = acquire_mesh(request, resident, error);
+    if( entry == nullptr ) {
+        fail(error);
+        return;
+    }
+    const Mesh& mesh = entry->_mesh;
+    response._timings[eTIMING_MESH] = timer.lap();
+
+    std::vector<std::pair<Vert_idx, float> > spec_boundaries;
+    const std::vector<std::pair<Vert_idx, float> >* boundaries = &request._boundaries;
+    if( !request._boundary_spec.empty() ) {
+        if( !set_boundaries(request._boundary_spec.c_str(), mesh, spec_boundaries, &entry->_index) ) {
+            fail("Invalid boundary preset '" + request._boundary_spec + "'");
+            return;
+        }
+        boundaries = &spec_boundaries;
+    }
+    if( boundaries->empty() ) {
+        fail("No boundary condition");
+        return;
+    }
+    for(const std::pair<Vert_idx, float>& b : *boundaries) {
+        if( b.first < 0 || b.first >= int(mesh.nb_vertices()) ) {
+            fail("Boundary vertex out of range");
+            return;
+        }
+    }
+
+    static const std::vector< std::vector<int> > no_rings;
+    bool use_triangles = (request._flags & eTRIANGLE_LAPLACIAN) != 0;
+    Solve_timings time;
+    if( !solve_laplace_equation(mesh._vertices,
+                                use_triangles ? no_rings : entry->_rings,
+                                mesh._triangles,
+                                *boundaries,
+                                response._weights,
+                                &time,
+                                &options) )
+    {
+        response._weights.clear();
+        fail("Solve failed (see the log of the service)");
+        return;
+    }
+
+    response._resident = (resident ? eRESIDENT_MESH : 0) |
+                         (time._cached_weights ? eRESIDENT_WEIGHTS : 0) |
+                         (time._cached_factor ? eRESIDENT_FACTOR : 0);
+    response._timings[eTIMING_LAPLACIAN] = time._laplacian;
+    response._timings[eTIMING_ASSEMBLY] = time._planning + time._assembly;
+    response._timings[eTIMING_FACTORIZATION] = time._factorization;
+    response._timings[eTIMING_SOLVE] = time._solve;
+    response._timings[eTIMING_TOTAL] = total.elapsed();
+
+    // The solve cache may have grown
+    std::lock_guard<std::mutex> lock(_mutex);
+    trim();
+}
+
+// -----------------------------------------------------------------------------
+
+std::string Solve_service::stats() const
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+    Solve_cache_stats cache = solve_cache_stats();
+    char buff[512];
+    std::snprintf(buff, sizeof(buff),
+                  "requests: %zu\n"
+                  "resident meshes: %zu (%.1f MB, %zu hits)\n"
+                  "solve cache: %.1f MB, factors %zu hits / %zu misses, weights %zu hits / %zu misses\n"
+                  "memory cap: %.1f MB\n",
+                  _nb_requests,
+                  _meshes.size(), double(_mesh_bytes) / (1024. * 1024.), _nb_mesh_hits,
+                  double(cache._memory_bytes) / (1024. * 1024.),
+                  cache._factor_hits, cache._factor_misses,
+                  cache._result_hits, cache._result_misses,
+                  double(_memory_cap) / (1024. * 1024.));
+    std::string str = buff;
+    for(const std::shared_ptr<Resident_mesh>& entry : _meshes) {
+        std::snprintf(buff, sizeof(buff), "  %-40s %8.1f MB\n",
+                      entry->_key.c_str(), double(entry->_bytes) / (1024. * 1024.));
+        str += buff;
+    }
+    return str;
+}
+
+// =============================================================================
+
+namespace {
+
+/// Connections being served, shut down to wake up their threads on exit
+struct Connections {
+    Connections() : _nb_threads(0) { }
+
+    std::mutex _mutex;
+    std::condition_variable _closed;
+    std::set<int> _fds;
+    int _nb_threads; ///< threads of serve_connection() still running
+};
+
+// -----------------------------------------------------------------------------
+
+/// Run service.process() on a worker of 'pool' and wait for it
+void process_on_pool(Thread_pool& pool,
+                     Solve_service& service,
+                     const Request& request,
+                     Response& response)
+{
+    std::mutex mutex;
+    std::condition_variable cond;
+    bool done = false;
+    pool.submit([&] {
+        service.process(request, response);
+        // Notified under the lock: 'cond' lives until the waiter sees 'done'
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cond.notify_one();
+    });
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&]{ return done; });
+}
+
+// -----------------------------------------------------------------------------
+
+/// Answer the requests of one client until it disconnects, on a thread of
+/// its own: waiting for the next request does not hold a worker of 'pool',
+/// which only runs process()
+void serve_connection(int fd,
+                      Solve_service& service,
+                      Thread_pool& pool,
+                      Connections& connections,
+                      std::atomic<bool>& stop,
+                      const Server_options& options)
+{
+    Request request;
+    Response response;
+    bool closed = false;
+    // A request can't hold more than the memory given to the service
+    while( !stop && receive_request(fd, request, closed, options._memory_cap) )
+    {
+        if( request._command == "shutdown" ) {
+            response = Response();
+            send_response(fd, response);
+            stop = true;
+            // Wake up the accept() of run_solve_server()
+            close_socket( connect_unix_socket(options._socket_path) );
+            break;
+        }
+        process_on_pool(pool, service, request, response);
+        if( !send_response(fd, response) )
+            break;
+    }
+
+    std::lock_guard<std::mutex> lock(connections._mutex);
+    connections._fds.erase( fd );
+    close_socket( fd );
+    connections._nb_threads--;
+    connections._closed.notify_all();
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+bool run_solve_server(const Server_options& options)
+{
+    int listen_fd = listen_unix_socket(options._socket_path);
+    if( listen_fd < 0 )
+        return false;
+
+    Solve_service service(options._memory_cap);
+    Connections connections;
+    std::atomic<bool> stop(false);
+    {
+        Thread_pool pool(options._nb_workers);
+        while( !stop ) {
+            int fd = accept_connection(listen_fd);
+            if( fd < 0 ) {
+                std::cerr << "Solve service: accept failed" << std::endl;
+                break;
+            }
+            if( stop ) {
+                close_socket( fd );
+                break;
+            }
+            {
+                std::lock_guard<std::mutex> lock(connections._mutex);
+                connections._fds.insert( fd );
+                connections._nb_threads++;
+            }
+            std::thread([fd, &service, &pool, &connections, &stop, &options] {
+                serve_connection(fd, service, pool, connections, stop, options);
+            }).detach();
+        }
+        stop = true;
+        // Idle clients are blocked reading their next request, the others
+        // finish the request in progress
+        std::unique_lock<std::mutex> lock(connections._mutex);
+        for(int fd : connections._fds)
+            shutdown_socket( fd );
+        connections._closed.wait(lock, [&]{ return connections._nb_threads == 0; });
+    }
+    close_socket( listen_fd );
+    remove_unix_socket( options._socket_path );
+    return true;
+}
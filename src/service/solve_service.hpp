@@ -0,0 +1,85 @@
+#ifndef SOLVE_SERVICE_HPP
+#define SOLVE_SERVICE_HPP
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "service/solve_protocol.hpp"
+
+/**
+ * @brief Long running solver answering Solve_protocol requests, so that
+ * repeated queries on the same asset skip loading, topology and
+ * factorization.
+ *
+ * Meshes (referenced by path or sent inline) stay resident with their first
+ * rings in a LRU, a mesh file whose size or modification time changed is
+ * loaded again. Weights and ldlt / llt factorizations are kept by the solve
+ * cache (io/solve_cache.hpp) in memory, and on disk when a directory is set.
+ * Both share a single memory cap: the oldest meshes are dropped first, then
+ * the solve cache gets what remains.
+ *
+ * process() is thread safe. run_solve_server() reads each connection on a
+ * thread of its own and calls process() from a pool of threads, so idle
+ * clients don't hold a worker.
+ */
+class Solve_service {
+public:
+    /// @param memory_cap : bytes of the resident meshes plus the in-memory
+    /// solve cache
+    explicit Solve_service(size_t memory_cap);
+
+    /// Answer one request (commands "solve" and "stats")
+    void process(const Solve_protocol::Request& request,
+                 Solve_protocol::Response& response);
+
+    /// Resident meshes, memory and number of requests
+    std::string stats() const;
+
+private:
+    struct Resident_mesh;
+
+    /// Find or load the mesh of 'request' and its first rings when needed
+    /// @return nullptr on error ('error' is set)
+    std::shared_ptr<const Resident_mesh> acquire_mesh(const Solve_protocol::Request& request,
+                                                      bool& resident,
+                                                      std::string& error);
+
+    /// Evict meshes above the memory cap and give the rest to the solve cache
+    /// (_mutex locked by the caller)
+    void trim();
+
+    size_t _memory_cap;
+    mutable std::mutex _mutex;
+    /// Most recently used first
+    std::list<std::shared_ptr<Resident_mesh>> _meshes;
+    size_t _mesh_bytes;
+    size_t _nb_requests;
+    size_t _nb_mesh_hits;
+};
+
+// -----------------------------------------------------------------------------
+
+struct Server_options {
+    Server_options()
+        : _nb_workers(0)
+        , _memory_cap(size_t(2) << 30)
+    { }
+
+    std::string _socket_path;
+    /// Requests processed at the same time, whatever the number of
+    /// connections (0: every hardware thread)
+    unsigned _nb_workers;
+    /// Memory of the Solve_service, also the largest request accepted
+    size_t _memory_cap;
+};
+
+/// Listen on 'options._socket_path' and serve every connection (one reading
+/// thread each, requests processed on a pool of threads) until a client
+/// sends "shutdown"
+/// @return false if the socket can't be opened (message printed on std::cerr)
+bool run_solve_server(const Server_options& options);
+
+#endif // SOLVE_SERVICE_HPP
@@ -0,0 +1,99 @@
+#include "solve_async.hpp"
+
+#include <atomic>
+#include <functional>
+
+#include "utils/thread_pool.hpp"
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+std::atomic<unsigned> g_nb_threads(1);
+
+/// Created on the first solve and never destroyed: exiting the program
+/// does not wait for a running solve
+Thread_pool& worker_pool()
+{
+    static Thread_pool* pool = new Thread_pool( g_nb_threads );
+    return *pool;
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+void set_async_solve_threads(unsigned nb)
+{
+    g_nb_threads = std::max(nb, 1u);
+}
+
+// -----------------------------------------------------------------------------
+
+/// Run 'body' on the worker threads unless 'control' is cancelled before
+/// @param body : fills the weights and timings, returns false on failure
+static std::shared_future<Solve_result>
+submit(std::shared_ptr<Solve_control> control,
+       std::function<bool(Solve_control*, Solve_result&)> body)
+{
+    // std::function needs a copyable task
+    auto task = std::make_shared<std::packaged_task<Solve_result()>>([control, body]() {
+        Solve_result res;
+        if( control->is_cancelled() ) {
+            res._cancelled = true;
+            control->enter_phase( ePHASE_CANCELLED );
+            return res;
+        }
+        res._ok = body(control.get(), res);
+        res._cancelled = !res._ok && control->is_cancelled();
+        if( !res._ok )
+            res._weights.clear();
+        return res;
+    });
+    std::shared_future<Solve_result> future = task->get_future().share();
+    worker_pool().submit([task]() { (*task)(); });
+    return future;
+}
+
+// -----------------------------------------------------------------------------
+
+Solve_handle solve_laplace_equation_async(Solve_input input,
+                                          Solve_control::Callback on_progress)
+{
+    Solve_handle handle;
+    handle._control = std::make_shared<Solve_control>( on_progress );
+    std::shared_ptr<Solve_input> in = std::make_shared<Solve_input>( std::move(input) );
+    handle._future = submit(handle._control, [in](Solve_control* control, Solve_result& res) {
+        if( in->_retained != nullptr )
+            return in->_retained->solve(in->_vertices,
+                                        in->_edges,
+                                        in->_triangles,
+                                        in->_boundaries,
+                                        res._weights,
+                                        &res._timings,
+                                        &in->_options,
+                                        control);
+        return solve_laplace_equation(in->_vertices,
+                                      in->_edges,
+                                      in->_triangles,
+                                      in->_boundaries,
+                                      res._weights,
+                                      &res._timings,
+                                      &in->_options,
+                                      control);
+    });
+    return handle;
+}
+
+// -----------------------------------------------------------------------------
+
+Solve_handle resolve_laplace_equation_async(std::shared_ptr<Retained_solve> system,
+                                            std::vector<std::pair<Vert_idx, float> > boundaries,
+                                            Solve_control::Callback on_progress)
+{
+    Solve_handle handle;
+    handle._control = std::make_shared<Solve_control>( on_progress );
+    auto bounds = std::make_shared<std::vector<std::pair<Vert_idx, float> > >( std::move(boundaries) );
+    handle._future = submit(handle._control, [system, bounds](Solve_control* control, Solve_result& res) {
+        return system->resolve(*bounds, res._weights, &res._timings, control);
+    });
+    return handle;
+}
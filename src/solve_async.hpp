@@ -0,0 +1,120 @@
+#ifndef SOLVE_ASYNC_HPP
+#define SOLVE_ASYNC_HPP
+
+#include <future>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "mesh.hpp"
+#include "solvers.hpp"
+#include "solve_control.hpp"
+#include "retained_solve.hpp"
+
+/**
+ * @brief solve_laplace_equation() on a pool of worker threads, so that
+ * interactive tools keep running during the solve.
+ *
+ * @code
+ * Solve_input input;
+ * input._vertices = mesh._vertices;
+ * input._edges.swap( rings );
+ * input._boundaries = boundaries;
+ * Solve_handle job = solve_laplace_equation_async( std::move(input) );
+ * // ... every frame:
+ * Solve_progress p = job.progress();
+ * if( job.is_ready() ) use( job.get()._weights );
+ * // Boundaries changed: drop the stale solve without waiting for it
+ * job.cancel();
+ * @endcode
+ * Interactive tools keep the factorization with Solve_input::_retained,
+ * then only send new boundary values:
+ * @code
+ * input._retained = std::make_shared<Retained_solve>();
+ * std::shared_ptr<Retained_solve> system = input._retained;
+ * Solve_handle job = solve_laplace_equation_async( std::move(input) );
+ * // ... once done, a handle is dragged:
+ * job = resolve_laplace_equation_async(system, boundaries);
+ * @endcode
+ */
+
+/// Copy of the arguments of solve_laplace_equation(), owned by the job
+struct Solve_input {
+    std::vector< Vec3 > _vertices;
+    /// First rings (the Laplacian is built from _triangles when empty)
+    std::vector< std::vector<int> > _edges;
+    std::vector<Tri_face> _triangles;
+    std::vector<std::pair<Vert_idx, float> > _boundaries;
+    Solver_options _options;
+    /// When set the solve goes through Retained_solve::solve(): the
+    /// factorization stays there for resolve_laplace_equation_async()
+    std::shared_ptr<Retained_solve> _retained;
+};
+
+struct Solve_result {
+    Solve_result() : _ok(false), _cancelled(false) { }
+
+    bool _ok;
+    bool _cancelled;
+    std::vector<double> _weights;
+    Solve_timings _timings;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @brief Handle of an asynchronous solve, cheap to copy (copies share
+/// the same job)
+class Solve_handle {
+public:
+    Solve_handle() { }
+
+    /// false for a default constructed handle
+    bool valid() const { return _control != nullptr; }
+
+    Solve_progress progress() const { return _control->progress(); }
+
+    /// Ask the job to stop: a queued job won't start, a running one stops
+    /// at the next phase (or progress report of an iterative solver), see
+    /// Solve_control
+    void cancel() { _control->cancel(); }
+
+    /// @return true when get() won't block
+    bool is_ready() const {
+        return _future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+    }
+
+    /// Block until the job is over
+    const Solve_result& get() const { return _future.get(); }
+
+    std::shared_future<Solve_result> future() const { return _future; }
+
+private:
+    friend Solve_handle solve_laplace_equation_async(Solve_input input,
+                                                     Solve_control::Callback on_progress);
+    friend Solve_handle resolve_laplace_equation_async(std::shared_ptr<Retained_solve> system,
+                                                       std::vector<std::pair<Vert_idx, float> > boundaries,
+                                                       Solve_control::Callback on_progress);
+
+    std::shared_ptr<Solve_control> _control;
+    std::shared_future<Solve_result> _future;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Queue a solve on the worker threads
+/// @param on_progress : called by the worker on each phase change and
+/// iteration report (optional)
+Solve_handle solve_laplace_equation_async(Solve_input input,
+                                          Solve_control::Callback on_progress = nullptr);
+
+/// Queue Retained_solve::resolve(): new values on the boundary vertices of
+/// the system factorized by a previous solve (see Solve_input::_retained)
+Solve_handle resolve_laplace_equation_async(std::shared_ptr<Retained_solve> system,
+                                            std::vector<std::pair<Vert_idx, float> > boundaries,
+                                            Solve_control::Callback on_progress = nullptr);
+
+/// Number of solves running at the same time (default 1, the others wait
+/// in the queue). Only effective before the first asynchronous solve.
+void set_async_solve_threads(unsigned nb);
+
+#endif // SOLVE_ASYNC_HPP
@@ -0,0 +1,127 @@
+#ifndef SOLVE_CONTROL_HPP
+#define SOLVE_CONTROL_HPP
+
+#include <atomic>
+#include <functional>
+
+#include "utils/timer.hpp"
+
+/// Phases of solve_laplace_equation() in order
+enum Solve_phase {
+    ePHASE_QUEUED = 0,    ///< waiting for a thread (async solves)
+    ePHASE_LAPLACIAN,
+    ePHASE_PLANNING,      ///< "auto" solver only
+    ePHASE_ASSEMBLY,
+    ePHASE_FACTORIZATION, ///< or preconditioner setup
+    ePHASE_SOLVE,
+    ePHASE_DONE,
+    ePHASE_FAILED,
+    ePHASE_CANCELLED
+};
+
+/// @return e.g. "factorization"
+inline const char* solve_phase_name(Solve_phase phase)
+{
+    switch( phase ) {
+    case ePHASE_QUEUED:        return "queued";
+    case ePHASE_LAPLACIAN:     return "laplacian";
+    case ePHASE_PLANNING:      return "planning";
+    case ePHASE_ASSEMBLY:      return "assembly";
+    case ePHASE_FACTORIZATION: return "factorization";
+    case ePHASE_SOLVE:         return "solve";
+    case ePHASE_DONE:          return "done";
+    case ePHASE_FAILED:        return "failed";
+    case ePHASE_CANCELLED:     return "cancelled";
+    }
+    return "unknown";
+}
+
+// -----------------------------------------------------------------------------
+
+/// Snapshot of a running solve
+struct Solve_progress {
+    Solve_progress()
+        : _phase(ePHASE_QUEUED), _iterations(0), _residual(0.), _elapsed(0.)
+    { }
+
+    Solve_phase _phase;
+    int _iterations;   ///< done so far by iterative solvers
+    double _residual;  ///< relative residual after _iterations
+    double _elapsed;   ///< seconds since the control was created
+};
+
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Progress and cooperative cancellation of a solve_laplace_equation()
+ * running on another thread.
+ *
+ * The solve reads cancel() between phases, and every few hundred iterations
+ * of the iterative backends (a factorization in progress is not
+ * interrupted). It then returns false and the phase is ePHASE_CANCELLED.
+ * Every method is thread safe.
+ */
+class Solve_control {
+public:
+    typedef std::function<void(const Solve_progress&)> Callback;
+
+    /// @param on_progress : called by the solving thread on every phase
+    /// change and iteration report (optional)
+    explicit Solve_control(Callback on_progress = nullptr)
+        : _on_progress(on_progress)
+        , _cancelled(false)
+        , _phase(ePHASE_QUEUED)
+        , _iterations(0)
+        , _residual(0.)
+    { }
+
+    void cancel() { _cancelled = true; }
+    bool is_cancelled() const { return _cancelled; }
+
+    Solve_progress progress() const
+    {
+        Solve_progress p;
+        p._phase = Solve_phase( _phase.load() );
+        p._iterations = _iterations;
+        p._residual = _residual;
+        p._elapsed = _timer.elapsed();
+        return p;
+    }
+
+    /// @name Called by the solver
+    /// @{
+
+    /// @return false if the solve must stop (cancelled)
+    bool enter_phase(Solve_phase phase)
+    {
+        _phase = int(phase);
+        notify();
+        return !_cancelled;
+    }
+
+    /// @return false if the solve must stop (cancelled)
+    bool report_iterations(int iterations, double residual)
+    {
+        _iterations = iterations;
+        _residual = residual;
+        notify();
+        return !_cancelled;
+    }
+    /// @}
+
+private:
+    void notify()
+    {
+        if( _on_progress )
+            _on_progress( progress() );
+    }
+
+    Callback _on_progress;
+    Timer _timer;
+    std::atomic<bool> _cancelled;
+    std::atomic<int> _phase;
+    std::atomic<int> _iterations;
+    std::atomic<double> _residual;
+};
+
+#endif // SOLVE_CONTROL_HPP
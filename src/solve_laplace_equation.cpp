@@ -1,12 +1,19 @@
 #include "solvers.hpp"
 
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <Eigen/Core>
 #include <Eigen/Sparse>
 
-#include <Eigen/QR>
-#include <Eigen/LU>
-#include <Eigen/SparseLU>
+#include "solve_control.hpp"
+#include "solver_backend.hpp"
+#include "solver_planner.hpp"
+#include "io/solve_cache.hpp"
+#include "utils/memory_usage.hpp"
+#include "utils/timer.hpp"
+#include "utils/trace.hpp"
 
 #ifndef M_PI
     #define M_PI 3.14159265358979323846
@@ -14,12 +21,6 @@
 
 // -----------------------------------------------------------------------------
 
-typedef Eigen::Triplet<double, int> Triplet;
-/// declares a column-major sparse matrix type of double
-typedef Eigen::SparseMatrix<double> Sparse_mat;
-
-// -----------------------------------------------------------------------------
-
 /// Are angles obtuse between e0 and e1 (meaning a < PI/2)
 static bool check_obtuse(const Vec3& e0,
                          const Vec3& e1)
@@ -125,9 +126,92 @@ float angle_between(const Vec3& v1, const Vec3& v2)
 
 // -----------------------------------------------------------------------------
 
-/// @return A sparse representation of the Laplacian matrix 'L'
-/// list[ith_row][list of columns] = Triplet(ith_row, jth_column, matrix value)
+/// Compute the ith row of the Laplacian matrix from the first ring
+/// neighborhood of the vertex 'i'
 static
+void laplacian_row(int i,
+                   const std::vector< Vec3 >& vertices,
+                   const std::vector< std::vector<int> >& edges,
+                   std::vector<Triplet>& row)
+{
+    row.clear();
+    const Vec3 c_pos = vertices[i];
+
+    //get laplacian
+    double sum = 0.;
+    int nb_edges = edges[i].size();
+    for(int e = 0; e < nb_edges; ++e)
+    {
+        int next_edge = (e + 1           ) % nb_edges;
+        int prev_edge = (e + nb_edges - 1) % nb_edges;
+
+
+        /*                                 next_edge
+                                e ◀---v4---(cotan2)
+                               ◥ ◤         /
+                              /   \       /
+                             v2    v5    v3
+                            /       \   /
+                           /         \ ◣
+                    (cotan1)----v1---▶c_pos
+                   prev_edge
+        */
+        Vec3 v1 = c_pos - vertices[edges[i][prev_edge]];
+        Vec3 v3 = c_pos - vertices[edges[i][next_edge]];
+        double w = 0.0;
+        if(true)
+        {
+            /* Cotangent weights
+             * (may be negative and undesirable in certain situations)
+            */
+            Vec3 v2 = vertices[edges[i][e]] - vertices[edges[i][prev_edge]];
+            Vec3 v4 = vertices[edges[i][e]] - vertices[edges[i][next_edge]];
+
+            double cotan1 = (v1.dot(v2)) / (1e-6 + (v1.cross(v2)).norm() );
+            double cotan2 = (v3.dot(v4)) / (1e-6 + (v3.cross(v4)).norm() );
+
+            // TODO: check for edge cases such as
+            // the mesh corners and boundaries and adjust cotan weights
+            // appropriatly ...
+            w = (cotan1 + cotan2) * 0.5f;
+        } else {
+            // Mean value coordinations weights:
+            // doesn't really work something must be wrong
+            Vec3 v5 = c_pos - vertices[edges[i][e]];
+            v1.normalize();
+            v3.normalize();
+            float v5_norm = v5.normalize();
+            double tan1 = std::tan(angle_between(-v1, v5)*0.5f);
+            double tan2 = std::tan(angle_between(-v3, v5)*0.5f);
+            w = (tan1 + tan2) / (1e-6 + v5_norm);
+        }
+
+
+        // Disable / Enable multiplying against the inverse of
+        // the Mass matrix 'M':
+        if(false)
+        {
+            // If we want to return M^{-1}.L instead of just L
+            // Then we can do it here since its more efficient
+            // than building M^{-1} and then do the product M^{-1}.L
+            // Since we solve for harmonic weights
+            // M^{-1}.L = 0 can be simplified to L = 0
+            // and this step safely ignored
+            double area = get_cell_area(i, vertices, edges);
+            area = 1. / ((1e-10 + area));
+            w *= area;
+        }
+
+        sum += w;
+
+        row.push_back( Triplet(i, edges[i][e], w) );
+    }
+
+    row.push_back( Triplet(i, i, -sum) );
+}
+
+// -----------------------------------------------------------------------------
+
 std::vector<std::vector<Triplet>>
 get_laplacian(const std::vector< Vec3 >& vertices,
               const std::vector< std::vector<int> >& edges )
@@ -139,82 +223,34 @@ get_laplacian(const std::vector< Vec3 >& vertices,
         mat_elemts[i].reserve(10);
 
     for(int i = 0; i < nv; ++i)
-    {
-        const Vec3 c_pos = vertices[i];
-
-        //get laplacian
-        double sum = 0.;
-        int nb_edges = edges[i].size();
-        for(int e = 0; e < nb_edges; ++e)
-        {
-            int next_edge = (e + 1           ) % nb_edges;
-            int prev_edge = (e + nb_edges - 1) % nb_edges;
-
-
-            /*                                 next_edge
-                                    e ◀---v4---(cotan2)
-                                   ◥ ◤         /
-                                  /   \       /
-                                 v2    v5    v3
-                                /       \   /
-                               /         \ ◣
-                        (cotan1)----v1---▶c_pos
-                       prev_edge
-            */
-            Vec3 v1 = c_pos - vertices[edges[i][prev_edge]];
-            Vec3 v3 = c_pos - vertices[edges[i][next_edge]];
-            double w = 0.0;
-            if(true)
-            {
-                /* Cotangent weights
-                 * (may be negative and undesirable in certain situations)
-                */
-                Vec3 v2 = vertices[edges[i][e]] - vertices[edges[i][prev_edge]];
-                Vec3 v4 = vertices[edges[i][e]] - vertices[edges[i][next_edge]];
-
-                double cotan1 = (v1.dot(v2)) / (1e-6 + (v1.cross(v2)).norm() );
-                double cotan2 = (v3.dot(v4)) / (1e-6 + (v3.cross(v4)).norm() );
-
-                // TODO: check for edge cases such as
-                // the mesh corners and boundaries and adjust cotan weights
-                // appropriatly ...
-                w = (cotan1 + cotan2) * 0.5f;
-            } else {
-                // Mean value coordinations weights:
-                // doesn't really work something must be wrong
-                Vec3 v5 = c_pos - vertices[edges[i][e]];
-                v1.normalize();
-                v3.normalize();
-                float v5_norm = v5.normalize();
-                double tan1 = std::tan(angle_between(-v1, v5)*0.5f);
-                double tan2 = std::tan(angle_between(-v3, v5)*0.5f);
-                w = (tan1 + tan2) / (1e-6 + v5_norm);
-            }
+        laplacian_row(i, vertices, edges, mat_elemts[i]);
 
+    return mat_elemts;
+}
 
-            // Disable / Enable multiplying against the inverse of
-            // the Mass matrix 'M':
-            if(false)
-            {
-                // If we want to return M^{-1}.L instead of just L
-                // Then we can do it here since its more efficient
-                // than building M^{-1} and then do the product M^{-1}.L
-                // Since we solve for harmonic weights
-                // M^{-1}.L = 0 can be simplified to L = 0
-                // and this step safely ignored
-                double area = get_cell_area(i, vertices, edges);
-                area = 1. / ((1e-10 + area));
-                w *= area;
-            }
-
-            sum += w;
-
-            mat_elemts[i].push_back( Triplet(i, edges[i][e], w) );
-        }
+//------------------------------------------------------------------------------
 
-        mat_elemts[i].push_back( Triplet(i, i, -sum) );
-    }
-    return mat_elemts;
+/// Cotangent weight of the edge (i, j) of a triangle seen from its
+/// third vertex 'org'
+static inline
+float half_cotan_weight(const std::vector< Vec3 >& vertices,
+                        int i, int j, int org)
+{
+    /*
+                            j
+                           ◥
+                          /  \
+                         v2   \
+                        /      \
+                       /        \
+                (cotan)----v1---▶ i
+                   org
+    */
+    Vec3 v1 = vertices[org] - vertices[i];
+    Vec3 v2 = vertices[org] - vertices[j];
+    double cotan = (v1.dot(v2)) / (1e-6 + (v1.cross(v2)).norm() );
+    float w = cotan * 0.5f;
+    return w;
 }
 
 //------------------------------------------------------------------------------
@@ -223,7 +259,6 @@ get_laplacian(const std::vector< Vec3 >& vertices,
     Alternate implementation of the Laplacian matrix using only the
     list of triangles instead of the first ring neighboors.
 */
-static
 std::vector<std::vector<Triplet>>
 get_laplacian(const std::vector< Vec3 >& vertices,
               const std::vector< Tri_face >& triangles )
@@ -246,20 +281,7 @@ get_laplacian(const std::vector< Vec3 >& vertices,
 
         for(Edge edge : edges)
         {
-            /*
-                                    j
-                                   ◥
-                                  /  \
-                                 v2   \
-                                /      \
-                               /        \
-                        (cotan)----v1---▶ i
-                           org
-            */
-            Vec3 v1 = vertices[edge.org] - vertices[edge.i];
-            Vec3 v2 = vertices[edge.org] - vertices[edge.j];
-            double cotan = (v1.dot(v2)) / (1e-6 + (v1.cross(v2)).norm() );
-            float w = cotan * 0.5f;
+            float w = half_cotan_weight(vertices, edge.i, edge.j, edge.org);
 
             int i = edge.i;
             int j = edge.j;
@@ -275,80 +297,606 @@ get_laplacian(const std::vector< Vec3 >& vertices,
 
 //------------------------------------------------------------------------------
 
-// Compute harmonic weights
-void solve_laplace_equation(const std::vector< Vec3 >& vertices,
-        const std::vector< std::vector<int> >& edges,
-        const std::vector<Tri_face>& triangles,
-        const std::vector<std::pair<Vert_idx, float> >& boundaries,
-        std::vector<double>& harmonic_weight_map)
+/// Compute the ith row of the Laplacian matrix from the triangles incident
+/// to the vertex 'i'
+static
+void triangle_laplacian_row(int i,
+                            const std::vector< Vec3 >& vertices,
+                            const std::vector< Tri_face >& triangles,
+                            const std::vector< std::vector<Tri_idx> >& tris_per_vertex,
+                            std::vector<Triplet>& row)
 {
-    std::cout << "COMPUTE LAPLACE EQUATION" << std::endl;
+    row.clear();
+    // Only the two edges of each triangle incident to 'i' contribute
+    // to the ith row
+    for(Tri_idx t : tris_per_vertex[i])
+    {
+        const Tri_face& f = triangles[t];
+        for(int k = 0; k < 3; ++k)
+        {
+            int a = f[k], b = f[(k+1) % 3], org = f[(k+2) % 3];
+            if( a != i && b != i )
+                continue;
+            float w = half_cotan_weight(vertices, a, b, org);
+            int j = (a == i) ? b : a;
+            row.push_back( Triplet(i, j,  w) );
+            row.push_back( Triplet(i, i, -w) );
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
 
-    int nv = vertices.size();
+void get_laplacian_rows(const std::vector< Vec3 >& vertices,
+                        const std::vector< std::vector<int> >& edges,
+                        int begin, int end,
+                        std::vector<std::vector<Triplet>>& mat_elemts)
+{
+    for(int i = begin; i < end; ++i)
+        laplacian_row(i, vertices, edges, mat_elemts[i]);
+}
 
-    // compute laplacian matrix of the mesh
-    /*
-        We can build the laplacian 'L' either from the half edge data structure
-        (edges) or simply the list of triangles.
-        For reference both versions are implemented here.
-    */
-    assert(edges.size() > 0 || triangles.size() > 0 );
-    std::vector<std::vector<Triplet>> mat_elemts;
-    if( edges.size() > 0)
-        mat_elemts = get_laplacian(vertices, edges);
-    else if( triangles.size() > 0 )
-        mat_elemts = get_laplacian(vertices, triangles);
+//------------------------------------------------------------------------------
+
+void get_laplacian_rows(const std::vector< Vec3 >& vertices,
+                        const std::vector< Tri_face >& triangles,
+                        const std::vector< std::vector<Tri_idx> >& tris_per_vertex,
+                        int begin, int end,
+                        std::vector<std::vector<Triplet>>& mat_elemts)
+{
+    for(int i = begin; i < end; ++i)
+        triangle_laplacian_row(i, vertices, triangles, tris_per_vertex, mat_elemts[i]);
+}
 
+//------------------------------------------------------------------------------
 
-    // Set boundary conditions
-    Eigen::VectorXd rhs = Eigen::VectorXd::Constant(nv, 0.);
-    // Initialize handle
-    for(const std::pair<int, float>& elt : boundaries){
-        rhs( elt.first ) = double(elt.second);
-        // Set row to 0.0f
-        mat_elemts[elt.first].clear();
-        // Set
-        mat_elemts[elt.first].push_back( Triplet(elt.first, elt.first, 1.0) );
+void reduced_indices(int nb_vertices,
+                     const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                     Reduced_indices& idx)
+{
+    idx._free_idx.assign(nb_vertices, 0);
+    idx._boundary_idx.assign(nb_vertices, -1);
+    for(const std::pair<Vert_idx, float>& elt : boundaries)
+        idx._free_idx[elt.first] = -1;
+    idx._nb_free = 0;
+    idx._nb_boundaries = 0;
+    for(int i = 0; i < nb_vertices; ++i) {
+        if( idx._free_idx[i] >= 0 )
+            idx._free_idx[i] = idx._nb_free++;
+        else
+            idx._boundary_idx[i] = idx._nb_boundaries++;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+template<typename Scalar>
+size_t assemble_reduced_system(const std::vector<std::vector<Triplet>>& mat_elemts,
+                               const Reduced_indices& idx,
+                               Eigen::SparseMatrix<Scalar>* A,
+                               Eigen::SparseMatrix<double, Eigen::RowMajor>* coupling)
+{
+    Trace_scope trace("triplets");
+    std::vector<Eigen::Triplet<Scalar>> triplets;
+    std::vector<Triplet> coupling_triplets;
+    if( A != nullptr )
+        triplets.reserve( size_t(idx._nb_free) * 10 );
+    for(int i = 0; i < int(mat_elemts.size()); ++i)
+    {
+        int fi = idx._free_idx[i];
+        if( fi < 0 )
+            continue;
+        for(const Triplet& elt : mat_elemts[i]) {
+            int fj = idx._free_idx[elt.col()];
+            if( fj >= 0 ) {
+                if( A != nullptr )
+                    triplets.push_back( Eigen::Triplet<Scalar>(fi, fj, Scalar(-elt.value())) );
+            } else if( coupling != nullptr )
+                coupling_triplets.push_back( Triplet(fi, idx._boundary_idx[elt.col()], elt.value()) );
+        }
+    }
+    if( A != nullptr ) {
+        Trace_scope trace_set("set_from_triplets");
+        A->resize(idx._nb_free, idx._nb_free);
+        A->setFromTriplets(triplets.begin(), triplets.end());
+    }
+    if( coupling != nullptr ) {
+        coupling->resize(idx._nb_free, idx._nb_boundaries);
+        coupling->setFromTriplets(coupling_triplets.begin(), coupling_triplets.end());
+    }
+    return triplets.size();
+}
+
+template size_t assemble_reduced_system<float>(const std::vector<std::vector<Triplet>>&, const Reduced_indices&,
+                                               Eigen::SparseMatrix<float>*, Eigen::SparseMatrix<double, Eigen::RowMajor>*);
+template size_t assemble_reduced_system<double>(const std::vector<std::vector<Triplet>>&, const Reduced_indices&,
+                                                Eigen::SparseMatrix<double>*, Eigen::SparseMatrix<double, Eigen::RowMajor>*);
+
+//------------------------------------------------------------------------------
+
+template<typename Scalar>
+size_t assemble_full_system(const std::vector<std::vector<Triplet>>& mat_elemts,
+                            const Reduced_indices& idx,
+                            Eigen::SparseMatrix<Scalar>& A)
+{
+    const int nv = int(mat_elemts.size());
+    std::vector<Eigen::Triplet<Scalar>> triplets;
+    {
+        Trace_scope trace("triplets");
+        triplets.reserve( size_t(nv) * 10 );
+        for(int i = 0; i < nv; ++i) {
+            if( idx._boundary_idx[i] >= 0 ) {
+                triplets.push_back( Eigen::Triplet<Scalar>(i, i, Scalar(1)) );
+                continue;
+            }
+            for(const Triplet& elt : mat_elemts[i])
+                triplets.push_back( Eigen::Triplet<Scalar>(elt.row(), elt.col(), Scalar(elt.value())) );
+        }
+    }
+    Trace_scope trace("set_from_triplets");
+    A.resize(nv, nv);
+    A.setFromTriplets(triplets.begin(), triplets.end());
+    return triplets.size();
+}
+
+template size_t assemble_full_system<float>(const std::vector<std::vector<Triplet>>&, const Reduced_indices&,
+                                            Eigen::SparseMatrix<float>&);
+template size_t assemble_full_system<double>(const std::vector<std::vector<Triplet>>&, const Reduced_indices&,
+                                             Eigen::SparseMatrix<double>&);
+
+//------------------------------------------------------------------------------
+
+void update_laplacian_rows(const std::vector< Vec3 >& vertices,
+                           const std::vector< std::vector<int> >& edges,
+                           const std::vector<Vert_idx>& rows,
+                           std::vector<std::vector<Triplet>>& mat_elemts)
+{
+    mat_elemts.resize( vertices.size() );
+    for(Vert_idx i : rows)
+        laplacian_row(i, vertices, edges, mat_elemts[i]);
+}
+
+//------------------------------------------------------------------------------
+
+void update_laplacian_rows(const std::vector< Vec3 >& vertices,
+                           const std::vector< Tri_face >& triangles,
+                           const std::vector< std::vector<Tri_idx> >& tris_per_vertex,
+                           const std::vector<Vert_idx>& rows,
+                           std::vector<std::vector<Triplet>>& mat_elemts)
+{
+    mat_elemts.resize( vertices.size() );
+    for(Vert_idx i : rows)
+        triangle_laplacian_row(i, vertices, triangles, tris_per_vertex, mat_elemts[i]);
+}
+
+//------------------------------------------------------------------------------
+
+bool parse_solver_options(const char* spec, Solver_options& options)
+{
+    options = Solver_options();
+    std::string str(spec);
+    std::vector<std::string> tokens;
+    for(size_t b = 0; b <= str.size(); ) {
+        size_t e = std::min(str.find(':', b), str.size());
+        tokens.push_back( str.substr(b, e - b) );
+        b = e + 1;
+    }
+
+    Solver_backend_info info;
+    if( tokens[0] != "auto" && !find_solver_backend(tokens[0], info) ) {
+        std::cerr << "Unknown solver '" << tokens[0] << "' in '" << spec;
+        std::cerr << "' (expected " << solver_backend_names() << " or auto)" << std::endl;
+        return false;
+    }
+    options._solver = tokens[0];
+
+    for(unsigned t = 1; t < tokens.size(); ++t)
+    {
+        const std::string& tok = tokens[t];
+        if( tok == "float" ) {
+            options._single_precision = true;
+            continue;
+        }
+        if( tok == "double" ) {
+            options._single_precision = false;
+            continue;
+        }
+        char* end = nullptr;
+        options._tolerance = std::strtod(tok.c_str(), &end);
+        if( end == tok.c_str() || *end != '\0' || options._tolerance <= 0. ) {
+            std::cerr << "Invalid solver option '" << tok << "' in '" << spec << "'" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------------
+
+std::string solver_options_string(const Solver_options& options)
+{
+    std::string str = options._solver;
+    Solver_backend_info info;
+    bool iterative = options._solver == "auto" ||
+                     (find_solver_backend(options._solver, info) && info._iterative);
+    if( iterative ) {
+        char buff[32];
+        std::snprintf(buff, sizeof(buff), ":%g", options._tolerance);
+        str += buff;
     }
+    str += options._single_precision ? ":float" : ":double";
+    return str;
+}
 
+//------------------------------------------------------------------------------
 
-#if 0
-    // Solving with a dense matrix is Extremely slow
-    Eigen::MatrixXd L = Eigen::MatrixXd::Constant(nv, nv, 0.);
-    for( const std::vector<Triplet>& row : mat_elemts)
-        for( const Triplet& elt : row )
-            L(elt.row(), elt.col()) = elt.value();
+/// Bytes allocated by a compressed sparse matrix
+template<class Matrix>
+static size_t sparse_matrix_bytes(const Matrix& m)
+{
+    typedef typename Matrix::Scalar Scalar;
+    typedef typename Matrix::StorageIndex Index;
+    return size_t(m.data().allocatedSize()) * (sizeof(Scalar) + sizeof(Index)) +
+           size_t(m.outerSize() + 1) * sizeof(Index);
+}
 
-    //Eigen::ColPivHouseholderQR<Eigen::MatrixXd> llt;
-    Eigen::FullPivLU<Eigen::MatrixXd> solver;
-    std::cout << "BEGIN MATRIX FACTORIZATION" << std::endl;
-    solver.compute( L );
-    std::cout << "END MATRIX FACTORIZATION" << std::endl;
+//------------------------------------------------------------------------------
+
+/// Report 'phase' to 'control' (optional)
+/// @return false if the solve was cancelled
+static bool enter_phase(Solve_control* control, Solve_phase phase)
+{
+    return control == nullptr || control->enter_phase(phase);
+}
 
-#else
-    Sparse_mat L(nv, nv);
-    // Convert to triplets
-    std::vector<Triplet> triplets;
-    triplets.reserve(nv * 10);
-    for( const std::vector<Triplet>& row : mat_elemts)
-        for( const Triplet& elt : row )
-            triplets.push_back( elt );
+static bool is_cancelled(const Solve_control* control)
+{
+    return control != nullptr && control->is_cancelled();
+}
 
-    L.setFromTriplets(triplets.begin(), triplets.end());
+//------------------------------------------------------------------------------
 
-    Eigen::SparseLU<Sparse_mat> solver;
+/// Analyze, factorize then solve A x = b with 'backend'
+template<typename Scalar>
+static bool run_backend(Solver_backend<Scalar>& backend,
+                        const Solver_backend_info& info,
+                        const typename Solver_backend<Scalar>::Matrix& A,
+                        const typename Solver_backend<Scalar>::Vector& rhs,
+                        typename Solver_backend<Scalar>::Vector& res,
+                        Solve_timings& time,
+                        Timer& timer)
+{
+    if( !enter_phase(backend.control(), ePHASE_FACTORIZATION) )
+        return false;
     std::cout << "BEGIN SPARSE MATRIX FACTORIZATION" << std::endl;
-    solver.compute( L );
+    bool ok = factorize_system(backend, info, A);
     std::cout << "END SPARSE MATRIX FACTORIZATION" << std::endl;
-#endif
+    time._factorization = timer.lap();
+    if( !ok )
+        return false;
+    Backend_stats stats = backend.stats();
+    if( stats._factor_bytes > 0 )
+        record_footprint("factors", stats._factor_bytes);
+
+    if( !enter_phase(backend.control(), ePHASE_SOLVE) )
+        return false;
+    Trace_scope trace("solve");
+    if( !backend.solve(rhs, res) ) {
+        if( !is_cancelled(backend.control()) )
+            std::cerr << info._name << " solve failed: " << backend.error() << std::endl;
+        return false;
+    }
+    stats = backend.stats();
+    time._iterations = stats._iterations;
+    time._residual = stats._residual;
+    return true;
+}
+
+//------------------------------------------------------------------------------
 
+/// Solve the full system, see assemble_full_system()
+template<typename Scalar>
+static bool solve_full_system(const std::vector<std::vector<Triplet>>& mat_elemts,
+                              const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                              Solver_backend<Scalar>& backend,
+                              const Solver_backend_info& info,
+                              std::vector<double>& harmonic_weight_map,
+                              Solve_timings& time,
+                              Timer& timer)
+{
+    typedef Eigen::SparseMatrix<Scalar> Matrix;
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> Vector;
+    int nv = int(mat_elemts.size());
+    if( !enter_phase(backend.control(), ePHASE_ASSEMBLY) )
+        return false;
+
+    Reduced_indices idx;
+    reduced_indices(nv, boundaries, idx);
+    // Set boundary conditions
+    Vector rhs = Vector::Constant(nv, Scalar(0));
+    for(const std::pair<int, float>& elt : boundaries)
+        rhs( elt.first ) = Scalar(elt.second);
+
+    Matrix L;
+    size_t nb_triplets = assemble_full_system<Scalar>(mat_elemts, idx, L);
+    record_footprint("triplets", nb_triplets * sizeof(Eigen::Triplet<Scalar>));
+    record_footprint("sparse_matrix", sparse_matrix_bytes(L));
+
+    time._assembly = timer.lap();
+
+    Vector res;
+    if( !run_backend(backend, info, L, rhs, res, time, timer) )
+        return false;
     harmonic_weight_map.resize(nv);
-    Eigen::VectorXd res = solver.solve( rhs );
     for(int i = 0; i < nv; ++i)
-        harmonic_weight_map[i] = res(i);
+        harmonic_weight_map[i] = double(res(i));
+    time._solve = timer.lap();
+    return true;
+}
 
-    return;
+//------------------------------------------------------------------------------
+
+/// Solve the reduced system: with F the free vertices and B the boundary
+/// vertices, L_FF x_F + L_FB x_B = 0 gives (-L_FF) x_F = L_FB x_B
+/// where -L_FF is symmetric positive definite only when L is symmetric
+/// (see Solver_options): backends needing it check it, see factorize_system().
+/// When 'factor_key' is given the factorization of -L_FF is looked up in the
+/// solve cache (only the right hand side is assembled on a hit) and stored
+/// there otherwise.
+template<typename Scalar>
+static bool solve_reduced_system(const std::vector<std::vector<Triplet>>& mat_elemts,
+                                 const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                                 Solver_backend<Scalar>& backend,
+                                 const Solver_backend_info& info,
+                                 const Hash128* factor_key,
+                                 std::vector<double>& harmonic_weight_map,
+                                 Solve_timings& time,
+                                 Timer& timer)
+{
+    typedef Eigen::SparseMatrix<Scalar> Matrix;
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> Vector;
+    int nv = int(mat_elemts.size());
+    if( !enter_phase(backend.control(), ePHASE_ASSEMBLY) )
+        return false;
+
+    // Index of the free vertices in the reduced system (-1 for boundaries)
+    std::vector<double>& x = harmonic_weight_map;
+    x.assign(nv, 0.);
+    Reduced_indices idx;
+    reduced_indices(nv, boundaries, idx);
+    const int nb_free = idx._nb_free;
+    Eigen::VectorXd x_boundary(idx._nb_boundaries);
+    for(const std::pair<int, float>& elt : boundaries) {
+        x[elt.first] = double(elt.second);
+        x_boundary( idx._boundary_idx[elt.first] ) = double(elt.second);
+    }
+
+    std::shared_ptr<const Cached_factor> cached;
+    if( factor_key != nullptr && nb_free > 0 )
+        cached = find_cached_factor(*factor_key, sizeof(Scalar) < sizeof(double));
+    if( cached != nullptr && cached->size() != nb_free )
+        cached = nullptr;
+
+    // On a cache hit only L_FB is needed for the right hand side
+    Matrix A;
+    Eigen::SparseMatrix<double, Eigen::RowMajor> coupling;
+    size_t nb_triplets = assemble_reduced_system<Scalar>(mat_elemts, idx, cached == nullptr ? &A : nullptr, &coupling);
+    Eigen::VectorXd rhs = coupling * x_boundary;
+    if( cached != nullptr ) {
+        time._assembly = timer.lap();
+        std::cout << "FACTORIZATION FROM SOLVE CACHE" << std::endl;
+        time._cached_factor = true;
+        record_footprint("factors", cached->bytes());
+        if( !enter_phase(backend.control(), ePHASE_SOLVE) )
+            return false;
+        Eigen::VectorXd res;
+        {
+            Trace_scope trace("solve");
+            cached->solve(rhs, res);
+        }
+        for(int i = 0; i < nv; ++i)
+            if( idx._free_idx[i] >= 0 )
+                x[i] = res( idx._free_idx[i] );
+        time._solve = timer.lap();
+        return true;
+    }
+
+    record_footprint("triplets", nb_triplets * sizeof(Eigen::Triplet<Scalar>));
+    record_footprint("sparse_matrix", sparse_matrix_bytes(A));
+    time._assembly = timer.lap();
+
+    if( nb_free == 0 )
+        return true;
+
+    Vector res;
+    if( !run_backend(backend, info, A, Vector(rhs.template cast<Scalar>()), res, time, timer) )
+        return false;
+    for(int i = 0; i < nv; ++i)
+        if( idx._free_idx[i] >= 0 )
+            x[i] = double(res( idx._free_idx[i] ));
+    time._solve = timer.lap();
+
+    Cholesky_factor factor;
+    if( factor_key != nullptr && backend.export_factor(factor) )
+        store_cached_factor(*factor_key, factor);
+    return true;
 }
 
-// -----------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+
+/// Create the backend of 'opt' in the precision 'Scalar' and solve
+template<typename Scalar>
+static bool solve_with(const std::vector<std::vector<Triplet>>& mat_elemts,
+                       const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                       const Solver_options& opt,
+                       const std::vector<int>& ordering,
+                       const Hash128* factor_key,
+                       Solve_control* control,
+                       std::vector<double>& harmonic_weight_map,
+                       Solve_timings& time,
+                       Timer& timer)
+{
+    Solver_backend_info info;
+    std::unique_ptr<Solver_backend<Scalar>> backend( make_solver_backend<Scalar>(opt, info) );
+    if( backend == nullptr )
+        return false;
+    backend->set_control( control );
+    if( !ordering.empty() && !info._full_system )
+        backend->set_ordering( ordering );
+    if( info._full_system )
+        return solve_full_system<Scalar>(mat_elemts, boundaries, *backend, info, harmonic_weight_map, time, timer);
+    return solve_reduced_system<Scalar>(mat_elemts, boundaries, *backend, info, factor_key, harmonic_weight_map, time, timer);
+}
+
+//------------------------------------------------------------------------------
+
+/// Run the backend of 'opt' (anything but "auto")
+/// @param ordering : of the reduced system computed by plan_solver() (or empty)
+/// @param mesh_key : enables the factorization cache when not null
+static bool solve_with(const std::vector<std::vector<Triplet>>& mat_elemts,
+                       const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                       const Solver_options& opt,
+                       const std::vector<int>& ordering,
+                       const Hash128* mesh_key,
+                       Solve_control* control,
+                       std::vector<double>& harmonic_weight_map,
+                       Solve_timings& time,
+                       Timer& timer)
+{
+    Hash128 factor_key;
+    if( mesh_key != nullptr )
+        factor_key = solve_cache_factor_key(*mesh_key, boundaries, opt);
+    const Hash128* key = mesh_key != nullptr ? &factor_key : nullptr;
+    if( opt._single_precision )
+        return solve_with<float>(mat_elemts, boundaries, opt, ordering, key, control, harmonic_weight_map, time, timer);
+    return solve_with<double>(mat_elemts, boundaries, opt, ordering, key, control, harmonic_weight_map, time, timer);
+}
+
+//------------------------------------------------------------------------------
+
+/// Body of solve_laplace_equation(), which reports the last phase
+/// @param laplacian : rows already built (consumed) or nullptr
+static bool solve(const std::vector< Vec3 >& vertices,
+                  const std::vector< std::vector<int> >& edges,
+                  const std::vector<Tri_face>& triangles,
+                  std::vector<std::vector<Triplet>>* laplacian,
+                  const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                  std::vector<double>& harmonic_weight_map,
+                  Solve_timings& time,
+                  const Solver_options& opt,
+                  Solve_control* control)
+{
+    Timer timer;
+
+    // Identical solve already in the cache
+    bool use_cache = is_solve_cache_enabled();
+    Hash128 mesh_key, result_key;
+    if( use_cache ) {
+        mesh_key = solve_cache_mesh_key(vertices, edges, triangles);
+        result_key = solve_cache_result_key(mesh_key, boundaries, opt);
+        if( find_cached_weights(result_key, harmonic_weight_map) &&
+            harmonic_weight_map.size() == vertices.size() )
+        {
+            std::cout << "WEIGHTS FROM SOLVE CACHE" << std::endl;
+            time._cached_weights = true;
+            time._solve = timer.lap();
+            return true;
+        }
+    }
+
+    // compute laplacian matrix of the mesh
+    /*
+        We can build the laplacian 'L' either from the half edge data structure
+        (edges) or simply the list of triangles.
+        For reference both versions are implemented here.
+    */
+    assert(edges.size() > 0 || triangles.size() > 0 || laplacian != nullptr);
+    if( !enter_phase(control, ePHASE_LAPLACIAN) )
+        return false;
+    std::vector<std::vector<Triplet>> mat_elemts;
+    {
+        Trace_scope trace_laplacian("laplacian");
+        if( laplacian != nullptr )
+            mat_elemts.swap( *laplacian );
+        else if( edges.size() > 0)
+            mat_elemts = get_laplacian(vertices, edges);
+        else if( triangles.size() > 0 )
+            mat_elemts = get_laplacian(vertices, triangles);
+    }
+    time._laplacian = timer.lap();
+    if( is_accounting_memory() )
+        record_footprint("laplacian_rows", heap_bytes(mat_elemts));
+
+    Solver_options chosen = opt;
+    std::vector<int> ordering;
+    if( !choose_solver(mat_elemts, boundaries, control, chosen, ordering) )
+        return false;
+    time._planning = timer.lap();
+
+    const Hash128* key = use_cache ? &mesh_key : nullptr;
+    bool ok = solve_with(mat_elemts, boundaries, chosen, ordering, key, control, harmonic_weight_map, time, timer);
+    if( ok && use_cache )
+        store_cached_weights(result_key, harmonic_weight_map);
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+
+/// Both solve_laplace_equation(), @param laplacian : rows already built or nullptr
+static bool run_solve(const std::vector< Vec3 >& vertices,
+        const std::vector< std::vector<int> >& edges,
+        const std::vector<Tri_face>& triangles,
+        std::vector<std::vector<Triplet>>* laplacian,
+        const std::vector<std::pair<Vert_idx, float> >& boundaries,
+        std::vector<double>& harmonic_weight_map,
+        Solve_timings* timings,
+        const Solver_options* options,
+        Solve_control* control)
+{
+    std::cout << "COMPUTE LAPLACE EQUATION" << std::endl;
+    Trace_scope trace("solve_laplace_equation");
+    Solve_timings local_timings;
+    Solve_timings& time = timings != nullptr ? *timings : local_timings;
+    time = Solve_timings();
+    const Solver_options default_options;
+    const Solver_options& opt = options != nullptr ? *options : default_options;
+
+    bool ok = solve(vertices, edges, triangles, laplacian, boundaries, harmonic_weight_map, time, opt, control);
+    if( is_cancelled(control) && !ok )
+        std::cout << "SOLVE CANCELLED" << std::endl;
+    if( control != nullptr )
+        control->enter_phase(ok ? ePHASE_DONE : control->is_cancelled() ? ePHASE_CANCELLED : ePHASE_FAILED);
+    return ok;
+}
+
+//------------------------------------------------------------------------------
+
+// Compute harmonic weights
+bool solve_laplace_equation(const std::vector< Vec3 >& vertices,
+        const std::vector< std::vector<int> >& edges,
+        const std::vector<Tri_face>& triangles,
+        const std::vector<std::pair<Vert_idx, float> >& boundaries,
+        std::vector<double>& harmonic_weight_map,
+        Solve_timings* timings,
+        const Solver_options* options,
+        Solve_control* control)
+{
+    return run_solve(vertices, edges, triangles, nullptr, boundaries,
+                     harmonic_weight_map, timings, options, control);
+}
 
+//------------------------------------------------------------------------------
+
+bool solve_laplace_equation(const std::vector< Vec3 >& vertices,
+        const std::vector< std::vector<int> >& edges,
+        const std::vector<Tri_face>& triangles,
+        std::vector<std::vector<Triplet>>& laplacian,
+        const std::vector<std::pair<Vert_idx, float> >& boundaries,
+        std::vector<double>& harmonic_weight_map,
+        Solve_timings* timings,
+        const Solver_options* options,
+        Solve_control* control)
+{
+    return run_solve(vertices, edges, triangles, &laplacian, boundaries,
+                     harmonic_weight_map, timings, options, control);
+}
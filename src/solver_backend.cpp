@@ -0,0 +1,750 @@
+#include "solver_backend.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <Eigen/SparseLU>
+#include <Eigen/SparseQR>
+#include <Eigen/SparseCholesky>
+#include <Eigen/IterativeLinearSolvers>
+#include <Eigen/OrderingMethods>
+
+#include "utils/trace.hpp"
+
+#ifdef HARMONIC_WEIGHTS_HAS_CHOLMOD
+    #include <Eigen/CholmodSupport>
+#endif
+#ifdef HARMONIC_WEIGHTS_HAS_UMFPACK
+    #include <Eigen/UmfPackSupport>
+#endif
+#ifdef HARMONIC_WEIGHTS_HAS_PASTIX
+    #include <Eigen/PaStiXSupport>
+#endif
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Ordering given to the backend analyzing a matrix on this thread
+/// (Solver_backend::set_ordering()), nullptr when there is none
+thread_local const std::vector<int>* t_given_ordering = nullptr;
+
+/// Ordering method of the Cholesky backends: the given ordering if any,
+/// AMD otherwise. Eigen default constructs the ordering method inside
+/// analyzePattern(), hence the thread local to pass the ordering.
+template<typename StorageIndex>
+struct Given_or_amd_ordering {
+    typedef Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, StorageIndex> PermutationType;
+
+    template<class Matrix>
+    void operator()(const Matrix& mat, PermutationType& perm)
+    {
+        const std::vector<int>* given = t_given_ordering;
+        if( given != nullptr && Eigen::Index(given->size()) == mat.rows() ) {
+            perm.resize( mat.rows() );
+            std::copy(given->begin(), given->end(), perm.indices().data());
+        } else {
+            Eigen::AMDOrdering<StorageIndex> amd;
+            amd(mat, perm);
+        }
+    }
+};
+
+template<class Matrix>
+using Cholesky_ldlt = Eigen::SimplicialLDLT<Matrix, Eigen::Lower, Given_or_amd_ordering<int>>;
+template<class Matrix>
+using Cholesky_llt = Eigen::SimplicialLLT<Matrix, Eigen::Lower, Given_or_amd_ordering<int>>;
+
+/// Only the Cholesky backends take a given ordering
+template<class Solver>
+bool takes_ordering(const Solver&) { return false; }
+
+template<class Matrix>
+bool takes_ordering(const Cholesky_ldlt<Matrix>&) { return true; }
+
+template<class Matrix>
+bool takes_ordering(const Cholesky_llt<Matrix>&) { return true; }
+
+// -----------------------------------------------------------------------------
+
+/// Bytes allocated by a compressed sparse matrix
+template<class Matrix>
+size_t sparse_matrix_bytes(const Matrix& m)
+{
+    typedef typename Matrix::Scalar Scalar;
+    typedef typename Matrix::StorageIndex Index;
+    return size_t(m.data().allocatedSize()) * (sizeof(Scalar) + sizeof(Index)) +
+           size_t(m.outerSize() + 1) * sizeof(Index);
+}
+
+/// Unknown for external libraries
+template<class Solver>
+size_t factor_bytes(const Solver&) { return 0; }
+
+/// Estimated bytes of the L and U factors from their non zeros, counting
+/// one index per value: an upper bound as the columns of a supernode of L
+/// share their row indices
+template<class Matrix, class Ordering>
+size_t factor_bytes(const Eigen::SparseLU<Matrix, Ordering>& lu)
+{
+    typedef typename Matrix::Scalar Scalar;
+    typedef typename Matrix::StorageIndex Index;
+#if EIGEN_VERSION_AT_LEAST(3, 4, 0)
+    size_t nnz = size_t(lu.nnzL() + lu.nnzU());
+#else
+    // No public count before Eigen 3.4 (e.g. the bundled 3.3): values of the
+    // supernodes of L and of U, read through the factors matrixL() and
+    // matrixU() return
+    auto L = lu.matrixL();
+    auto U = lu.matrixU();
+    size_t nnz = size_t(L.m_mapL.colIndexPtr()[lu.cols()]) + size_t(U.m_mapU.nonZeros());
+#endif
+    return nnz * (sizeof(Scalar) + sizeof(Index));
+}
+
+/// Bytes of the L factor, the diagonal D and the permutations
+template<class Matrix, int UpLo, class Ordering>
+size_t factor_bytes(const Eigen::SimplicialLDLT<Matrix, UpLo, Ordering>& ldlt)
+{
+    typedef typename Matrix::Scalar Scalar;
+    typedef typename Matrix::StorageIndex Index;
+    return sparse_matrix_bytes( ldlt.matrixL().nestedExpression() ) +
+           size_t(ldlt.vectorD().size()) * (sizeof(Scalar) + 2 * sizeof(Index));
+}
+
+/// Bytes of the L factor and the permutations
+template<class Matrix, int UpLo, class Ordering>
+size_t factor_bytes(const Eigen::SimplicialLLT<Matrix, UpLo, Ordering>& llt)
+{
+    typedef typename Matrix::StorageIndex Index;
+    return sparse_matrix_bytes( llt.matrixL().nestedExpression() ) +
+           size_t(llt.cols()) * 2 * sizeof(Index);
+}
+
+/// Bytes of R (the Householder vectors of Q are not accessible)
+template<class Matrix, class Ordering>
+size_t factor_bytes(const Eigen::SparseQR<Matrix, Ordering>& qr)
+{
+    return sparse_matrix_bytes( qr.matrixR() );
+}
+
+// -----------------------------------------------------------------------------
+
+/// Only simplicial Cholesky factors can be exported
+template<class Solver>
+bool export_factor(const Solver&, Cholesky_factor&) { return false; }
+
+/// Copy the factors of SimplicialLDLT or SimplicialLLT
+template<class Cholesky>
+void export_cholesky(const Cholesky& chol, bool unit_diagonal, Cholesky_factor& factor)
+{
+    Eigen::SparseMatrix<double> L = chol.matrixL().nestedExpression().template cast<double>();
+    L.makeCompressed();
+    const int n = int(L.cols());
+    factor._n = n;
+    factor._outer.assign(L.outerIndexPtr(), L.outerIndexPtr() + n + 1);
+    factor._inner.assign(L.innerIndexPtr(), L.innerIndexPtr() + L.nonZeros());
+    factor._values.assign(L.valuePtr(), L.valuePtr() + L.nonZeros());
+    factor._diag.clear();
+    const auto& P = chol.permutationP().indices();
+    factor._perm.assign(P.data(), P.data() + P.size());
+    factor._unit_diagonal = unit_diagonal;
+    factor._single_precision = sizeof(typename Cholesky::Scalar) < sizeof(double);
+}
+
+template<class Matrix, int UpLo, class Ordering>
+bool export_factor(const Eigen::SimplicialLDLT<Matrix, UpLo, Ordering>& ldlt, Cholesky_factor& factor)
+{
+    export_cholesky(ldlt, true, factor);
+    // vectorD() returns a copy
+    const auto D = ldlt.vectorD();
+    factor._diag.resize( D.size() );
+    for(int i = 0; i < int(D.size()); ++i)
+        factor._diag[i] = double(D(i));
+    return true;
+}
+
+template<class Matrix, int UpLo, class Ordering>
+bool export_factor(const Eigen::SimplicialLLT<Matrix, UpLo, Ordering>& llt, Cholesky_factor& factor)
+{
+    export_cholesky(llt, false, factor);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Cholesky factorizations: a matrix that isn't symmetric was refused before
+/// (factorize_system()), what is left is a zero or negative pivot
+template<class Solver>
+std::string failure_message(const Solver&)
+{
+    return "singular or indefinite matrix (is every connected component of the mesh touching a boundary?)";
+}
+
+template<class Matrix, class Ordering>
+std::string failure_message(const Eigen::SparseLU<Matrix, Ordering>& lu) { return lu.lastErrorMessage(); }
+
+template<class Matrix, class Ordering>
+std::string failure_message(const Eigen::SparseQR<Matrix, Ordering>& qr) { return qr.lastErrorMessage(); }
+
+// -----------------------------------------------------------------------------
+
+/// Any Eigen direct solver (analyzePattern() / factorize() / solve())
+template<typename Scalar, class Eigen_solver>
+class Direct_backend : public Solver_backend<Scalar> {
+public:
+    typedef typename Solver_backend<Scalar>::Matrix Matrix;
+    typedef typename Solver_backend<Scalar>::Vector Vector;
+
+    bool analyze(const Matrix& A) override {
+        t_given_ordering = _ordering.empty() ? nullptr : &_ordering;
+        _solver.analyzePattern( A );
+        t_given_ordering = nullptr;
+        return check();
+    }
+
+    bool factorize(const Matrix& A) override {
+        _solver.factorize( A );
+        return check();
+    }
+
+    bool set_ordering(const std::vector<int>& ordering) override {
+        if( !takes_ordering(_solver) )
+            return false;
+        _ordering = ordering;
+        return true;
+    }
+
+    bool solve(const Vector& b, Vector& x) override {
+        x = _solver.solve( b );
+        return check();
+    }
+
+    Backend_stats stats() const override {
+        Backend_stats s;
+        s._factor_bytes = factor_bytes( _solver );
+        return s;
+    }
+
+    bool export_factor(Cholesky_factor& factor) const override {
+        return ::export_factor(_solver, factor);
+    }
+
+private:
+    bool check() {
+        if( _solver.info() == Eigen::Success )
+            return true;
+        this->_error = failure_message( _solver );
+        return false;
+    }
+
+    Eigen_solver _solver;
+    std::vector<int> _ordering; ///< empty: computed by _solver
+};
+
+// -----------------------------------------------------------------------------
+
+/// @brief Iterations of krylov_solve(), reported to a Solve_control
+struct Krylov_progress {
+    /// Iterations between two progress reports
+    enum { eREPORT = 256 };
+
+    Krylov_progress(Solve_control* control)
+        : _control(control), _iterations(0), _residual(0.), _cancelled(false) { }
+
+    /// Count one iteration with the relative residual 'residual'
+    /// @return false if the solve must stop (cancelled)
+    bool next(double residual) {
+        _iterations++;
+        _residual = residual;
+        if( _iterations % eREPORT == 0 &&
+            !_control->report_iterations(_iterations, _residual) )
+        {
+            _cancelled = true;
+        }
+        return !_cancelled;
+    }
+
+    Solve_control* _control;
+    int _iterations;
+    double _residual;
+    bool _cancelled;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Preconditioned conjugate gradient, the iterations of
+/// Eigen::internal::conjugate_gradient() with a progress report
+template<class Matrix, int UpLo, class Preconditioner, class Vector>
+void krylov_solve(const Eigen::ConjugateGradient<Matrix, UpLo, Preconditioner>& cg,
+                  const Matrix& mat,
+                  const Vector& b,
+                  Vector& x,
+                  int max_iterations,
+                  Krylov_progress& progress)
+{
+    typedef typename Vector::RealScalar Real;
+    const auto A = mat.template selfadjointView<UpLo>();
+    const Preconditioner& precond = cg.preconditioner();
+    const Real b_norm2 = b.squaredNorm();
+    x.setZero( b.size() );
+    if( b_norm2 == Real(0) )
+        return;
+    const Real threshold = cg.tolerance() * cg.tolerance() * b_norm2;
+    Vector r = b;
+    Vector p = precond.solve( r );
+    Vector z( b.size() ), Ap( b.size() );
+    Real r_z = r.dot( p );
+    Real r_norm2 = r.squaredNorm();
+    progress._residual = std::sqrt(double(r_norm2 / b_norm2));
+    if( r_norm2 < threshold )
+        return;
+    while( progress._iterations < max_iterations ) {
+        Ap.noalias() = A * p;
+        Real alpha = r_z / p.dot( Ap );
+        x += alpha * p;
+        r -= alpha * Ap;
+        r_norm2 = r.squaredNorm();
+        double residual = std::sqrt(double(r_norm2 / b_norm2));
+        // Like Eigen, the converging iteration is not counted
+        if( r_norm2 < threshold ) {
+            progress._residual = residual;
+            return;
+        }
+        if( !progress.next( residual ) )
+            return;
+        z = precond.solve( r );
+        Real r_z_old = r_z;
+        r_z = r.dot( z );
+        p = z + (r_z / r_z_old) * p;
+    }
+}
+
+/// Preconditioned BiCGSTAB, the iterations of Eigen::internal::bicgstab()
+/// with a progress report
+template<class Matrix, class Preconditioner, class Vector>
+void krylov_solve(const Eigen::BiCGSTAB<Matrix, Preconditioner>& bicg,
+                  const Matrix& A,
+                  const Vector& b,
+                  Vector& x,
+                  int max_iterations,
+                  Krylov_progress& progress)
+{
+    typedef typename Vector::Scalar Scalar;
+    typedef typename Vector::RealScalar Real;
+    const Preconditioner& precond = bicg.preconditioner();
+    const Eigen::Index n = b.size();
+    const Real b_norm2 = b.squaredNorm();
+    x.setZero( n );
+    if( b_norm2 == Real(0) )
+        return;
+    const Real tol2 = bicg.tolerance() * bicg.tolerance() * b_norm2;
+    const Real eps2 = Eigen::NumTraits<Scalar>::epsilon() * Eigen::NumTraits<Scalar>::epsilon();
+    Vector r = b;
+    Vector r0 = r;
+    Real r0_norm2 = r0.squaredNorm();
+    Vector v = Vector::Zero(n), p = Vector::Zero(n);
+    Vector y(n), z(n), s(n), t(n);
+    Scalar rho = 1, alpha = 1, w = 1;
+    progress._residual = std::sqrt(double(r.squaredNorm() / b_norm2));
+    bool restarted = false;
+    while( r.squaredNorm() > tol2 && progress._iterations < max_iterations ) {
+        Scalar rho_old = rho;
+        rho = r0.dot( r );
+        if( std::abs(rho) < eps2 * r0_norm2 ) {
+            // r became orthogonal to r0: restart from the current solution
+            // (Eigen also resets its iteration count on the first restart)
+            r = b - A * x;
+            r0 = r;
+            rho = r0_norm2 = r.squaredNorm();
+            if( !restarted )
+                progress._iterations = 0;
+            restarted = true;
+        }
+        Scalar beta = (rho / rho_old) * (alpha / w);
+        p = r + beta * (p - w * v);
+        y = precond.solve( p );
+        v.noalias() = A * y;
+        alpha = rho / r0.dot( v );
+        s = r - alpha * v;
+        z = precond.solve( s );
+        t.noalias() = A * z;
+        Real t_norm2 = t.squaredNorm();
+        w = t_norm2 > Real(0) ? Scalar(t.dot(s) / t_norm2) : Scalar(0);
+        x += alpha * y + w * z;
+        r = s - w * t;
+        if( !progress.next( std::sqrt(double(r.squaredNorm() / b_norm2)) ) )
+            return;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+/// Eigen iterative solvers with their default (diagonal) preconditioner.
+/// Without a Solve_control Eigen's solve() is used, with one the same
+/// iterations are run by krylov_solve() which reports them and stops when
+/// cancelled, without restarting the Krylov space.
+template<typename Scalar, class Eigen_solver>
+class Iterative_backend : public Solver_backend<Scalar> {
+public:
+    typedef typename Solver_backend<Scalar>::Matrix Matrix;
+    typedef typename Solver_backend<Scalar>::Vector Vector;
+
+    Iterative_backend(const char* name, const Solver_options& options)
+        : _name(name)
+        , _max_iterations(options._max_iterations)
+        , _matrix(nullptr)
+    {
+        _solver.setTolerance( Scalar(options._tolerance) );
+        if( options._max_iterations > 0 )
+            _solver.setMaxIterations( options._max_iterations );
+    }
+
+    bool analyze(const Matrix& A) override {
+        _solver.analyzePattern( A );
+        return true;
+    }
+
+    /// 'A' is used until the last solve(), as with Eigen's solvers
+    bool factorize(const Matrix& A) override {
+        _solver.factorize( A );
+        _matrix = &A;
+        if( _solver.info() != Eigen::Success ) {
+            this->_error = "preconditioner setup failed";
+            return false;
+        }
+        return true;
+    }
+
+    bool solve(const Vector& b, Vector& x) override {
+        bool converged = true;
+        if( this->_control == nullptr ) {
+            x = _solver.solve( b );
+            _stats._iterations = int(_solver.iterations());
+            _stats._residual = double(_solver.error());
+            converged = _solver.info() == Eigen::Success;
+        } else {
+            // Eigen's default limit
+            int max_iterations = _max_iterations > 0 ? _max_iterations : 2 * int(b.size());
+            Krylov_progress progress( this->_control );
+            krylov_solve(_solver, *_matrix, b, x, max_iterations, progress);
+            _stats._iterations = progress._iterations;
+            _stats._residual = progress._residual;
+            if( progress._cancelled ) {
+                this->_error = "cancelled";
+                return false;
+            }
+            this->_control->report_iterations(_stats._iterations, _stats._residual);
+            converged = _stats._residual <= double(_solver.tolerance());
+        }
+        if( !converged ) {
+            std::cerr << _name << " did not converge: relative residual ";
+            std::cerr << _stats._residual << " after " << _stats._iterations << " iterations" << std::endl;
+        }
+        return true;
+    }
+
+    Backend_stats stats() const override {
+        Backend_stats s = _stats;
+        s._factor_bytes = size_t(_solver.rows()) * sizeof(Scalar); // inverse diagonal
+        return s;
+    }
+
+private:
+    const char* _name;
+    int _max_iterations;
+    const Matrix* _matrix; ///< given to factorize()
+    Backend_stats _stats;
+    Eigen_solver _solver;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Fill the factories of 'info' with Backend<float> and Backend<double>
+template<template<typename> class Backend>
+void set_factories(Solver_backend_info& info, bool single_precision = true)
+{
+    if( single_precision ) {
+        info._create_float = [](const Solver_options& options) -> Solver_backend<float>* {
+            return Backend<float>::create( options );
+        };
+    }
+    info._create_double = [](const Solver_options& options) -> Solver_backend<double>* {
+        return Backend<double>::create( options );
+    };
+}
+
+// Factories of the built-in backends, one per Eigen solver ------------------
+
+template<typename S> struct Sparse_lu {
+    static Solver_backend<S>* create(const Solver_options&) {
+        return new Direct_backend<S, Eigen::SparseLU<Eigen::SparseMatrix<S>>>();
+    }
+};
+
+template<typename S> struct Ldlt {
+    static Solver_backend<S>* create(const Solver_options&) {
+        return new Direct_backend<S, Cholesky_ldlt<Eigen::SparseMatrix<S>>>();
+    }
+};
+
+template<typename S> struct Llt {
+    static Solver_backend<S>* create(const Solver_options&) {
+        return new Direct_backend<S, Cholesky_llt<Eigen::SparseMatrix<S>>>();
+    }
+};
+
+template<typename S> struct Sparse_qr {
+    typedef Eigen::SparseQR<Eigen::SparseMatrix<S>, Eigen::COLAMDOrdering<int>> Solver;
+    static Solver_backend<S>* create(const Solver_options&) {
+        return new Direct_backend<S, Solver>();
+    }
+};
+
+template<typename S> struct Cg {
+    typedef Eigen::ConjugateGradient<Eigen::SparseMatrix<S>, Eigen::Lower> Solver;
+    static Solver_backend<S>* create(const Solver_options& options) {
+        return new Iterative_backend<S, Solver>("cg", options);
+    }
+};
+
+template<typename S> struct Bicgstab {
+    static Solver_backend<S>* create(const Solver_options& options) {
+        return new Iterative_backend<S, Eigen::BiCGSTAB<Eigen::SparseMatrix<S>>>("bicgstab", options);
+    }
+};
+
+#ifdef HARMONIC_WEIGHTS_HAS_CHOLMOD
+template<typename S> struct Cholmod {
+    typedef Eigen::CholmodSupernodalLLT<Eigen::SparseMatrix<S>, Eigen::Lower> Solver;
+    static Solver_backend<S>* create(const Solver_options&) {
+        return new Direct_backend<S, Solver>();
+    }
+};
+#endif
+
+#ifdef HARMONIC_WEIGHTS_HAS_UMFPACK
+template<typename S> struct Umfpack {
+    static Solver_backend<S>* create(const Solver_options&) {
+        return new Direct_backend<S, Eigen::UmfPackLU<Eigen::SparseMatrix<S>>>();
+    }
+};
+#endif
+
+#ifdef HARMONIC_WEIGHTS_HAS_PASTIX
+template<typename S> struct Pastix {
+    typedef Eigen::PastixLLT<Eigen::SparseMatrix<S>, Eigen::Lower> Solver;
+    static Solver_backend<S>* create(const Solver_options&) {
+        return new Direct_backend<S, Solver>();
+    }
+};
+#endif
+
+// -----------------------------------------------------------------------------
+
+Solver_backend_info make_info(const char* name, const char* description,
+                              bool full_system, bool symmetric, bool iterative)
+{
+    Solver_backend_info info;
+    info._name = name;
+    info._description = description;
+    info._full_system = full_system;
+    info._symmetric = symmetric;
+    info._iterative = iterative;
+    return info;
+}
+
+// -----------------------------------------------------------------------------
+
+std::vector<Solver_backend_info> builtin_backends()
+{
+    std::vector<Solver_backend_info> list;
+    Solver_backend_info info;
+
+    info = make_info("lu", "SparseLU on the full system (reference)", true, false, false);
+    set_factories<Sparse_lu>(info);
+    list.push_back( info );
+
+    info = make_info("ldlt", "SimplicialLDLT (Cholesky) on the reduced system", false, true, false);
+    set_factories<Ldlt>(info);
+    list.push_back( info );
+
+    info = make_info("llt", "SimplicialLLT (Cholesky) on the reduced system", false, true, false);
+    set_factories<Llt>(info);
+    list.push_back( info );
+
+    info = make_info("qr", "SparseQR (COLAMD ordering) on the reduced system, small meshes only", false, false, false);
+    set_factories<Sparse_qr>(info);
+    list.push_back( info );
+
+    info = make_info("cg", "conjugate gradient, diagonal preconditioner", false, true, true);
+    set_factories<Cg>(info);
+    list.push_back( info );
+
+    info = make_info("bicgstab", "BiCGSTAB, diagonal preconditioner", false, false, true);
+    set_factories<Bicgstab>(info);
+    list.push_back( info );
+
+#ifdef HARMONIC_WEIGHTS_HAS_CHOLMOD
+    info = make_info("cholmod", "CHOLMOD supernodal Cholesky on the reduced system", false, true, false);
+    set_factories<Cholmod>(info, false);
+    list.push_back( info );
+#endif
+#ifdef HARMONIC_WEIGHTS_HAS_UMFPACK
+    info = make_info("umfpack", "UMFPACK LU on the full system", true, false, false);
+    set_factories<Umfpack>(info, false);
+    list.push_back( info );
+#endif
+#ifdef HARMONIC_WEIGHTS_HAS_PASTIX
+    info = make_info("pastix", "PaStiX Cholesky on the reduced system", false, true, false);
+    set_factories<Pastix>(info, false);
+    list.push_back( info );
+#endif
+    return list;
+}
+
+// -----------------------------------------------------------------------------
+
+// Registering the built-ins on first use (rather than with static
+// constructors) keeps them when linking the static library
+std::mutex g_mutex;
+
+std::vector<Solver_backend_info>& registry()
+{
+    static std::vector<Solver_backend_info> backends = builtin_backends();
+    return backends;
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+bool register_solver_backend(const Solver_backend_info& info)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    std::vector<Solver_backend_info>& backends = registry();
+    bool taken = info._name == "auto";
+    for(const Solver_backend_info& b : backends)
+        taken = taken || b._name == info._name;
+    if( taken || info._name.empty() ) {
+        std::cerr << "Can't register the solver backend '" << info._name;
+        std::cerr << "': name already taken" << std::endl;
+        return false;
+    }
+    backends.push_back( info );
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool find_solver_backend(const std::string& name, Solver_backend_info& info)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    for(const Solver_backend_info& b : registry()) {
+        if( b._name == name ) {
+            info = b;
+            return true;
+        }
+    }
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+
+std::vector<Solver_backend_info> solver_backends()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return registry();
+}
+
+// -----------------------------------------------------------------------------
+
+std::string solver_backend_names()
+{
+    std::string names;
+    for(const Solver_backend_info& b : solver_backends())
+        names += (names.empty() ? "" : ", ") + b._name;
+    return names;
+}
+
+// -----------------------------------------------------------------------------
+
+template<>
+Solver_backend<float>* create_solver_backend<float>(const Solver_backend_info& info,
+                                                    const Solver_options& options)
+{
+    return info._create_float ? info._create_float(options) : nullptr;
+}
+
+template<>
+Solver_backend<double>* create_solver_backend<double>(const Solver_backend_info& info,
+                                                      const Solver_options& options)
+{
+    return info._create_double ? info._create_double(options) : nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+template<typename Scalar>
+bool is_symmetric(const Eigen::SparseMatrix<Scalar>& A)
+{
+    const Scalar eps = Scalar(sizeof(Scalar) < sizeof(double) ? 1e-5 : 1e-8);
+    Eigen::SparseMatrix<Scalar> At = A.transpose();
+    return (A - At).norm() <= eps * A.norm();
+}
+
+template bool is_symmetric<float>(const Eigen::SparseMatrix<float>&);
+template bool is_symmetric<double>(const Eigen::SparseMatrix<double>&);
+
+// -----------------------------------------------------------------------------
+
+template<typename Scalar>
+Solver_backend<Scalar>* make_solver_backend(const Solver_options& options,
+                                            Solver_backend_info& info)
+{
+    if( !find_solver_backend(options._solver, info) ) {
+        std::cerr << "Unknown solver '" << options._solver << "' (expected ";
+        std::cerr << solver_backend_names() << " or auto)" << std::endl;
+        return nullptr;
+    }
+    Solver_backend<Scalar>* backend = create_solver_backend<Scalar>(info, options);
+    if( backend == nullptr ) {
+        std::cerr << "Solver '" << info._name << "' has no ";
+        std::cerr << (sizeof(Scalar) < sizeof(double) ? "single" : "double") << " precision version" << std::endl;
+    }
+    return backend;
+}
+
+template Solver_backend<float>* make_solver_backend<float>(const Solver_options&, Solver_backend_info&);
+template Solver_backend<double>* make_solver_backend<double>(const Solver_options&, Solver_backend_info&);
+
+// -----------------------------------------------------------------------------
+
+template<typename Scalar>
+bool factorize_system(Solver_backend<Scalar>& backend,
+                      const Solver_backend_info& info,
+                      const typename Solver_backend<Scalar>::Matrix& A)
+{
+    if( info._symmetric && !is_symmetric(A) ) {
+        std::cerr << info._name << " needs a symmetric matrix: the Laplacian built from first";
+        std::cerr << " rings is not when free vertices lie on an open side of the mesh";
+        std::cerr << " (use lu, qr or bicgstab, or the Laplacian built from triangles)" << std::endl;
+        return false;
+    }
+    bool ok = false;
+    {
+        Trace_scope trace("analyze_pattern");
+        ok = backend.analyze( A );
+    }
+    if( ok ) {
+        Trace_scope trace("factorize");
+        ok = backend.factorize( A );
+    }
+    if( !ok )
+        std::cerr << info._name << " factorization failed: " << backend.error() << std::endl;
+    return ok;
+}
+
+template bool factorize_system<float>(Solver_backend<float>&, const Solver_backend_info&,
+                                      const Solver_backend<float>::Matrix&);
+template bool factorize_system<double>(Solver_backend<double>&, const Solver_backend_info&,
+                                       const Solver_backend<double>::Matrix&);
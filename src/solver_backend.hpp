@@ -0,0 +1,196 @@
+#ifndef SOLVER_BACKEND_HPP
+#define SOLVER_BACKEND_HPP
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+
+#include "solvers.hpp"
+#include "solve_control.hpp"
+
+/**
+ * @brief Linear solvers of solve_laplace_equation() behind a common
+ * interface, registered by name so they can be picked at runtime
+ * (Solver_options::_solver, '-s' option of the command line tools).
+ *
+ * Built-in backends wrap the Eigen sparse solvers:
+ * "lu" (SparseLU), "ldlt" (SimplicialLDLT), "llt" (SimplicialLLT),
+ * "qr" (SparseQR), "cg" (ConjugateGradient) and "bicgstab" (BiCGSTAB).
+ * "cholmod", "umfpack" and "pastix" are only registered when the library
+ * was found at configure time (double precision only).
+ *
+ * @code
+ * Solver_backend_info info;
+ * if( find_solver_backend("ldlt", info) ) {
+ *     std::unique_ptr<Solver_backend<double>> solver( create_solver_backend<double>(info, options) );
+ *     solver->analyze( A ) && solver->factorize( A ) && solver->solve(b, x);
+ * }
+ * @endcode
+ */
+
+/// Figures reported by a backend after factorize() and solve()
+struct Backend_stats {
+    Backend_stats() : _factor_bytes(0), _iterations(0), _residual(0.) { }
+
+    size_t _factor_bytes; ///< factors or preconditioner (0 if unknown, estimated for lu)
+    int _iterations;      ///< iterative backends
+    double _residual;     ///< relative residual estimated by iterative backends
+};
+
+// -----------------------------------------------------------------------------
+
+/// @brief Copy of a sparse Cholesky factorization P^T L D L^T P (in double
+/// precision whatever the backend precision) that can be reused without the
+/// backend, see io/solve_cache.hpp
+struct Cholesky_factor {
+    Cholesky_factor() : _n(0), _unit_diagonal(true), _single_precision(false) { }
+
+    int _n;
+    /// Compressed columns of L
+    std::vector<int> _outer;
+    std::vector<int> _inner;
+    std::vector<double> _values;
+    /// D of LDL^T (empty for LL^T where L holds the diagonal)
+    std::vector<double> _diag;
+    /// Fill reducing permutation P (empty for the identity)
+    std::vector<int> _perm;
+    /// true: the diagonal of L is implicit and equal to 1 (LDL^T)
+    bool _unit_diagonal;
+    /// Factorized in float (the values only have float accuracy)
+    bool _single_precision;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Interface of a sparse linear solver working on 'Scalar' (float or double)
+template<typename Scalar>
+class Solver_backend {
+public:
+    typedef Eigen::SparseMatrix<Scalar> Matrix;
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, 1> Vector;
+
+    Solver_backend() : _control(nullptr) { }
+    virtual ~Solver_backend() { }
+
+    /// Ordering and symbolic analysis, only the pattern of 'A' is read
+    /// @return false on failure (see error())
+    virtual bool analyze(const Matrix& A) = 0;
+
+    /// Numerical factorization (preconditioner for iterative backends)
+    /// of a matrix with the pattern given to analyze()
+    virtual bool factorize(const Matrix& A) = 0;
+
+    /// Solve A x = b with the last factorization
+    /// @note iterative backends return true even when they did not converge
+    /// (a warning is printed, see stats())
+    virtual bool solve(const Vector& b, Vector& x) = 0;
+
+    virtual Backend_stats stats() const = 0;
+
+    /// Fill reducing ordering used by the next analyze() instead of computing
+    /// one (e.g. Solver_plan::_ordering), as Eigen's ordering methods return
+    /// it (inverse permutation). Ignored when its size is not the one of the
+    /// analyzed matrix.
+    /// @return false if the backend always computes its own ordering
+    virtual bool set_ordering(const std::vector<int>& ordering) { (void)ordering; return false; }
+
+    /// Copy the factorization when it is a Cholesky one (ldlt, llt)
+    /// @return false if the backend can't export its factors
+    virtual bool export_factor(Cholesky_factor& factor) const { (void)factor; return false; }
+
+    /// @return message of the last failure
+    const std::string& error() const { return _error; }
+
+    /// Progress and cancellation of the solve (optional, not owned).
+    /// Iterative backends report their iterations and stop when cancelled.
+    void set_control(Solve_control* control) { _control = control; }
+    Solve_control* control() const { return _control; }
+
+protected:
+    std::string _error;
+    Solve_control* _control;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Description and factories of a registered backend
+struct Solver_backend_info {
+    Solver_backend_info()
+        : _full_system(false)
+        , _symmetric(false)
+        , _iterative(false)
+    { }
+
+    std::string _name;        ///< selects the backend e.g. "ldlt"
+    std::string _description;
+    /// Solves the full system (Dirichlet rows replaced by identity rows)
+    /// instead of the reduced system -L_FF (see Reduced_indices)
+    bool _full_system;
+    /// Only reads the lower triangle: needs a symmetric matrix, checked by
+    /// factorize_system()
+    bool _symmetric;
+    /// Honors Solver_options::_tolerance and _max_iterations
+    bool _iterative;
+    /// Factories, empty when the precision is not supported
+    std::function<Solver_backend<float>* (const Solver_options&)> _create_float;
+    std::function<Solver_backend<double>*(const Solver_options&)> _create_double;
+};
+
+/// Add a backend to the registry
+/// @return false if the name is already taken or is "auto"
+/// (message printed on std::cerr)
+bool register_solver_backend(const Solver_backend_info& info);
+
+/// @return false if no backend is registered under 'name'
+bool find_solver_backend(const std::string& name, Solver_backend_info& info);
+
+/// @return every registered backend, built-ins first
+std::vector<Solver_backend_info> solver_backends();
+
+/// @return names of the registered backends separated by ", "
+std::string solver_backend_names();
+
+/// @return new backend in the precision 'Scalar' (to be deleted by the
+/// caller) or nullptr if 'info' has no factory for it
+template<typename Scalar>
+Solver_backend<Scalar>* create_solver_backend(const Solver_backend_info& info,
+                                              const Solver_options& options);
+
+template<>
+Solver_backend<float>* create_solver_backend<float>(const Solver_backend_info& info,
+                                                    const Solver_options& options);
+template<>
+Solver_backend<double>* create_solver_backend<double>(const Solver_backend_info& info,
+                                                      const Solver_options& options);
+
+// -----------------------------------------------------------------------------
+
+/// @return true if 'A' equals its transpose up to round-off:
+/// |A - A^T| <= eps |A| (Frobenius norms) with eps 1e-8 in double and
+/// 1e-5 in float
+template<typename Scalar>
+bool is_symmetric(const Eigen::SparseMatrix<Scalar>& A);
+
+/// @brief Look up the backend 'options._solver' (anything but "auto") and
+/// create it in the precision 'Scalar'
+/// @param[out] info : description of the backend
+/// @return new backend (to be deleted by the caller) or nullptr if the name
+/// is unknown or the backend has no version in this precision
+/// (message printed on std::cerr)
+template<typename Scalar>
+Solver_backend<Scalar>* make_solver_backend(const Solver_options& options,
+                                            Solver_backend_info& info);
+
+/// @brief Analyze then factorize 'A' with 'backend' created from 'info'.
+/// Backends reading only the lower triangle (Solver_backend_info::_symmetric)
+/// are refused when 'A' is not symmetric (see is_symmetric()).
+/// @return false on failure (message printed on std::cerr)
+template<typename Scalar>
+bool factorize_system(Solver_backend<Scalar>& backend,
+                      const Solver_backend_info& info,
+                      const typename Solver_backend<Scalar>::Matrix& A);
+
+#endif // SOLVER_BACKEND_HPP
@@ -0,0 +1,342 @@
+#include "solver_planner.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+#include <Eigen/OrderingMethods>
+
+#include "solve_control.hpp"
+#include "solver_backend.hpp"
+#include "utils/trace.hpp"
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Structure of the reduced system (boundary vertices eliminated)
+struct Reduced_pattern {
+    int _nb_free;
+    size_t _nb_triplets;       ///< pushed by the solver before compression
+    size_t _nb_full_triplets;  ///< same for the full system of SparseLU
+    size_t _full_nnz;          ///< non zeros of the full system
+    Sparse_mat _matrix;        ///< -L_FF
+};
+
+// -----------------------------------------------------------------------------
+
+void reduce(const std::vector<std::vector<Triplet>>& laplacian,
+            const std::vector<std::pair<Vert_idx, float> >& boundaries,
+            Reduced_pattern& red)
+{
+    int nv = int(laplacian.size());
+    Reduced_indices idx;
+    reduced_indices(nv, boundaries, idx);
+    size_t nb_full = 0;
+    for(int i = 0; i < nv; ++i)
+        nb_full += idx._free_idx[i] < 0 ? 1 : laplacian[i].size(); // identity rows on boundaries
+
+    red._nb_free = idx._nb_free;
+    red._nb_triplets = assemble_reduced_system<double>(laplacian, idx, &red._matrix, nullptr);
+    red._nb_full_triplets = nb_full;
+    // Compression sums duplicates in the same proportion for the full system
+    double ratio = red._nb_triplets == 0 ? 1. : double(red._matrix.nonZeros()) / double(red._nb_triplets);
+    red._full_nnz = size_t(double(nb_full - boundaries.size()) * ratio) + boundaries.size();
+}
+
+// -----------------------------------------------------------------------------
+
+/// Column counts of the LDLT factor of 'A' ordered by AMD
+/// @param ordering : set to the AMD ordering, as SimplicialLDLT computes it
+/// (see Solver_plan::_ordering)
+/// @return non zeros of L (unit diagonal excluded), 'flops' is set to the
+/// sum of the squared column counts
+double cholesky_symbolic(const Sparse_mat& A, std::vector<int>& ordering, double& flops)
+{
+    typedef Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> Permutation;
+    const int n = int(A.rows());
+    Permutation pinv;
+    {
+        Sparse_mat C;
+        C = A.selfadjointView<Eigen::Lower>();
+        Eigen::AMDOrdering<int> amd;
+        amd(C, pinv);
+    }
+    ordering.assign(pinv.indices().data(), pinv.indices().data() + n);
+    Permutation perm = pinv.inverse();
+    Sparse_mat ap(n, n);
+    ap.selfadjointView<Eigen::Upper>() = A.selfadjointView<Eigen::Lower>().twistedBy(perm);
+
+    // Elimination tree (see Eigen's SimplicialCholeskyBase::analyzePattern_preordered())
+    std::vector<int> parent(n), tags(n), col_count(n);
+    for(int k = 0; k < n; ++k)
+    {
+        parent[k] = -1;
+        tags[k] = k;
+        col_count[k] = 0;
+        for(Sparse_mat::InnerIterator it(ap, k); it; ++it)
+        {
+            int i = int(it.index());
+            if( i >= k )
+                continue;
+            for(; tags[i] != k; i = parent[i]) {
+                if( parent[i] == -1 )
+                    parent[i] = k;
+                col_count[i]++;
+                tags[i] = k;
+            }
+        }
+    }
+
+    double nnz = 0.;
+    flops = 0.;
+    for(int k = 0; k < n; ++k) {
+        nnz += col_count[k];
+        flops += double(col_count[k]) * double(col_count[k]);
+    }
+    return nnz;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Bytes of a compressed sparse matrix
+size_t matrix_bytes(double nnz, int n, size_t scalar)
+{
+    return size_t(nnz * double(scalar + sizeof(int))) + size_t(n + 1) * sizeof(int);
+}
+
+/// Peak of plan_solver() itself: Laplacian rows 'rows_bytes' and the reduced
+/// matrix of 'nnz' non zeros, with the copies made by reduce() and
+/// cholesky_symbolic()
+size_t planner_bytes(const Reduced_pattern& red, double nnz, size_t rows_bytes)
+{
+    const int n = red._nb_free;
+    const size_t matrix = matrix_bytes(nnz, n, sizeof(double));
+    // reduce(): triplets, then setFromTriplets() fills a transposed matrix
+    // with the duplicates before compressing it into the result
+    size_t nb_triplets = std::max(red._nb_triplets, size_t(n) * 10);
+    size_t assembly = nb_triplets * sizeof(Eigen::Triplet<double>) +
+                      matrix_bytes(double(red._nb_triplets), n, sizeof(double)) + matrix;
+    // Symmetry test: A and its transpose
+    size_t symmetry = 2 * matrix;
+    // AMD: A, its selfadjoint copy C and A + A^T, which Eigen's
+    // minimum_degree_ordering() reallocates a fifth larger plus 2n (then
+    // 8n integers of workspace replace the old copy)
+    size_t grown = matrix_bytes(nnz * 1.2 + 2. * n, n, sizeof(double));
+    size_t ordering = 2 * matrix + grown + std::max(matrix, size_t(n) * 8 * sizeof(int));
+    return rows_bytes + std::max(assembly, std::max(symmetry, ordering));
+}
+
+// -----------------------------------------------------------------------------
+
+double to_mb(size_t bytes) { return double(bytes) / (1024. * 1024.); }
+
+/// Backends the cost model knows
+enum Candidate { eLU, eLDLT, eCG, eBICGSTAB };
+
+const char* candidate_name(Candidate c)
+{
+    switch( c ) {
+    case eLU:       return "lu";
+    case eLDLT:     return "ldlt";
+    case eCG:       return "cg";
+    case eBICGSTAB: return "bicgstab";
+    }
+    return "";
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+Solver_options Solver_plan::chosen_options() const
+{
+    if( _choice >= 0 )
+        return _estimates[_choice]._options;
+    int best = -1;
+    for(unsigned i = 0; i < _estimates.size(); ++i) {
+        if( !_estimates[i]._applicable )
+            continue;
+        if( best < 0 || _estimates[i]._peak_bytes < _estimates[best]._peak_bytes )
+            best = int(i);
+    }
+    Solver_options options;
+    if( best >= 0 )
+        options = _estimates[best]._options;
+    return options;
+}
+
+// -----------------------------------------------------------------------------
+
+void Solver_plan::print() const
+{
+    std::printf("Solver plan: %d vertices, %d free, %zu non zeros%s, planner %.1f MB\n",
+                _nb_vertices, _nb_free, _reduced_nnz,
+                _symmetric ? "" : " (not symmetric)", to_mb(_planner_bytes));
+    std::printf("  %-22s %12s %10s %12s %12s %10s\n",
+                "solver", "factor nnz", "iterations", "solver (MB)", "peak (MB)", "time (s)");
+    for(const Solver_estimate& e : _estimates)
+    {
+        std::string name = solver_options_string(e._options);
+        const char* note = !e._applicable ? "  needs a symmetric L" :
+                           !e._fits       ? "  over budget" : "";
+        std::printf("  %-22s %12.0f %10.0f %12.1f %12.1f %10.3f%s\n",
+                    name.c_str(), e._factor_nnz, e._iterations,
+                    to_mb(e._solver_bytes), to_mb(e._peak_bytes), e._time, note);
+    }
+
+    std::string budget = "no memory budget";
+    if( _memory_budget > 0 ) {
+        char buff[64];
+        std::snprintf(buff, sizeof(buff), "budget %.1f MB", to_mb(_memory_budget));
+        budget = buff;
+    }
+    std::string chosen = solver_options_string( chosen_options() );
+    if( _choice >= 0 )
+        std::printf("  Chosen: %s (fastest within %s)\n", chosen.c_str(), budget.c_str());
+    else
+        std::printf("  Nothing fits the %s, using the smallest: %s\n", budget.c_str(), chosen.c_str());
+}
+
+// -----------------------------------------------------------------------------
+
+void plan_solver(const std::vector<std::vector<Triplet>>& laplacian,
+                 const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                 const Solver_options& options,
+                 Solver_plan& plan,
+                 const Planner_cost_model& model)
+{
+    Trace_scope trace("plan_solver");
+    const int nv = int(laplacian.size());
+    plan = Solver_plan();
+    plan._nb_vertices = nv;
+    plan._memory_budget = options._memory_budget;
+
+    Reduced_pattern red;
+    reduce(laplacian, boundaries, red);
+    const Sparse_mat& A = red._matrix;
+    const int n = red._nb_free;
+    const double nnz = double(A.nonZeros());
+    plan._nb_free = n;
+    plan._reduced_nnz = size_t(A.nonZeros());
+    plan._symmetric = is_symmetric(A);
+
+    double ldlt_flops = 0.;
+    double ldlt_nnz = n > 0 ? cholesky_symbolic(A, plan._ordering, ldlt_flops) : 0.;
+
+    // Memory shared by every solver: Laplacian rows and triplets
+    // (kept until the end of the solve)
+    const bool single = options._single_precision;
+    const size_t scalar = single ? sizeof(float) : sizeof(double);
+    const size_t triplet = single ? sizeof(Eigen::Triplet<float>) : sizeof(Eigen::Triplet<double>);
+    size_t rows_bytes = laplacian.capacity() * sizeof(std::vector<Triplet>);
+    for(const std::vector<Triplet>& row : laplacian)
+        rows_bytes += row.capacity() * sizeof(Triplet);
+    plan._planner_bytes = planner_bytes(red, nnz, rows_bytes);
+    // The ordering stays alive until the backend analyzed the matrix
+    const size_t ordering_bytes = plan._ordering.size() * sizeof(int);
+    const double tol = std::max(options._tolerance, 1e-16);
+
+    for(Candidate type : {eLU, eLDLT, eCG, eBICGSTAB})
+    {
+        Solver_backend_info info;
+        if( !find_solver_backend(candidate_name(type), info) )
+            continue;
+        Solver_estimate e;
+        e._options = options;
+        e._options._solver = info._name;
+        e._options._memory_budget = 0;
+        e._factor_nnz = 0.;
+        e._iterations = 0.;
+        e._applicable = plan._symmetric || !info._symmetric;
+
+        // Assembly
+        size_t nb_triplets, matrix;
+        double assembly_time;
+        if( info._full_system ) {
+            nb_triplets = std::max(red._nb_full_triplets, size_t(nv) * 10);
+            matrix = matrix_bytes(double(red._full_nnz), nv, scalar);
+            assembly_time = double(red._nb_full_triplets) * model._assembly_per_nnz;
+        } else {
+            nb_triplets = std::max(red._nb_triplets, size_t(n) * 10);
+            matrix = matrix_bytes(nnz, n, scalar);
+            assembly_time = double(red._nb_triplets) * model._assembly_per_nnz;
+        }
+        size_t base = rows_bytes + nb_triplets * triplet;
+
+        // Solver
+        double time = 0.;
+        size_t workspace = 0;
+        switch( type ) {
+        case eLU: {
+            // SparseLU orders the full system itself (COLAMD): its fill is
+            // extrapolated from the one of LDLT
+            e._factor_nnz = ldlt_nnz * model._lu_fill_ratio + nv;
+            e._solver_bytes = matrix_bytes(e._factor_nnz, nv, scalar) + size_t(nv) * 4 * sizeof(int);
+            time = double(red._full_nnz) * model._ordering_per_nnz +
+                   ldlt_flops * model._lu_flop_ratio * model._ldlt_per_flop +
+                   2. * e._factor_nnz * model._solve_per_nnz;
+            workspace = size_t(nv) * 2 * scalar; // right hand side and solution
+        } break;
+        case eLDLT: {
+            e._factor_nnz = ldlt_nnz + n;
+            e._solver_bytes = matrix_bytes(ldlt_nnz, n, scalar) + size_t(n) * (scalar + 2 * sizeof(int));
+            time = nnz * model._ordering_per_nnz +
+                   ldlt_flops * model._ldlt_per_flop +
+                   2. * e._factor_nnz * model._solve_per_nnz;
+            // Upper triangle of the permuted matrix during the analysis
+            workspace = matrix_bytes(nnz * 0.5 + n, n, scalar);
+        } break;
+        case eCG:
+        case eBICGSTAB: {
+            bool cg = type == eCG;
+            double factor = cg ? model._cg_iterations : model._bicgstab_iterations;
+            e._iterations = std::min(double(n), std::ceil(factor * std::sqrt(double(n)) * std::log(1. / tol)));
+            if( options._max_iterations > 0 )
+                e._iterations = std::min(e._iterations, double(options._max_iterations));
+            // Diagonal preconditioner and work vectors
+            int nb_vectors = cg ? 6 : 10;
+            e._solver_bytes = size_t(n) * size_t(nb_vectors) * scalar;
+            double per_iteration = (nnz + 6. * n) * model._matvec_per_nnz;
+            time = e._iterations * per_iteration * (cg ? 1. : 2.);
+        } break;
+        }
+
+        // Peak: compressing the triplets needs a second copy of the
+        // matrix, then factors / work vectors live with the matrix.
+        // The planner ran before with its own peak.
+        size_t solve_peak = base + matrix + std::max(matrix, e._solver_bytes + workspace) + ordering_bytes;
+        e._peak_bytes = std::max(solve_peak, plan._planner_bytes);
+        e._time = assembly_time + time;
+        e._fits = options._memory_budget == 0 || e._peak_bytes <= options._memory_budget;
+        plan._estimates.push_back( e );
+    }
+
+    for(unsigned i = 0; i < plan._estimates.size(); ++i) {
+        const Solver_estimate& e = plan._estimates[i];
+        if( !e._applicable || !e._fits )
+            continue;
+        if( plan._choice < 0 || e._time < plan._estimates[plan._choice]._time )
+            plan._choice = int(i);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+bool choose_solver(const std::vector<std::vector<Triplet>>& laplacian,
+                   const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                   Solve_control* control,
+                   Solver_options& options,
+                   std::vector<int>& ordering)
+{
+    ordering.clear();
+    if( options._solver != "auto" )
+        return true;
+    if( control != nullptr && !control->enter_phase(ePHASE_PLANNING) )
+        return false;
+    Solver_plan plan;
+    plan_solver(laplacian, boundaries, options, plan);
+    plan.print();
+    options = plan.chosen_options();
+    ordering.swap( plan._ordering );
+    return true;
+}
@@ -0,0 +1,149 @@
+#ifndef SOLVER_PLANNER_HPP
+#define SOLVER_PLANNER_HPP
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+
+#include "solvers.hpp"
+
+/**
+ * @brief Predict the memory and time of each linear solver before solving,
+ * and pick the fastest one fitting a memory budget (Solver_options
+ * with the "auto" solver).
+ *
+ * Predictions come from a symbolic analysis of the reduced system: an
+ * approximate minimum degree ordering (the one of SimplicialLDLT) then
+ * the column counts of the Cholesky factor given by its elimination tree.
+ * This gives the exact size of the LDLT factor and its flop count without
+ * allocating the factor. The planner still assembles the reduced matrix
+ * and the copies the ordering needs: O(nnz(A)) memory, reported in
+ * Solver_plan::_planner_bytes and counted against the budget. The column
+ * counts take O(nnz(L)) time once the matrix is ordered.
+ * The ordering is kept (Solver_plan::_ordering) for the backends which
+ * can reuse it instead of computing it again (ldlt, llt).
+ * SparseLU fill and iteration counts of CG / BiCGSTAB are extrapolated
+ * with the empirical ratios of Planner_cost_model.
+ */
+
+/// nnz(L + U) of SparseLU (COLAMD on the full system) over nnz(L) of
+/// SimplicialLDLT (AMD on the reduced system). Empirical, not derived:
+/// measured between 3.3 (20K vertices) and 4.5 (500K vertices) on the
+/// generated grids, tori, perforated planes and icospheres with strips or
+/// scattered Dirichlet vertices; it slowly grows with the mesh size.
+const double g_lu_fill_ratio = 3.7;
+
+/// @brief Constants of the time and memory model.
+/// Rates are seconds per elementary operation calibrated on a 200K vertex grid
+/// (Release build): absolute times are indicative, what matters is the
+/// ratio between solvers.
+struct Planner_cost_model {
+    Planner_cost_model()
+        : _assembly_per_nnz(3e-8)
+        , _ordering_per_nnz(6e-8)
+        , _ldlt_per_flop(0.9e-9)
+        , _solve_per_nnz(3e-9)
+        , _lu_fill_ratio(g_lu_fill_ratio)
+        , _lu_flop_ratio(1.9)
+        , _matvec_per_nnz(1.5e-9)
+        , _cg_iterations(0.09)
+        , _bicgstab_iterations(0.06)
+    { }
+
+    double _assembly_per_nnz;   ///< triplets and compressed matrix
+    double _ordering_per_nnz;   ///< ordering and symbolic analysis
+    double _ldlt_per_flop;      ///< numerical factorization
+    double _solve_per_nnz;      ///< triangular solves, per non zero of the factors
+    double _lu_fill_ratio;      ///< nnz(L + U) of SparseLU / nnz(L) of LDLT
+    double _lu_flop_ratio;      ///< flops of SparseLU / flops of LDLT
+    double _matvec_per_nnz;     ///< sparse matrix vector product
+    /// Iterations = factor * sqrt(nb_free) * ln(1 / tolerance)
+    /// (condition number of the Laplacian grows like the number of vertices)
+    double _cg_iterations;
+    double _bicgstab_iterations;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Prediction for one solver configuration
+struct Solver_estimate {
+    Solver_options _options;
+    /// Non zeros of the factors (0 for iterative solvers)
+    double _factor_nnz;
+    /// Predicted iterations (0 for direct solvers)
+    double _iterations;
+    /// Factors, or preconditioner and work vectors of iterative solvers
+    size_t _solver_bytes;
+    /// Predicted peak of solve_laplace_equation(): Laplacian rows,
+    /// triplets, sparse matrix and _solver_bytes, or the peak of the
+    /// planner (Solver_plan::_planner_bytes) when higher
+    size_t _peak_bytes;
+    /// Predicted seconds of assembly, factorization and solve
+    double _time;
+    /// false when the solver needs a symmetric matrix and L is not
+    bool _applicable;
+    bool _fits; ///< _peak_bytes within the memory budget
+};
+
+// -----------------------------------------------------------------------------
+
+struct Solver_plan {
+    Solver_plan()
+        : _nb_vertices(0)
+        , _nb_free(0)
+        , _reduced_nnz(0)
+        , _symmetric(true)
+        , _memory_budget(0)
+        , _planner_bytes(0)
+        , _choice(-1)
+    { }
+
+    int _nb_vertices;
+    int _nb_free;           ///< vertices without boundary condition
+    size_t _reduced_nnz;    ///< non zeros of the reduced system
+    bool _symmetric;        ///< is the reduced system symmetric
+    size_t _memory_budget;  ///< bytes (0: no limit)
+    /// Predicted peak of plan_solver(): Laplacian rows, reduced matrix and
+    /// the copies made to order it
+    size_t _planner_bytes;
+    /// AMD ordering of the reduced system (inverse permutation, as Eigen's
+    /// ordering methods return it), see Solver_backend::set_ordering()
+    std::vector<int> _ordering;
+    std::vector<Solver_estimate> _estimates;
+    /// Index of the fastest applicable estimate within the budget,
+    /// -1 if none fits
+    int _choice;
+
+    /// @return options of the choice, or of the applicable solver needing
+    /// the least memory when nothing fits
+    Solver_options chosen_options() const;
+
+    /// Print the estimates and the decision on the standard output
+    void print() const;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @brief Estimate every solver on the Laplacian 'laplacian' (as returned by
+/// get_laplacian()) with the Dirichlet conditions 'boundaries'.
+/// Candidates are SparseLU, LDLT, CG and BiCGSTAB in the precision and
+/// with the tolerance of 'options'. The budget is 'options._memory_budget'.
+void plan_solver(const std::vector<std::vector<Triplet>>& laplacian,
+                 const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                 const Solver_options& options,
+                 Solver_plan& plan,
+                 const Planner_cost_model& model = Planner_cost_model());
+
+/// @brief Options the solve runs with: 'options' itself, or the choice of
+/// plan_solver() for "auto" (the plan is printed)
+/// @param control : receives the planning phase of "auto" (optional)
+/// @param[out] ordering : of the reduced system for the chosen backend,
+/// empty when 'options' is not "auto"
+/// @return false if the solve was cancelled
+bool choose_solver(const std::vector<std::vector<Triplet>>& laplacian,
+                   const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                   Solve_control* control,
+                   Solver_options& options,
+                   std::vector<int>& ordering);
+
+#endif // SOLVER_PLANNER_HPP
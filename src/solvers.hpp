@@ -1,10 +1,93 @@
 #ifndef SOLVERS_HPP
 #define SOLVERS_HPP
 
+#include <string>
 #include <vector>
+#include <Eigen/Sparse>
 #include "mesh.hpp"
 #include "vec3.hpp"
 
+class Solve_control;
+
+typedef Eigen::Triplet<double, int> Triplet;
+/// declares a column-major sparse matrix type of double
+typedef Eigen::SparseMatrix<double> Sparse_mat;
+
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief How solve_laplace_equation() solves the linear system.
+ *
+ * '_solver' names a backend of the registry (see solver_backend.hpp):
+ * lu, ldlt, llt, qr, cg, bicgstab (and cholmod, umfpack, pastix when
+ * available). Apart from lu and umfpack, backends work on the reduced
+ * system: boundary vertices are eliminated which leaves the matrix -L
+ * restricted to the free vertices. It is symmetric positive definite
+ * (every connected component touching a boundary) only when L is
+ * symmetric: always true for the Laplacian built from triangles, true for
+ * the one built from first rings when every vertex on a side of the mesh
+ * is a boundary vertex, false otherwise.
+ * ldlt, llt and cg only read its lower triangle and refuse a matrix that is
+ * not symmetric (see factorize_system()).
+ * Iterative solvers use a diagonal preconditioner.
+ * "auto" estimates every solver on the assembled Laplacian (plan_solver())
+ * and runs the fastest one whose predicted peak memory fits _memory_budget.
+ */
+struct Solver_options {
+    Solver_options()
+        : _solver("lu")
+        , _single_precision(false)
+        , _tolerance(1e-10)
+        , _max_iterations(0)
+        , _memory_budget(0)
+    { }
+
+    std::string _solver; ///< backend name or "auto"
+    /// Matrices and vectors in float instead of double
+    bool _single_precision;
+    /// Relative residual reached by iterative solvers
+    double _tolerance;
+    /// Iterative solvers stop there, 0 is Eigen's default (twice the size)
+    int _max_iterations;
+    /// Bytes "auto" may use (0: no limit)
+    size_t _memory_budget;
+};
+
+/// @brief Parse "<solver>[:<tolerance>][:float|double]"
+/// e.g. "lu", "ldlt:float", "cg:1e-6", "bicgstab:1e-8:float", "auto:1e-8"
+/// where <solver> is a registered backend or "auto"
+/// @return false if 'spec' is invalid (message printed on std::cerr)
+bool parse_solver_options(const char* spec, Solver_options& options);
+
+/// @return 'options' formatted as parse_solver_options() reads them
+std::string solver_options_string(const Solver_options& options);
+
+// -----------------------------------------------------------------------------
+
+/// Time spent in each phase of solve_laplace_equation() (in seconds)
+struct Solve_timings {
+    Solve_timings()
+        : _laplacian(0.), _planning(0.), _assembly(0.), _factorization(0.), _solve(0.)
+        , _iterations(0), _residual(0.)
+        , _cached_weights(false), _cached_factor(false)
+    { }
+
+    double _laplacian;     ///< cotangent weights
+    double _planning;      ///< plan_solver() ("auto" only)
+    double _assembly;      ///< boundary conditions and sparse matrix
+    double _factorization; ///< factorization or preconditioner setup
+    double _solve;
+
+    int _iterations;       ///< done by iterative solvers
+    double _residual;      ///< relative residual estimated by iterative solvers
+    bool _cached_weights;  ///< weights read from the solve cache
+    bool _cached_factor;   ///< factorization read from the solve cache
+
+    double total() const { return _laplacian + _planning + _assembly + _factorization + _solve; }
+};
+
+// -----------------------------------------------------------------------------
+
 /// http://rodolphe-vaillant.fr/entry/20/compute-harmonic-weights-on-a-triangular-mesh
 ///
 /// @brief Compute harmonic weight map of a triangle mesh
@@ -19,10 +102,128 @@
 /// 'vertices'
 /// @param[out] harmonic_weight_map : values computed inside the boundary
 /// these values should represent an harmonic function
-void solve_laplace_equation(const std::vector< Vec3 >& vertices,
+/// @param[out] timings : time spent in each phase (optional)
+/// @param options : linear solver to use (SparseLU in double by default)
+/// @param control : progress report and cancellation (optional, see
+/// solve_control.hpp and solve_async.hpp to solve on another thread)
+/// @return false if the factorization failed (message printed on std::cerr)
+/// or the solve was cancelled
+bool solve_laplace_equation(const std::vector< Vec3 >& vertices,
         const std::vector< std::vector<int> >& edges,
         const std::vector<Tri_face>& triangles,
         const std::vector<std::pair<Vert_idx, float> >& boundaries,
-        std::vector<double>& harmonic_weight_map);
+        std::vector<double>& harmonic_weight_map,
+        Solve_timings* timings = nullptr,
+        const Solver_options* options = nullptr,
+        Solve_control* control = nullptr);
+
+/// Same as above with the rows of the Laplacian already built (see
+/// build_mesh_pipelined()), 'laplacian' is consumed.
+/// 'edges' and 'triangles' only identify the mesh in the solve cache.
+bool solve_laplace_equation(const std::vector< Vec3 >& vertices,
+        const std::vector< std::vector<int> >& edges,
+        const std::vector<Tri_face>& triangles,
+        std::vector<std::vector<Triplet>>& laplacian,
+        const std::vector<std::pair<Vert_idx, float> >& boundaries,
+        std::vector<double>& harmonic_weight_map,
+        Solve_timings* timings = nullptr,
+        const Solver_options* options = nullptr,
+        Solve_control* control = nullptr);
+
+// -----------------------------------------------------------------------------
+
+/// @return A sparse representation of the Laplacian matrix 'L' computed
+/// with cotangent weights from the first ring of each vertex
+/// list[ith_row][list of columns] = Triplet(ith_row, jth_column, matrix value)
+std::vector<std::vector<Triplet>>
+get_laplacian(const std::vector< Vec3 >& vertices,
+              const std::vector< std::vector<int> >& edges );
+
+/// @return same as above but computed from the list of triangles.
+/// @note rows may hold duplicate entries (summed by setFromTriplets())
+std::vector<std::vector<Triplet>>
+get_laplacian(const std::vector< Vec3 >& vertices,
+              const std::vector< Tri_face >& triangles );
+
+/// @brief Rows [begin end) of get_laplacian(), to build the Laplacian block
+/// by block (distinct blocks may be computed in parallel, see mesh_pipeline.hpp)
+/// @pre 'mat_elemts' holds one row per vertex
+void get_laplacian_rows(const std::vector< Vec3 >& vertices,
+                        const std::vector< std::vector<int> >& edges,
+                        int begin, int end,
+                        std::vector<std::vector<Triplet>>& mat_elemts);
+
+/// Same as above computed from the triangles incident to each vertex
+/// @param tris_per_vertex : Vertex_to_face::_1st_ring_tris
+void get_laplacian_rows(const std::vector< Vec3 >& vertices,
+                        const std::vector< Tri_face >& triangles,
+                        const std::vector< std::vector<Tri_idx> >& tris_per_vertex,
+                        int begin, int end,
+                        std::vector<std::vector<Triplet>>& mat_elemts);
+
+// -----------------------------------------------------------------------------
+
+/// @brief Re-emit the Laplacian rows 'rows' after a local edit of the mesh
+/// (see Mesh_editor) the other rows of 'mat_elemts' are left untouched.
+/// 'mat_elemts' is resized to the new number of vertices.
+/// @param edges : up to date first ring neighbors
+/// (Vertex_to_1st_ring_vertices::_rings_per_vertex)
+/// @param rows : typically Topology_delta::_dirty_vertices
+void update_laplacian_rows(const std::vector< Vec3 >& vertices,
+                           const std::vector< std::vector<int> >& edges,
+                           const std::vector<Vert_idx>& rows,
+                           std::vector<std::vector<Triplet>>& mat_elemts);
+
+/// Same as above for a Laplacian built from the list of triangles
+/// @param tris_per_vertex : up to date Vertex_to_face::_1st_ring_tris
+void update_laplacian_rows(const std::vector< Vec3 >& vertices,
+                           const std::vector< Tri_face >& triangles,
+                           const std::vector< std::vector<Tri_idx> >& tris_per_vertex,
+                           const std::vector<Vert_idx>& rows,
+                           std::vector<std::vector<Triplet>>& mat_elemts);
+
+// -----------------------------------------------------------------------------
+
+/// @brief Split of the vertices between the free ones F and the boundary
+/// ones B: L_FF x_F + L_FB x_B = 0 gives the reduced system
+/// (-L_FF) x_F = L_FB x_B. -L_FF is symmetric positive definite when L is
+/// symmetric (see Solver_options), not for the first ring Laplacian of a
+/// mesh with free vertices on an open side.
+struct Reduced_indices {
+    Reduced_indices() : _nb_free(0), _nb_boundaries(0) { }
+
+    std::vector<int> _free_idx;     ///< row in the reduced system, -1 on boundaries
+    std::vector<int> _boundary_idx; ///< column of L_FB, -1 for free vertices
+    int _nb_free;
+    int _nb_boundaries;
+};
+
+/// @param boundaries : Dirichlet vertices (values are ignored)
+void reduced_indices(int nb_vertices,
+                     const std::vector<std::pair<Vert_idx, float> >& boundaries,
+                     Reduced_indices& idx);
+
+/// @brief Assemble the blocks of the reduced system from the rows of the
+/// Laplacian (see get_laplacian())
+/// @param[out] A : -L_FF (not assembled when nullptr, e.g. when the
+/// factorization is already known)
+/// @param[out] coupling : L_FB, builds the right hand side from the
+/// boundary values (not assembled when nullptr)
+/// @return number of triplets of 'A' before compression
+template<typename Scalar>
+size_t assemble_reduced_system(const std::vector<std::vector<Triplet>>& mat_elemts,
+                               const Reduced_indices& idx,
+                               Eigen::SparseMatrix<Scalar>* A,
+                               Eigen::SparseMatrix<double, Eigen::RowMajor>* coupling);
+
+/// @brief Assemble the full system from the rows of the Laplacian: rows of
+/// the boundary vertices are replaced by identity rows, the right hand side
+/// then holds the boundary values on these rows and 0 elsewhere.
+/// Works whether L is symmetric or not.
+/// @return number of triplets of 'A' before compression
+template<typename Scalar>
+size_t assemble_full_system(const std::vector<std::vector<Triplet>>& mat_elemts,
+                            const Reduced_indices& idx,
+                            Eigen::SparseMatrix<Scalar>& A);
 
 #endif // SOLVERS_HPP
@@ -0,0 +1,368 @@
+#include "spatial_index.hpp"
+
+#include <cmath>
+#include <map>
+#include <thread>
+
+#include "utils/parallel_for.hpp"
+#include "utils/trace.hpp"
+
+// -----------------------------------------------------------------------------
+
+/// Items per leaf: vertices are cheap to test, triangles less so
+static const int g_vertex_leaf_size = 8;
+static const int g_triangle_leaf_size = 4;
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Top down construction of a Spatial_index::Tree
+template<class Node>
+class Tree_builder {
+public:
+    Tree_builder(const std::vector<Aabb>& boxes, int leaf_size,
+                 std::vector<int>& items, std::vector<Node>& nodes)
+        : _boxes(boxes), _leaf_size(leaf_size), _items(items), _nodes(nodes)
+    {
+        _centroids.resize( boxes.size() );
+        parallel_for(0, int(boxes.size()), [&](int i) {
+            _centroids[i] = (boxes[i]._min + boxes[i]._max) * 0.5f;
+        });
+        // A level holds subtrees of at most two sizes: n/2 and n - n/2
+        count_nodes( int(boxes.size()) );
+    }
+
+    int nb_nodes(int n) const { return n <= _leaf_size ? 1 : _nb_nodes.at(n); }
+
+    /// Build the subtree of 'node' over the items [begin end)
+    /// @param parallel_depth : levels left where children are built by two threads
+    void build(int node, int begin, int end, int parallel_depth)
+    {
+        Node& nd = _nodes[node];
+        const int n = end - begin;
+        if( n <= _leaf_size ) {
+            nd._box = Aabb();
+            for(int i = begin; i < end; ++i)
+                nd._box.add( _boxes[_items[i]] );
+            nd._first = begin;
+            nd._count = n;
+            return;
+        }
+
+        Aabb centroids;
+        for(int i = begin; i < end; ++i)
+            centroids.add( _centroids[_items[i]] );
+        Vec3 extent = centroids._max - centroids._min;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+        const int mid = begin + n / 2;
+        std::nth_element(_items.begin() + begin, _items.begin() + mid, _items.begin() + end,
+                         [&](int a, int b) { return _centroids[a][axis] < _centroids[b][axis]; });
+
+        const int left = node + 1;
+        const int right = left + nb_nodes(n / 2);
+        nd._first = right;
+        nd._count = 0;
+        if( parallel_depth > 0 ) {
+            std::thread thread([=] { build(left, begin, mid, parallel_depth - 1); });
+            build(right, mid, end, parallel_depth - 1);
+            thread.join();
+        } else {
+            build(left, begin, mid, 0);
+            build(right, mid, end, 0);
+        }
+        // Bottom up: the children are done
+        nd._box = _nodes[left]._box;
+        nd._box.add( _nodes[right]._box );
+    }
+
+private:
+    void count_nodes(int n)
+    {
+        if( n <= _leaf_size || _nb_nodes.count(n) )
+            return;
+        count_nodes(n / 2);
+        count_nodes(n - n / 2);
+        _nb_nodes[n] = 1 + nb_nodes(n / 2) + nb_nodes(n - n / 2);
+    }
+
+    const std::vector<Aabb>& _boxes;
+    std::vector<Vec3> _centroids;
+    int _leaf_size;
+    std::vector<int>& _items;
+    std::vector<Node>& _nodes;
+    std::map<int, int> _nb_nodes; ///< nodes of a subtree over n > _leaf_size items
+};
+
+// -----------------------------------------------------------------------------
+
+/// Closest point to 'p' on the triangle (a, b, c) and its barycentric
+/// coordinates (Ericson, Real-Time Collision Detection 5.1.5)
+Vec3 closest_on_triangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c, Vec3& bary)
+{
+    Vec3 ab = b - a;
+    Vec3 ac = c - a;
+    Vec3 ap = p - a;
+    float d1 = ab.dot(ap);
+    float d2 = ac.dot(ap);
+    if( d1 <= 0.f && d2 <= 0.f ) {
+        bary = Vec3(1.f, 0.f, 0.f);
+        return a;
+    }
+    Vec3 bp = p - b;
+    float d3 = ab.dot(bp);
+    float d4 = ac.dot(bp);
+    if( d3 >= 0.f && d4 <= d3 ) {
+        bary = Vec3(0.f, 1.f, 0.f);
+        return b;
+    }
+    float vc = d1 * d4 - d3 * d2;
+    if( vc <= 0.f && d1 >= 0.f && d3 <= 0.f ) {
+        float v = d1 / (d1 - d3);
+        bary = Vec3(1.f - v, v, 0.f);
+        return a + ab * v;
+    }
+    Vec3 cp = p - c;
+    float d5 = ab.dot(cp);
+    float d6 = ac.dot(cp);
+    if( d6 >= 0.f && d5 <= d6 ) {
+        bary = Vec3(0.f, 0.f, 1.f);
+        return c;
+    }
+    float vb = d5 * d2 - d1 * d6;
+    if( vb <= 0.f && d2 >= 0.f && d6 <= 0.f ) {
+        float w = d2 / (d2 - d6);
+        bary = Vec3(1.f - w, 0.f, w);
+        return a + ac * w;
+    }
+    float va = d3 * d6 - d5 * d4;
+    if( va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f ) {
+        float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        bary = Vec3(0.f, 1.f - w, w);
+        return b + (c - b) * w;
+    }
+    float sum = va + vb + vc;
+    if( !(sum > 0.f) ) {
+        // Degenerate triangle
+        bary = Vec3(1.f, 0.f, 0.f);
+        return a;
+    }
+    float v = vb / sum;
+    float w = vc / sum;
+    bary = Vec3(1.f - v - w, v, w);
+    return a + ab * v + ac * w;
+}
+
+/// Levels of a tree built by parallel threads
+int parallel_depth()
+{
+    int depth = 0;
+    while( (1u << depth) < get_nb_threads() )
+        ++depth;
+    return depth;
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+void Spatial_index::Tree::build(const std::vector<Aabb>& boxes, int leaf_size)
+{
+    clear();
+    const int n = int(boxes.size());
+    if( n == 0 )
+        return;
+    _items.resize( n );
+    for(int i = 0; i < n; ++i)
+        _items[i] = i;
+    Tree_builder<Node> builder(boxes, leaf_size, _items, _nodes);
+    _nodes.resize( builder.nb_nodes(n) );
+    builder.build(0, 0, n, parallel_depth());
+}
+
+// -----------------------------------------------------------------------------
+
+void Spatial_index::build(const Mesh& mesh)
+{
+    Trace_scope trace("build_spatial_index");
+    build_vertices( mesh._vertices );
+    build_triangles( mesh._vertices, mesh._triangles );
+}
+
+// -----------------------------------------------------------------------------
+
+void Spatial_index::build_vertices(const std::vector<Vec3>& vertices)
+{
+    const int nv = int(vertices.size());
+    std::vector<Aabb> boxes( nv );
+    parallel_for(0, nv, [&](int i) { boxes[i] = Aabb(vertices[i], vertices[i]); });
+    _vertex_tree.build(boxes, g_vertex_leaf_size);
+
+    _points.resize( nv );
+    parallel_for(0, nv, [&](int i) { _points[i] = vertices[ _vertex_tree._items[i] ]; });
+}
+
+// -----------------------------------------------------------------------------
+
+void Spatial_index::build_triangles(const std::vector<Vec3>& vertices, const std::vector<Tri_face>& triangles)
+{
+    const int nt = int(triangles.size());
+    std::vector<Aabb> boxes( nt );
+    parallel_for(0, nt, [&](int t) {
+        for(int k = 0; k < 3; ++k)
+            boxes[t].add( vertices[triangles[t][k]] );
+    });
+    _triangle_tree.build(boxes, g_triangle_leaf_size);
+
+    _corners.resize( 3 * size_t(nt) );
+    parallel_for(0, nt, [&](int i) {
+        const Tri_face& tri = triangles[ _triangle_tree._items[i] ];
+        for(int k = 0; k < 3; ++k)
+            _corners[3 * size_t(i) + k] = vertices[tri[k]];
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+void Spatial_index::clear()
+{
+    _vertex_tree.clear();
+    _triangle_tree.clear();
+    _points.clear();
+    _corners.clear();
+}
+
+// -----------------------------------------------------------------------------
+
+size_t Spatial_index::bytes() const
+{
+    return heap_bytes(_vertex_tree._nodes) + heap_bytes(_vertex_tree._items) +
+           heap_bytes(_triangle_tree._nodes) + heap_bytes(_triangle_tree._items) +
+           heap_bytes(_points) + heap_bytes(_corners);
+}
+
+// -----------------------------------------------------------------------------
+
+void Spatial_index::vertices_in_box(const Aabb& box, std::vector<Vert_idx>& out) const
+{
+    vertices_where([&](const Aabb& b) { return box.overlaps(b); },
+                   [&](const Vec3& p) { return box.contains(p); }, out);
+}
+
+// -----------------------------------------------------------------------------
+
+void Spatial_index::vertices_in_sphere(const Vec3& center, float radius, std::vector<Vert_idx>& out) const
+{
+    const float r2 = radius * radius;
+    vertices_where([&](const Aabb& b) { return b.distance_squared(center) <= r2; },
+                   [&](const Vec3& p) { return (p - center).norm_squared() <= r2; }, out);
+}
+
+// -----------------------------------------------------------------------------
+
+Vert_idx Spatial_index::nearest_vertex(const Vec3& pos, float* distance) const
+{
+    std::vector<std::pair<Vert_idx, float> > nearest;
+    k_nearest_vertices(pos, 1, nearest);
+    if( nearest.empty() )
+        return -1;
+    if( distance != nullptr )
+        *distance = nearest[0].second;
+    return nearest[0].first;
+}
+
+// -----------------------------------------------------------------------------
+
+void Spatial_index::k_nearest_vertices(const Vec3& pos, int k, std::vector<std::pair<Vert_idx, float> >& out) const
+{
+    out.clear();
+    const std::vector<Node>& nodes = _vertex_tree._nodes;
+    if( nodes.empty() || k <= 0 )
+        return;
+
+    // Max heap of the (squared distance, tree position) of the best so far
+    std::vector<std::pair<float, int> > heap;
+    heap.reserve( k );
+    float worst = FLT_MAX;
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while( top > 0 )
+    {
+        const int idx = stack[--top];
+        const Node& node = nodes[idx];
+        if( node._box.distance_squared(pos) > worst )
+            continue;
+        if( node._count == 0 ) {
+            // Visit the closest child first
+            int near = idx + 1, far = node._first;
+            if( nodes[far]._box.distance_squared(pos) < nodes[near]._box.distance_squared(pos) )
+                std::swap(near, far);
+            stack[top++] = far;
+            stack[top++] = near;
+            continue;
+        }
+        for(int i = node._first; i < node._first + node._count; ++i) {
+            float d2 = (_points[i] - pos).norm_squared();
+            if( int(heap.size()) < k ) {
+                heap.push_back( std::make_pair(d2, i) );
+                std::push_heap(heap.begin(), heap.end());
+            } else if( d2 < heap.front().first ) {
+                std::pop_heap(heap.begin(), heap.end());
+                heap.back() = std::make_pair(d2, i);
+                std::push_heap(heap.begin(), heap.end());
+            }
+            if( int(heap.size()) == k )
+                worst = heap.front().first;
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end());
+    out.reserve( heap.size() );
+    for(const std::pair<float, int>& elt : heap)
+        out.push_back( std::make_pair(_vertex_tree._items[elt.second], std::sqrt(elt.first)) );
+}
+
+// -----------------------------------------------------------------------------
+
+bool Spatial_index::closest_point(const Vec3& pos, Surface_point& out, float max_distance) const
+{
+    out = Surface_point();
+    const std::vector<Node>& nodes = _triangle_tree._nodes;
+    if( nodes.empty() )
+        return false;
+
+    float best = max_distance < FLT_MAX ? max_distance * max_distance : FLT_MAX;
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while( top > 0 )
+    {
+        const int idx = stack[--top];
+        const Node& node = nodes[idx];
+        if( node._box.distance_squared(pos) >= best )
+            continue;
+        if( node._count == 0 ) {
+            int near = idx + 1, far = node._first;
+            if( nodes[far]._box.distance_squared(pos) < nodes[near]._box.distance_squared(pos) )
+                std::swap(near, far);
+            stack[top++] = far;
+            stack[top++] = near;
+            continue;
+        }
+        for(int i = node._first; i < node._first + node._count; ++i) {
+            const Vec3* c = &_corners[3 * size_t(i)];
+            Vec3 bary;
+            Vec3 p = closest_on_triangle(pos, c[0], c[1], c[2], bary);
+            float d2 = (p - pos).norm_squared();
+            if( d2 < best ) {
+                best = d2;
+                out._tri = _triangle_tree._items[i];
+                out._bary = bary;
+                out._pos = p;
+            }
+        }
+    }
+    if( out._tri < 0 )
+        return false;
+    out._distance = std::sqrt(best);
+    return true;
+}
@@ -0,0 +1,174 @@
+#ifndef SPATIAL_INDEX_HPP
+#define SPATIAL_INDEX_HPP
+
+#include <algorithm>
+#include <cfloat>
+#include <utility>
+#include <vector>
+
+#include "mesh.hpp"
+
+/// Axis aligned bounding box (empty when _min > _max)
+struct Aabb {
+    Aabb() : _min(FLT_MAX), _max(-FLT_MAX) { }
+    Aabb(const Vec3& min, const Vec3& max) : _min(min), _max(max) { }
+
+    void add(const Vec3& p) {
+        _min = Vec3(std::min(_min.x, p.x), std::min(_min.y, p.y), std::min(_min.z, p.z));
+        _max = Vec3(std::max(_max.x, p.x), std::max(_max.y, p.y), std::max(_max.z, p.z));
+    }
+
+    void add(const Aabb& b) { add(b._min); add(b._max); }
+
+    bool overlaps(const Aabb& b) const {
+        return _min.x <= b._max.x && _min.y <= b._max.y && _min.z <= b._max.z &&
+               b._min.x <= _max.x && b._min.y <= _max.y && b._min.z <= _max.z;
+    }
+
+    bool contains(const Vec3& p) const {
+        return p.x >= _min.x && p.y >= _min.y && p.z >= _min.z &&
+               p.x <= _max.x && p.y <= _max.y && p.z <= _max.z;
+    }
+
+    /// Squared distance from 'p' to the box (0 inside)
+    float distance_squared(const Vec3& p) const {
+        float dx = std::max(std::max(_min.x - p.x, 0.f), p.x - _max.x);
+        float dy = std::max(std::max(_min.y - p.y, 0.f), p.y - _max.y);
+        float dz = std::max(std::max(_min.z - p.z, 0.f), p.z - _max.z);
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    Vec3 _min, _max;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Point on the surface of a mesh
+struct Surface_point {
+    Surface_point() : _tri(-1), _bary(0.f), _pos(0.f), _distance(FLT_MAX) { }
+
+    Tri_idx _tri;    ///< triangle holding the point
+    Vec3 _bary;      ///< barycentric coordinates of the corners of _tri
+    Vec3 _pos;
+    float _distance; ///< to the query point
+};
+
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Bounding volume hierarchies over the vertices and the triangles of
+ * a mesh, for region, nearest vertex and closest point queries in
+ * logarithmic time instead of scans over every vertex.
+ *
+ * @code
+ * Spatial_index index;
+ * index.build( mesh );
+ * std::vector<Vert_idx> inside;
+ * index.vertices_in_sphere(handle_pos, 0.1f, inside);
+ * Vert_idx snapped = index.nearest_vertex( joint_pos );
+ * Surface_point hit;
+ * index.closest_point(click_pos, hit);
+ * @endcode
+ * Trees are built top down with median splits on the largest axis of the
+ * centroids: the size of each subtree is known before it is built, so the
+ * first levels are built by parallel threads. Leaves store copies of the
+ * positions (vertices, triangle corners) in tree order to be cache
+ * friendly, the index does not keep a reference to the mesh. Queries are
+ * read only and can run concurrently.
+ */
+class Spatial_index {
+public:
+    /// Index the vertices and the triangles of 'mesh' (in parallel)
+    void build(const Mesh& mesh);
+
+    void build_vertices(const std::vector<Vec3>& vertices);
+    void build_triangles(const std::vector<Vec3>& vertices, const std::vector<Tri_face>& triangles);
+
+    void clear();
+
+    int nb_vertices() const { return int(_points.size()); }
+    int nb_triangles() const { return int(_corners.size() / 3); }
+
+    /// Bounding box of the vertices
+    Aabb bounds() const { return _vertex_tree._nodes.empty() ? Aabb() : _vertex_tree._nodes[0]._box; }
+
+    /// Heap memory of the trees (bytes)
+    size_t bytes() const;
+
+    /// @name Vertex queries (results in no particular order)
+    /// @{
+    void vertices_in_box(const Aabb& box, std::vector<Vert_idx>& out) const;
+    void vertices_in_sphere(const Vec3& center, float radius, std::vector<Vert_idx>& out) const;
+
+    /// @brief Vertices of any region
+    /// @param may_overlap : 'may_overlap(const Aabb&)' false when no point of
+    /// the box is in the region (conservative)
+    /// @param inside : 'inside(const Vec3&)' true for the points of the region
+    template<class Box_test, class Point_test>
+    void vertices_where(Box_test may_overlap, Point_test inside, std::vector<Vert_idx>& out) const;
+
+    /// @return nearest vertex to 'pos' or -1 when empty
+    Vert_idx nearest_vertex(const Vec3& pos, float* distance = nullptr) const;
+
+    /// 'k' nearest vertices of 'pos' as (vertex, distance), closest first
+    void k_nearest_vertices(const Vec3& pos, int k, std::vector<std::pair<Vert_idx, float> >& out) const;
+    /// @}
+
+    /// @brief Closest point to 'pos' on the triangles
+    /// @param max_distance : only look for points closer than that (a known
+    /// point of the surface near 'pos' makes the search much shorter)
+    /// @return false when no triangle is closer than 'max_distance'
+    bool closest_point(const Vec3& pos, Surface_point& out, float max_distance = FLT_MAX) const;
+
+private:
+    /// Inner nodes have _count == 0, their children are the next node and
+    /// _first. Leaves hold the items [_first, _first + _count) of the tree.
+    struct Node {
+        Aabb _box;
+        int _first;
+        int _count;
+    };
+
+    struct Tree {
+        std::vector<Node> _nodes;
+        std::vector<int> _items; ///< vertex or triangle index in tree order
+
+        void build(const std::vector<Aabb>& boxes, int leaf_size);
+        void clear() { _nodes.clear(); _items.clear(); }
+    };
+
+    Tree _vertex_tree;
+    Tree _triangle_tree;
+    std::vector<Vec3> _points;  ///< vertex positions in tree order
+    std::vector<Vec3> _corners; ///< 3 corners per triangle in tree order
+};
+
+// -----------------------------------------------------------------------------
+
+template<class Box_test, class Point_test>
+void Spatial_index::vertices_where(Box_test may_overlap, Point_test inside, std::vector<Vert_idx>& out) const
+{
+    out.clear();
+    const std::vector<Node>& nodes = _vertex_tree._nodes;
+    if( nodes.empty() )
+        return;
+    int stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while( top > 0 )
+    {
+        const Node& node = nodes[ stack[--top] ];
+        if( !may_overlap(node._box) )
+            continue;
+        if( node._count == 0 ) {
+            stack[top++] = node._first;
+            stack[top++] = int(&node - nodes.data()) + 1;
+            continue;
+        }
+        for(int i = node._first; i < node._first + node._count; ++i)
+            if( inside(_points[i]) )
+                out.push_back( _vertex_tree._items[i] );
+    }
+}
+
+#endif // SPATIAL_INDEX_HPP
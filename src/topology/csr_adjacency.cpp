@@ -0,0 +1,72 @@
+#include "topology/csr_adjacency.hpp"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include "utils/parallel_for.hpp"
+
+// -----------------------------------------------------------------------------
+
+void Csr_adjacency::compute(const std::vector< std::vector<int> >& lists)
+{
+    int nb = int(lists.size());
+    _offsets.resize( nb + 1 );
+    _offsets[0] = 0;
+    for(int i = 0; i < nb; ++i)
+        _offsets[i+1] = _offsets[i] + int(lists[i].size());
+
+    _indices.resize( _offsets[nb] );
+    parallel_for(0, nb, [&](int i) {
+        std::copy(lists[i].begin(), lists[i].end(), _indices.begin() + _offsets[i]);
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+void Csr_adjacency::compute_vertex_to_face(const Mesh& mesh)
+{
+    const int nv = int(mesh.nb_vertices());
+    const int nt = int(mesh.nb_triangles());
+
+    // Count triangles per vertex
+    std::unique_ptr<std::atomic<int>[]> cursor( new std::atomic<int>[nv] );
+    parallel_for(0, nv, [&](int i) { cursor[i].store(0, std::memory_order_relaxed); });
+    parallel_for(0, nt, [&](int t) {
+        const Tri_face& tri = mesh._triangles[t];
+        for(int j = 0; j < 3; ++j)
+            cursor[ tri[j] ].fetch_add(1, std::memory_order_relaxed);
+    });
+
+    _offsets.resize( nv + 1 );
+    _offsets[0] = 0;
+    for(int i = 0; i < nv; ++i) {
+        int count = cursor[i].load(std::memory_order_relaxed);
+        _offsets[i+1] = _offsets[i] + count;
+        cursor[i].store(_offsets[i], std::memory_order_relaxed);
+    }
+
+    // Scatter
+    _indices.resize( _offsets[nv] );
+    parallel_for(0, nt, [&](int t) {
+        const Tri_face& tri = mesh._triangles[t];
+        for(int j = 0; j < 3; ++j)
+            _indices[ cursor[ tri[j] ].fetch_add(1, std::memory_order_relaxed) ] = t;
+    });
+
+    // Scatter order depends on thread scheduling: make it deterministic
+    parallel_for(0, nv, [&](int i) {
+        std::sort(_indices.begin() + _offsets[i], _indices.begin() + _offsets[i+1]);
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+void Csr_adjacency::to_lists(std::vector< std::vector<int> >& lists) const
+{
+    int nb = nb_lists();
+    lists.resize( nb );
+    parallel_for(0, nb, [&](int i) {
+        lists[i].assign(_indices.begin() + _offsets[i], _indices.begin() + _offsets[i+1]);
+    });
+}
@@ -0,0 +1,66 @@
+#ifndef CSR_ADJACENCY_HPP
+#define CSR_ADJACENCY_HPP
+
+#include <vector>
+#include "mesh.hpp"
+
+/**
+ * @brief Read only view of a compressed sparse row adjacency.
+ * Elements of the ith list are _indices[ _offsets[i] ] to
+ * _indices[ _offsets[i+1] - 1 ]
+ *
+ * The view does not own its arrays, they may point to a Csr_adjacency or
+ * directly inside a memory mapped file (see Mesh_cache).
+ */
+struct Csr_view {
+    Csr_view() : _offsets(nullptr), _indices(nullptr), _nb_lists(0) { }
+
+    Csr_view(const int* offsets, const int* indices, int nb_lists)
+        : _offsets(offsets), _indices(indices), _nb_lists(nb_lists) { }
+
+    int nb_lists() const { return _nb_lists; }
+    int nb_elements() const { return _nb_lists > 0 ? _offsets[_nb_lists] : 0; }
+
+    const int* begin(int i) const { return _indices + _offsets[i]; }
+    const int* end(int i) const { return _indices + _offsets[i+1]; }
+    int size(int i) const { return _offsets[i+1] - _offsets[i]; }
+
+    bool empty() const { return _offsets == nullptr; }
+
+    const int* _offsets; ///< size nb_lists+1
+    const int* _indices; ///< size _offsets[nb_lists]
+    int _nb_lists;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @brief compressed sparse row adjacency owning its arrays.
+/// A compact alternative to std::vector<std::vector<int>> (two allocations
+/// and contiguous memory)
+struct Csr_adjacency {
+    std::vector<int> _offsets;
+    std::vector<int> _indices;
+
+    void clear() {
+        _offsets.clear();
+        _indices.clear();
+    }
+
+    int nb_lists() const { return _offsets.empty() ? 0 : int(_offsets.size()) - 1; }
+
+    Csr_view view() const {
+        return Csr_view(_offsets.data(), _indices.data(), nb_lists());
+    }
+
+    /// Flatten a list of lists
+    void compute(const std::vector< std::vector<int> >& lists);
+
+    /// Vertex to triangles adjacency of 'mesh' (computed in parallel).
+    /// Triangles of each list are sorted by increasing index.
+    void compute_vertex_to_face(const Mesh& mesh);
+
+    /// Copy back to a list of lists
+    void to_lists(std::vector< std::vector<int> >& lists) const;
+};
+
+#endif // CSR_ADJACENCY_HPP
@@ -0,0 +1,327 @@
+#include "topology/mesh_edits.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+// -----------------------------------------------------------------------------
+
+/// @return local index of 'v' in 'tri' or -1
+static int index_in_tri(const Tri_face& tri, Vert_idx v)
+{
+    for(int i = 0; i < 3; i++)
+        if( tri[i] == v ) return i;
+    return -1;
+}
+
+// -----------------------------------------------------------------------------
+
+/// @return the vertex of 'tri' which is neither 'a' nor 'b'
+static Vert_idx opposite_vertex(const Tri_face& tri, Vert_idx a, Vert_idx b)
+{
+    for(int i = 0; i < 3; i++)
+        if( tri[i] != a && tri[i] != b ) return tri[i];
+    return -1;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Sort and remove duplicates
+static void make_unique(std::vector<Vert_idx>& list)
+{
+    std::sort(list.begin(), list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+}
+
+// -----------------------------------------------------------------------------
+
+void Mesh_editor::edge_triangles(Vert_idx a,
+                                 Vert_idx b,
+                                 std::vector<Tri_idx>& tris) const
+{
+    tris.clear();
+    for(Tri_idx t : _vert_to_face._1st_ring_tris[a])
+        if( index_in_tri(_mesh._triangles[t], b) >= 0 )
+            tris.push_back( t );
+}
+
+// -----------------------------------------------------------------------------
+
+void Mesh_editor::neighbors(Vert_idx v, std::vector<Vert_idx>& list) const
+{
+    list.clear();
+    for(Tri_idx t : _vert_to_face._1st_ring_tris[v]) {
+        const Tri_face& tri = _mesh._triangles[t];
+        for(int i = 0; i < 3; i++)
+            if( tri[i] != v ) list.push_back( tri[i] );
+    }
+    make_unique( list );
+}
+
+// -----------------------------------------------------------------------------
+
+bool Mesh_editor::has_edge(Vert_idx a, Vert_idx b) const
+{
+    for(Tri_idx t : _vert_to_face._1st_ring_tris[a])
+        if( index_in_tri(_mesh._triangles[t], b) >= 0 )
+            return true;
+    return false;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Mesh_editor::flip_edge(Vert_idx a, Vert_idx b, Topology_delta& delta)
+{
+    std::vector<Tri_idx> tris;
+    edge_triangles(a, b, tris);
+    if( tris.size() != 2 )
+        return false;
+
+    // 't0' holds the oriented edge a->b, 't1' holds b->a
+    Tri_idx t0 = tris[0];
+    Tri_idx t1 = tris[1];
+    {
+        const Tri_face& tri = _mesh._triangles[t0];
+        if( tri[(index_in_tri(tri, a) + 1) % 3] != b )
+            std::swap(t0, t1);
+    }
+    const Tri_face tri0 = _mesh._triangles[t0];
+    const Tri_face tri1 = _mesh._triangles[t1];
+    if( tri0[(index_in_tri(tri0, a) + 1) % 3] != b ||
+        tri1[(index_in_tri(tri1, b) + 1) % 3] != a )
+    {
+        // Inconsistent orientation
+        return false;
+    }
+
+    /*
+           c                  c
+          / \                /|\
+         / t0\              / | \
+        a-----b    ==>     a t0|t1 b
+         \ t1/              \ | /
+          \ /                \|/
+           d                  d
+    */
+    Vert_idx c = opposite_vertex(tri0, a, b);
+    Vert_idx d = opposite_vertex(tri1, a, b);
+    if( c == d || has_edge(c, d) )
+        return false;
+
+    _vert_to_face.remove_triangle(t0, tri0);
+    _vert_to_face.remove_triangle(t1, tri1);
+
+    Tri_face new0, new1;
+    new0.a = c; new0.b = a; new0.c = d;
+    new1.a = d; new1.b = b; new1.c = c;
+    _mesh._triangles[t0] = new0;
+    _mesh._triangles[t1] = new1;
+    _vert_to_face.add_triangle(t0, new0);
+    _vert_to_face.add_triangle(t1, new1);
+
+    std::vector<Vert_idx> touched = {a, b, c, d};
+    finalize(delta, touched);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+Vert_idx Mesh_editor::split_edge(Vert_idx a, Vert_idx b, Topology_delta& delta)
+{
+    std::vector<Tri_idx> tris;
+    edge_triangles(a, b, tris);
+    if( tris.size() == 0 )
+        return -1;
+
+    Mesh& mesh = _mesh;
+    const Vert_idx m = Vert_idx( mesh.nb_vertices() );
+    mesh._vertices.push_back( (mesh._vertices[a] + mesh._vertices[b]) * 0.5f );
+    if( mesh._normals.size() == size_t(m) )
+        mesh._normals.push_back( (mesh._normals[a] + mesh._normals[b]) * 0.5f );
+    if( mesh._colors.size() == size_t(m) )
+        mesh._colors.push_back( (mesh._colors[a] + mesh._colors[b]) * 0.5f );
+
+    _vert_to_face.resize( m + 1 );
+
+    std::vector<Vert_idx> touched = {a, b, m};
+    for(Tri_idx t : tris)
+    {
+        /*
+                 c                  c
+                / \                /|\
+               /   \      ==>     / | \
+              p-----q            p--m--q
+        */
+        const Tri_face tri = mesh._triangles[t];
+        int ip = index_in_tri(tri, a);
+        if( tri[(ip + 1) % 3] != b )
+            ip = index_in_tri(tri, b);
+        Vert_idx p = tri[ ip           ];
+        Vert_idx q = tri[ (ip + 1) % 3 ];
+        Vert_idx c = tri[ (ip + 2) % 3 ];
+
+        Tri_face t_pmc, t_mqc;
+        t_pmc.a = p; t_pmc.b = m; t_pmc.c = c;
+        t_mqc.a = m; t_mqc.b = q; t_mqc.c = c;
+
+        _vert_to_face.remove_triangle(t, tri);
+        mesh._triangles[t] = t_pmc;
+        _vert_to_face.add_triangle(t, t_pmc);
+
+        Tri_idx new_t = Tri_idx( mesh._triangles.size() );
+        mesh._triangles.push_back( t_mqc );
+        _vert_to_face.add_triangle(new_t, t_mqc);
+
+        touched.push_back( c );
+    }
+
+    finalize(delta, touched);
+    return m;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Mesh_editor::collapse_edge(Vert_idx a, Vert_idx b, Topology_delta& delta)
+{
+    std::vector<Tri_idx> tris;
+    edge_triangles(a, b, tris);
+    if( tris.size() == 0 || tris.size() > 2 )
+        return false;
+
+    // Link condition: vertices adjacent to both 'a' and 'b' must be exactly
+    // the ones opposite to the edge
+    std::vector<Vert_idx> opposite;
+    for(Tri_idx t : tris)
+        opposite.push_back( opposite_vertex(_mesh._triangles[t], a, b) );
+    make_unique( opposite );
+
+    std::vector<Vert_idx> ring_a, ring_b, common;
+    neighbors(a, ring_a);
+    neighbors(b, ring_b);
+    std::set_intersection(ring_a.begin(), ring_a.end(),
+                          ring_b.begin(), ring_b.end(),
+                          std::back_inserter(common));
+    if( common != opposite )
+        return false;
+
+    // Collapsing an interior edge joining two boundaries would pinch the mesh
+    if( tris.size() == 2 &&
+        _first_ring._is_vert_on_side[a] && _first_ring._is_vert_on_side[b] )
+    {
+        return false;
+    }
+
+    Mesh& mesh = _mesh;
+    mesh._vertices[a] = (mesh._vertices[a] + mesh._vertices[b]) * 0.5f;
+
+    for(Tri_idx t : tris)
+        _vert_to_face.remove_triangle(t, mesh._triangles[t]);
+
+    // Reconnect triangles of 'b' to 'a'
+    std::vector<Tri_idx>& tris_b = _vert_to_face._1st_ring_tris[b];
+    for(Tri_idx t : tris_b) {
+        Tri_face& tri = mesh._triangles[t];
+        tri[ index_in_tri(tri, b) ] = a;
+        _vert_to_face._1st_ring_tris[a].push_back( t );
+    }
+    tris_b.clear();
+    _vert_to_face._is_vertex_connected[b] = false;
+    _vert_to_face._is_vertex_connected[a] = !_vert_to_face._1st_ring_tris[a].empty();
+
+    // Remove from the highest index so the lowest stays valid
+    std::sort(tris.begin(), tris.end());
+    for(int i = int(tris.size()) - 1; i >= 0; --i)
+        remove_triangle( tris[i] );
+
+    // 'a' moved: rows of its whole ring depend on its position
+    std::vector<Vert_idx> touched(1, a);
+    touched.insert(touched.end(), ring_a.begin(), ring_a.end());
+    touched.insert(touched.end(), ring_b.begin(), ring_b.end());
+
+    remove_vertex(b, delta, touched);
+    finalize(delta, touched);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void Mesh_editor::remove_triangle(Tri_idx t)
+{
+    // Fill the hole with the last triangle
+    Tri_idx last = Tri_idx( _mesh._triangles.size() ) - 1;
+    if( t != last ) {
+        const Tri_face tri_last = _mesh._triangles[last];
+        _vert_to_face.rename_triangle(last, t, tri_last);
+        _mesh._triangles[t] = tri_last;
+    }
+    _mesh._triangles.pop_back();
+}
+
+// -----------------------------------------------------------------------------
+
+void Mesh_editor::remove_vertex(Vert_idx v,
+                                Topology_delta& delta,
+                                std::vector<Vert_idx>& touched)
+{
+    Mesh& mesh = _mesh;
+    assert( !_vert_to_face._is_vertex_connected[v] );
+    Vert_idx last = Vert_idx( mesh.nb_vertices() ) - 1;
+
+    // Keep track of the original index of the removed vertex
+    std::vector<std::pair<Vert_idx, Vert_idx> >& moved = delta._moved_vertices;
+    bool found = false;
+    for(std::pair<Vert_idx, Vert_idx>& elt : moved)
+        if( elt.second == v ) { elt.second = -1; found = true; }
+    if( !found )
+        moved.push_back( std::make_pair(v, -1) );
+
+    std::vector<Vert_idx>* lists[2] = {&delta._dirty_vertices, &touched};
+    for(std::vector<Vert_idx>* list : lists)
+        list->erase(std::remove(list->begin(), list->end(), v), list->end());
+
+    if( v != last )
+    {
+        // Fill the hole with the last vertex
+        mesh._vertices[v] = mesh._vertices[last];
+        if( mesh._normals.size() > size_t(last) ) mesh._normals[v] = mesh._normals[last];
+        if( mesh._colors.size()  > size_t(last) ) mesh._colors [v] = mesh._colors [last];
+
+        _vert_to_face.rename_vertex(last, v);
+        for(Tri_idx t : _vert_to_face._1st_ring_tris[v]) {
+            Tri_face& tri = mesh._triangles[t];
+            tri[ index_in_tri(tri, last) ] = v;
+        }
+
+        found = false;
+        for(std::pair<Vert_idx, Vert_idx>& elt : moved)
+            if( elt.second == last ) { elt.second = v; found = true; }
+        if( !found )
+            moved.push_back( std::make_pair(last, v) );
+
+        for(std::vector<Vert_idx>* list : lists)
+            std::replace(list->begin(), list->end(), last, v);
+
+        // Column indices of the neighbors' rows changed
+        std::vector<Vert_idx> ring;
+        neighbors(v, ring);
+        touched.push_back( v );
+        touched.insert(touched.end(), ring.begin(), ring.end());
+    }
+
+    mesh._vertices.pop_back();
+    if( mesh._normals.size() > size_t(last) ) mesh._normals.pop_back();
+    if( mesh._colors.size()  > size_t(last) ) mesh._colors .pop_back();
+    _vert_to_face.resize( last );
+    _first_ring.resize( last );
+}
+
+// -----------------------------------------------------------------------------
+
+void Mesh_editor::finalize(Topology_delta& delta,
+                           std::vector<Vert_idx>& touched)
+{
+    make_unique( touched );
+    _first_ring.update(_mesh, _vert_to_face, touched);
+    std::vector<Vert_idx>& dirty = delta._dirty_vertices;
+    dirty.insert(dirty.end(), touched.begin(), touched.end());
+    make_unique( dirty );
+}
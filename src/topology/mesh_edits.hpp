@@ -0,0 +1,95 @@
+#ifndef MESH_EDITS_HPP
+#define MESH_EDITS_HPP
+
+#include <vector>
+#include <utility>
+#include "mesh.hpp"
+#include "topology/vertex_to_face.hpp"
+#include "topology/vertex_to_1st_ring_vertices.hpp"
+
+/// @brief What a local edit of the mesh touched.
+/// Deltas accumulate over several edits until clear() is called.
+struct Topology_delta {
+    /// Vertices whose first ring, position or index changed.
+    /// Only their Laplacian rows need to be re-emitted
+    /// (see update_laplacian_rows())
+    std::vector<Vert_idx> _dirty_vertices;
+
+    /// A removed vertex is replaced by the last vertex of the mesh:
+    /// _moved_vertices[] = (old index, new index)
+    /// Use it to remap per vertex data (e.g. boundary conditions)
+    std::vector<std::pair<Vert_idx, Vert_idx> > _moved_vertices;
+
+    void clear() {
+        _dirty_vertices.clear();
+        _moved_vertices.clear();
+    }
+};
+
+// -----------------------------------------------------------------------------
+
+/**
+ * @brief Local edits (flip, split, collapse) of a triangle mesh which
+ * incrementally maintain its topology.
+ *
+ * Only the rings of the vertices around the edit are recomputed, so the cost
+ * is proportional to the size of the edit instead of the size of the mesh.
+ * 'vert_to_face' and 'first_ring' must be computed beforehand.
+ * @code
+ * Mesh_editor editor(mesh, v_to_face, first_ring);
+ * Topology_delta delta;
+ * editor.flip_edge(a, b, delta);
+ * update_laplacian_rows(mesh._vertices, first_ring._rings_per_vertex,
+ *                       delta._dirty_vertices, mat_elemts);
+ * @endcode
+ * @note Edits expect consistently oriented triangles and will refuse
+ * (return false / -1) to break the manifold property of the mesh.
+ */
+struct Mesh_editor {
+
+    Mesh_editor(Mesh& mesh,
+                Vertex_to_face& vert_to_face,
+                Vertex_to_1st_ring_vertices& first_ring)
+        : _mesh(mesh)
+        , _vert_to_face(vert_to_face)
+        , _first_ring(first_ring)
+    {  }
+
+    /// Replace the interior edge (a, b) with the edge joining the two
+    /// vertices opposite to it.
+    /// @return false if the edge is not interior or the flip would create
+    /// an already existing edge.
+    bool flip_edge(Vert_idx a, Vert_idx b, Topology_delta& delta);
+
+    /// Insert a new vertex in the middle of edge (a, b) and split the one or
+    /// two adjacent triangles.
+    /// @return index of the new vertex (always the last one) or -1 if
+    /// (a, b) is not an edge
+    Vert_idx split_edge(Vert_idx a, Vert_idx b, Topology_delta& delta);
+
+    /// Merge 'b' into 'a', 'a' is moved to the middle of the edge.
+    /// 'b' is removed from the mesh and its index is taken by the last vertex
+    /// (see Topology_delta::_moved_vertices)
+    /// @return false if the collapse would make the mesh non-manifold
+    /// (link condition)
+    bool collapse_edge(Vert_idx a, Vert_idx b, Topology_delta& delta);
+
+    /// Does the edge (a, b) exist
+    bool has_edge(Vert_idx a, Vert_idx b) const;
+
+    Mesh& _mesh;
+    Vertex_to_face& _vert_to_face;
+    Vertex_to_1st_ring_vertices& _first_ring;
+
+private:
+    /// List the triangles adjacent to edge (a, b)
+    void edge_triangles(Vert_idx a, Vert_idx b, std::vector<Tri_idx>& tris) const;
+    /// Vertices sharing a triangle with 'v' (unordered, unique)
+    void neighbors(Vert_idx v, std::vector<Vert_idx>& list) const;
+    void remove_triangle(Tri_idx t);
+    void remove_vertex(Vert_idx v, Topology_delta& delta, std::vector<Vert_idx>& touched);
+    /// Recompute rings of 'touched' and append them to the dirty vertices
+    void finalize(Topology_delta& delta, std::vector<Vert_idx>& touched);
+};
+
+#endif // MESH_EDITS_HPP
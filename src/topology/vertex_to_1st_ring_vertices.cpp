@@ -2,6 +2,9 @@
 
 #include <deque>
 #include <cassert>
+#include <algorithm>
+
+#include "utils/trace.hpp"
 
 /** given a triangle 'tri' and one of its vertex index 'current_vert'
     return the pair corresponding to the vertex index opposite to 'current_vert'
@@ -77,14 +80,115 @@ bool add_to_ring(std::deque<int>& ring, int neigh)
 
 // -----------------------------------------------------------------------------
 
+/// Build the ordered list of the first ring of neighborhood of 'vert'
+/// @param tris : triangles connected to 'vert' (at least one)
+/// @param[out] manifold : false when the ring could not be ordered
+/// @param[out] on_side : true when 'vert' lies on a boundary of the mesh
+static
+void build_ring(const Mesh& mesh,
+                const std::vector<Tri_idx>& tris,
+                Vert_idx vert,
+                std::vector<std::pair<int, int> >& list_pairs,
+                std::vector<Vert_idx>& ring_out,
+                bool& manifold,
+                bool& on_side)
+{
+    list_pairs.clear();
+    // fill pairs with the first ring of neighborhood of triangles
+    for(unsigned j = 0; j < tris.size(); j++)
+        list_pairs.push_back(pair_from_tri(mesh._triangles[ tris[j] ], vert));
+
+    // Try to build the ordered list of the first ring of neighborhood of i
+    std::deque<int> ring;
+    ring.push_back(list_pairs[0].first );
+    ring.push_back(list_pairs[0].second);
+    std::vector<std::pair<int, int> >::iterator it = list_pairs.begin();
+    list_pairs.erase(it);
+    size_t  pairs_left = list_pairs.size();
+    manifold = true;
+    while( (pairs_left = list_pairs.size()) != 0)
+    {
+        for(it = list_pairs.begin(); it < list_pairs.end(); ++it)
+        {
+            if(add_to_ring(ring, *it)) {
+                list_pairs.erase(it);
+                break;
+            }
+        }
+
+        if(pairs_left == list_pairs.size()) {
+            // Not manifold we push neighborhoods of vert 'i'
+            // in a random order
+            add_to_ring(ring, list_pairs[0].first );
+            add_to_ring(ring, list_pairs[0].second);
+            list_pairs.erase(list_pairs.begin());
+            manifold = false;
+        }
+    }
+
+    on_side = ring[0] != ring[ring.size()-1];
+    if( !on_side )
+        ring.pop_back();
+
+    ring_out.clear();
+    for(unsigned int j = 0; j < ring.size(); j++)
+        ring_out.push_back( ring[j] );
+}
+
+// -----------------------------------------------------------------------------
+
+/// Position of every vertex in 'list' (-1 when absent)
+static
+void index_list(const std::vector<Vert_idx>& list,
+                int nb_vertices,
+                std::vector<int>& slots)
+{
+    slots.assign(nb_vertices, -1);
+    for(int i = 0; i < int(list.size()); i++)
+        slots[ list[i] ] = i;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Append 'v' to 'list' unless already there
+static
+void insert_in_list(std::vector<Vert_idx>& list, std::vector<int>& slots, Vert_idx v)
+{
+    if( slots[v] >= 0 )
+        return;
+    slots[v] = int(list.size());
+    list.push_back( v );
+}
+
+// -----------------------------------------------------------------------------
+
+/// Remove 'v' from 'list' in constant time: the last element takes its place
+static
+void remove_from_list(std::vector<Vert_idx>& list, std::vector<int>& slots, Vert_idx v)
+{
+    int slot = slots[v];
+    if( slot < 0 )
+        return;
+    Vert_idx last = list.back();
+    list[slot] = last;
+    slots[last] = slot;
+    list.pop_back();
+    slots[v] = -1;
+}
+
+// -----------------------------------------------------------------------------
+
 void Vertex_to_1st_ring_vertices::compute(
         const Mesh& mesh,
         const Vertex_to_face& vert_to_face)
 {
+    Trace_scope trace("first_ring");
     _is_mesh_closed = true;
     _is_mesh_manifold = true;
     _not_manifold_verts.clear();
     _on_side_verts.clear();
+    _not_manifold_slot.clear();
+    _on_side_slot.clear();
 
     _is_vert_on_side.resize( mesh.nb_vertices() );
 
@@ -104,54 +208,151 @@ void Vertex_to_1st_ring_vertices::compute(
         if( !is_connected[i] )
             continue;
 
-        list_pairs.clear();
-        // fill pairs with the first ring of neighborhood of triangles
-        for(unsigned j = 0; j < tri_list_per_vert[i].size(); j++)
-            list_pairs.push_back(pair_from_tri(mesh._triangles[ tri_list_per_vert[i][j] ], i));
-
-        // Try to build the ordered list of the first ring of neighborhood of i
-        std::deque<int> ring;
-        ring.push_back(list_pairs[0].first );
-        ring.push_back(list_pairs[0].second);
-        std::vector<std::pair<int, int> >::iterator it = list_pairs.begin();
-        list_pairs.erase(it);
-        size_t  pairs_left = list_pairs.size();
-        bool manifold   = true;
-        while( (pairs_left = list_pairs.size()) != 0)
-        {
-            for(it = list_pairs.begin(); it < list_pairs.end(); ++it)
-            {
-                if(add_to_ring(ring, *it)) {
-                    list_pairs.erase(it);
-                    break;
-                }
-            }
-
-            if(pairs_left == list_pairs.size()) {
-                // Not manifold we push neighborhoods of vert 'i'
-                // in a random order
-                add_to_ring(ring, list_pairs[0].first );
-                add_to_ring(ring, list_pairs[0].second);
-                list_pairs.erase(list_pairs.begin());
-                manifold = false;
-            }
-        }
+        bool manifold, on_side;
+        build_ring(mesh, tri_list_per_vert[i], i, list_pairs,
+                   _rings_per_vertex[i], manifold, on_side);
 
         if(!manifold) {
             _is_mesh_manifold = false;
             _not_manifold_verts.push_back(i);
         }
 
-        if(ring[0] != ring[ring.size()-1]){
-            _is_vert_on_side[i] = true;
+        _is_vert_on_side[i] = on_side;
+        if( on_side ){
             _on_side_verts.push_back(i);
             _is_mesh_closed = false;
-        } else {
-            _is_vert_on_side[i] = false;
-            ring.pop_back();
         }
-
-        for(unsigned int j = 0; j < ring.size(); j++)
-            _rings_per_vertex[i].push_back( ring[j] );
     }// END FOR( EACH VERTEX )
 }
+
+// -----------------------------------------------------------------------------
+
+void Vertex_to_1st_ring_vertices::update(
+        const Mesh& mesh,
+        const Vertex_to_face& vert_to_face,
+        const std::vector<Vert_idx>& vertices)
+{
+    const int nb_vertices = mesh.nb_vertices();
+    if( int(_on_side_slot.size()) != int(_rings_per_vertex.size()) ) {
+        index_list(_not_manifold_verts, int(_rings_per_vertex.size()), _not_manifold_slot);
+        index_list(_on_side_verts, int(_rings_per_vertex.size()), _on_side_slot);
+    }
+    resize( nb_vertices );
+    const std::vector<std::vector<Tri_idx> >& tri_list_per_vert = vert_to_face._1st_ring_tris;
+    const std::vector<bool>& is_connected = vert_to_face._is_vertex_connected;
+
+    std::vector<std::pair<int, int> > list_pairs;
+    list_pairs.reserve(16);
+    for(Vert_idx i : vertices)
+    {
+        remove_from_list(_not_manifold_verts, _not_manifold_slot, i);
+        remove_from_list(_on_side_verts, _on_side_slot, i);
+        _is_vert_on_side[i] = false;
+
+        if( !is_connected[i] ) {
+            _rings_per_vertex[i].clear();
+            continue;
+        }
+
+        bool manifold, on_side;
+        build_ring(mesh, tri_list_per_vert[i], i, list_pairs,
+                   _rings_per_vertex[i], manifold, on_side);
+
+        if(!manifold)
+            insert_in_list(_not_manifold_verts, _not_manifold_slot, i);
+
+        _is_vert_on_side[i] = on_side;
+        if( on_side )
+            insert_in_list(_on_side_verts, _on_side_slot, i);
+    }
+    _is_mesh_manifold = _not_manifold_verts.empty();
+    _is_mesh_closed = _on_side_verts.empty();
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_to_1st_ring_vertices::allocate(int nb_vertices)
+{
+    clear();
+    _rings_per_vertex.clear();
+    _rings_per_vertex.resize( nb_vertices );
+    _is_vert_on_side.assign( nb_vertices, false );
+    _is_mesh_closed = true;
+    _is_mesh_manifold = true;
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_to_1st_ring_vertices::compute_rings(
+        const Mesh& mesh,
+        const Vertex_to_face& vert_to_face,
+        int begin, int end,
+        uint8_t* flags)
+{
+    const std::vector<std::vector<Tri_idx> >& tri_list_per_vert = vert_to_face._1st_ring_tris;
+
+    std::vector<std::pair<int, int> > list_pairs;
+    list_pairs.reserve(16);
+    for(int i = begin; i < end; i++)
+    {
+        flags[i] = 0;
+        // _is_vertex_connected may not be set yet
+        if( tri_list_per_vert[i].empty() )
+            continue;
+
+        _rings_per_vertex[i].reserve(tri_list_per_vert[i].size());
+        bool manifold, on_side;
+        build_ring(mesh, tri_list_per_vert[i], i, list_pairs,
+                   _rings_per_vertex[i], manifold, on_side);
+
+        flags[i] = (on_side ? eON_SIDE : 0) | (manifold ? 0 : eNOT_MANIFOLD);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_to_1st_ring_vertices::set_flags(const uint8_t* flags)
+{
+    _not_manifold_verts.clear();
+    _on_side_verts.clear();
+    _not_manifold_slot.clear();
+    _on_side_slot.clear();
+    for(int i = 0; i < int(_rings_per_vertex.size()); i++)
+    {
+        bool on_side = (flags[i] & eON_SIDE) != 0;
+        _is_vert_on_side[i] = on_side;
+        if( on_side )
+            _on_side_verts.push_back(i);
+        if( flags[i] & eNOT_MANIFOLD )
+            _not_manifold_verts.push_back(i);
+    }
+    _is_mesh_manifold = _not_manifold_verts.empty();
+    _is_mesh_closed = _on_side_verts.empty();
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_to_1st_ring_vertices::resize(int nb_vertices)
+{
+    const int old_size = int(_rings_per_vertex.size());
+    if( int(_on_side_slot.size()) == old_size ) {
+        // Indexed lists (see update()): only the forgotten vertices are visited
+        for(int v = nb_vertices; v < old_size; v++) {
+            remove_from_list(_not_manifold_verts, _not_manifold_slot, v);
+            remove_from_list(_on_side_verts, _on_side_slot, v);
+        }
+        _not_manifold_slot.resize( nb_vertices, -1 );
+        _on_side_slot.resize( nb_vertices, -1 );
+    } else {
+        std::vector<Vert_idx>* lists[2] = {&_not_manifold_verts, &_on_side_verts};
+        for(std::vector<Vert_idx>* list : lists) {
+            list->erase(std::remove_if(list->begin(), list->end(),
+                                       [nb_vertices](Vert_idx v){ return v >= nb_vertices; }),
+                        list->end());
+        }
+    }
+    _rings_per_vertex.resize( nb_vertices );
+    _is_vert_on_side.resize( nb_vertices, false );
+    _is_mesh_manifold = _not_manifold_verts.empty();
+    _is_mesh_closed = _on_side_verts.empty();
+}
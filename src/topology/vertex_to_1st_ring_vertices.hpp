@@ -1,6 +1,7 @@
 #ifndef VERTEX_TO_1ST_RING_VERTICES_HPP
 #define VERTEX_TO_1ST_RING_VERTICES_HPP
 
+#include <cstdint>
 #include <vector>
 #include "topology/vertex_to_face.hpp"
 
@@ -19,6 +20,15 @@ struct Vertex_to_1st_ring_vertices {
         _is_vert_on_side.clear();
         _not_manifold_verts.clear();
         _on_side_verts.clear();
+        _not_manifold_slot.clear();
+        _on_side_slot.clear();
+    }
+
+    /// Bytes allocated by the arrays
+    size_t memory_bytes() const {
+        return heap_bytes(_rings_per_vertex) + heap_bytes(_is_vert_on_side) +
+               heap_bytes(_not_manifold_verts) + heap_bytes(_on_side_verts) +
+               heap_bytes(_not_manifold_slot) + heap_bytes(_on_side_slot);
     }
 
     /// Is the mesh closed
@@ -40,14 +50,60 @@ struct Vertex_to_1st_ring_vertices {
     std::vector<bool> _is_vert_on_side;
 
     /// List of vertices index presenting topological defects.
+    /// @note sorted after compute(), unordered after update()
     std::vector<Vert_idx> _not_manifold_verts;
 
     /// List of every vertices on some boundary of the mesh
+    /// @note sorted after compute(), unordered after update()
     std::vector<Vert_idx> _on_side_verts;
 
     /// Compute and allocate topological informations
     void compute(const Mesh& mesh,
                  const Vertex_to_face& vert_to_face);
+
+    /// Recompute the rings of 'vertices' only, after a local edit of the
+    /// mesh. 'vert_to_face' must be up to date (see Vertex_to_face::add_triangle()).
+    /// Cost is proportional to the size of the edit (the first call after
+    /// compute() also indexes the two lists of vertices).
+    void update(const Mesh& mesh,
+                const Vertex_to_face& vert_to_face,
+                const std::vector<Vert_idx>& vertices);
+
+    /// Grow or shrink the per vertex arrays to 'nb_vertices'
+    /// (vertices beyond are forgotten)
+    void resize(int nb_vertices);
+
+    /// Position of each vertex in _not_manifold_verts and _on_side_verts
+    /// (-1 when absent), so that update() removes a vertex from the lists
+    /// without searching them. Built by the first update(), emptied by
+    /// every full computation.
+    std::vector<int> _not_manifold_slot;
+    std::vector<int> _on_side_slot;
+
+    // -------------------------------------------------------------------------
+    /// @name Block by block computation
+    /// Rings of distinct blocks of vertices may be computed by several
+    /// threads (see build_mesh_pipelined()): allocate(), compute_rings() on
+    /// every block, then set_flags().
+    // -------------------------------------------------------------------------
+
+    /// Per vertex flags written by compute_rings()
+    enum Vertex_flags { eON_SIDE = 1, eNOT_MANIFOLD = 2 };
+
+    /// Empty rings for 'nb_vertices'
+    void allocate(int nb_vertices);
+
+    /// Order the rings of the vertices [begin end)
+    /// @param[out] flags : Vertex_flags of each vertex of [begin end)
+    /// (flags[v] for a vertex 'v')
+    void compute_rings(const Mesh& mesh,
+                       const Vertex_to_face& vert_to_face,
+                       int begin, int end,
+                       uint8_t* flags);
+
+    /// Sides, manifoldness and the lists of vertices from the flags of
+    /// every vertex
+    void set_flags(const uint8_t* flags);
 };
 
 #endif // VERTEX_TO_1ST_RING_VERTICES_HPP
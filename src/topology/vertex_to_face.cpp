@@ -1,9 +1,13 @@
 #include "topology/vertex_to_face.hpp"
 
 #include <cassert>
+#include <algorithm>
+
+#include "utils/trace.hpp"
 
 void Vertex_to_face::compute(const Mesh& mesh)
 {
+    Trace_scope trace("vertex_to_face");
     clear();
     _1st_ring_tris. resize( mesh.nb_vertices() );
     _is_vertex_connected.assign(mesh.nb_vertices(), false );
@@ -22,3 +26,76 @@ void Vertex_to_face::compute(const Mesh& mesh)
     // FIXME: look up the list _tri_list_per_vert and re-order in order to ensure
     // triangles touching each other are next in the list.
 }
+
+// -----------------------------------------------------------------------------
+
+void Vertex_to_face::add_triangle(Tri_idx tri_idx, const Tri_face& tri)
+{
+    for(int j = 0; j < 3; j++){
+        int v = tri[ j ];
+        assert(v >= 0 && v < (int)_1st_ring_tris.size());
+        _1st_ring_tris[v].push_back(tri_idx);
+        _is_vertex_connected[v] = true;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_to_face::remove_triangle(Tri_idx tri_idx, const Tri_face& tri)
+{
+    for(int j = 0; j < 3; j++){
+        std::vector<Tri_idx>& list = _1st_ring_tris[ tri[j] ];
+        std::vector<Tri_idx>::iterator it = std::find(list.begin(), list.end(), tri_idx);
+        if( it != list.end() )
+            list.erase( it );
+        _is_vertex_connected[ tri[j] ] = !list.empty();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_to_face::rename_triangle(Tri_idx old_idx,
+                                     Tri_idx new_idx,
+                                     const Tri_face& tri)
+{
+    for(int j = 0; j < 3; j++){
+        std::vector<Tri_idx>& list = _1st_ring_tris[ tri[j] ];
+        std::replace(list.begin(), list.end(), old_idx, new_idx);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_to_face::rename_vertex(Vert_idx from, Vert_idx to)
+{
+    _1st_ring_tris[to].swap( _1st_ring_tris[from] );
+    _1st_ring_tris[from].clear();
+    _is_vertex_connected[to] = _is_vertex_connected[from];
+    _is_vertex_connected[from] = false;
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_to_face::resize(int nb_vertices)
+{
+    _1st_ring_tris.resize( nb_vertices );
+    _is_vertex_connected.resize( nb_vertices, false );
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_to_face::allocate(int nb_vertices)
+{
+    clear();
+    _1st_ring_tris.resize( nb_vertices );
+    _is_vertex_connected.assign( nb_vertices, false );
+}
+
+// -----------------------------------------------------------------------------
+
+void Vertex_to_face::update_connected()
+{
+    // std::vector<bool> can't be written by several threads
+    for(unsigned v = 0; v < _1st_ring_tris.size(); ++v)
+        _is_vertex_connected[v] = !_1st_ring_tris[v].empty();
+}
@@ -19,8 +19,49 @@ struct Vertex_to_face {
         _is_vertex_connected.clear();
     }
 
+    /// Bytes allocated by the arrays
+    size_t memory_bytes() const {
+        return heap_bytes(_1st_ring_tris) + heap_bytes(_is_vertex_connected);
+    }
+
     /// Allocate and compute attributes
     void compute(const Mesh& mesh);
+
+    // -------------------------------------------------------------------------
+    /// @name Incremental updates
+    /// Keep the arrays in sync after a local edit of the mesh triangles,
+    /// cost is proportional to the valence of the touched vertices.
+    // -------------------------------------------------------------------------
+
+    /// Register the triangle 'tri' stored at index 'tri_idx'
+    void add_triangle(Tri_idx tri_idx, const Tri_face& tri);
+
+    /// Unregister the triangle 'tri' stored at index 'tri_idx'
+    void remove_triangle(Tri_idx tri_idx, const Tri_face& tri);
+
+    /// The triangle 'tri' formerly stored at 'old_idx' now lies at 'new_idx'
+    void rename_triangle(Tri_idx old_idx, Tri_idx new_idx, const Tri_face& tri);
+
+    /// Vertex 'from' is renamed 'to': its list of triangles is moved
+    /// and 'from' is left unconnected.
+    /// @note triangles of 'mesh' must be renamed by the caller
+    void rename_vertex(Vert_idx from, Vert_idx to);
+
+    /// Grow or shrink the per vertex arrays to 'nb_vertices'
+    void resize(int nb_vertices);
+
+    // -------------------------------------------------------------------------
+    /// @name Block by block computation
+    /// Lists of distinct vertices may be filled by several threads
+    /// (see build_mesh_pipelined()): allocate(), fill _1st_ring_tris,
+    /// then update_connected().
+    // -------------------------------------------------------------------------
+
+    /// Empty lists for 'nb_vertices'
+    void allocate(int nb_vertices);
+
+    /// Set _is_vertex_connected from the lists
+    void update_connected();
 };
 
 #endif // VERTEX_TO_FACE_HPP
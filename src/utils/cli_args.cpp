@@ -0,0 +1,101 @@
+#include "utils/cli_args.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// -----------------------------------------------------------------------------
+
+bool Cli_args::is(const char* name, const char* alias) const
+{
+    return !std::strcmp(arg(), name) || (alias != nullptr && !std::strcmp(arg(), alias));
+}
+
+// -----------------------------------------------------------------------------
+
+const char* Cli_args::value()
+{
+    if( _idx + 1 >= _argc ) {
+        std::cerr << "Missing value for option: " << arg() << std::endl;
+        return nullptr;
+    }
+    return _argv[++_idx];
+}
+
+// -----------------------------------------------------------------------------
+
+bool Cli_args::value(long long& val)
+{
+    const char* str = value();
+    if( str == nullptr )
+        return false;
+    return parse_count(str, val) || invalid(str);
+}
+
+// -----------------------------------------------------------------------------
+
+bool Cli_args::value(unsigned& val)
+{
+    long long nb = 0;
+    if( !value(nb) )
+        return false;
+    if( nb > UINT_MAX )
+        return invalid(_argv[_idx]);
+    val = unsigned(nb);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool Cli_args::value(double& val)
+{
+    const char* str = value();
+    if( str == nullptr )
+        return false;
+    return parse_real(str, val) || invalid(str);
+}
+
+// -----------------------------------------------------------------------------
+
+bool Cli_args::invalid(const char* str) const
+{
+    // The option precedes its value
+    const char* option = _argv[_idx] == str && _idx > 0 ? _argv[_idx - 1] : arg();
+    std::cerr << "Invalid value for option " << option << ": " << str << std::endl;
+    return false;
+}
+
+// =============================================================================
+
+bool parse_count(const char* str, long long& val)
+{
+    char* end = nullptr;
+    val = std::strtoll(str, &end, 10);
+    return end != str && *end == '\0' && val >= 0;
+}
+
+// -----------------------------------------------------------------------------
+
+bool parse_real(const char* str, double& val)
+{
+    char* end = nullptr;
+    val = std::strtod(str, &end);
+    return end != str && *end == '\0' && val >= 0.;
+}
+
+// -----------------------------------------------------------------------------
+
+std::vector<std::string> split_list(const char* str)
+{
+    std::vector<std::string> list;
+    std::string s(str);
+    for(size_t b = 0; b <= s.size(); ) {
+        size_t e = std::min(s.find(',', b), s.size());
+        if( e > b )
+            list.push_back( s.substr(b, e - b) );
+        b = e + 1;
+    }
+    return list;
+}
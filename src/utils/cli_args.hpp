@@ -0,0 +1,75 @@
+#ifndef CLI_ARGS_HPP
+#define CLI_ARGS_HPP
+
+#include <string>
+#include <vector>
+
+/**
+ * @brief Walk the command line of the executables (src/apps/).
+ *
+ * @code
+ * Cli_args args(argc, argv);
+ * while( args.next() ) {
+ *     if( args.is("-o", "--output") ) {
+ *         if( (opt._output = args.value()) == nullptr )
+ *             return false;
+ *     } else if( args.is("--threads") ) {
+ *         if( !args.value(opt._nb_threads) )
+ *             return false;
+ *     } else ...
+ * }
+ * @endcode
+ * Values are read from the argument following the option. On error a
+ * message naming the option is printed on std::cerr and false (or nullptr)
+ * is returned.
+ */
+class Cli_args {
+public:
+    Cli_args(int argc, char** argv) : _argc(argc), _argv(argv), _idx(0) { }
+
+    /// Move to the next argument
+    /// @return false when every argument was consumed
+    bool next() { return ++_idx < _argc; }
+
+    /// Current argument
+    const char* arg() const { return _argv[_idx]; }
+
+    /// @return true if the current argument is 'name' or 'alias'
+    bool is(const char* name, const char* alias = nullptr) const;
+
+    /// Consume the value of the current option
+    /// @return nullptr if it is missing
+    const char* value();
+
+    /// Consume a non negative integer value
+    bool value(long long& val);
+    bool value(unsigned& val);
+
+    /// Consume a non negative real value
+    bool value(double& val);
+
+    /// Print that 'str' is not a valid value of the current option
+    /// @return false
+    bool invalid(const char* str) const;
+
+private:
+    int _argc;
+    char** _argv;
+    int _idx;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Parse a whole string as a non negative integer
+/// @return false if 'str' holds anything else
+bool parse_count(const char* str, long long& val);
+
+/// Parse a whole string as a non negative real
+/// @return false if 'str' holds anything else
+bool parse_real(const char* str, double& val);
+
+/// Split a comma separated list, empty items are skipped
+/// e.g. "lu,cg:1e-8" -> {"lu", "cg:1e-8"}
+std::vector<std::string> split_list(const char* str);
+
+#endif // CLI_ARGS_HPP
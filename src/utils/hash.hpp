@@ -0,0 +1,102 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 128 bits content hash (two independent 64 bits lanes)
+ *
+ * Not cryptographic: meant to identify data e.g. the inputs of a solve
+ * (see io/solve_cache.hpp). Processes 8 bytes per step, the digest depends
+ * on the sequence of add() calls and their sizes.
+ * @code
+ * Hasher h;
+ * h.add( mesh._vertices );
+ * h.add( int(scheme) );
+ * Hash128 key = h.digest();
+ * @endcode
+ */
+struct Hash128 {
+    Hash128() { _h[0] = _h[1] = 0; }
+
+    uint64_t _h[2];
+
+    bool operator==(const Hash128& o) const { return _h[0] == o._h[0] && _h[1] == o._h[1]; }
+    bool operator!=(const Hash128& o) const { return !(*this == o); }
+
+    /// @return 32 hexadecimal digits
+    std::string hex() const {
+        static const char digits[] = "0123456789abcdef";
+        std::string str(32, '0');
+        for(int l = 0; l < 2; ++l)
+            for(int i = 0; i < 16; ++i)
+                str[l * 16 + i] = digits[(_h[l] >> (60 - 4 * i)) & 0xf];
+        return str;
+    }
+};
+
+// -----------------------------------------------------------------------------
+
+struct Hasher {
+    Hasher() : _size(0) {
+        _lane[0] = 0x9e3779b97f4a7c15ull;
+        _lane[1] = 0xc2b2ae3d27d4eb4full;
+    }
+
+    void add(const void* data, size_t nb_bytes)
+    {
+        const unsigned char* p = (const unsigned char*)data;
+        size_t nb_words = nb_bytes / 8;
+        for(size_t w = 0; w < nb_words; ++w) {
+            uint64_t word;
+            std::memcpy(&word, p + w * 8, 8);
+            mix( word );
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, p + nb_words * 8, nb_bytes - nb_words * 8);
+        // The length separates consecutive add() calls
+        mix( tail ^ (uint64_t(nb_bytes) << 3) );
+        _size += nb_bytes;
+    }
+
+    template<class T>
+    void add(const std::vector<T>& vec) { add(vec.data(), vec.size() * sizeof(T)); }
+
+    void add(const std::string& str) { add(str.data(), str.size()); }
+
+    template<class T>
+    void add(const T& val) { add(&val, sizeof(T)); }
+
+    Hash128 digest() const {
+        Hash128 res;
+        for(int l = 0; l < 2; ++l)
+            res._h[l] = finalize(_lane[l] ^ _size);
+        return res;
+    }
+
+private:
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    /// Murmur3 finalizer
+    static uint64_t finalize(uint64_t h) {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    void mix(uint64_t word) {
+        _lane[0] = rotl(_lane[0] ^ (word * 0x87c37b91114253d5ull), 31) * 0x4cf5ad432745937full;
+        _lane[1] = rotl(_lane[1] ^ (word * 0x52dce729ull), 27) * 0x38495ab5ull + _lane[0];
+    }
+
+    uint64_t _lane[2];
+    uint64_t _size;
+};
+
+#endif // HASH_HPP
@@ -0,0 +1,402 @@
+#include "utils/json.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+// -----------------------------------------------------------------------------
+
+unsigned Json_value::size() const
+{
+    if( _type == eARRAY ) return unsigned(_array.size());
+    if( _type == eOBJECT ) return unsigned(_object.size());
+    return 0;
+}
+
+// -----------------------------------------------------------------------------
+
+void Json_value::push_back(const Json_value& v)
+{
+    if( _type == eNULL )
+        _type = eARRAY;
+    _array.push_back( v );
+}
+
+// -----------------------------------------------------------------------------
+
+Json_value& Json_value::operator[](const std::string& key)
+{
+    if( _type == eNULL )
+        _type = eOBJECT;
+    for(std::pair<std::string, Json_value>& m : _object)
+        if( m.first == key )
+            return m.second;
+    _object.emplace_back( key, Json_value() );
+    return _object.back().second;
+}
+
+// -----------------------------------------------------------------------------
+
+const Json_value* Json_value::find(const std::string& key) const
+{
+    for(const std::pair<std::string, Json_value>& m : _object)
+        if( m.first == key )
+            return &m.second;
+    return nullptr;
+}
+
+// =============================================================================
+// Writing
+// =============================================================================
+
+static void dump_string(std::string& out, const std::string& str)
+{
+    out += '"';
+    for(char c : str) {
+        switch( c ) {
+        case '"':  out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n";  break;
+        case '\r': out += "\\r";  break;
+        case '\t': out += "\\t";  break;
+        default:
+            if( (unsigned char)c < 0x20 ) {
+                char buff[8];
+                std::snprintf(buff, sizeof(buff), "\\u%04x", c);
+                out += buff;
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+// -----------------------------------------------------------------------------
+
+static void dump_number(std::string& out, double n)
+{
+    // JSON has no representation for these
+    if( !std::isfinite(n) ) {
+        out += "null";
+        return;
+    }
+    // Shortest of the two precisions that reads back the same value
+    char buff[32];
+    std::snprintf(buff, sizeof(buff), "%.15g", n);
+    if( std::strtod(buff, nullptr) != n )
+        std::snprintf(buff, sizeof(buff), "%.17g", n);
+    out += buff;
+}
+
+// -----------------------------------------------------------------------------
+
+void Json_value::dump(std::string& out, int indent, int depth) const
+{
+    auto new_line = [&](int level) {
+        if( indent < 0 )
+            return;
+        out += '\n';
+        out.append(size_t(indent * level), ' ');
+    };
+
+    switch( _type ) {
+    case eNULL:   out += "null"; break;
+    case eBOOL:   out += _bool ? "true" : "false"; break;
+    case eNUMBER: dump_number(out, _number); break;
+    case eSTRING: dump_string(out, _string); break;
+    case eARRAY:
+        out += '[';
+        for(unsigned i = 0; i < _array.size(); ++i) {
+            out += i > 0 ? "," : "";
+            new_line(depth + 1);
+            _array[i].dump(out, indent, depth + 1);
+        }
+        if( !_array.empty() )
+            new_line(depth);
+        out += ']';
+        break;
+    case eOBJECT:
+        out += '{';
+        for(unsigned i = 0; i < _object.size(); ++i) {
+            out += i > 0 ? "," : "";
+            new_line(depth + 1);
+            dump_string(out, _object[i].first);
+            out += indent < 0 ? ":" : ": ";
+            _object[i].second.dump(out, indent, depth + 1);
+        }
+        if( !_object.empty() )
+            new_line(depth);
+        out += '}';
+        break;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+std::string Json_value::dump(int indent) const
+{
+    std::string out;
+    dump(out, indent, 0);
+    return out;
+}
+
+// =============================================================================
+// Parsing
+// =============================================================================
+
+namespace {
+
+struct Json_parser {
+    const char* _begin;
+    const char* _p;
+    const char* _end;
+    std::string _error;
+
+    bool fail(const char* msg) {
+        if( _error.empty() ) {
+            std::ostringstream str;
+            str << msg << " at offset " << (_p - _begin);
+            _error = str.str();
+        }
+        return false;
+    }
+
+    void skip_spaces() {
+        while( _p < _end && (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r') )
+            ++_p;
+    }
+
+    bool match(const char* word) {
+        const char* q = _p;
+        for(; *word != '\0'; ++word, ++q)
+            if( q >= _end || *q != *word )
+                return false;
+        _p = q;
+        return true;
+    }
+
+    static void append_utf8(std::string& out, unsigned cp) {
+        if( cp < 0x80 ) {
+            out += char(cp);
+        } else if( cp < 0x800 ) {
+            out += char(0xC0 | (cp >> 6));
+            out += char(0x80 | (cp & 0x3F));
+        } else if( cp < 0x10000 ) {
+            out += char(0xE0 | (cp >> 12));
+            out += char(0x80 | ((cp >> 6) & 0x3F));
+            out += char(0x80 | (cp & 0x3F));
+        } else {
+            out += char(0xF0 | (cp >> 18));
+            out += char(0x80 | ((cp >> 12) & 0x3F));
+            out += char(0x80 | ((cp >> 6) & 0x3F));
+            out += char(0x80 | (cp & 0x3F));
+        }
+    }
+
+    bool parse_hex4(unsigned& cp) {
+        if( _end - _p < 4 )
+            return fail("Truncated \\u escape");
+        cp = 0;
+        for(int i = 0; i < 4; ++i, ++_p) {
+            char c = *_p;
+            cp <<= 4;
+            if( c >= '0' && c <= '9' ) cp |= unsigned(c - '0');
+            else if( c >= 'a' && c <= 'f' ) cp |= unsigned(c - 'a' + 10);
+            else if( c >= 'A' && c <= 'F' ) cp |= unsigned(c - 'A' + 10);
+            else return fail("Invalid \\u escape");
+        }
+        return true;
+    }
+
+    bool parse_string(std::string& out) {
+        ++_p; // opening quote
+        while( _p < _end && *_p != '"' )
+        {
+            char c = *_p++;
+            if( c != '\\' ) {
+                out += c;
+                continue;
+            }
+            if( _p >= _end )
+                break;
+            char e = *_p++;
+            switch( e ) {
+            case '"':  out += '"';  break;
+            case '\\': out += '\\'; break;
+            case '/':  out += '/';  break;
+            case 'b':  out += '\b'; break;
+            case 'f':  out += '\f'; break;
+            case 'n':  out += '\n'; break;
+            case 'r':  out += '\r'; break;
+            case 't':  out += '\t'; break;
+            case 'u': {
+                unsigned cp = 0;
+                if( !parse_hex4(cp) )
+                    return false;
+                // Surrogate pair
+                if( cp >= 0xD800 && cp < 0xDC00 && match("\\u") ) {
+                    unsigned low = 0;
+                    if( !parse_hex4(low) )
+                        return false;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                append_utf8(out, cp);
+                break;
+            }
+            default:
+                return fail("Invalid escape sequence");
+            }
+        }
+        if( _p >= _end )
+            return fail("Unterminated string");
+        ++_p; // closing quote
+        return true;
+    }
+
+    bool parse_value(Json_value& v, int depth) {
+        if( depth > 256 )
+            return fail("Too many nested values");
+        skip_spaces();
+        if( _p >= _end )
+            return fail("Unexpected end of document");
+
+        char c = *_p;
+        if( c == '{' )
+        {
+            ++_p;
+            v = Json_value::object();
+            skip_spaces();
+            if( _p < _end && *_p == '}' ) {
+                ++_p;
+                return true;
+            }
+            while( true ) {
+                skip_spaces();
+                if( _p >= _end || *_p != '"' )
+                    return fail("Expected a member name");
+                std::string key;
+                if( !parse_string(key) )
+                    return false;
+                skip_spaces();
+                if( _p >= _end || *_p != ':' )
+                    return fail("Expected ':'");
+                ++_p;
+                if( !parse_value(v[key], depth + 1) )
+                    return false;
+                skip_spaces();
+                if( _p < _end && *_p == ',' ) { ++_p; continue; }
+                if( _p < _end && *_p == '}' ) { ++_p; return true; }
+                return fail("Expected ',' or '}'");
+            }
+        }
+        else if( c == '[' )
+        {
+            ++_p;
+            v = Json_value::array();
+            skip_spaces();
+            if( _p < _end && *_p == ']' ) {
+                ++_p;
+                return true;
+            }
+            while( true ) {
+                Json_value elt;
+                if( !parse_value(elt, depth + 1) )
+                    return false;
+                v.push_back( elt );
+                skip_spaces();
+                if( _p < _end && *_p == ',' ) { ++_p; continue; }
+                if( _p < _end && *_p == ']' ) { ++_p; return true; }
+                return fail("Expected ',' or ']'");
+            }
+        }
+        else if( c == '"' )
+        {
+            std::string str;
+            if( !parse_string(str) )
+                return false;
+            v = Json_value(str);
+            return true;
+        }
+        else if( match("true") )  { v = Json_value(true);  return true; }
+        else if( match("false") ) { v = Json_value(false); return true; }
+        else if( match("null") )  { v = Json_value();      return true; }
+        else if( c == '-' || (c >= '0' && c <= '9') )
+        {
+            // strtod() needs a null terminated string
+            const char* q = _p;
+            while( q < _end && (std::strchr("+-.eE", *q) != nullptr || (*q >= '0' && *q <= '9')) )
+                ++q;
+            std::string num(_p, q);
+            char* stop = nullptr;
+            double n = std::strtod(num.c_str(), &stop);
+            if( stop != num.c_str() + num.size() )
+                return fail("Invalid number");
+            _p = q;
+            v = Json_value(n);
+            return true;
+        }
+        return fail("Unexpected character");
+    }
+};
+
+} // END anonymous namespace
+
+// -----------------------------------------------------------------------------
+
+bool Json_value::parse(const std::string& text, Json_value& out, std::string* error)
+{
+    Json_parser parser;
+    parser._begin = parser._p = text.data();
+    parser._end = text.data() + text.size();
+    bool ok = parser.parse_value(out, 0);
+    if( ok ) {
+        parser.skip_spaces();
+        if( parser._p != parser._end )
+            ok = parser.fail("Unexpected data after the document");
+    }
+    if( !ok && error != nullptr )
+        *error = parser._error;
+    return ok;
+}
+
+// =============================================================================
+
+bool read_json_file(const char* file_name, Json_value& out)
+{
+    std::ifstream file(file_name, std::ios::binary);
+    if( !file.is_open() ) {
+        std::cerr << "Can't open file: " << file_name << std::endl;
+        return false;
+    }
+    std::stringstream buff;
+    buff << file.rdbuf();
+
+    std::string error;
+    if( !Json_value::parse(buff.str(), out, &error) ) {
+        std::cerr << "Invalid JSON file " << file_name << ": " << error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool write_json_file(const char* file_name, const Json_value& value)
+{
+    std::ofstream file(file_name, std::ios::binary);
+    if( !file.is_open() ) {
+        std::cerr << "Can't open file for writing: " << file_name << std::endl;
+        return false;
+    }
+    file << value.dump() << '\n';
+    if( !file.good() ) {
+        std::cerr << "Error while writing: " << file_name << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,110 @@
+#ifndef JSON_HPP
+#define JSON_HPP
+
+#include <string>
+#include <vector>
+#include <utility>
+
+/**
+ * @brief Minimal JSON document: enough to write reports and read back
+ * small configuration files (benchmark baselines, manifests...).
+ *
+ * @code
+ * Json_value doc = Json_value::object();
+ * doc["name"] = "plane";
+ * doc["times"].push_back( 0.5 );
+ * std::string text = doc.dump();
+ * @endcode
+ * Object members keep their insertion order. Lookups are linear,
+ * this is not meant for large documents.
+ */
+struct Json_value {
+
+    enum Type { eNULL, eBOOL, eNUMBER, eSTRING, eARRAY, eOBJECT };
+
+    Json_value() : _type(eNULL), _bool(false), _number(0.) { }
+    Json_value(bool b) : _type(eBOOL), _bool(b), _number(0.) { }
+    Json_value(int n) : _type(eNUMBER), _bool(false), _number(n) { }
+    Json_value(unsigned n) : _type(eNUMBER), _bool(false), _number(n) { }
+    Json_value(long n) : _type(eNUMBER), _bool(false), _number(double(n)) { }
+    Json_value(unsigned long n) : _type(eNUMBER), _bool(false), _number(double(n)) { }
+    Json_value(long long n) : _type(eNUMBER), _bool(false), _number(double(n)) { }
+    Json_value(unsigned long long n) : _type(eNUMBER), _bool(false), _number(double(n)) { }
+    Json_value(double n) : _type(eNUMBER), _bool(false), _number(n) { }
+    Json_value(const char* s) : _type(eSTRING), _bool(false), _number(0.), _string(s) { }
+    Json_value(const std::string& s) : _type(eSTRING), _bool(false), _number(0.), _string(s) { }
+
+    static Json_value array() { Json_value v; v._type = eARRAY; return v; }
+    static Json_value object() { Json_value v; v._type = eOBJECT; return v; }
+
+    Type type() const { return _type; }
+    bool is_null() const { return _type == eNULL; }
+    bool is_bool() const { return _type == eBOOL; }
+    bool is_number() const { return _type == eNUMBER; }
+    bool is_string() const { return _type == eSTRING; }
+    bool is_array() const { return _type == eARRAY; }
+    bool is_object() const { return _type == eOBJECT; }
+
+    /// @return the value or 'def' if the type does not match
+    bool as_bool(bool def = false) const { return is_bool() ? _bool : def; }
+    double as_number(double def = 0.) const { return is_number() ? _number : def; }
+    std::string as_string(const std::string& def = "") const { return is_string() ? _string : def; }
+
+    /// Number of elements of an array or members of an object
+    unsigned size() const;
+
+    // -------------------------------------------------------------------------
+    /// @name Arrays
+    // -------------------------------------------------------------------------
+
+    /// Append to an array (a null value becomes an empty array first)
+    void push_back(const Json_value& v);
+    const Json_value& at(unsigned i) const { return _array[i]; }
+    Json_value& at(unsigned i) { return _array[i]; }
+
+    // -------------------------------------------------------------------------
+    /// @name Objects
+    // -------------------------------------------------------------------------
+
+    /// Member 'key', inserted if missing (a null value becomes an empty
+    /// object first)
+    Json_value& operator[](const std::string& key);
+
+    /// @return member 'key' or nullptr if missing or not an object
+    const Json_value* find(const std::string& key) const;
+
+    /// Members as (key, value) in insertion order
+    const std::vector< std::pair<std::string, Json_value> >& members() const { return _object; }
+
+    // -------------------------------------------------------------------------
+    /// @name Text conversion
+    // -------------------------------------------------------------------------
+
+    /// @param indent : spaces per level, a negative value writes everything
+    /// on a single line
+    std::string dump(int indent = 2) const;
+
+    /// Parse 'text' into 'out'
+    /// @return false on syntax error, described in 'error' if not null
+    static bool parse(const std::string& text, Json_value& out, std::string* error = nullptr);
+
+private:
+    void dump(std::string& out, int indent, int depth) const;
+
+    Type _type;
+    bool _bool;
+    double _number;
+    std::string _string;
+    std::vector<Json_value> _array;
+    std::vector< std::pair<std::string, Json_value> > _object;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @return false on error (message printed on std::cerr)
+bool read_json_file(const char* file_name, Json_value& out);
+
+/// @return false on error (message printed on std::cerr)
+bool write_json_file(const char* file_name, const Json_value& value);
+
+#endif // JSON_HPP
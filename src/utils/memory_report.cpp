@@ -0,0 +1,169 @@
+#include "utils/memory_report.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+#include "utils/memory_usage.hpp"
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Phase still open: its running peak and counters at its start
+struct Open_phase {
+    int _idx;
+    size_t _peak;
+    Allocation_stats _allocs;
+};
+
+std::mutex g_mutex;
+std::thread::id g_thread;
+std::vector<Memory_phase> g_phases;
+std::vector<Open_phase> g_stack;
+std::vector<Memory_footprint> g_footprints;
+
+double to_mb(size_t bytes) { return double(bytes) / (1024. * 1024.); }
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+void start_memory_accounting()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_thread = std::this_thread::get_id();
+    g_phases.clear();
+    g_stack.clear();
+    g_footprints.clear();
+    memory_accounting_flag() = true;
+}
+
+// -----------------------------------------------------------------------------
+
+void stop_memory_accounting()
+{
+    memory_accounting_flag() = false;
+}
+
+// -----------------------------------------------------------------------------
+
+void record_footprint(const char* name, size_t bytes)
+{
+    if( !is_accounting_memory() )
+        return;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_footprints.push_back( Memory_footprint{name, bytes} );
+}
+
+// -----------------------------------------------------------------------------
+
+std::vector<Memory_phase> memory_phases()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_phases;
+}
+
+// -----------------------------------------------------------------------------
+
+std::vector<Memory_footprint> memory_footprints()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_footprints;
+}
+
+// -----------------------------------------------------------------------------
+
+int begin_memory_phase(const char* name)
+{
+    if( std::this_thread::get_id() != g_thread )
+        return -1;
+    size_t peak = peak_rss_bytes();
+    size_t rss = current_rss_bytes();
+    std::lock_guard<std::mutex> lock(g_mutex);
+    // The enclosing phase keeps its peak so far, then the peak restarts
+    // from now for the new phase
+    if( !g_stack.empty() )
+        g_stack.back()._peak = std::max(g_stack.back()._peak, peak);
+    reset_peak_rss();
+
+    Memory_phase phase;
+    phase._name = name;
+    phase._depth = int(g_stack.size());
+    phase._rss_begin = rss;
+    phase._rss_end = rss;
+    phase._peak_rss = rss;
+    phase._nb_allocations = 0;
+    phase._allocated_bytes = 0;
+    g_phases.push_back( phase );
+
+    Open_phase open;
+    open._idx = int(g_phases.size()) - 1;
+    open._peak = rss;
+    open._allocs = allocation_stats();
+    g_stack.push_back( open );
+    return open._idx;
+}
+
+// -----------------------------------------------------------------------------
+
+void end_memory_phase(int idx)
+{
+    if( idx < 0 )
+        return;
+    size_t peak = peak_rss_bytes();
+    size_t rss = current_rss_bytes();
+    Allocation_stats allocs = allocation_stats();
+    std::lock_guard<std::mutex> lock(g_mutex);
+    // start_memory_accounting() was called again meanwhile
+    if( g_stack.empty() || g_stack.back()._idx != idx )
+        return;
+
+    Open_phase open = g_stack.back();
+    g_stack.pop_back();
+    Memory_phase& phase = g_phases[idx];
+    phase._rss_end = rss;
+    phase._peak_rss = std::max(std::max(open._peak, peak), rss);
+    phase._nb_allocations = allocs._nb_allocations - open._allocs._nb_allocations;
+    phase._allocated_bytes = allocs._allocated_bytes - open._allocs._allocated_bytes;
+    if( !g_stack.empty() )
+        g_stack.back()._peak = std::max(g_stack.back()._peak, phase._peak_rss);
+}
+
+// -----------------------------------------------------------------------------
+
+void print_memory_report()
+{
+    std::vector<Memory_phase> phases = memory_phases();
+    std::vector<Memory_footprint> footprints = memory_footprints();
+    bool counting = is_counting_allocations();
+
+    std::printf("Memory per phase (MB):\n");
+    std::printf("  %-28s %10s %10s %10s", "phase", "rss start", "rss end", "peak");
+    if( counting )
+        std::printf(" %12s %12s", "new calls", "new MB");
+    std::printf("\n");
+    for(const Memory_phase& p : phases)
+    {
+        char name[64];
+        std::snprintf(name, sizeof(name), "%*s%s", 2 * p._depth, "", p._name);
+        std::printf("  %-28s %10.1f %10.1f %10.1f", name,
+                    to_mb(p._rss_begin), to_mb(p._rss_end), to_mb(p._peak_rss));
+        if( counting )
+            std::printf(" %12zu %12.1f", p._nb_allocations, to_mb(p._allocated_bytes));
+        std::printf("\n");
+    }
+    if( counting ) {
+        std::printf("  (operator new only: malloc() buffers, e.g. the dense\n"
+                    "   vectors and SparseLU workspace of Eigen, are not counted)\n");
+    }
+
+    if( !footprints.empty() ) {
+        std::printf("Data structures (MB):\n");
+        for(const Memory_footprint& f : footprints)
+            std::printf("  %-28s %10.1f\n", f._name, to_mb(f._bytes));
+    }
+    size_t peak = peak_rss_bytes();
+    for(const Memory_phase& p : phases)
+        peak = std::max(peak, p._peak_rss);
+    std::printf("Peak RSS: %.1f MB\n", to_mb(peak));
+}
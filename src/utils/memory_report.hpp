@@ -0,0 +1,88 @@
+#ifndef MEMORY_REPORT_HPP
+#define MEMORY_REPORT_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Memory used by each phase of a run and by the main data
+ * structures, to budget memory before launching large jobs.
+ *
+ * @code
+ * start_memory_accounting();
+ * solve_laplace_equation(...); // phases are the Trace_scope of the library
+ * stop_memory_accounting();
+ * print_memory_report();
+ * @endcode
+ * Between start and stop, every Trace_scope opened by the thread which
+ * called start_memory_accounting() records the resident set size (RSS) at
+ * its start and end, the peak RSS in between and, when built with
+ * COUNT_ALLOCATIONS, the number and size of the allocations
+ * (see allocation_stats()).
+ * The library reports the size of its main structures (mesh, topology,
+ * triplets, sparse matrix, factors) with record_footprint().
+ *
+ * @note per phase peaks rely on reset_peak_rss(): where unsupported, a
+ * phase peak is the peak of the process up to the end of the phase.
+ */
+
+/// One phase (Trace_scope) in the order phases were opened
+struct Memory_phase {
+    const char* _name;
+    int _depth;              ///< nesting level (0 for outermost phases)
+    size_t _rss_begin;       ///< bytes
+    size_t _rss_end;
+    size_t _peak_rss;        ///< highest RSS during the phase
+    size_t _nb_allocations;  ///< (only with COUNT_ALLOCATIONS)
+    size_t _allocated_bytes; ///< (only with COUNT_ALLOCATIONS)
+};
+
+/// Bytes held by a data structure
+struct Memory_footprint {
+    const char* _name;
+    size_t _bytes;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Storage for the accounting state
+inline std::atomic<bool>& memory_accounting_flag() {
+    static std::atomic<bool> on(false);
+    return on;
+}
+
+/// @return true between start_memory_accounting() and stop_memory_accounting()
+inline bool is_accounting_memory() {
+    return memory_accounting_flag().load(std::memory_order_relaxed);
+}
+
+/// Clear previous records and start accounting phases opened by the
+/// calling thread
+void start_memory_accounting();
+
+void stop_memory_accounting();
+
+/// Record the size of a data structure (ignored when not accounting)
+/// @param name : must outlive the report (string literal)
+/// @note several records with the same name are kept (one per call)
+void record_footprint(const char* name, size_t bytes);
+
+std::vector<Memory_phase> memory_phases();
+
+std::vector<Memory_footprint> memory_footprints();
+
+/// Print phases and footprints as tables on the standard output
+void print_memory_report();
+
+// -----------------------------------------------------------------------------
+/// @name Hooks of Trace_scope
+// -----------------------------------------------------------------------------
+
+/// @return index of the new phase or -1 if the calling thread is not
+/// the accounting thread
+int begin_memory_phase(const char* name);
+
+void end_memory_phase(int phase);
+
+#endif // MEMORY_REPORT_HPP
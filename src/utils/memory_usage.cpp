@@ -0,0 +1,209 @@
+#include "utils/memory_usage.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(_WIN32)
+    #include <windows.h>
+    #include <psapi.h>
+#else
+    #include <unistd.h>
+    #include <sys/resource.h>
+#endif
+
+// -----------------------------------------------------------------------------
+
+#if defined(__linux__)
+/// @return value of the field 'key' (in kB) of /proc/self/status, or -1
+static long proc_status_kb(const char* key)
+{
+    FILE* file = std::fopen("/proc/self/status", "r");
+    if( file == nullptr )
+        return -1;
+    char line[256];
+    long kb = -1;
+    size_t len = std::strlen(key);
+    while( std::fgets(line, sizeof(line), file) != nullptr ) {
+        if( std::strncmp(line, key, len) == 0 && line[len] == ':' ) {
+            kb = std::strtol(line + len + 1, nullptr, 10);
+            break;
+        }
+    }
+    std::fclose(file);
+    return kb;
+}
+#endif
+
+// -----------------------------------------------------------------------------
+
+size_t peak_rss_bytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS info;
+    if( !GetProcessMemoryInfo(GetCurrentProcess(), &info, sizeof(info)) )
+        return 0;
+    return size_t(info.PeakWorkingSetSize);
+#else
+    #if defined(__linux__)
+    // Unlike ru_maxrss, the high water mark follows reset_peak_rss()
+    long kb = proc_status_kb("VmHWM");
+    if( kb >= 0 )
+        return size_t(kb) * 1024;
+    #endif
+    struct rusage usage;
+    if( getrusage(RUSAGE_SELF, &usage) != 0 )
+        return 0;
+    #if defined(__APPLE__)
+    return size_t(usage.ru_maxrss); // bytes
+    #else
+    return size_t(usage.ru_maxrss) * 1024; // kilobytes
+    #endif
+#endif
+}
+
+// -----------------------------------------------------------------------------
+
+size_t current_rss_bytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS info;
+    if( !GetProcessMemoryInfo(GetCurrentProcess(), &info, sizeof(info)) )
+        return 0;
+    return size_t(info.WorkingSetSize);
+#elif defined(__linux__)
+    // Second field: resident pages
+    FILE* file = std::fopen("/proc/self/statm", "r");
+    if( file == nullptr )
+        return 0;
+    long pages = 0, resident = 0;
+    int nb = std::fscanf(file, "%ld %ld", &pages, &resident);
+    std::fclose(file);
+    return nb == 2 ? size_t(resident) * size_t(sysconf(_SC_PAGESIZE)) : 0;
+#else
+    return 0;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+
+bool reset_peak_rss()
+{
+#if defined(__linux__)
+    // "5" resets the peak resident set size (Linux 4.0+)
+    FILE* file = std::fopen("/proc/self/clear_refs", "w");
+    if( file == nullptr )
+        return false;
+    bool ok = std::fputs("5", file) >= 0;
+    ok = (std::fclose(file) == 0) && ok;
+    return ok;
+#else
+    return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+
+bool parse_byte_size(const char* str, size_t& bytes)
+{
+    char* end = nullptr;
+    double value = std::strtod(str, &end);
+    double unit = 1.;
+    if( end != str ) {
+        switch( *end ) {
+        case 'k': case 'K': unit = 1024.;                 ++end; break;
+        case 'm': case 'M': unit = 1024. * 1024.;         ++end; break;
+        case 'g': case 'G': unit = 1024. * 1024. * 1024.; ++end; break;
+        default: break;
+        }
+        if( unit > 1. && (*end == 'B' || *end == 'b') )
+            ++end;
+    }
+    if( end == str || *end != '\0' || value < 0. ) {
+        std::fprintf(stderr, "Invalid size: '%s' (expected e.g. 512M, 2G, 100000)\n", str);
+        return false;
+    }
+    bytes = size_t(value * unit);
+    return true;
+}
+
+// =============================================================================
+// Allocation counters
+// =============================================================================
+
+#ifdef HARMONIC_WEIGHTS_COUNT_ALLOCATIONS
+
+namespace {
+
+std::atomic<size_t> g_nb_allocations(0);
+std::atomic<size_t> g_allocated_bytes(0);
+std::atomic<size_t> g_live_bytes(0);
+std::atomic<size_t> g_peak_live_bytes(0);
+
+/// Size stored in front of each block, keeps the default alignment
+const size_t g_header = 16;
+
+void* counted_alloc(size_t size)
+{
+    char* ptr = (char*)std::malloc(size + g_header);
+    if( ptr == nullptr )
+        return nullptr;
+    *(size_t*)ptr = size;
+    g_nb_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    size_t live = g_live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak = g_peak_live_bytes.load(std::memory_order_relaxed);
+    while( live > peak && !g_peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed) ) { }
+    return ptr + g_header;
+}
+
+void counted_free(void* p)
+{
+    if( p == nullptr )
+        return;
+    char* ptr = (char*)p - g_header;
+    g_live_bytes.fetch_sub(*(size_t*)ptr, std::memory_order_relaxed);
+    std::free(ptr);
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+void* operator new(size_t size)
+{
+    void* ptr = counted_alloc(size);
+    if( ptr == nullptr )
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return counted_alloc(size); }
+void operator delete(void* ptr) noexcept { counted_free(ptr); }
+void operator delete[](void* ptr) noexcept { counted_free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { counted_free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { counted_free(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { counted_free(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { counted_free(ptr); }
+
+bool is_counting_allocations() { return true; }
+
+Allocation_stats allocation_stats()
+{
+    Allocation_stats stats;
+    stats._nb_allocations  = g_nb_allocations.load(std::memory_order_relaxed);
+    stats._allocated_bytes = g_allocated_bytes.load(std::memory_order_relaxed);
+    stats._live_bytes      = g_live_bytes.load(std::memory_order_relaxed);
+    stats._peak_live_bytes = g_peak_live_bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+#else
+
+bool is_counting_allocations() { return false; }
+
+Allocation_stats allocation_stats() { return Allocation_stats(); }
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef MEMORY_USAGE_HPP
+#define MEMORY_USAGE_HPP
+
+#include <cstddef>
+#include <vector>
+
+/// @return largest resident set size of the process since it started or
+/// since the last successful reset_peak_rss()
+/// (in bytes, 0 if unsupported on this platform)
+size_t peak_rss_bytes();
+
+/// @return current resident set size of the process
+/// (in bytes, 0 if unsupported on this platform)
+size_t current_rss_bytes();
+
+/// Restart peak_rss_bytes() from the current resident set size (Linux only)
+/// @return false if unsupported: the peak then covers the whole process life
+bool reset_peak_rss();
+
+/// Parse a number of bytes with an optional binary suffix K, M or G
+/// (optionally followed by B) e.g. "512M", "1.5G", "100000"
+/// @return false if 'str' is invalid (message printed on stderr)
+bool parse_byte_size(const char* str, size_t& bytes);
+
+// -----------------------------------------------------------------------------
+
+/// @brief Counters of the global operator new / delete.
+/// Only maintained when built with HARMONIC_WEIGHTS_COUNT_ALLOCATIONS
+/// (CMake option COUNT_ALLOCATIONS), which replaces the global operators
+/// by counting versions (an extra header of 16 bytes per allocation).
+/// @note buffers allocated with malloc() (e.g. Eigen dense vectors) are
+/// not counted, they still show in the RSS.
+struct Allocation_stats {
+    Allocation_stats()
+        : _nb_allocations(0)
+        , _allocated_bytes(0)
+        , _live_bytes(0)
+        , _peak_live_bytes(0)
+    { }
+
+    size_t _nb_allocations;  ///< calls to operator new
+    size_t _allocated_bytes; ///< sum of the requested sizes
+    size_t _live_bytes;      ///< requested and not deleted yet
+    size_t _peak_live_bytes; ///< maximum of _live_bytes
+};
+
+/// @return true if built with the counting operator new
+bool is_counting_allocations();
+
+/// @return counters since the start of the process (zeros when not counting)
+Allocation_stats allocation_stats();
+
+// -----------------------------------------------------------------------------
+/// @name Heap footprint of containers (allocated capacity, not size)
+// -----------------------------------------------------------------------------
+
+template<class T>
+size_t heap_bytes(const std::vector<T>& vec) { return vec.capacity() * sizeof(T); }
+
+inline size_t heap_bytes(const std::vector<bool>& vec) { return (vec.capacity() + 7) / 8; }
+
+template<class T>
+size_t heap_bytes(const std::vector< std::vector<T> >& vec)
+{
+    size_t bytes = vec.capacity() * sizeof(std::vector<T>);
+    for(const std::vector<T>& v : vec)
+        bytes += heap_bytes( v );
+    return bytes;
+}
+
+#endif // MEMORY_USAGE_HPP
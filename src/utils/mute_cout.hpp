@@ -0,0 +1,14 @@
+#ifndef MUTE_COUT_HPP
+#define MUTE_COUT_HPP
+
+#include <iostream>
+
+/// @brief Silence std::cout in its scope
+/// (e.g. around the verbose solve_laplace_equation() in batch tools)
+struct Mute_cout {
+    Mute_cout() : _buff( std::cout.rdbuf(nullptr) ) { }
+    ~Mute_cout() { std::cout.rdbuf( _buff ); }
+    std::streambuf* _buff;
+};
+
+#endif // MUTE_COUT_HPP
@@ -0,0 +1,238 @@
+#ifndef PARALLEL_FOR_HPP
+#define PARALLEL_FOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/trace.hpp"
+
+/**
+ * @brief Minimal helpers to run loops over several threads.
+ *
+ * @code
+ * parallel_for(0, nb_vertices, [&](int i){
+ *     normals[i] = compute_normal(i);
+ * });
+ * @endcode
+ * Every call blocks until all iterations are done,
+ * the calling thread takes part in the work. Loops are run by a set of
+ * threads started once and kept for the whole process (Loop_workers), a
+ * call allocates nothing.
+ * When tracing, each thread records a span named after the enclosing
+ * Trace_scope of the caller.
+ */
+
+// -----------------------------------------------------------------------------
+
+/// Storage for the number of threads requested by the user (0 == automatic)
+inline std::atomic<unsigned>& nb_threads_setting() {
+    static std::atomic<unsigned> nb(0);
+    return nb;
+}
+
+/// Number of threads of the loops started by the current thread, overrides
+/// nb_threads_setting() when not 0 (see Nb_threads_scope)
+inline unsigned& thread_nb_threads_setting() {
+    static thread_local unsigned nb = 0;
+    return nb;
+}
+
+/// Force the number of threads used by the parallel loops.
+/// 0 means use every hardware thread
+inline void set_nb_threads(unsigned nb) { nb_threads_setting() = nb; }
+
+/// @return number of threads used by the parallel loops
+inline unsigned get_nb_threads()
+{
+    unsigned nb = thread_nb_threads_setting();
+    if( nb == 0 )
+        nb = nb_threads_setting();
+    if( nb == 0 )
+        nb = std::thread::hardware_concurrency();
+    return std::max(nb, 1u);
+}
+
+/// @brief Number of threads of the parallel loops started by the current
+/// thread while in scope, whatever set_nb_threads() says (e.g. 1 on the
+/// workers of a pool, without changing the setting of the other threads)
+class Nb_threads_scope {
+public:
+    explicit Nb_threads_scope(unsigned nb) : _previous(thread_nb_threads_setting()) {
+        thread_nb_threads_setting() = nb;
+    }
+    ~Nb_threads_scope() { thread_nb_threads_setting() = _previous; }
+
+    Nb_threads_scope(const Nb_threads_scope&) = delete;
+    Nb_threads_scope& operator=(const Nb_threads_scope&) = delete;
+
+private:
+    unsigned _previous;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @brief Threads helping the loops of parallel_for_chunks(), started on
+/// the first loop and kept until the end of the process.
+/// A loop is published as a Loop_job, idle threads join it until
+/// '_max_helpers' of them work on it. The calling thread works too, so a
+/// loop completes even when every thread is busy (nested loops, loops
+/// started by several threads at once).
+class Loop_workers {
+public:
+    struct Loop_job {
+        void (*_run)(void* ctx, int chunk);
+        void* _ctx;
+        const char* _scope;        ///< trace scope of the calling thread
+        int _nb_chunks;
+        int _max_helpers;
+        std::atomic<int> _next_chunk;
+        int _nb_helpers;           ///< threads that joined, under _mutex
+        int _nb_running;           ///< helpers not done yet, under _mutex
+    };
+
+    static Loop_workers& instance() {
+        static Loop_workers workers;
+        return workers;
+    }
+
+    /// Run every chunk of 'job' with the help of the idle threads
+    void run(Loop_job& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            // Threads are only started when more are requested than ever
+            while( int(_threads.size()) < job._max_helpers )
+                _threads.emplace_back( [this]{ help(); } );
+            _jobs.push_back( &job );
+        }
+        _wake.notify_all();
+        work(job, 0);
+
+        // No helper joins once unpublished, wait for those already in
+        std::unique_lock<std::mutex> lock(_mutex);
+        _jobs.erase( std::find(_jobs.begin(), _jobs.end(), &job) );
+        _done.wait(lock, [&]{ return job._nb_running == 0; });
+    }
+
+    ~Loop_workers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for(std::thread& t : _threads)
+            t.join();
+    }
+
+private:
+    Loop_workers() : _stop(false) { _jobs.reserve(64); }
+
+    static void work(Loop_job& job, int slot)
+    {
+        Trace_worker_scope trace(job._scope, slot);
+        int i;
+        while( (i = job._next_chunk.fetch_add(1)) < job._nb_chunks )
+            job._run(job._ctx, i);
+    }
+
+    /// A published job still short of helpers
+    Loop_job* open_job() const
+    {
+        for(Loop_job* job : _jobs)
+            if( job->_nb_helpers < job->_max_helpers &&
+                job->_next_chunk.load() < job->_nb_chunks )
+                return job;
+        return nullptr;
+    }
+
+    void help()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while( true ) {
+            Loop_job* job = nullptr;
+            _wake.wait(lock, [&]{ return _stop || (job = open_job()) != nullptr; });
+            if( job == nullptr )
+                return; // _stop
+            const int slot = ++job->_nb_helpers;
+            job->_nb_running++;
+            lock.unlock();
+            work(*job, slot);
+            lock.lock();
+            if( --job->_nb_running == 0 )
+                _done.notify_all();
+        }
+    }
+
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    std::vector<Loop_job*> _jobs;  ///< published loops
+    std::vector<std::thread> _threads;
+    bool _stop;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Call 'func(chunk_idx)' for every chunk index in [0 nb_chunks)
+/// Chunks are dynamically distributed to the threads
+template<class Func>
+void parallel_for_chunks(int nb_chunks, Func func)
+{
+    int nb_threads = std::min(int(get_nb_threads()), nb_chunks);
+    if( nb_threads <= 1 ) {
+        for(int i = 0; i < nb_chunks; ++i)
+            func(i);
+        return;
+    }
+
+    Loop_workers::Loop_job job;
+    job._run = [](void* ctx, int chunk) { (*static_cast<Func*>(ctx))(chunk); };
+    job._ctx = &func;
+    job._scope = current_trace_scope();
+    job._nb_chunks = nb_chunks;
+    job._max_helpers = nb_threads - 1;
+    job._next_chunk = 0;
+    job._nb_helpers = 0;
+    job._nb_running = 0;
+    Loop_workers::instance().run( job );
+}
+
+// -----------------------------------------------------------------------------
+
+/// Split [begin end) in contiguous ranges and call 'func(range_begin, range_end)'
+/// on each of them in parallel.
+/// @param grain : minimal number of elements per range
+template<class Func>
+void parallel_for_ranges(int begin, int end, Func func, int grain = 1024)
+{
+    int size = end - begin;
+    if( size <= 0 )
+        return;
+    // A few ranges per thread to balance the load
+    int nb_ranges = std::min(int(get_nb_threads()) * 4, (size + grain - 1) / grain);
+    nb_ranges = std::max(nb_ranges, 1);
+    parallel_for_chunks(nb_ranges, [&](int r) {
+        int b = begin + int( (long long)size *  r      / nb_ranges );
+        int e = begin + int( (long long)size * (r + 1) / nb_ranges );
+        func(b, e);
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+/// Call 'func(i)' for every i in [begin end) in parallel
+template<class Func>
+void parallel_for(int begin, int end, Func func, int grain = 1024)
+{
+    parallel_for_ranges(begin, end, [&](int b, int e) {
+        for(int i = b; i < e; ++i)
+            func(i);
+    }, grain);
+}
+
+#endif // PARALLEL_FOR_HPP
@@ -0,0 +1,140 @@
+#ifndef TASK_GRAPH_HPP
+#define TASK_GRAPH_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "utils/parallel_for.hpp"
+#include "utils/trace.hpp"
+
+/**
+ * @brief Tasks with dependencies, run on several threads as soon as their
+ * dependencies are done.
+ *
+ * Unlike successive parallel_for() there is no barrier between the stages
+ * of a computation: a task of stage 2 starts when the few tasks of stage 1
+ * it reads are over, while the rest of stage 1 is still running.
+ * @code
+ * Task_graph graph;
+ * int a = graph.add("parse", [&]{ return parse(0); });
+ * int b = graph.add("parse", [&]{ return parse(1); });
+ * graph.add("merge", [&]{ merge(); return true; }, {a, b});
+ * bool ok = graph.run();
+ * @endcode
+ * Tasks return false on error: tasks not started yet are then skipped and
+ * run() returns false. Ready tasks start in the order they were added.
+ * When tracing, each task records a span named after it on the lane of its
+ * worker thread.
+ */
+class Task_graph {
+public:
+    Task_graph() { }
+
+    Task_graph(const Task_graph&) = delete;
+    Task_graph& operator=(const Task_graph&) = delete;
+
+    /// @param name : of the trace span (must outlive the trace)
+    /// @param deps : tasks that must be over before 'func' starts
+    /// @return index of the task, to be used in the 'deps' of later tasks
+    int add(const char* name,
+            std::function<bool()> func,
+            const std::vector<int>& deps = std::vector<int>())
+    {
+        int id = int(_tasks.size());
+        _tasks.emplace_back();
+        Task& task = _tasks.back();
+        task._name = name;
+        task._func = std::move(func);
+        task._nb_deps = int(deps.size());
+        for(int d : deps)
+            _tasks[d]._successors.push_back( id );
+        return id;
+    }
+
+    int size() const { return int(_tasks.size()); }
+
+    /// Run every task then clear the graph
+    /// @param nb_threads : 0 means get_nb_threads()
+    /// @return false if a task failed
+    bool run(unsigned nb_threads = 0)
+    {
+        if( nb_threads == 0 )
+            nb_threads = get_nb_threads();
+        nb_threads = std::max(1u, std::min(nb_threads, unsigned(_tasks.size())));
+
+        _nb_left = int(_tasks.size());
+        _failed = false;
+        _ready.clear();
+        for(int i = 0; i < int(_tasks.size()); ++i)
+            if( _tasks[i]._nb_deps == 0 )
+                _ready.push_back( i );
+
+        std::vector<std::thread> threads;
+        threads.reserve(nb_threads - 1);
+        for(unsigned t = 1; t < nb_threads; ++t)
+            threads.emplace_back( [this, t]{ work(int(t)); } );
+        work(0);
+        for(std::thread& t : threads)
+            t.join();
+
+        bool ok = !_failed;
+        _tasks.clear();
+        return ok;
+    }
+
+private:
+    struct Task {
+        const char* _name;
+        std::function<bool()> _func;
+        std::vector<int> _successors;
+        int _nb_deps; ///< not done yet (guarded by _mutex)
+    };
+
+    /// Run ready tasks until every task is over
+    /// @param slot : 0 for the thread which called run()
+    void work(int slot)
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while( true ) {
+            _wake.wait(lock, [this]{ return _nb_left == 0 || !_ready.empty(); });
+            if( _nb_left == 0 )
+                return;
+            int id = _ready.front();
+            _ready.pop_front();
+            Task& task = _tasks[id];
+            bool skip = _failed;
+            lock.unlock();
+
+            bool ok = true;
+            if( !skip ) {
+                Trace_worker_scope trace(is_tracing() ? task._name : nullptr, slot);
+                ok = task._func();
+            }
+
+            lock.lock();
+            if( !ok )
+                _failed = true;
+            // Successors of a skipped task are skipped as well, but still
+            // go through the queue to be counted
+            for(int s : task._successors)
+                if( --_tasks[s]._nb_deps == 0 )
+                    _ready.push_back( s );
+            if( --_nb_left == 0 || !_ready.empty() )
+                _wake.notify_all();
+        }
+    }
+
+    std::deque<Task> _tasks;
+    std::deque<int> _ready;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    int _nb_left;
+    bool _failed;
+};
+
+#endif // TASK_GRAPH_HPP
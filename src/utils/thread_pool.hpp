@@ -0,0 +1,107 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed set of threads running queued tasks in FIFO order.
+ *
+ * Unlike parallel_for() the caller does not wait: tasks are meant to be
+ * long lived and independent (e.g. one client connection of the solve
+ * service).
+ * @code
+ * Thread_pool pool(4);
+ * pool.submit([&]{ process(connection); });
+ * pool.wait_idle();
+ * @endcode
+ * The destructor runs the remaining tasks then joins the threads.
+ */
+class Thread_pool {
+public:
+    /// @param nb_threads : 0 means every hardware thread
+    explicit Thread_pool(unsigned nb_threads)
+        : _nb_busy(0)
+        , _stop(false)
+    {
+        if( nb_threads == 0 )
+            nb_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        _threads.reserve(nb_threads);
+        for(unsigned t = 0; t < nb_threads; ++t)
+            _threads.emplace_back( [this]{ run(); } );
+    }
+
+    ~Thread_pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for(std::thread& t : _threads)
+            t.join();
+    }
+
+    Thread_pool(const Thread_pool&) = delete;
+    Thread_pool& operator=(const Thread_pool&) = delete;
+
+    void submit(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _tasks.push_back( std::move(task) );
+        }
+        _wake.notify_one();
+    }
+
+    /// Block until the queue is empty and no task is running
+    void wait_idle()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _idle.wait(lock, [this]{ return _tasks.empty() && _nb_busy == 0; });
+    }
+
+    unsigned size() const { return unsigned(_threads.size()); }
+
+    /// Tasks waiting for a thread
+    size_t nb_pending() const
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _tasks.size();
+    }
+
+private:
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while( true ) {
+            _wake.wait(lock, [this]{ return _stop || !_tasks.empty(); });
+            if( _tasks.empty() )
+                return; // _stop
+            std::function<void()> task = std::move( _tasks.front() );
+            _tasks.pop_front();
+            _nb_busy++;
+            lock.unlock();
+            task();
+            lock.lock();
+            _nb_busy--;
+            if( _tasks.empty() && _nb_busy == 0 )
+                _idle.notify_all();
+        }
+    }
+
+    mutable std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+    std::deque<std::function<void()>> _tasks;
+    std::vector<std::thread> _threads;
+    unsigned _nb_busy;
+    bool _stop;
+};
+
+#endif // THREAD_POOL_HPP
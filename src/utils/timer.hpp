@@ -0,0 +1,31 @@
+#ifndef TIMER_HPP
+#define TIMER_HPP
+
+#include <chrono>
+
+/// @brief Wall clock timer, started at construction
+struct Timer {
+    typedef std::chrono::steady_clock Clock;
+
+    Timer() { start(); }
+
+    void start() { _start = Clock::now(); }
+
+    /// @return seconds since the last start()
+    double elapsed() const {
+        return std::chrono::duration<double>(Clock::now() - _start).count();
+    }
+
+    /// @return seconds since the last start() and restart the timer
+    double lap() {
+        Clock::time_point now = Clock::now();
+        double sec = std::chrono::duration<double>(now - _start).count();
+        _start = now;
+        return sec;
+    }
+
+private:
+    Clock::time_point _start;
+};
+
+#endif // TIMER_HPP
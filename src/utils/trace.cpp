@@ -0,0 +1,184 @@
+#include "utils/trace.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include "utils/json.hpp"
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+struct Trace_event {
+    const char* _name;
+    const char* _category;
+    long long _begin; ///< nanoseconds since start_tracing()
+    long long _end;
+    int _lane;
+};
+
+/// Lanes of parallel_for() workers start here, other threads are numbered
+/// from 0 in the order they record their first span
+const int g_worker_lane_base = 1000;
+
+std::mutex g_mutex;
+std::vector<Trace_event> g_events;
+std::set<std::string> g_names; ///< see trace_name()
+std::atomic<long long> g_origin(0);
+std::atomic<int> g_next_lane(0);
+
+thread_local int t_lane = -1;
+thread_local const char* t_scope = nullptr;
+
+long long clock_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+long long now_ns() { return clock_ns() - g_origin.load(std::memory_order_relaxed); }
+
+int thread_lane()
+{
+    if( t_lane < 0 )
+        t_lane = g_next_lane.fetch_add(1);
+    return t_lane;
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+void start_tracing()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        g_events.clear();
+    }
+    g_origin = clock_ns();
+    tracing_flag() = true;
+}
+
+// -----------------------------------------------------------------------------
+
+void stop_tracing()
+{
+    tracing_flag() = false;
+}
+
+// -----------------------------------------------------------------------------
+
+unsigned nb_trace_events()
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return unsigned(g_events.size());
+}
+
+// -----------------------------------------------------------------------------
+
+const char* trace_name(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(g_mutex);
+    return g_names.insert( name ).first->c_str();
+}
+
+// -----------------------------------------------------------------------------
+
+const char* current_trace_scope()
+{
+    return is_tracing() ? t_scope : nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+bool write_trace(const char* file_name)
+{
+    Json_value events = Json_value::array();
+    std::set<int> lanes;
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        for(const Trace_event& e : g_events)
+        {
+            Json_value ev = Json_value::object();
+            ev["name"] = e._name;
+            ev["cat"] = e._category;
+            ev["ph"] = "X";
+            ev["ts"] = double(e._begin) * 1e-3;
+            ev["dur"] = double(e._end - e._begin) * 1e-3;
+            ev["pid"] = 1;
+            ev["tid"] = e._lane;
+            events.push_back( ev );
+            lanes.insert( e._lane );
+        }
+    }
+
+    // Name the lanes
+    for(int lane : lanes)
+    {
+        char name[32];
+        if( lane >= g_worker_lane_base )
+            std::snprintf(name, sizeof(name), "worker %d", lane - g_worker_lane_base);
+        else
+            std::snprintf(name, sizeof(name), "thread %d", lane);
+        Json_value ev = Json_value::object();
+        ev["name"] = "thread_name";
+        ev["ph"] = "M";
+        ev["pid"] = 1;
+        ev["tid"] = lane;
+        ev["args"]["name"] = name;
+        events.push_back( ev );
+    }
+
+    Json_value doc = Json_value::object();
+    doc["traceEvents"] = events;
+    doc["displayTimeUnit"] = "ms";
+    return write_json_file(file_name, doc);
+}
+
+// =============================================================================
+
+void Trace_scope::begin(const char* name, const char* category, bool account_memory)
+{
+    _name = name;
+    _category = category;
+    _parent = t_scope;
+    _restore_lane = false;
+    _traced = is_tracing();
+    _memory_phase = -1;
+    if( account_memory && is_accounting_memory() )
+        _memory_phase = begin_memory_phase(name);
+    t_scope = name;
+    _start = now_ns();
+}
+
+// -----------------------------------------------------------------------------
+
+void Trace_scope::end()
+{
+    Trace_event e = {_name, _category, _start, now_ns(), thread_lane()};
+    t_scope = _parent;
+    if( _restore_lane )
+        t_lane = _prev_lane;
+    end_memory_phase( _memory_phase );
+    if( !_traced )
+        return;
+    std::lock_guard<std::mutex> lock(g_mutex);
+    g_events.push_back( e );
+}
+
+// =============================================================================
+
+Trace_worker_scope::Trace_worker_scope(const char* parent_scope, int worker_slot)
+    : _scope(nullptr)
+{
+    if( parent_scope == nullptr || !is_tracing() )
+        return;
+    _scope.begin(parent_scope, "worker", false);
+    // Slot 0 is the thread which called parallel_for(): keep its lane
+    if( worker_slot > 0 ) {
+        _scope._restore_lane = true;
+        _scope._prev_lane = t_lane;
+        t_lane = g_worker_lane_base + worker_slot;
+    }
+}
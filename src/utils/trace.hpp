@@ -0,0 +1,113 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <atomic>
+#include <string>
+
+#include "utils/memory_report.hpp"
+
+/**
+ * @brief Scoped timers recording the phases of the program, exported in the
+ * Chrome trace event format (open the file in chrome://tracing or
+ * https://ui.perfetto.dev).
+ *
+ * @code
+ * start_tracing();
+ * {
+ *     Trace_scope scope("factorization");
+ *     solver.factorize( A );
+ * }
+ * write_trace("trace.json");
+ * @endcode
+ * When tracing is off a Trace_scope costs two relaxed atomic loads.
+ * Each thread has its own lane. Workers of parallel_for() record a span
+ * named after the scope that started the loop (see Trace_worker_scope),
+ * so load imbalance and serial parts of parallel phases are visible.
+ * Scopes are also the phases of the memory accounting (see
+ * memory_report.hpp).
+ *
+ * @warning names must outlive the trace: use string literals or
+ * trace_name()
+ */
+
+// -----------------------------------------------------------------------------
+
+/// Storage for the tracing state
+inline std::atomic<bool>& tracing_flag() {
+    static std::atomic<bool> on(false);
+    return on;
+}
+
+/// @return true between start_tracing() and stop_tracing()
+inline bool is_tracing() { return tracing_flag().load(std::memory_order_relaxed); }
+
+/// Clear previously recorded spans and start recording
+void start_tracing();
+
+/// Stop recording (spans are kept until the next start_tracing())
+void stop_tracing();
+
+/// Number of spans recorded so far
+unsigned nb_trace_events();
+
+/// Write the recorded spans as a Chrome trace JSON file
+/// @return false on error (message printed on std::cerr)
+bool write_trace(const char* file_name);
+
+/// @return a copy of 'name' kept until the end of the program, to name
+/// spans with strings built at run time (mesh names...)
+const char* trace_name(const std::string& name);
+
+/// @return name of the innermost Trace_scope opened by the calling thread,
+/// nullptr if none or if tracing is off
+const char* current_trace_scope();
+
+// -----------------------------------------------------------------------------
+
+/// @brief Record the span between construction and destruction
+struct Trace_scope {
+    explicit Trace_scope(const char* name, const char* category = "phase")
+        : _name(nullptr)
+    {
+        if( name != nullptr && (is_tracing() || is_accounting_memory()) )
+            begin(name, category, true);
+    }
+
+    ~Trace_scope() {
+        if( _name != nullptr )
+            end();
+    }
+
+    Trace_scope(const Trace_scope&) = delete;
+    Trace_scope& operator=(const Trace_scope&) = delete;
+
+private:
+    void begin(const char* name, const char* category, bool account_memory);
+    void end();
+
+    const char* _name;     ///< nullptr when not recording
+    bool _traced;
+    int _memory_phase;     ///< -1 when not accounted
+    const char* _category;
+    const char* _parent;   ///< enclosing scope of the thread
+    long long _start;      ///< nanoseconds since start_tracing()
+    bool _restore_lane;    ///< worker scopes only
+    int _prev_lane;
+
+    friend struct Trace_worker_scope;
+};
+
+// -----------------------------------------------------------------------------
+
+/// @brief Span of a worker thread of parallel_for(): recorded on the lane
+/// of the worker slot and named after the scope of the calling thread
+/// ('parent_scope' as given by current_trace_scope()).
+/// Does nothing if 'parent_scope' is null.
+struct Trace_worker_scope {
+    Trace_worker_scope(const char* parent_scope, int worker_slot);
+
+private:
+    Trace_scope _scope;
+};
+
+#endif // TRACE_HPP
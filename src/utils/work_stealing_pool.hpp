@@ -0,0 +1,182 @@
+#ifndef WORK_STEALING_POOL_HPP
+#define WORK_STEALING_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Thread pool where each worker has its own queue of tasks.
+ *
+ * A worker runs the most recent task of its own queue first (LIFO: what
+ * it just submitted is still in cache) and, once it is empty, steals the
+ * oldest task of another worker. Tasks submitted from a worker go to its
+ * own queue, so a task splitting its work in sub tasks (e.g. one solve per
+ * boundary preset of a mesh) keeps them local unless other workers are
+ * idle. Tasks submitted from other threads are spread round robin.
+ * @code
+ * Work_stealing_pool pool(8);
+ * for(Job& job : jobs)
+ *     pool.submit([&job, &pool]{
+ *         load(job);
+ *         for(Preset& p : job._presets)
+ *             pool.submit([&job, &p]{ solve(job, p); });
+ *     });
+ * pool.wait_idle();
+ * @endcode
+ * Unlike Thread_pool, order is not FIFO.
+ */
+class Work_stealing_pool {
+public:
+    typedef std::function<void()> Task;
+
+    /// @param nb_threads : 0 means every hardware thread
+    explicit Work_stealing_pool(unsigned nb_threads)
+        : _nb_queued(0)
+        , _nb_unfinished(0)
+        , _nb_steals(0)
+        , _next_queue(0)
+        , _stop(false)
+    {
+        if( nb_threads == 0 )
+            nb_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        for(unsigned t = 0; t < nb_threads; ++t)
+            _queues.emplace_back( new Queue() );
+        _threads.reserve(nb_threads);
+        for(unsigned t = 0; t < nb_threads; ++t)
+            _threads.emplace_back( [this, t]{ run(int(t)); } );
+    }
+
+    /// Runs the remaining tasks then joins the threads
+    ~Work_stealing_pool()
+    {
+        wait_idle();
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for(std::thread& t : _threads)
+            t.join();
+    }
+
+    Work_stealing_pool(const Work_stealing_pool&) = delete;
+    Work_stealing_pool& operator=(const Work_stealing_pool&) = delete;
+
+    void submit(Task task)
+    {
+        int w = worker_index();
+        Queue& queue = (w >= 0 && w < int(_queues.size()) && t_pool() == this) ?
+                    *_queues[w] :
+                    *_queues[_next_queue.fetch_add(1) % _queues.size()];
+        _nb_unfinished++;
+        {
+            std::lock_guard<std::mutex> lock(queue._mutex);
+            queue._tasks.push_back( std::move(task) );
+        }
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _nb_queued++;
+        }
+        _wake.notify_one();
+    }
+
+    /// Block until every task, including the tasks they submitted, is done
+    /// @warning not from a task of the pool
+    void wait_idle()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _idle.wait(lock, [this]{ return _nb_unfinished == 0; });
+    }
+
+    unsigned size() const { return unsigned(_threads.size()); }
+
+    /// Tasks run by another worker than the one they were queued on
+    size_t nb_steals() const { return _nb_steals; }
+
+    /// @return index of the calling worker in [0 size()) or -1 when not
+    /// called from a worker (of any pool)
+    static int worker_index() { return t_worker(); }
+
+private:
+    struct Queue {
+        std::mutex _mutex;
+        std::deque<Task> _tasks;
+    };
+
+    static int& t_worker() { thread_local int w = -1; return w; }
+    static Work_stealing_pool*& t_pool() { thread_local Work_stealing_pool* p = nullptr; return p; }
+
+    /// Pop from the back of our queue or the front of another one
+    bool pop(int w, Task& task)
+    {
+        {
+            Queue& own = *_queues[w];
+            std::lock_guard<std::mutex> lock(own._mutex);
+            if( !own._tasks.empty() ) {
+                task = std::move( own._tasks.back() );
+                own._tasks.pop_back();
+                return true;
+            }
+        }
+        const int nb = int(_queues.size());
+        for(int i = 1; i < nb; ++i) {
+            Queue& other = *_queues[(w + i) % nb];
+            std::lock_guard<std::mutex> lock(other._mutex);
+            if( !other._tasks.empty() ) {
+                task = std::move( other._tasks.front() );
+                other._tasks.pop_front();
+                _nb_steals++;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(int w)
+    {
+        t_worker() = w;
+        t_pool() = this;
+        while( true ) {
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _wake.wait(lock, [this]{ return _stop || _nb_queued > 0; });
+                if( _nb_queued == 0 )
+                    return; // _stop
+                // Claim one of the queued tasks
+                _nb_queued--;
+            }
+            // Tasks are pushed before being counted: a claimed task is
+            // always in one of the queues
+            Task task;
+            while( !pop(w, task) )
+                std::this_thread::yield();
+            task();
+            task = nullptr;
+
+            if( --_nb_unfinished == 0 ) {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _idle.notify_all();
+            }
+        }
+    }
+
+    std::vector< std::unique_ptr<Queue> > _queues;
+    std::vector<std::thread> _threads;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _idle;
+    int _nb_queued;                    ///< guarded by _mutex
+    std::atomic<int> _nb_unfinished;
+    std::atomic<size_t> _nb_steals;
+    std::atomic<unsigned> _next_queue;
+    bool _stop;
+};
+
+#endif // WORK_STEALING_POOL_HPP
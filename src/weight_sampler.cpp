@@ -0,0 +1,156 @@
+#include "weight_sampler.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "utils/memory_usage.hpp"
+#include "utils/parallel_for.hpp"
+#include "utils/trace.hpp"
+
+// -----------------------------------------------------------------------------
+
+/// Points located one after another by a thread, in Morton order
+static const int g_locate_chunk_size = 512;
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Spread the 21 low bits of 'v' every third bit
+uint64_t spread_bits(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8)  & 0x100f00f00f00f00full;
+    v = (v | v << 4)  & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2)  & 0x1249249249249249ull;
+    return v;
+}
+
+// -----------------------------------------------------------------------------
+
+/// @return indices of 'points' sorted along a Morton curve of their bounding box
+std::vector<int> morton_order(const std::vector<Vec3>& points)
+{
+    const int nb = int(points.size());
+    Aabb box;
+    for(const Vec3& p : points)
+        box.add( p );
+    Vec3 extent = box._max - box._min;
+    float size = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-30f));
+    const float scale = float((1 << 21) - 1) / size;
+
+    std::vector<std::pair<uint64_t, int> > codes( nb );
+    parallel_for(0, nb, [&](int i) {
+        Vec3 c = (points[i] - box._min) * scale;
+        codes[i].first = spread_bits(uint64_t(c.x)) | spread_bits(uint64_t(c.y)) << 1 |
+                         spread_bits(uint64_t(c.z)) << 2;
+        codes[i].second = i;
+    });
+    std::sort(codes.begin(), codes.end());
+
+    std::vector<int> order( nb );
+    for(int i = 0; i < nb; ++i)
+        order[i] = codes[i].second;
+    return order;
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+void Weight_sampler::build(const Mesh& mesh)
+{
+    Trace_scope trace("build_weight_sampler");
+    _index.clear();
+    _index.build_triangles(mesh._vertices, mesh._triangles);
+    _triangles = mesh._triangles;
+}
+
+// -----------------------------------------------------------------------------
+
+void Weight_sampler::locate(const std::vector<Vec3>& points, Point_locations& out) const
+{
+    Trace_scope trace("locate_points");
+    const int nb = int(points.size());
+    out._corners.resize( 3 * size_t(nb) );
+    out._bary.resize( 3 * size_t(nb) );
+    out._distance.resize( nb );
+    if( nb == 0 || empty() )
+        return;
+
+    const std::vector<int> order = morton_order( points );
+    const int nb_chunks = (nb + g_locate_chunk_size - 1) / g_locate_chunk_size;
+    parallel_for_chunks(nb_chunks, [&](int chunk) {
+        const int end = std::min(nb, (chunk + 1) * g_locate_chunk_size);
+        Surface_point prev;
+        for(int i = chunk * g_locate_chunk_size; i < end; ++i)
+        {
+            const int p = order[i];
+            const Vec3& pos = points[p];
+            // The previous projection is on the surface: the closest point
+            // is at most that far (slightly more for rounding)
+            Surface_point hit;
+            bool found = prev._tri >= 0 &&
+                         _index.closest_point(pos, hit, (pos - prev._pos).norm() * 1.0001f + 1e-20f);
+            if( !found )
+                _index.closest_point(pos, hit);
+            prev = hit;
+
+            const Tri_face& tri = _triangles[hit._tri];
+            for(int k = 0; k < 3; ++k) {
+                out._corners[3 * size_t(p) + k] = tri[k];
+                out._bary[3 * size_t(p) + k] = hit._bary[k];
+            }
+            out._distance[p] = hit._distance;
+        }
+    });
+}
+
+// -----------------------------------------------------------------------------
+
+void Weight_sampler::interpolate(const Point_locations& locations,
+                                 const double* values,
+                                 int nb_maps,
+                                 double* out) const
+{
+    Trace_scope trace("interpolate_weights");
+    const Vert_idx* corners = locations._corners.data();
+    const float* bary = locations._bary.data();
+    parallel_for_ranges(0, locations.size(), [&](int begin, int end) {
+        for(int p = begin; p < end; ++p)
+        {
+            const double b0 = bary[3 * size_t(p)];
+            const double b1 = bary[3 * size_t(p) + 1];
+            const double b2 = bary[3 * size_t(p) + 2];
+            const double* w0 = values + size_t(corners[3 * size_t(p)]) * nb_maps;
+            const double* w1 = values + size_t(corners[3 * size_t(p) + 1]) * nb_maps;
+            const double* w2 = values + size_t(corners[3 * size_t(p) + 2]) * nb_maps;
+            double* res = out + size_t(p) * nb_maps;
+            for(int m = 0; m < nb_maps; ++m)
+                res[m] = b0 * w0[m] + b1 * w1[m] + b2 * w2[m];
+        }
+    }, 4096);
+}
+
+// -----------------------------------------------------------------------------
+
+void Weight_sampler::sample(const std::vector<Vec3>& points,
+                            const std::vector<double>& weight_map,
+                            std::vector<double>& out) const
+{
+    Point_locations locations;
+    locate(points, locations);
+    out.resize( points.size() );
+    if( empty() ) {
+        std::fill(out.begin(), out.end(), 0.);
+        return;
+    }
+    interpolate(locations, weight_map.data(), 1, out.data());
+}
+
+// -----------------------------------------------------------------------------
+
+size_t Weight_sampler::bytes() const
+{
+    return _index.bytes() + heap_bytes(_triangles);
+}
@@ -0,0 +1,77 @@
+#ifndef WEIGHT_SAMPLER_HPP
+#define WEIGHT_SAMPLER_HPP
+
+#include <vector>
+
+#include "mesh.hpp"
+#include "spatial_index.hpp"
+
+/**
+ * @brief Harmonic weights (or any per vertex values) at points which are
+ * not vertices of the mesh: hair roots, cloth attachments, scattered
+ * instances...
+ *
+ * Each point is projected on the closest triangle and the values of its
+ * corners are blended with the barycentric coordinates of the projection.
+ * @code
+ * Weight_sampler sampler;
+ * sampler.build( mesh );
+ * std::vector<double> root_weights;
+ * sampler.sample(root_positions, harmonic_weight_map, root_weights);
+ * @endcode
+ * Locating the points is the expensive part. A batch is sorted along a
+ * Morton curve and cut in chunks spread over the threads: consecutive
+ * points of a chunk are close, the projection of the previous point bounds
+ * the search of the next one and the nodes of the tree stay in cache.
+ * Locations are kept as structure of arrays (Point_locations) so one
+ * location pass serves any number of weight maps, and interpolate() blends
+ * maps stored interleaved per vertex in a contiguous inner loop the
+ * compiler vectorizes.
+ */
+
+/// Triangle corners and barycentric coordinates of located points
+struct Point_locations {
+    int size() const { return int(_distance.size()); }
+
+    std::vector<Vert_idx> _corners; ///< 3 per point
+    std::vector<float> _bary;       ///< 3 per point, same order as _corners
+    std::vector<float> _distance;   ///< from the point to the surface
+};
+
+// -----------------------------------------------------------------------------
+
+class Weight_sampler {
+public:
+    /// Index the triangles of 'mesh' (in parallel). The sampler keeps a
+    /// copy of what it needs, 'mesh' may change afterwards.
+    void build(const Mesh& mesh);
+
+    bool empty() const { return _triangles.empty(); }
+
+    /// Project 'points' on the surface (in parallel)
+    void locate(const std::vector<Vec3>& points, Point_locations& out) const;
+
+    /// @brief Interpolate values per vertex at located points (in parallel)
+    /// @param values : 'nb_maps' values per vertex,
+    /// values[vertex * nb_maps + map]
+    /// @param[out] out : 'nb_maps' values per point,
+    /// out[point * nb_maps + map] (locations.size() * nb_maps elements)
+    void interpolate(const Point_locations& locations,
+                     const double* values,
+                     int nb_maps,
+                     double* out) const;
+
+    /// locate() then interpolate() one weight map
+    void sample(const std::vector<Vec3>& points,
+                const std::vector<double>& weight_map,
+                std::vector<double>& out) const;
+
+    /// Heap memory (bytes)
+    size_t bytes() const;
+
+private:
+    Spatial_index _index;
+    std::vector<Tri_face> _triangles;
+};
+
+#endif // WEIGHT_SAMPLER_HPP
@@ -0,0 +1,44 @@
+#ifndef TEST_CHECK_HPP
+#define TEST_CHECK_HPP
+
+#include <iostream>
+
+/**
+ * @brief Minimal checks for the test executables (tests/test_*.cpp, run by
+ * ctest). A failed check prints its location and the test goes on, main()
+ * returns test_result().
+ * @code
+ * int main() {
+ *     CHECK( mesh.nb_vertices() == 4 );
+ *     CHECK_MSG( err < 1e-6, "vertex " << i << " error " << err );
+ *     return test_result();
+ * }
+ * @endcode
+ */
+
+/// Number of failed checks
+inline int& test_failures() {
+    static int nb = 0;
+    return nb;
+}
+
+/// @return exit code of the test: 0 when every check passed
+inline int test_result()
+{
+    if( test_failures() > 0 )
+        std::cerr << test_failures() << " check(s) failed" << std::endl;
+    return test_failures() > 0 ? 1 : 0;
+}
+
+#define CHECK_MSG(cond, msg) \
+    do { \
+        if( !(cond) ) { \
+            ++test_failures(); \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " \
+                      << #cond << " (" << msg << ")" << std::endl; \
+        } \
+    } while(0)
+
+#define CHECK(cond) CHECK_MSG(cond, "")
+
+#endif // TEST_CHECK_HPP
@@ -0,0 +1,173 @@
+// Random local edits (Mesh_editor) must leave the topology and the Laplacian
+// rows exactly as a full recompute on the edited mesh would.
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "test_check.hpp"
+#include "mesh_generators.hpp"
+#include "solvers.hpp"
+#include "topology/mesh_edits.hpp"
+#include "topology/vertex_to_face.hpp"
+#include "topology/vertex_to_1st_ring_vertices.hpp"
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Deterministic pseudo random numbers
+struct Lcg {
+    Lcg(unsigned seed) : _state(seed) { }
+    unsigned next(unsigned n) {
+        _state = _state * 1664525u + 1013904223u;
+        return (_state >> 8) % n;
+    }
+    unsigned _state;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Consecutive pairs of an ordered ring (closing pair when not on a side),
+/// as sorted undirected edges: equal for rings listed from another start
+/// or in the other direction
+std::vector<std::pair<int, int> > ring_edges(const std::vector<int>& ring, bool on_side)
+{
+    std::vector<std::pair<int, int> > edges;
+    int nb = int(ring.size());
+    int nb_pairs = on_side ? nb - 1 : nb;
+    for(int i = 0; i < nb_pairs; ++i) {
+        int a = ring[i], b = ring[(i + 1) % nb];
+        edges.push_back( std::make_pair(std::min(a, b), std::max(a, b)) );
+    }
+    std::sort(edges.begin(), edges.end());
+    return edges;
+}
+
+// -----------------------------------------------------------------------------
+
+std::vector<int> sorted(std::vector<int> list)
+{
+    std::sort(list.begin(), list.end());
+    return list;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Sum of the entries of a Laplacian row per column
+std::map<int, double> row_values(const std::vector<Triplet>& row)
+{
+    std::map<int, double> values;
+    for(const Triplet& elt : row)
+        values[ elt.col() ] += elt.value();
+    return values;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Compare the incrementally maintained data to a full recompute
+void check_against_recompute(const Mesh& mesh,
+                             const Vertex_to_face& v_to_face,
+                             const Vertex_to_1st_ring_vertices& first_ring,
+                             const std::vector<std::vector<Triplet>>& mat_elemts,
+                             const char* name)
+{
+    Vertex_to_face ref_v_to_face;
+    ref_v_to_face.compute( mesh );
+    Vertex_to_1st_ring_vertices ref_ring;
+    ref_ring.compute(mesh, ref_v_to_face);
+    std::vector<std::vector<Triplet>> ref_mat = get_laplacian(mesh._vertices, ref_ring._rings_per_vertex);
+
+    const int nv = int(mesh.nb_vertices());
+    CHECK_MSG( int(v_to_face._1st_ring_tris.size()) == nv, name );
+    CHECK_MSG( int(first_ring._rings_per_vertex.size()) == nv, name );
+    CHECK_MSG( int(mat_elemts.size()) == nv, name );
+    if( test_failures() > 0 )
+        return;
+
+    for(int v = 0; v < nv; ++v)
+    {
+        CHECK_MSG( sorted(v_to_face._1st_ring_tris[v]) == sorted(ref_v_to_face._1st_ring_tris[v]),
+                   name << " triangles of vertex " << v );
+        CHECK_MSG( v_to_face._is_vertex_connected[v] == ref_v_to_face._is_vertex_connected[v],
+                   name << " vertex " << v );
+        bool on_side = ref_ring._is_vert_on_side[v];
+        CHECK_MSG( first_ring._is_vert_on_side[v] == on_side, name << " vertex " << v );
+        CHECK_MSG( ring_edges(first_ring._rings_per_vertex[v], on_side) ==
+                   ring_edges(ref_ring._rings_per_vertex[v], on_side),
+                   name << " ring of vertex " << v );
+
+        std::map<int, double> row = row_values( mat_elemts[v] );
+        std::map<int, double> ref_row = row_values( ref_mat[v] );
+        bool same = row.size() == ref_row.size();
+        for(auto it = row.begin(), ref = ref_row.begin(); same && it != row.end(); ++it, ++ref)
+            same = it->first == ref->first &&
+                   std::abs(it->second - ref->second) <= 1e-9 * (1.0 + std::abs(ref->second));
+        CHECK_MSG( same, name << " Laplacian row " << v );
+    }
+    CHECK_MSG( sorted(first_ring._on_side_verts) == sorted(ref_ring._on_side_verts), name );
+    CHECK_MSG( sorted(first_ring._not_manifold_verts) == sorted(ref_ring._not_manifold_verts), name );
+    CHECK_MSG( first_ring._is_mesh_closed == ref_ring._is_mesh_closed, name );
+    CHECK_MSG( first_ring._is_mesh_manifold == ref_ring._is_mesh_manifold, name );
+}
+
+// -----------------------------------------------------------------------------
+
+/// Apply 'nb_edits' random flips, splits and collapses on 'mesh'
+void random_edits(Mesh& mesh, int nb_edits, unsigned seed, const char* name)
+{
+    Vertex_to_face v_to_face;
+    v_to_face.compute( mesh );
+    Vertex_to_1st_ring_vertices first_ring;
+    first_ring.compute(mesh, v_to_face);
+    std::vector<std::vector<Triplet>> mat_elemts = get_laplacian(mesh._vertices, first_ring._rings_per_vertex);
+
+    Mesh_editor editor(mesh, v_to_face, first_ring);
+    Topology_delta delta;
+    Lcg rand(seed);
+    int nb_applied = 0;
+    for(int i = 0; i < nb_edits && mesh.nb_triangles() > 8; ++i)
+    {
+        const Tri_face& tri = mesh._triangles[ rand.next(mesh.nb_triangles()) ];
+        int k = int(rand.next(3));
+        Vert_idx a = tri[k], b = tri[(k + 1) % 3];
+        unsigned op = rand.next(10);
+        bool applied = false;
+        if( op < 4 )
+            applied = editor.flip_edge(a, b, delta);
+        else if( op < 7 )
+            applied = editor.split_edge(a, b, delta) >= 0;
+        else
+            applied = editor.collapse_edge(a, b, delta);
+        nb_applied += applied ? 1 : 0;
+
+        update_laplacian_rows(mesh._vertices, first_ring._rings_per_vertex,
+                              delta._dirty_vertices, mat_elemts);
+        delta.clear();
+        if( i % 100 == 99 )
+            check_against_recompute(mesh, v_to_face, first_ring, mat_elemts, name);
+    }
+    check_against_recompute(mesh, v_to_face, first_ring, mat_elemts, name);
+    CHECK_MSG( nb_applied > nb_edits / 4, name << ": only " << nb_applied << " edits applied" );
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+int main()
+{
+    Mesh grid;
+    generate_jittered_grid(24, 24, 0.3f, 7, grid);
+    random_edits(grid, 1500, 1, "jittered grid");
+
+    Mesh torus;
+    generate_torus(24, 12, 1.0f, 0.3f, torus);
+    random_edits(torus, 1500, 2, "torus");
+
+    Mesh holes;
+    generate_perforated_plane(40, 40, 4, 0.12f, 3, holes);
+    random_edits(holes, 1500, 3, "perforated plane");
+
+    return test_result();
+}
@@ -0,0 +1,174 @@
+// build_mesh_pipelined() must give the same mesh, topology and Laplacian rows
+// as build_mesh() followed by the topology and get_laplacian() phases.
+
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "test_check.hpp"
+#include "mesh.hpp"
+#include "mesh_generators.hpp"
+#include "mesh_pipeline.hpp"
+#include "solvers.hpp"
+#include "io/mesh_cache.hpp"
+#include "topology/vertex_to_face.hpp"
+#include "topology/vertex_to_1st_ring_vertices.hpp"
+#include "utils/parallel_for.hpp"
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Write 'mesh' as an ASCII OFF file. With 'quads', pairs of consecutive
+/// triangles sharing their first and third vertices (the generators emit
+/// grid cells that way) are written as one quad, so that the pipeline
+/// triangulates polygons. Comment lines are spread over the file.
+bool write_off(const std::string& file_name, const Mesh& mesh, bool quads)
+{
+    FILE* file = std::fopen(file_name.c_str(), "w");
+    if( file == nullptr )
+        return false;
+    std::vector<std::vector<int> > faces;
+    for(int t = 0; t < int(mesh.nb_triangles()); ++t) {
+        const Tri_face& a = mesh._triangles[t];
+        if( quads && t + 1 < int(mesh.nb_triangles()) ) {
+            const Tri_face& b = mesh._triangles[t + 1];
+            if( a.a == b.a && a.c == b.b ) {
+                faces.push_back( {a.a, a.b, a.c, b.c} );
+                ++t;
+                continue;
+            }
+        }
+        faces.push_back( {a.a, a.b, a.c} );
+    }
+    std::fprintf(file, "OFF\n# generated by test_mesh_pipeline\n%d %d 0\n",
+                 int(mesh.nb_vertices()), int(faces.size()));
+    for(int v = 0; v < int(mesh.nb_vertices()); ++v) {
+        const Vec3& p = mesh._vertices[v];
+        std::fprintf(file, "%.9g %.9g %.9g\n", p.x, p.y, p.z);
+        if( v % 5000 == 4999 )
+            std::fprintf(file, "# vertex %d\n", v);
+    }
+    for(size_t f = 0; f < faces.size(); ++f) {
+        std::fprintf(file, "%d", int(faces[f].size()));
+        for(int v : faces[f])
+            std::fprintf(file, " %d", v);
+        std::fprintf(file, "\n");
+    }
+    return std::fclose(file) == 0;
+}
+
+// -----------------------------------------------------------------------------
+
+bool same_rows(const std::vector<Triplet>& a, const std::vector<Triplet>& b)
+{
+    if( a.size() != b.size() )
+        return false;
+    for(size_t i = 0; i < a.size(); ++i)
+        if( a[i].row() != b[i].row() || a[i].col() != b[i].col() || a[i].value() != b[i].value() )
+            return false;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Load 'file_name' both ways and compare everything
+void check_pipeline(const std::string& file_name, bool laplacian_from_triangles, const char* name)
+{
+    std::unique_ptr<Mesh> ref_mesh( build_mesh(file_name.c_str()) );
+    CHECK_MSG( ref_mesh != nullptr, name );
+    if( ref_mesh == nullptr )
+        return;
+    Vertex_to_face ref_v_to_face;
+    ref_v_to_face.compute( *ref_mesh );
+    Vertex_to_1st_ring_vertices ref_ring;
+    std::vector<std::vector<Triplet>> ref_mat;
+    if( laplacian_from_triangles ) {
+        ref_mat = get_laplacian(ref_mesh->_vertices, ref_mesh->_triangles);
+    } else {
+        ref_ring.compute(*ref_mesh, ref_v_to_face);
+        ref_mat = get_laplacian(ref_mesh->_vertices, ref_ring._rings_per_vertex);
+    }
+
+    Mesh mesh;
+    Vertex_to_face v_to_face;
+    Vertex_to_1st_ring_vertices first_ring;
+    std::vector<std::vector<Triplet>> mat_elemts;
+    bool ok = build_mesh_pipelined(file_name.c_str(), laplacian_from_triangles,
+                                   mesh, v_to_face, first_ring, mat_elemts);
+    CHECK_MSG( ok, name );
+    if( !ok )
+        return;
+
+    CHECK_MSG( mesh._vertices.size() == ref_mesh->_vertices.size(), name );
+    CHECK_MSG( mesh._triangles.size() == ref_mesh->_triangles.size(), name );
+    CHECK_MSG( int(mat_elemts.size()) == int(ref_mesh->nb_vertices()), name );
+    if( test_failures() > 0 )
+        return;
+    for(int v = 0; v < int(mesh.nb_vertices()); ++v) {
+        const Vec3& p = mesh._vertices[v];
+        const Vec3& q = ref_mesh->_vertices[v];
+        CHECK_MSG( p.x == q.x && p.y == q.y && p.z == q.z, name << " vertex " << v );
+    }
+    for(int t = 0; t < int(mesh.nb_triangles()); ++t) {
+        const Tri_face& a = mesh._triangles[t];
+        const Tri_face& b = ref_mesh->_triangles[t];
+        CHECK_MSG( a.a == b.a && a.b == b.b && a.c == b.c, name << " triangle " << t );
+    }
+
+    CHECK_MSG( v_to_face._1st_ring_tris == ref_v_to_face._1st_ring_tris, name );
+    CHECK_MSG( v_to_face._is_vertex_connected == ref_v_to_face._is_vertex_connected, name );
+    if( laplacian_from_triangles ) {
+        CHECK_MSG( first_ring._rings_per_vertex.empty(), name );
+    } else {
+        CHECK_MSG( first_ring._rings_per_vertex == ref_ring._rings_per_vertex, name );
+        CHECK_MSG( first_ring._is_vert_on_side == ref_ring._is_vert_on_side, name );
+        CHECK_MSG( first_ring._on_side_verts == ref_ring._on_side_verts, name );
+        CHECK_MSG( first_ring._not_manifold_verts == ref_ring._not_manifold_verts, name );
+        CHECK_MSG( first_ring._is_mesh_closed == ref_ring._is_mesh_closed, name );
+        CHECK_MSG( first_ring._is_mesh_manifold == ref_ring._is_mesh_manifold, name );
+    }
+    for(int v = 0; v < int(mesh.nb_vertices()); ++v)
+        CHECK_MSG( same_rows(mat_elemts[v], ref_mat[v]), name << " Laplacian row " << v );
+}
+
+// -----------------------------------------------------------------------------
+
+void check_mesh(const Mesh& mesh, bool quads, const char* name)
+{
+    std::string file_name = (std::filesystem::temp_directory_path() / "test_mesh_pipeline.off").string();
+    CHECK_MSG( write_off(file_name, mesh, quads), name << ": can't write " << file_name );
+    check_pipeline(file_name, false, name);
+    check_pipeline(file_name, true, name);
+    std::remove( file_name.c_str() );
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+int main()
+{
+    // The cache would give build_mesh() the topology of a previous file
+    set_mesh_cache_enabled(false);
+    // Several chunks of faces and blocks of vertices (at least 16K each)
+    set_nb_threads(4);
+
+    Mesh torus;
+    generate_torus(300, 150, 1.0f, 0.3f, torus);
+    check_mesh(torus, false, "torus");
+
+    Mesh holes;
+    generate_perforated_plane(230, 230, 6, 0.1f, 5, holes);
+    check_mesh(holes, false, "perforated plane");
+
+    Mesh grid;
+    generate_jittered_grid(210, 210, 0.3f, 11, grid);
+    check_mesh(grid, true, "jittered grid of quads");
+
+    Mesh small;
+    generate_grid(7, 5, small);
+    check_mesh(small, true, "small grid");
+
+    return test_result();
+}
@@ -0,0 +1,229 @@
+// Spatial_index queries (region, nearest, k nearest and closest point) must
+// give the results of a brute force scan over every vertex and triangle.
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "test_check.hpp"
+#include "mesh_generators.hpp"
+#include "spatial_index.hpp"
+#include "utils/parallel_for.hpp"
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Deterministic pseudo random numbers
+struct Lcg {
+    Lcg(unsigned seed) : _state(seed) { }
+    unsigned next(unsigned n) {
+        _state = _state * 1664525u + 1013904223u;
+        return (_state >> 8) % n;
+    }
+    /// Uniform in [lo hi]
+    float uniform(float lo, float hi) { return lo + (hi - lo) * float(next(1u << 20)) / float(1u << 20); }
+    unsigned _state;
+};
+
+// -----------------------------------------------------------------------------
+
+struct Dvec {
+    Dvec(const Vec3& v) : x(v.x), y(v.y), z(v.z) { }
+    Dvec(double x_, double y_, double z_) : x(x_), y(y_), z(z_) { }
+    Dvec operator-(const Dvec& v) const { return Dvec(x - v.x, y - v.y, z - v.z); }
+    Dvec operator+(const Dvec& v) const { return Dvec(x + v.x, y + v.y, z + v.z); }
+    Dvec operator*(double s) const { return Dvec(x * s, y * s, z * s); }
+    double dot(const Dvec& v) const { return x * v.x + y * v.y + z * v.z; }
+    double x, y, z;
+};
+
+/// Distance from 'p' to the segment [a b]
+double segment_distance(const Dvec& p, const Dvec& a, const Dvec& b)
+{
+    Dvec ab = b - a;
+    double len2 = ab.dot(ab);
+    double t = len2 > 0. ? std::min(1., std::max(0., (p - a).dot(ab) / len2)) : 0.;
+    Dvec d = p - (a + ab * t);
+    return std::sqrt( d.dot(d) );
+}
+
+/// Distance from 'p' to the triangle (a, b, c): to its plane when the
+/// projection falls inside, to the closest edge otherwise (not the
+/// algorithm of Spatial_index)
+double triangle_distance(const Dvec& p, const Dvec& a, const Dvec& b, const Dvec& c)
+{
+    Dvec ab = b - a, ac = c - a, ap = p - a;
+    double d00 = ab.dot(ab), d01 = ab.dot(ac), d11 = ac.dot(ac);
+    double d20 = ap.dot(ab), d21 = ap.dot(ac);
+    double denom = d00 * d11 - d01 * d01;
+    if( denom > 1e-30 ) {
+        double v = (d11 * d20 - d01 * d21) / denom;
+        double w = (d00 * d21 - d01 * d20) / denom;
+        if( v >= 0. && w >= 0. && v + w <= 1. ) {
+            Dvec d = p - (a + ab * v + ac * w);
+            return std::sqrt( d.dot(d) );
+        }
+    }
+    return std::min(segment_distance(p, a, b),
+                    std::min(segment_distance(p, b, c), segment_distance(p, c, a)));
+}
+
+// -----------------------------------------------------------------------------
+
+/// Every query at 'nb_queries' random points of the (enlarged) bounding box
+/// and at the vertices of 'mesh'
+void check_queries(const Mesh& mesh, int nb_queries, unsigned seed, const char* name)
+{
+    const int nv = int(mesh.nb_vertices());
+    const int nt = int(mesh.nb_triangles());
+    Spatial_index index;
+    index.build( mesh );
+    CHECK_MSG( index.nb_vertices() == nv, name );
+    CHECK_MSG( index.nb_triangles() == nt, name );
+
+    const std::vector<Vec3>& verts = mesh._vertices;
+    Aabb bounds;
+    for(const Vec3& p : verts)
+        bounds.add( p );
+    CHECK_MSG( index.bounds()._min == bounds._min && index.bounds()._max == bounds._max, name );
+    const Vec3 size = bounds._max - bounds._min;
+    const float diag = size.norm();
+    const float eps = 1e-5f * diag;
+
+    Lcg rand(seed);
+    for(int q = 0; q < nb_queries; ++q)
+    {
+        Vec3 pos;
+        if( q % 4 == 3 ) {
+            pos = verts[ rand.next(unsigned(verts.size())) ];
+        } else {
+            pos = Vec3(rand.uniform(bounds._min.x - 0.2f * size.x, bounds._max.x + 0.2f * size.x),
+                       rand.uniform(bounds._min.y - 0.2f * size.y, bounds._max.y + 0.2f * size.y),
+                       rand.uniform(bounds._min.z - 0.2f * size.z, bounds._max.z + 0.2f * size.z));
+        }
+
+        // Brute force distances to every vertex, sorted
+        std::vector<float> dists( verts.size() );
+        for(size_t v = 0; v < verts.size(); ++v)
+            dists[v] = (verts[v] - pos).norm();
+        std::vector<float> sorted_dists = dists;
+        std::sort(sorted_dists.begin(), sorted_dists.end());
+
+        float nearest_dist = -1.f;
+        Vert_idx nearest = index.nearest_vertex(pos, &nearest_dist);
+        CHECK_MSG( nearest >= 0 && nearest < nv, name << " query " << q );
+        if( nearest >= 0 && nearest < nv ) {
+            CHECK_MSG( std::abs(dists[nearest] - sorted_dists[0]) <= eps,
+                       name << " query " << q << ": nearest vertex at " << dists[nearest] <<
+                       " instead of " << sorted_dists[0] );
+            CHECK_MSG( std::abs(nearest_dist - dists[nearest]) <= eps, name << " query " << q );
+        }
+
+        const int k = 1 + int(rand.next(24));
+        std::vector<std::pair<Vert_idx, float> > knn;
+        index.k_nearest_vertices(pos, k, knn);
+        CHECK_MSG( int(knn.size()) == std::min(k, nv), name << " query " << q );
+        std::vector<Vert_idx> seen;
+        for(int i = 0; i < int(knn.size()); ++i) {
+            Vert_idx v = knn[i].first;
+            CHECK_MSG( v >= 0 && v < nv, name << " query " << q );
+            if( v < 0 || v >= nv )
+                continue;
+            seen.push_back( v );
+            // Ties may be listed in any order: compare the distances
+            CHECK_MSG( std::abs(knn[i].second - dists[v]) <= eps, name << " query " << q << " neighbor " << i );
+            CHECK_MSG( std::abs(dists[v] - sorted_dists[i]) <= eps,
+                       name << " query " << q << " neighbor " << i << ": " << dists[v] <<
+                       " instead of " << sorted_dists[i] );
+            CHECK_MSG( i == 0 || knn[i - 1].second <= knn[i].second, name << " query " << q );
+        }
+        std::sort(seen.begin(), seen.end());
+        CHECK_MSG( std::unique(seen.begin(), seen.end()) == seen.end(), name << " query " << q << ": duplicates" );
+
+        // Regions: same expressions as the index, so the same vertices
+        float radius = rand.uniform(0.f, 0.3f) * diag;
+        std::vector<Vert_idx> in_sphere, ref_sphere;
+        index.vertices_in_sphere(pos, radius, in_sphere);
+        for(int v = 0; v < nv; ++v)
+            if( (verts[v] - pos).norm_squared() <= radius * radius )
+                ref_sphere.push_back( v );
+        std::sort(in_sphere.begin(), in_sphere.end());
+        CHECK_MSG( in_sphere == ref_sphere, name << " query " << q << ": " << in_sphere.size() <<
+                   " vertices in the sphere instead of " << ref_sphere.size() );
+
+        Aabb box(pos - Vec3(radius, 0.5f * radius, 2.f * radius), pos + Vec3(0.5f * radius, radius, radius));
+        std::vector<Vert_idx> in_box, ref_box;
+        index.vertices_in_box(box, in_box);
+        for(int v = 0; v < nv; ++v)
+            if( box.contains(verts[v]) )
+                ref_box.push_back( v );
+        std::sort(in_box.begin(), in_box.end());
+        CHECK_MSG( in_box == ref_box, name << " query " << q << ": " << in_box.size() <<
+                   " vertices in the box instead of " << ref_box.size() );
+
+        // Closest point on the surface
+        double ref_dist = 1e30;
+        for(const Tri_face& tri : mesh._triangles)
+            ref_dist = std::min(ref_dist, triangle_distance(pos, verts[tri.a], verts[tri.b], verts[tri.c]));
+        Surface_point hit;
+        bool found = index.closest_point(pos, hit);
+        CHECK_MSG( found && hit._tri >= 0 && hit._tri < nt, name << " query " << q );
+        if( !found || hit._tri < 0 || hit._tri >= nt )
+            continue;
+        CHECK_MSG( std::abs(double(hit._distance) - ref_dist) <= eps,
+                   name << " query " << q << ": closest point at " << hit._distance <<
+                   " instead of " << ref_dist );
+        const Tri_face& tri = mesh._triangles[hit._tri];
+        Vec3 from_bary = verts[tri.a] * hit._bary.x + verts[tri.b] * hit._bary.y + verts[tri.c] * hit._bary.z;
+        CHECK_MSG( (from_bary - hit._pos).norm() <= eps, name << " query " << q << ": barycentric coordinates" );
+        CHECK_MSG( std::abs((hit._pos - pos).norm() - hit._distance) <= eps, name << " query " << q );
+        CHECK_MSG( hit._bary.x >= -1e-5f && hit._bary.y >= -1e-5f && hit._bary.z >= -1e-5f &&
+                   std::abs(hit._bary.x + hit._bary.y + hit._bary.z - 1.f) <= 1e-4f,
+                   name << " query " << q << ": barycentric coordinates" );
+
+        // Nothing closer than the closest point
+        if( ref_dist > 1e-3 * diag ) {
+            Surface_point none;
+            CHECK_MSG( !index.closest_point(pos, none, float(ref_dist) * 0.99f), name << " query " << q );
+        }
+    }
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+int main()
+{
+    // Trees whose first levels are built in parallel
+    set_nb_threads(4);
+
+    Mesh sphere;
+    generate_icosphere(24, sphere);
+    check_queries(sphere, 300, 1, "icosphere");
+
+    Mesh torus;
+    generate_torus(80, 30, 1.0f, 0.3f, torus);
+    check_queries(torus, 300, 2, "torus");
+
+    // Regular grid: many vertices at the same distance
+    Mesh grid;
+    generate_grid(60, 40, grid);
+    check_queries(grid, 300, 3, "grid");
+
+    Mesh holes;
+    generate_perforated_plane(70, 70, 4, 0.12f, 4, holes);
+    check_queries(holes, 300, 4, "perforated plane");
+
+    Mesh empty;
+    Spatial_index index;
+    index.build( empty );
+    Surface_point hit;
+    std::vector<std::pair<Vert_idx, float> > knn;
+    index.k_nearest_vertices(Vec3(0.f), 3, knn);
+    CHECK( index.nearest_vertex(Vec3(0.f)) == -1 );
+    CHECK( knn.empty() );
+    CHECK( !index.closest_point(Vec3(0.f), hit) );
+
+    return test_result();
+}
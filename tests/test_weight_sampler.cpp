@@ -0,0 +1,201 @@
+// Weight_sampler must return, for every point, the barycentric blend of the
+// vertex values over its closest triangle, whatever the number of maps and
+// the order of the points.
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "test_check.hpp"
+#include "mesh_generators.hpp"
+#include "weight_sampler.hpp"
+#include "utils/parallel_for.hpp"
+
+// -----------------------------------------------------------------------------
+
+namespace {
+
+/// Deterministic pseudo random numbers
+struct Lcg {
+    Lcg(unsigned seed) : _state(seed) { }
+    unsigned next(unsigned n) {
+        _state = _state * 1664525u + 1013904223u;
+        return (_state >> 8) % n;
+    }
+    /// Uniform in [lo hi]
+    float uniform(float lo, float hi) { return lo + (hi - lo) * float(next(1u << 20)) / float(1u << 20); }
+    unsigned _state;
+};
+
+// -----------------------------------------------------------------------------
+
+/// Points of known triangles at known barycentric coordinates (corners,
+/// edges and interiors), some pushed off the surface along the normal
+struct Samples {
+    std::vector<Vec3> _points;
+    std::vector<Tri_idx> _tris;
+    std::vector<Vec3> _bary;
+    std::vector<float> _offsets; ///< distance to the surface along the normal
+};
+
+Samples generate_samples(const Mesh& mesh, int nb, float max_offset, unsigned seed)
+{
+    Samples s;
+    Lcg rand(seed);
+    for(int i = 0; i < nb; ++i) {
+        Tri_idx t = Tri_idx( rand.next(unsigned(mesh.nb_triangles())) );
+        const Tri_face& tri = mesh._triangles[t];
+        Vec3 bary;
+        switch( i % 4 ) {
+        case 0:  bary = Vec3(1.f, 0.f, 0.f); break; // vertex
+        case 1: {                                   // edge
+            float u = rand.uniform(0.f, 1.f);
+            bary = Vec3(u, 1.f - u, 0.f);
+        } break;
+        default: {                                  // interior
+            float u = rand.uniform(0.f, 1.f), v = rand.uniform(0.f, 1.f);
+            if( u + v > 1.f ) { u = 1.f - u; v = 1.f - v; }
+            bary = Vec3(u, v, 1.f - u - v);
+        } break;
+        }
+        const Vec3& a = mesh._vertices[tri.a];
+        const Vec3& b = mesh._vertices[tri.b];
+        const Vec3& c = mesh._vertices[tri.c];
+        Vec3 pos = a * bary.x + b * bary.y + c * bary.z;
+        // Off the surface only above interiors, where the closest point of
+        // a convex enough surface stays the projection
+        float offset = i % 4 == 3 ? rand.uniform(0.f, max_offset) : 0.f;
+        pos += (b - a).cross(c - a).normalized() * offset;
+        s._points.push_back( pos );
+        s._tris.push_back( t );
+        s._bary.push_back( bary );
+        s._offsets.push_back( offset );
+    }
+    return s;
+}
+
+// -----------------------------------------------------------------------------
+
+/// 'nb_maps' values per vertex: a linear field (interpolated exactly) and
+/// random values
+std::vector<double> vertex_values(const Mesh& mesh, int nb_maps, unsigned seed)
+{
+    Lcg rand(seed);
+    std::vector<double> values( size_t(mesh.nb_vertices()) * nb_maps );
+    for(int v = 0; v < int(mesh.nb_vertices()); ++v) {
+        const Vec3& p = mesh._vertices[v];
+        values[size_t(v) * nb_maps] = 0.5 + 0.3 * p.x - 0.2 * p.y + 0.7 * p.z;
+        for(int m = 1; m < nb_maps; ++m)
+            values[size_t(v) * nb_maps + m] = double(rand.uniform(-1.f, 1.f));
+    }
+    return values;
+}
+
+// -----------------------------------------------------------------------------
+
+/// Sample 'nb_maps' interleaved maps and compare every result with the
+/// direct barycentric evaluation
+void check_sampler(const Mesh& mesh, int nb_maps, float max_offset, unsigned seed, const char* name)
+{
+    Weight_sampler sampler;
+    sampler.build( mesh );
+    CHECK_MSG( !sampler.empty(), name );
+
+    const int nv = int(mesh.nb_vertices());
+    Samples samples = generate_samples(mesh, 4000, max_offset, seed);
+    std::vector<double> values = vertex_values(mesh, nb_maps, seed + 1);
+    const int nb = int(samples._points.size());
+
+    Point_locations loc;
+    sampler.locate(samples._points, loc);
+    CHECK_MSG( loc.size() == nb, name );
+    CHECK_MSG( int(loc._corners.size()) == 3 * nb && int(loc._bary.size()) == 3 * nb, name );
+    if( test_failures() > 0 )
+        return;
+
+    std::vector<double> out( size_t(nb) * nb_maps );
+    sampler.interpolate(loc, values.data(), nb_maps, out.data());
+
+    for(int i = 0; i < nb; ++i)
+    {
+        // Located on a triangle of the mesh, at the expected distance
+        const Vert_idx* corners = &loc._corners[3 * size_t(i)];
+        const float* bary = &loc._bary[3 * size_t(i)];
+        bool valid = true;
+        for(int k = 0; k < 3; ++k)
+            valid = valid && corners[k] >= 0 && corners[k] < nv && bary[k] >= -1e-5f;
+        CHECK_MSG( valid, name << " point " << i );
+        if( !valid )
+            continue;
+        CHECK_MSG( std::abs(bary[0] + bary[1] + bary[2] - 1.f) <= 1e-4f, name << " point " << i );
+        CHECK_MSG( std::abs(loc._distance[i] - samples._offsets[i]) <= 1e-4f,
+                   name << " point " << i << ": distance " << loc._distance[i] <<
+                   " instead of " << samples._offsets[i] );
+
+        // Output of interpolate() against the returned location
+        for(int m = 0; m < nb_maps; ++m) {
+            double direct = 0.;
+            for(int k = 0; k < 3; ++k)
+                direct += double(bary[k]) * values[size_t(corners[k]) * nb_maps + m];
+            double got = out[size_t(i) * nb_maps + m];
+            CHECK_MSG( std::abs(got - direct) <= 1e-9 * (1. + std::abs(direct)),
+                       name << " point " << i << " map " << m << ": " << got << " instead of " << direct );
+        }
+
+        // Against the known triangle: any triangle holding the projection
+        // gives the same blend of the linear field and, inside the known
+        // triangle, of every map
+        const Tri_face& tri = mesh._triangles[ samples._tris[i] ];
+        const Vec3& b = samples._bary[i];
+        for(int m = 0; m < nb_maps; ++m) {
+            double expected = double(b.x) * values[size_t(tri.a) * nb_maps + m] +
+                              double(b.y) * values[size_t(tri.b) * nb_maps + m] +
+                              double(b.z) * values[size_t(tri.c) * nb_maps + m];
+            bool interior = b.x > 0.05f && b.y > 0.05f && b.z > 0.05f;
+            if( m > 0 && !interior && i % 4 != 0 )
+                continue; // edge points: the neighbor triangle is as close
+            double got = out[size_t(i) * nb_maps + m];
+            CHECK_MSG( std::abs(got - expected) <= 1e-4 * (1. + std::abs(expected)),
+                       name << " point " << i << " map " << m << ": " << got << " instead of " << expected );
+        }
+    }
+
+    // One map at a time gives the interleaved results
+    for(int m = 0; m < nb_maps; ++m) {
+        std::vector<double> map( nv );
+        for(int v = 0; v < nv; ++v)
+            map[v] = values[size_t(v) * nb_maps + m];
+        std::vector<double> single;
+        sampler.sample(samples._points, map, single);
+        CHECK_MSG( int(single.size()) == nb, name );
+        bool same = int(single.size()) == nb;
+        for(int i = 0; same && i < nb; ++i)
+            same = single[i] == out[size_t(i) * nb_maps + m];
+        CHECK_MSG( same, name << " map " << m << " sampled alone" );
+    }
+}
+
+}// END ANONYMOUS NAMESPACE ====================================================
+
+int main()
+{
+    set_nb_threads(4);
+
+    // Planar: points pushed off the surface still project inside their
+    // triangle
+    Mesh grid;
+    generate_jittered_grid(80, 60, 0.3f, 5, grid);
+    check_sampler(grid, 1, 0.5f, 1, "jittered grid, 1 map");
+    check_sampler(grid, 5, 0.5f, 2, "jittered grid, 5 maps");
+
+    Mesh holes;
+    generate_perforated_plane(60, 60, 3, 0.1f, 7, holes);
+    check_sampler(holes, 8, 0.2f, 3, "perforated plane, 8 maps");
+
+    // Curved: only tiny offsets keep the projection on the same triangle
+    Mesh sphere;
+    generate_icosphere(20, sphere);
+    check_sampler(sphere, 3, 1e-4f, 4, "icosphere, 3 maps");
+
+    return test_result();
+}